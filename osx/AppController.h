@@ -20,6 +20,7 @@
 
 #import <Cocoa/Cocoa.h>
 class ApplicationController;
+class ApplicationControllerObserver;
 
 @interface AppController : NSObject
 {
@@ -53,6 +54,7 @@ class ApplicationController;
 	IBOutlet NSButton *clearLedsButton;
 	
 	ApplicationController *_appController;
+	ApplicationControllerObserver *_observer;
 }
 - (IBAction)cableOrientationSelected:(id)sender;
 - (IBAction)deviceSelected:(id)sender;
@@ -16,17 +16,50 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+#import "AppController.h"
 #include "ApplicationController.h"
 #include <sstream>
 using namespace std;
 
+// forwards the routing core's state changes to the window.  they arrive on the core's
+// notification thread, so each one is passed to the main thread without waiting.  the
+// window only ever shows the selected device, so which device changed doesn't matter here.
+class AppControllerObserver : public ApplicationControllerObserver
+{
+public:
+    AppControllerObserver(AppController *appController) : _appController(appController) {}
+
+    virtual void deviceListChanged(void) { _update(@selector(updateDeviceList)); }
+    virtual void midiDeviceListChanged(void) { _update(@selector(updateMIDIDevices)); }
+
+    virtual void addressPatternPrefixChanged(const string& serialNumber) { _update(@selector(updateOscAddressPatternPrefix)); }
+    virtual void cableOrientationChanged(const string& serialNumber) { _update(@selector(updateCableOrientation)); }
+    virtual void offsetChanged(const string& serialNumber) { _update(@selector(updateOscStartRowAndColumn)); }
+    virtual void adcStatesChanged(const string& serialNumber) { _update(@selector(updateAdcStates)); }
+    virtual void encStatesChanged(const string& serialNumber) { _update(@selector(updateEncStates)); }
+    virtual void midiInputDeviceChanged(const string& serialNumber) { _update(@selector(updateMIDIDevices)); }
+    virtual void midiOutputDeviceChanged(const string& serialNumber) { _update(@selector(updateMIDIDevices)); }
+
+private:
+    void _update(SEL selector)
+    {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        [_appController performSelectorOnMainThread:selector withObject:nil waitUntilDone:NO];
+        [pool release];
+    }
+
+private:
+    AppController *_appController;
+};
+
 @implementation AppController
 
 - (id)init
 {
 	if (self = [super init]) {
 		try {
-			_appController = new ApplicationController(self);
+			_observer = new AppControllerObserver(self);
+			_appController = new ApplicationController(_observer);
 		}
 		catch (const char *error) {
 			NSString *aString = [NSString stringWithCString:error encoding:NSASCIIStringEncoding];
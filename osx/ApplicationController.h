@@ -20,15 +20,23 @@
 #define __ApplicationController_h__
 
 #include "MonomeXXhDevice.h"
+#include "LedCanvas.h"
+#include "InputSubscriptions.h"
+#include "MessageBatch.h"
 #include "AsynchronousSerialDeviceReader.h"
 #include "OscController.h"
 #include "MonomeSerialDefaults.h"
+#include "EventScheduler.h"
+#include "ApplicationControllerObserver.h"
+#include "CoalescingObserver.h"
+#include "OscAddressPattern.h"
+
+#include <pthread.h>
 
 #include <vector>
+#include <map>
 using namespace std;
 
-#import "AppController.h"
-
 class ApplicationController
 {
 public:
@@ -39,7 +47,7 @@ public:
     } ProtocolType;
     
 public:
-    ApplicationController(AppController *appController);
+    ApplicationController(ApplicationControllerObserver *observer);   // observer may be 0
     ~ApplicationController();
 	
 	void registerForSerialDeviceNotifications(void);
@@ -53,6 +61,8 @@ public:
     void handleButtonPressEvent(MonomeXXhDevice *device, unsigned int localColumn, unsigned int localRow, bool state);
     void handleAdcValueChangeEvent(MonomeXXhDevice *device, unsigned int localAdcIndex, float value);
     void handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps);
+    void handleEncoderSendEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex);
+    void handleSensorRetryEvent(MonomeXXhDevice *device, unsigned int sensor);
 	void handleTiltValueChangeEvent(MonomeXXhDevice *device, int WhichAxis, int value);
 	//for mk
 	void handleAuxVersionReportEvent(MonomeXXhDevice *device, int version);
@@ -65,6 +75,11 @@ public:
     void handleMIDIReceivedOnVirtualDestination(const MIDIPacketList *packetList, CCoreMIDIEndpointRef source);
     void handleMIDIReceived(const MIDIPacketList *packetList, CCoreMIDIEndpointRef source);
     void handleMIDISystemStateChanged(const MIDINotification *message);
+    void handleScheduledMIDILedEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+    void handleLedAnimationEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+    void handleAutoSwapEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+    void handleSwapEvent(MonomeXXhDevice *device, double milliseconds);
+    void handleFlowEvent(MonomeXXhDevice *device);
 
     // Handlers for UI events:
     void protocolPopUpMenuChanged(unsigned int index);
@@ -114,10 +129,138 @@ public:
 private:
     void _initCoreMIDI(void);
     void _handleOscSystemMessage(const string& addressPattern, list <OscAtom *> *atoms);
+    void _handleOscSubscribeMessage(const string &prefix, const string &suffix, list <OscAtom *> *atoms);
     void _initOpenSoundControl(void);
     bool _typeCheckOscAtoms(list<OscAtom *>& atoms, const char *typetags);
     bool _typeCheckRowOrColumnMessage(list<OscAtom *>& atoms);
-	void _handleMIDIMessage(MonomeXXhDevice *device, unsigned char status, unsigned char data1, unsigned char data2);
+    bool _typeCheckAnimationMessage(list<OscAtom *>& atoms);
+    bool _typeCheckBlitMessage(list<OscAtom *>& atoms);
+
+    // the rectangle of osc coordinates covered by every device in devices
+    void _ledBounds(const vector<MonomeXXhDevice *> &devices, unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height);
+    // the leds of every device in devices, as one bitmap over the osc coordinates they
+    // cover.  the reads and the write back go under one LedsLock of the devices.
+    LedBitmap _readLedBitmap(const vector<MonomeXXhDevice *> &devices);
+    void _writeLedBitmap(const vector<MonomeXXhDevice *> &devices, const LedBitmap &bitmap);
+
+    // the next step of a device's led animation, or its next automatic swap, for the led scheduler
+    typedef struct {
+        unsigned int generation;
+        HostTime time;          // when the step is due
+    } LedAnimationStep;
+
+    void _startLedAnimation(MonomeXXhDevice *device, const LedAnimation &animation);
+    void _setDoubleBuffered(MonomeXXhDevice *device, bool doubleBuffered, unsigned int autoSwapInterval);
+
+    // charges each device a message went to its flow credit once the message has been
+    // handled, however handling it returns
+    class FlowCharge {
+    public:
+        FlowCharge(ApplicationController *controller, const vector<MonomeXXhDevice *> &devices) : _controller(controller), _devices(devices) { }
+        ~FlowCharge();
+
+    private:
+        ApplicationController *_controller;
+        const vector<MonomeXXhDevice *> &_devices;
+    };
+
+    // holds the leds of every device a canvas operation reads, changes and writes back, so
+    // nothing drawn on them meanwhile is lost.  only the osc thread holds more than one
+    // device at a time, so taking them in the canvas' order can't deadlock.
+    class LedsLock {
+    public:
+        LedsLock(const vector<MonomeXXhDevice *> &devices);
+        ~LedsLock();
+
+    private:
+        const vector<MonomeXXhDevice *> &_devices;
+    };
+
+    // a short MIDI message, decoded once and then applied to every device listening on its source
+    typedef struct {
+        unsigned char type;     // status with the channel masked off: 0x80, 0x90, 0xB0...
+        unsigned char channel;
+        unsigned char data1;
+        unsigned char data2;
+        HostTime time;          // the packet's timestamp, or when it arrived if that was 0
+    } MIDIInputEvent;
+
+    // an led update from MIDI, copied into the scheduler until its timestamp comes round
+    typedef struct {
+        unsigned char command;  // kMIDILedNote or one of the SysEx led commands
+        unsigned char index;    // note number, row or column
+        unsigned char velocity;
+        uint16 bitMaps[16];
+    } MIDILedEvent;
+
+    typedef map<CCoreMIDIEndpointRef, vector<MonomeXXhDevice *> > MIDIInputIndex;
+
+    enum { kMaxMIDIInputEvents = 128, kMaxMIDISysExSize = 64 };
+
+    // bulk led SysEx, documented in README.md:
+    //   F0 7D 6D <command << 4 | channel> [row or column] <bitmap, 7 bits per byte> F7
+    enum {
+        kMIDISysExManufacturerID = 0x7D,    // reserved for non-commercial use
+        kMIDISysExMonomeID = 0x6D,          // 'm'
+        kMIDISysExHeaderSize = 4,
+        kMIDISysExLedRow = 1,
+        kMIDISysExLedColumn = 2,
+        kMIDISysExLedFrame = 3,
+        kMIDISysExLedLatency = 4,       // F0 7D 6D <4 << 4 | channel> <ms, low 7 bits> <ms, high 7 bits> F7
+        kMIDISysExEncInterval = 5,      // same layout, in milliseconds
+        kMIDISysExEncAccel = 6,         // same layout, in hundredths
+        kMIDISysExSensorFilter = 7,     // <input> <deadband, thousandths> <interval, ms> <smoothing> <amount, hundredths>, 14 bit values
+        kMIDILedNote = 0
+    };
+
+	void _handleMIDIMessage(MonomeXXhDevice *device, const MIDIInputEvent &event);
+    void _dispatchMIDIInputEvents(MonomeXXhDevice *const *targets, unsigned int numTargets, const MIDIInputEvent *events, unsigned int numEvents);
+    void _dispatchMIDISysEx(MonomeXXhDevice *const *targets, unsigned int numTargets, const unsigned char *data, unsigned int length, HostTime time);
+    void _handleMIDISysEx(MonomeXXhDevice *device, unsigned char command, const unsigned char *data, unsigned int length, HostTime time);
+    void _scheduleMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event, HostTime time);
+    void _applyMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event);
+    void _rebuildMIDIInputIndex(void);
+
+    // a device that drops off keeps what it was showing this long, so coming back in time
+    // puts the grid back as it was without the clients redrawing
+    enum { kDeviceRestoreGracePeriod = 60000 };     // milliseconds
+
+    typedef struct {
+        MonomeXXhDevice::OutputState state;
+        HostTime time;      // when it dropped off
+    } DetachedDevice;
+
+    bool _restoreDetachedDevice(MonomeXXhDevice *device);
+
+    // the canvas of devices with prefix, rebuilt when a device comes or goes or moves; 0 if none
+    LedCanvas *_canvasForPrefix(const string &prefix);
+    void _updateCanvases(void);
+
+    // a compiled prefix pattern and the prefixes it matched when the canvases were last rebuilt
+    enum { kMaxPrefixPatterns = 32 };
+
+    typedef struct {
+        OscAddressPattern pattern;
+        unsigned long canvasesGeneration;
+        vector<string> prefixes;
+    } PrefixPattern;
+
+    // the prefixes of the present devices that pattern matches
+    const vector<string> &_prefixesMatching(const string &pattern);
+
+    void _handleMessageBatch(MonomeXXhDevice *device, const MessageBatch &batch);
+    void _handleButtonPressRun(MonomeXXhDevice *device, const MessageBatch &batch, unsigned int first, unsigned int count);
+
+    void _accumulateEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps, HostTime time);
+    void _sendEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex);
+    void _filterSensorSample(MonomeXXhDevice *device, unsigned int sensor, float sample, HostTime time);
+    void _sendSensorValue(MonomeXXhDevice *device, unsigned int sensor, float value);
+
+    // sends a key, encoder or analog message time stamped with the serial read it came from,
+    // however the device's input timestamps are set, to the host and to the subscribers that
+    // want it.  localColumn and localRow pick the subscribers to a key press.
+    void _sendInputMessage(MonomeXXhDevice *device, const string &addressPattern, list<OscAtom *> *atoms, HostTime time, InputSubscriptions::Event event, unsigned int localColumn = 0, unsigned int localRow = 0);
+    NtpTime _ntpTimeFromHostTime(HostTime time) const;
 
 private:
     ProtocolType _protocol;
@@ -131,12 +274,54 @@ private:
 
     vector<MonomeXXhDevice *> _devices;
 
+    // source endpoint -> devices with that MIDI input, rebuilt whenever a device or its input changes
+    MIDIInputIndex _midiInputIndex;
+    pthread_mutex_t _midiInputIndexLock;
+
+    // serial number -> devices that dropped off in the last kDeviceRestoreGracePeriod
+    map<string, DetachedDevice> _detachedDevices;
+
+    // osc prefix -> its devices' canvas, only touched on the osc thread
+    map<string, LedCanvas> _canvases;
+    unsigned long _canvasLayoutGeneration;
+    int32_t _canvasDevicesGeneration;
+    unsigned long _canvasesGeneration;      // bumped after every rebuild of _canvases
+
+    // prefix pattern -> its compiled form and matches, only touched on the osc thread
+    map<string, PrefixPattern> _prefixPatterns;
+    // the matches of the pattern being handled and each expanded address, kept across
+    // messages so expanding a pattern doesn't allocate once they have grown to fit
+    enum { kMaxMatchedPrefixes = 64 };
+    vector<string> _matchedPrefixes;
+    string _expandedAddressPattern;
+    volatile int32_t _devicesGeneration;     // bumped after every change to _devices
+
+    // plays incoming MIDI led events at their timestamp plus the device's latency
+    EventScheduler _ledScheduler;
+
+    // sends accumulated encoder steps and held back sensor values once their interval is up.  the
+    // encoder, adc and tilt handlers keep their atoms in statics, so sends from here and the serial
+    // thread take _inputSendLock.
+    EventScheduler _inputScheduler;
+    pthread_mutex_t _inputSendLock;
+
+    // destinations besides the host that take some of each prefix's input
+    InputSubscriptions _inputSubscriptions;
+
+    // host time and the wall clock read together at launch.  time stamps count on from
+    // there in host time, so they never jump when the wall clock is set.
+    HostTime _clockHostTime;
+    NtpTime _clockNtpTime;
+
     AsynchronousSerialDeviceReader _deviceReader;
 	
     OscController _oscController;
     OscHostRef _oscHostRef;
 
-	AppController *_appController;
+    // the observer is only ever called through _coalescingObserver, so a client flooding
+    // /sys or /adc_enable messages never waits on it.  0 when there is no observer.
+    ApplicationControllerObserver *_observer;
+    CoalescingObserver _coalescingObserver;
 
     MonomeSerialDefaults *_defaults;
 };
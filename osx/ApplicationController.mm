@@ -21,7 +21,9 @@
 #include "message.h"
 #include "message256.h"
 #include "messageMK.h"
+#include "MessageProtocol.h"
 #include "osc.h"
+#include "RealtimeThread.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -30,8 +32,133 @@
 	 
 #include <iostream>
 #include <sstream>
+#include <limits.h>
+#include <libkern/OSAtomic.h>
 using namespace std;
 
+// the serial number field is fixed length and not always terminated
+static string _serialNumberString(const MonomeXXhDevice *device)
+{
+    const char *serialNumber = device->serialNumber();
+    size_t length = 0;
+
+    while (length < kMonomeXXhDevice_SerialNumberLength && serialNumber[length] != 0)
+        length++;
+
+    return string(serialNumber, length);
+}
+
+static bool _inputTimestampsFromString(const string &name, MonomeXXhDevice::InputTimestamps &timestamps)
+{
+    if (name == kOscInputTimestampsOff)
+        timestamps = MonomeXXhDevice::kInputTimestamps_Off;
+    else if (name == kOscInputTimestampsBundle)
+        timestamps = MonomeXXhDevice::kInputTimestamps_Bundle;
+    else if (name == kOscInputTimestampsArgument)
+        timestamps = MonomeXXhDevice::kInputTimestamps_Argument;
+    else
+        return false;
+
+    return true;
+}
+
+static bool _flowModeFromString(const string &name, MonomeXXhDevice::FlowMode &mode)
+{
+    if (name == kOscFlowOff)
+        mode = MonomeXXhDevice::kFlow_Off;
+    else if (name == kOscFlowReport)
+        mode = MonomeXXhDevice::kFlow_Report;
+    else if (name == kOscFlowCredit)
+        mode = MonomeXXhDevice::kFlow_Credit;
+    else
+        return false;
+
+    return true;
+}
+
+static bool _realtimeThreadClassFromString(const string &name, RealtimeThread::ThreadClass &threadClass)
+{
+    if (name == kOscRealtimeThreadReader)
+        threadClass = RealtimeThread::kThreadClass_Reader;
+    else if (name == kOscRealtimeThreadOsc)
+        threadClass = RealtimeThread::kThreadClass_Osc;
+    else if (name == kOscRealtimeThreadMidi)
+        threadClass = RealtimeThread::kThreadClass_Midi;
+    else if (name == kOscRealtimeThreadTransmit)
+        threadClass = RealtimeThread::kThreadClass_Transmit;
+    else if (name == kOscRealtimeThreadScheduler)
+        threadClass = RealtimeThread::kThreadClass_Scheduler;
+    else
+        return false;
+
+    return true;
+}
+
+static bool _layerBlendFromString(const string &name, MonomeXXhDevice::LayerBlend &blend)
+{
+    if (name == kOscLayerBlendOr)
+        blend = MonomeXXhDevice::kLayerBlend_Or;
+    else if (name == kOscLayerBlendMask)
+        blend = MonomeXXhDevice::kLayerBlend_Mask;
+    else if (name == kOscLayerBlendXor)
+        blend = MonomeXXhDevice::kLayerBlend_Xor;
+    else if (name == kOscLayerBlendReplace)
+        blend = MonomeXXhDevice::kLayerBlend_Replace;
+    else
+        return false;
+
+    return true;
+}
+
+// a comma separated list of press, enc, adc and tilt, or all
+static bool _inputEventsFromString(const string &names, unsigned int &events)
+{
+    string::size_type start = 0, end;
+
+    events = 0;
+
+    do {
+        end = names.find(',', start);
+        string name = names.substr(start, end == string::npos ? string::npos : end - start);
+
+        if (name == kOscInputEventAll)
+            events |= InputSubscriptions::kAllEvents;
+        else if (name == kOscInputEventPress)
+            events |= 1 << InputSubscriptions::kEvent_Press;
+        else if (name == kOscInputEventEnc)
+            events |= 1 << InputSubscriptions::kEvent_Enc;
+        else if (name == kOscInputEventAdc)
+            events |= 1 << InputSubscriptions::kEvent_Adc;
+        else if (name == kOscInputEventTilt)
+            events |= 1 << InputSubscriptions::kEvent_Tilt;
+        else
+            return false;
+
+        start = end + 1;
+    } while (end != string::npos);
+
+    return true;
+}
+
+// splits prefix/layer/<id> into the prefix and the layer id
+static bool _layerFromAddressPatternPrefix(string &prefix, int &layer)
+{
+    string::size_type i = prefix.rfind(kOscDefaultAddrPatternLayerInfix);
+
+    if (i == string::npos)
+        return false;
+
+    string id = prefix.substr(i + strlen(kOscDefaultAddrPatternLayerInfix));
+
+    if (id.empty() || id.size() > 4 || id.find_first_not_of("0123456789") != string::npos)
+        return false;
+
+    layer = atoi(id.c_str());
+    prefix.erase(i);
+
+    return true;
+}
+
 static void _ApplicationController_SerialDeviceDiscoveredCallback(const char *bsdFilePath, void *userData)
 {
     ApplicationController *SELF = (ApplicationController *)userData;
@@ -47,7 +174,12 @@ static void _ApplicationController_SerialDeviceTerminatedCallback(const char *bs
 static int _ApplicationController_SerialDeviceMessageReceivedCallback(SerialDevice *device, char *data, size_t len, void *userData)
 {
     ApplicationController *SELF = (ApplicationController *)userData;
-    return SELF->handleSerialDeviceMessageReceivedEvent(static_cast<MonomeXXhDevice *>(device), data, len);
+    int result = SELF->handleSerialDeviceMessageReceivedEvent(static_cast<MonomeXXhDevice *>(device), data, len);
+
+    // MIDI generated by the whole burst goes out in one packet list per endpoint
+    SELF->coreMIDI()->flushOutput();
+
+    return result;
 }
 
 static void _ApplicationController_OSCMessageReceivedCallback(const string& addressPattern, list <OscAtom *> *atoms, void *userData)
@@ -69,21 +201,78 @@ static void _ApplicationController_MIDIReceivedCallback(const MIDIPacketList *pa
 }
 
 
+static void _ApplicationController_EncoderSendCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleEncoderSendEvent((MonomeXXhDevice *)target, *(const unsigned int *)data);
+}
+
+static void _ApplicationController_SensorRetryCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleSensorRetryEvent((MonomeXXhDevice *)target, *(const unsigned int *)data);
+}
+
+static void _ApplicationController_MIDILedEventCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleScheduledMIDILedEvent((MonomeXXhDevice *)target, data, length);
+}
+
+static void _ApplicationController_LedAnimationCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleLedAnimationEvent((MonomeXXhDevice *)target, data, length);
+}
+
+static void _ApplicationController_AutoSwapCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleAutoSwapEvent((MonomeXXhDevice *)target, data, length);
+}
+
+static void _ApplicationController_SwapCallback(MonomeXXhDevice *device, double milliseconds, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleSwapEvent(device, milliseconds);
+}
+
+static void _ApplicationController_FlowCallback(MonomeXXhDevice *device, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleFlowEvent(device);
+}
+
 static void _ApplicationController_MIDISystemStateChangedCallback(const MIDINotification *message, void *userData)
 {
     ApplicationController *SELF = (ApplicationController *)userData;
     SELF->handleMIDISystemStateChanged(message);
 }
 
-ApplicationController::ApplicationController(AppController *appController)
+ApplicationController::ApplicationController(ApplicationControllerObserver *observer)
+    : _coalescingObserver(observer)
 {
-	_appController = appController;
+    _observer = observer != 0 ? &_coalescingObserver : 0;
+    _coalescingObserver.start();
 	
     _protocol = kProtocolType_MIDI;
 
     _oscHostAddressString = "127.0.0.1";
     _oscHostPort = 8000;
     _oscListenPort = 8080;
+
+    _devicesGeneration = 0;
+    _canvasDevicesGeneration = -1;
+    _canvasLayoutGeneration = 0;
+    _canvasesGeneration = 0;
+    _matchedPrefixes.reserve(kMaxMatchedPrefixes);
+
+    pthread_mutex_init(&_midiInputIndexLock, NULL);
+    pthread_mutex_init(&_inputSendLock, NULL);
+    _clockHostTime = EventScheduler::now();
+    _clockNtpTime = EventScheduler::ntpNow();
+    _ledScheduler.start();
+    _inputScheduler.start();
 	
 	_initOpenSoundControl();
     _initCoreMIDI();
@@ -94,6 +283,9 @@ ApplicationController::ApplicationController(AppController *appController)
 ApplicationController::~ApplicationController()
 {
     _deviceReader.stopReading();
+    _coalescingObserver.stop();
+    _ledScheduler.stop();
+    _inputScheduler.stop();
 
 	if (_defaults != 0)
 		delete _defaults;
@@ -108,6 +300,9 @@ ApplicationController::~ApplicationController()
 	
 	if (_cCoreMIDI != 0)
 		delete _cCoreMIDI;
+
+    pthread_mutex_destroy(&_inputSendLock);
+    pthread_mutex_destroy(&_midiInputIndexLock);
 }
 
 void 
@@ -128,6 +323,8 @@ ApplicationController::handleSerialDeviceDiscoveredEvent(const char *bsdFilePath
 
     device->setMIDIInputDevice(_toMonomeSerial);
     device->setMIDIOutputDevice(_fromMonomeSerial);
+    device->setSwapCallback(_ApplicationController_SwapCallback, this);
+    device->setFlowCallback(_ApplicationController_FlowCallback, this);
 
     _defaults->setDeviceStateFromDefaults(device);
 
@@ -137,10 +334,15 @@ ApplicationController::handleSerialDeviceDiscoveredEvent(const char *bsdFilePath
     device->setMIDIInputPort(port);
 
     _devices.push_back(device);
+    _rebuildMIDIInputIndex();
+    OSAtomicIncrement32Barrier(&_devicesGeneration);
 
     _deviceReader.addSerialDevice(device, device->messageSize(), _ApplicationController_SerialDeviceMessageReceivedCallback, this);
+
+    _restoreDetachedDevice(device);
 	
-	[_appController updateDeviceList];
+    if (_observer != 0)
+        _observer->deviceListChanged();
 }
 
 void 
@@ -153,6 +355,8 @@ ApplicationController::handleSerialDeviceTerminatedEvent(const char *bsdFilePath
 
         if (device->bsdFilePath() == bsdFilePath) {
             _devices.erase(i);
+            _rebuildMIDIInputIndex();
+            OSAtomicIncrement32Barrier(&_devicesGeneration);
 
             if (device != 0) {
                 device->setUnexpectedDeviceRemovalFlag(true);
@@ -160,6 +364,13 @@ ApplicationController::handleSerialDeviceTerminatedEvent(const char *bsdFilePath
 
                 _defaults->setDefaultsFromDeviceState(device);
 
+                _ledScheduler.cancel(device);
+                _inputScheduler.cancel(device);
+
+                DetachedDevice &detached = _detachedDevices[_serialNumberString(device)];
+                device->outputState(detached.state);
+                detached.time = EventScheduler::now();
+
                 delete device;
             }
 
@@ -167,7 +378,103 @@ ApplicationController::handleSerialDeviceTerminatedEvent(const char *bsdFilePath
         }
     }
 
-	[_appController updateDeviceList];
+    if (_observer != 0)
+        _observer->deviceListChanged();
+}
+
+// puts back what device was showing if it dropped off within the grace period, and
+// forgets any other devices that have been gone longer
+bool
+ApplicationController::_restoreDetachedDevice(MonomeXXhDevice *device)
+{
+    map<string, DetachedDevice>::iterator i;
+    HostTime now = EventScheduler::now();
+    HostTime gracePeriod = EventScheduler::hostTimeFromMilliseconds(kDeviceRestoreGracePeriod);
+    string serialNumber = _serialNumberString(device);
+    bool restored = false;
+
+    for (i = _detachedDevices.begin(); i != _detachedDevices.end(); ) {
+        bool expired = now - i->second.time > gracePeriod;
+
+        if (i->first == serialNumber) {
+            if (!expired) {
+                device->restoreOutputState(i->second.state);
+                restored = true;
+            }
+            _detachedDevices.erase(i++);
+        }
+        else if (expired)
+            _detachedDevices.erase(i++);
+        else
+            i++;
+    }
+
+    return restored;
+}
+
+void 
+ApplicationController::_updateCanvases(void)
+{
+    unsigned long layoutGeneration = MonomeXXhDevice::layoutGeneration();
+    int32_t devicesGeneration = _devicesGeneration;
+
+    if (layoutGeneration != _canvasLayoutGeneration || devicesGeneration != _canvasDevicesGeneration) {
+        vector<MonomeXXhDevice *>::iterator i;
+
+        _canvases.clear();
+        for (i = _devices.begin(); i != _devices.end(); i++) {
+            if (*i != 0)
+                _canvases[(*i)->oscAddressPatternPrefix()].addDevice(*i);
+        }
+
+        _canvasLayoutGeneration = layoutGeneration;
+        _canvasDevicesGeneration = devicesGeneration;
+        _canvasesGeneration++;
+    }
+}
+
+LedCanvas *
+ApplicationController::_canvasForPrefix(const string &prefix)
+{
+    _updateCanvases();
+
+    map<string, LedCanvas>::iterator canvas = _canvases.find(prefix);
+
+    return canvas != _canvases.end() ? &canvas->second : 0;
+}
+
+const vector<string> &
+ApplicationController::_prefixesMatching(const string &pattern)
+{
+    _updateCanvases();
+
+    map<string, PrefixPattern>::iterator i = _prefixPatterns.find(pattern);
+
+    if (i == _prefixPatterns.end()) {
+        // a client generating patterns shouldn't grow this without bound
+        if (_prefixPatterns.size() >= kMaxPrefixPatterns)
+            _prefixPatterns.clear();
+
+        i = _prefixPatterns.insert(make_pair(pattern, PrefixPattern())).first;
+        i->second.pattern = OscAddressPattern(pattern);
+        i->second.canvasesGeneration = _canvasesGeneration - 1;
+    }
+
+    PrefixPattern &prefixPattern = i->second;
+
+    if (prefixPattern.canvasesGeneration != _canvasesGeneration) {
+        map<string, LedCanvas>::iterator canvas;
+
+        prefixPattern.prefixes.clear();
+        for (canvas = _canvases.begin(); canvas != _canvases.end(); canvas++) {
+            if (prefixPattern.pattern.match(canvas->first))
+                prefixPattern.prefixes.push_back(canvas->first);
+        }
+
+        prefixPattern.canvasesGeneration = _canvasesGeneration;
+    }
+
+    return prefixPattern.prefixes;
 }
 
 int
@@ -176,176 +483,143 @@ ApplicationController::handleSerialDeviceMessageReceivedEvent(MonomeXXhDevice *d
     if (device == 0)
         return 0;
 
-    if (device->type() == MonomeXXhDevice::kDeviceType_40h) {
-        unsigned int i = 0;
-
-        while (i < len) {
-            t_message *message = (t_message *)data;
-            switch (messageGetType(*message)) {
-            case kMessageTypeButtonPress:
-                handleButtonPressEvent(device, 
-                                       messageGetButtonX(*message), 
-                                       messageGetButtonY(*message),
-                                       messageGetButtonState(*message));
-									   
-                break;
+    const uint8 *message = (const uint8 *)data;
+    unsigned int remaining = (unsigned int)len;
+    unsigned int used;
+    int result = 0;
+    MessageBatch batch;
 
-            case kMessageTypeAdcVal:
-                handleAdcValueChangeEvent(device, messageGetAdcPort(*message), (float)(messageGetAdcVal(*message)) / (float)0x3FF);
-                break;
+    batch.time = device->readTime();
 
-			
-            case kMessageTypeEncVal:
-                handleRotaryEncoderEvent(device, messageGetEncPort(*message), messageGetEncVal(*message));
-                break;
+    // the whole read is decoded at once; a read too big for one batch takes a few passes
+    while (remaining > 0) {
+        bool known;
 
-            default:
-                return -1;
-            }
+        if (device->type() == MonomeXXhDevice::kDeviceType_40h)
+            known = batch.decode40h(message, remaining, used);
+        else //always 2 bytes from 256device
+            known = batch.decodeSeries(message, remaining, used);
 
-            data += device->messageSize();
-            i += device->messageSize();
+        _handleMessageBatch(device, batch);
+
+        if (!known) {
+            result = -1;
+            break;
         }
-    }
-	else  if (device->type() <= MonomeXXhDevice::kDeviceType_mk) //always 2 bytes from 256device
-	 {
-	 
-	      unsigned int i = 0;
-		
-		 
-        while (i < len) {
-            t_message *message = (t_message *)data;
-			
-            switch (messageGetType(*message)) {
-          
-		  
-		  case kMessageType_256_keydown:
-									handleButtonPressEvent(device, 
-                                       messageGetButtonX(*message), 
-                                       messageGetButtonY(*message), 1);
-									   break;
-			
-		   case kMessageType_256_keyup:
-									handleButtonPressEvent(device, 
-                                       messageGetButtonX(*message), 
-                                       messageGetButtonY(*message), 0);
-									   break;	
-									   
-		case kMessageType_256_auxiliaryInput	:
-									handleRotaryEncoderEvent(device, messageGetEncPort(*message), messageGetEncVal(*message));		
-									break;
-									
-			case kMessageTypeTiltEvent:
-			    handleTiltValueChangeEvent(device, 	messageGetTiltAxis(*message),  (messageGetEncVal(*message)));		
-				break;	
-																								
-		  /*
-			 case kMessageTypeButtonPress:
-                handleButtonPressEvent(device, 
-                                       messageGetButtonX(*message), 
-                                       messageGetButtonY(*message),
-                                       messageGetButtonState(*message));
-                break;
 
-            case kMessageTypeAdcVal:
-                handleAdcValueChangeEvent(device, messageGetAdcPort(*message), (float)(messageGetAdcVal(*message)) / (float)0x3FF);
-                break;
+        if (used == 0)
+            break;
 
-            case kMessageTypeEncVal:
-                handleRotaryEncoderEvent(device, messageGetEncPort(*message), messageGetEncVal(*message));
-                break;
-*/
-            default:
-                return -1;
-				
-            }
+        message += used;
+        remaining -= used;
+    }
 
-            data += device->messageSize();
-            i += device->messageSize();
-        }
-    
-	 } //end 256
-	/* else  if (device->type() == MonomeXXhDevice::kDeviceType_mk)
-	{
-		
-		unsigned int i = 0;
-		
-		
-		while (i < len) {
-			t_message *message = (t_message *)data;
-			//t_mk_1byte_message *message_1b = (t_mk_1byte_message *)data;
-			t_mk_3byte_message *message_3b = (t_mk_3byte_message *)data;
-			
-			switch (messageGetType(*message)) {
-					
-					
-				case kMessageType_mk_keydown:
-					handleButtonPressEvent(device, 
-										   messageGetButtonX(*message), 
-										   messageGetButtonY(*message), 1);
-					break;
-					
-				case kMessageType_mk_keyup:
-					handleButtonPressEvent(device, 
-										   messageGetButtonX(*message), 
-										   messageGetButtonY(*message), 0);
-					break;	
-
-					
-				case kMessageTypeTiltEvent:
-					handleTiltValueChangeEvent(device, 	messageGetTiltAxis(*message),  (messageGetEncVal(*message)));		
-					break;	
-					
-				case kMessageType_mk_auxout:
-				{
-					int auxOutType = messageGet_mk_AuxOutType(*message);
-					switch (auxOutType) {
-						case 0:
-							//version
-							handleAuxVersionReportEvent(device, messageGet_mk_Version(*message_3b));
-							break;
-						case 1:
-							//analog
-							handleAuxAnalogValueChangeEvent(device,
-															messageGet_mk_AnalogPort(*message_3b),
-															(float)(messageGet_mk_AnalogValue(*message_3b)) / (float)0x3FF);
-							break;
-						case 2:
-							//digital
-							handleAuxDigitalValueChangeEvent(device,
-															 messageGet_mk_DigitalNumber(*message_3b),
-															 messageGet_mk_DigitalState(*message_3b));
-							break;
-						case 3:
-							//encoder
-							handleAuxEncoderValueChangeEvent(device,
-															 messageGet_mk_EncoderNumber(*message_3b),
-															 messageGet_mk_EncoderChange(*message_3b));
-							break;
-						default:
-							break;
-					}
-				}
+    // encoders without an interval send what the whole read added up to
+    if (device->encoderInterval() == 0) {
+        unsigned int pending = device->pendingEncoders();
 
-				default:
-					return -1;
-					
-			}
-			
-			data += device->messageSize();
-			i += device->messageSize();
-		}
-		
-	} //end mk */
-	
-			 
-	 
+        for (unsigned int n = 0; pending != 0; pending >>= 1, n++) {
+            if (pending & 1)
+                _sendEncoderSteps(device, n);
+        }
+    }
 
 #ifdef DEBUG_PRINT
     cout << "ApplicationController::handleSerialDeviceMessageReceivedEvent" << endl;
 #endif
 
-	return 0;
+    return result;
+}
+
+void 
+ApplicationController::_handleMessageBatch(MonomeXXhDevice *device, const MessageBatch &batch)
+{
+    unsigned int i = 0;
+
+    while (i < batch.count) {
+        switch (batch.type[i]) {
+        case MessageBatch::kEvent_Key:
+            {
+                unsigned int run = batch.keyRunLength(i);
+
+                _handleButtonPressRun(device, batch, i, run);
+                i += run;
+            }
+            continue;
+
+        case MessageBatch::kEvent_Adc:
+            _filterSensorSample(device, MonomeXXhDevice::kSensor_Adc0 + batch.x[i], (float)batch.value[i] / (float)0x3FF, batch.time);
+            break;
+
+        case MessageBatch::kEvent_Encoder:
+            _accumulateEncoderSteps(device, batch.x[i], batch.value[i], batch.time);
+            break;
+
+        case MessageBatch::kEvent_Tilt:
+            _filterSensorSample(device, batch.x[i] == 0 ? MonomeXXhDevice::kSensor_TiltX : MonomeXXhDevice::kSensor_TiltY, batch.value[i], batch.time);
+            break;
+        }
+
+        i++;
+    }
+}
+
+// handleButtonPressEvent for a run of keys: the address pattern, the remap and the midi
+// output are looked up once for the run instead of once per key
+void 
+ApplicationController::_handleButtonPressRun(MonomeXXhDevice *device, const MessageBatch &batch, unsigned int first, unsigned int count)
+{
+    static list<OscAtom *> oscAtomList;
+    static OscAtom atoms[3];
+    unsigned int i;
+
+    if (oscAtomList.size() == 0) {
+        oscAtomList.push_back(&(atoms[0]));
+        oscAtomList.push_back(&(atoms[1]));
+        oscAtomList.push_back(&(atoms[2]));
+    }
+
+    // local echo lights the leds before the presses leave, in one write for the run
+    device->echoButtonPresses(batch.x + first, batch.y + first, batch.value + first, count);
+
+    if (_protocol == kProtocolType_OpenSoundControl) {
+        unsigned int columns[MessageBatch::kMaxEvents], rows[MessageBatch::kMaxEvents];
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Press);
+
+        device->convertLocalCoordinatesToOscCoordinates(batch.x + first, batch.y + first, columns, rows, count);
+
+        // still one message per key, so clients see the same packets as before
+        for (i = 0; i < count; i++) {
+            atoms[0].setValue((int)columns[i]);
+            atoms[1].setValue((int)rows[i]);
+            atoms[2].setValue((int)batch.value[first + i]);
+
+            _sendInputMessage(device, oscAddressPattern, &oscAtomList, batch.time, InputSubscriptions::kEvent_Press, batch.x[first + i], batch.y[first + i]);
+        }
+    }
+    else {
+        CCoreMIDIEndpointRef endpointRef;
+
+        if ((endpointRef = device->MIDIOutputDevice()) == 0)
+            return;
+
+        unsigned char channel = device->MIDIOutputChannel();
+
+        for (i = first; i < first + count; i++) {
+            unsigned int column = batch.x[i], row = batch.y[i];
+            unsigned char MIDINoteNumber = device->convertLocalCoordinatesToMIDINoteNumber(column, row);
+            unsigned char Channelspill = channel;
+
+            //wrap > 127 notes from 256	
+            if (MIDINoteNumber > 127) { //wrap MIDI notes to next channel
+                MIDINoteNumber = (MIDINoteNumber%128); 
+                Channelspill++;
+                if (Channelspill > 16) Channelspill = 1;
+            }
+
+            _cCoreMIDI->queueShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, batch.value[i] ? 127 : 0, device->readTime());
+        }
+    }
 }
 
 void 
@@ -363,16 +637,19 @@ ApplicationController::handleButtonPressEvent(MonomeXXhDevice *device, unsigned
     if (device == 0)
         return;
 
+    device->echoButtonPress(localColumn, localRow, state);
+
     if (_protocol == kProtocolType_OpenSoundControl) {
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternButtonPressSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Press);
+        unsigned int column = localColumn, row = localRow;
 
-        device->convertLocalCoordinatesToOscCoordinates(localColumn, localRow);
+        device->convertLocalCoordinatesToOscCoordinates(column, row);
 
-        atoms[0].setValue((int)localColumn);
-        atoms[1].setValue((int)localRow);
+        atoms[0].setValue((int)column);
+        atoms[1].setValue((int)row);
         atoms[2].setValue(state ? 1 : 0);
 
-        _oscController.send(_oscHostRef, oscAddressPattern, &oscAtomList);
+        _sendInputMessage(device, oscAddressPattern, &oscAtomList, device->readTime(), InputSubscriptions::kEvent_Press, localColumn, localRow);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -393,7 +670,7 @@ ApplicationController::handleButtonPressEvent(MonomeXXhDevice *device, unsigned
 			if (Channelspill > 16) Channelspill = 1;
 			}
 		
-        _cCoreMIDI->sendShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, state ? 127 : 0);
+        _cCoreMIDI->queueShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, state ? 127 : 0, device->readTime());
     }
 
 #ifdef DEBUG_PRINT
@@ -416,12 +693,12 @@ ApplicationController::handleAdcValueChangeEvent(MonomeXXhDevice *device, unsign
         return;
     
     if (_protocol == kProtocolType_OpenSoundControl) {
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternAdcValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Adc);
         
         atoms[0].setValue((int)(device->oscAdcOffset() + localAdcIndex));
         atoms[1].setValue((float)value);
         
-        _oscController.send(_oscHostRef, oscAddressPattern, &oscAtomList);
+        _sendInputMessage(device, oscAddressPattern, &oscAtomList, device->sensorSampleTime(MonomeXXhDevice::kSensor_Adc0 + localAdcIndex), InputSubscriptions::kEvent_Adc);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -437,7 +714,7 @@ ApplicationController::handleAdcValueChangeEvent(MonomeXXhDevice *device, unsign
         else
             ccValue = (unsigned char)(value * 127.f);
                 
-        _cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue);
+        _cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue, device->readTime());
     }
 
 #ifdef DEBUG_PRINT
@@ -464,13 +741,13 @@ ApplicationController::handleTiltValueChangeEvent(MonomeXXhDevice *device, int W
 	else device->LastTiltY = value;
 	
     if (_protocol == kProtocolType_OpenSoundControl) {
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternTiltValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Tilt);
         
         atoms[0].setValue((int)device->LastTiltX);
 		atoms[1].setValue((int)device->LastTiltY);
 		
 		
-          _oscController.send(_oscHostRef, oscAddressPattern, &oscAtomList);
+          _sendInputMessage(device, oscAddressPattern, &oscAtomList, device->sensorSampleTime(MonomeXXhDevice::kSensor_TiltX + WhichAxis), InputSubscriptions::kEvent_Tilt);
     }
    /* Tilt MIDI, just a copy from ADC, needs tweaking if you want it to work 
 	  else {
@@ -487,7 +764,7 @@ ApplicationController::handleTiltValueChangeEvent(MonomeXXhDevice *device, int W
         else
             ccValue = (unsigned char)(value * 127.f);
                 
-        _cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue);
+        _cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue, device->readTime());
     }
 */
 #ifdef DEBUG_PRINT
@@ -511,12 +788,12 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
         return;
 
     if (_protocol == kProtocolType_OpenSoundControl) {
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternEncValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Enc);
 
         atoms[0].setValue((int)(device->oscAdcOffset() + localEncoderIndex));
         atoms[1].setValue(steps);
 
-        _oscController.send(_oscHostRef, oscAddressPattern, &oscAtomList);
+        _sendInputMessage(device, oscAddressPattern, &oscAtomList, device->encoderStepTime(localEncoderIndex), InputSubscriptions::kEvent_Enc);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -532,7 +809,7 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 			else 
 				stepsUsed = steps;
 				
-			_cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
+			_cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64, device->readTime()); // offset by the number of adcs
 			
 			steps -= stepsUsed;
 		}
@@ -545,7 +822,7 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 			else 
 				stepsUsed = steps;
 				
-			_cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
+			_cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64, device->readTime()); // offset by the number of adcs
 			
 			steps += stepsUsed;
 		}
@@ -557,61 +834,237 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 }
 
 void 
-ApplicationController::handleOscMessage(const string& addressPattern, list <OscAtom *> *atoms)
+ApplicationController::handleEncoderSendEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex)
 {
-    static vector<MonomeXXhDevice *> matchingDevices;
-
-    if (_protocol != kProtocolType_OpenSoundControl || atoms == 0)
-        return;
+    _sendEncoderSteps(device, localEncoderIndex);
+    _cCoreMIDI->flushOutput();
+}
 
-    if (addressPattern.substr(0, 5) == "/sys/") {
-        _handleOscSystemMessage(addressPattern, atoms);
+void 
+ApplicationController::_accumulateEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps, HostTime time)
+{
+    if (device == 0)
         return;
-    }
 
-    unsigned int indexOfSuffix;
+    HostTime now = EventScheduler::now();
+    HostTime sendTime = device->addEncoderSteps(localEncoderIndex, steps, time);
 
-    if ((indexOfSuffix = addressPattern.rfind('/')) >= addressPattern.size())
+    // with no interval the steps wait for the end of the serial read
+    if (sendTime == 0 || device->encoderInterval() == 0)
         return;
 
-    string prefix = addressPattern.substr(0, indexOfSuffix);
-    string suffix = addressPattern.substr(indexOfSuffix);
+    if (sendTime <= now)
+        _sendEncoderSteps(device, localEncoderIndex);
+    else
+        _inputScheduler.schedule(sendTime, _ApplicationController_EncoderSendCallback, this, device, &localEncoderIndex, sizeof(localEncoderIndex));
+}
 
-    vector<MonomeXXhDevice *>::iterator deviceIter;
+void 
+ApplicationController::_sendEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex)
+{
+    HostTime nextSendTime;
+    int minSteps = INT_MIN, maxSteps = INT_MAX;
 
-    matchingDevices.clear();
-    for (deviceIter = _devices.begin(); deviceIter != _devices.end(); deviceIter++) {
-        if ((*deviceIter)->oscAddressPatternPrefix() == prefix)
-            matchingDevices.push_back(*deviceIter);
+    // one CC carries -64..63; when rate limited, the rest goes next time round
+    if (_protocol == kProtocolType_MIDI && device->encoderInterval() != 0) {
+        minSteps = -64;
+        maxSteps = 63;
     }
 
-    if (matchingDevices.size() == 0)
-        return;
-
-    list<OscAtom *>::iterator atomIter;
-
-	
-    if (suffix == kOscDefaultAddrPatternLedStateSuffix) {
+    pthread_mutex_lock(&_inputSendLock);
 
-        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedState))
-            return;
+    int steps = device->takeEncoderSteps(localEncoderIndex, minSteps, maxSteps, EventScheduler::now(), nextSendTime);
 
-        unsigned int column = (*(atomIter = atoms->begin())++)->valueAsInt();
-        unsigned int row = (*atomIter++)->valueAsInt();
-        bool state = (*atomIter++)->valueAsInt() ? true : false;
+    if (steps != 0)
+        handleRotaryEncoderEvent(device, localEncoderIndex, steps);
 
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-            (*deviceIter)->oscLedStateChangeEvent(column, row, state);
-	}
+    pthread_mutex_unlock(&_inputSendLock);
 
-    else if (suffix == kOscDefaultAddrPatternLedIntensitySuffix) {
-        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedIntensity))
-            return;
+    if (nextSendTime != 0)
+        _inputScheduler.schedule(nextSendTime, _ApplicationController_EncoderSendCallback, this, device, &localEncoderIndex, sizeof(localEncoderIndex));
+}
 
-        float intensity = (*(atoms->begin()))->valueAsFloat();
+void 
+ApplicationController::handleSensorRetryEvent(MonomeXXhDevice *device, unsigned int sensor)
+{
+    float value;
+    HostTime retryTime;
 
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-            (*deviceIter)->oscLedIntensityChangeEvent(intensity);
+    if (device->retrySensorSample(sensor, EventScheduler::now(), value, retryTime)) {
+        _sendSensorValue(device, sensor, value);
+        _cCoreMIDI->flushOutput();
+    }
+}
+
+void 
+ApplicationController::_filterSensorSample(MonomeXXhDevice *device, unsigned int sensor, float sample, HostTime time)
+{
+    if (device == 0)
+        return;
+
+    float value;
+    HostTime retryTime;
+
+    // adcs go out as 7 bit CCs in MIDI mode; changes below that are not worth a message
+    unsigned int outputSteps = _protocol == kProtocolType_MIDI && sensor < MonomeXXhDevice::kSensor_TiltX ? 127 : 0;
+
+    if (device->filterSensorSample(sensor, sample, outputSteps, time, value, retryTime))
+        _sendSensorValue(device, sensor, value);
+    else if (retryTime != 0)
+        _inputScheduler.schedule(retryTime, _ApplicationController_SensorRetryCallback, this, device, &sensor, sizeof(sensor));
+}
+
+void 
+ApplicationController::_sendSensorValue(MonomeXXhDevice *device, unsigned int sensor, float value)
+{
+    pthread_mutex_lock(&_inputSendLock);
+
+    if (sensor < MonomeXXhDevice::kSensor_TiltX)
+        handleAdcValueChangeEvent(device, sensor - MonomeXXhDevice::kSensor_Adc0, value);
+    else
+        handleTiltValueChangeEvent(device, sensor - MonomeXXhDevice::kSensor_TiltX, (int)value);
+
+    pthread_mutex_unlock(&_inputSendLock);
+}
+
+void 
+ApplicationController::_sendInputMessage(MonomeXXhDevice *device, const string &addressPattern, list<OscAtom *> *atoms, HostTime time, InputSubscriptions::Event event, unsigned int localColumn, unsigned int localRow)
+{
+    InputSubscriptions::Destinations destinations(_inputSubscriptions, device, event, localColumn, localRow);
+    OscHostRef hostRefs[InputSubscriptions::kMaxSubscribers + 1];
+    unsigned int numHostRefs = 0;
+    OscAtom timeTag;
+
+    // the message is built once for the host and all of its subscribers
+    hostRefs[numHostRefs++] = _oscHostRef;
+
+    for (unsigned int i = 0; i < destinations.count(); i++) {
+        if (destinations[i] != _oscHostRef)
+            hostRefs[numHostRefs++] = destinations[i];
+    }
+
+    switch (device->inputTimestamps()) {
+    case MonomeXXhDevice::kInputTimestamps_Bundle:
+        _oscController.send(hostRefs, numHostRefs, addressPattern, atoms, _ntpTimeFromHostTime(time));
+        break;
+
+    case MonomeXXhDevice::kInputTimestamps_Argument:
+        timeTag.setTimeTag(_ntpTimeFromHostTime(time));
+        atoms->push_back(&timeTag);
+        _oscController.send(hostRefs, numHostRefs, addressPattern, atoms);
+        atoms->pop_back();
+        break;
+
+    default:
+        _oscController.send(hostRefs, numHostRefs, addressPattern, atoms);
+        break;
+    }
+}
+
+NtpTime 
+ApplicationController::_ntpTimeFromHostTime(HostTime time) const
+{
+    if (time >= _clockHostTime)
+        return _clockNtpTime + EventScheduler::ntpTimeFromHostTime(time - _clockHostTime);
+    else
+        return _clockNtpTime - EventScheduler::ntpTimeFromHostTime(_clockHostTime - time);
+}
+
+void 
+ApplicationController::handleOscMessage(const string& addressPattern, list <OscAtom *> *atoms)
+{
+    static vector<MonomeXXhDevice *> matchingDevices;
+
+    if (_protocol != kProtocolType_OpenSoundControl || atoms == 0)
+        return;
+
+    if (addressPattern.substr(0, 5) == "/sys/") {
+        _handleOscSystemMessage(addressPattern, atoms);
+        return;
+    }
+
+    unsigned int indexOfSuffix;
+
+    if ((indexOfSuffix = addressPattern.rfind('/')) >= addressPattern.size())
+        return;
+
+    string prefix = addressPattern.substr(0, indexOfSuffix);
+    string suffix = addressPattern.substr(indexOfSuffix);
+
+    // subscriptions go by prefix alone, so a client can subscribe before the devices arrive.
+    // a prefix with wildcards is kept as a pattern and matched as each device sends input.
+    if (suffix == kOscDefaultAddrPatternSubscribeSuffix || suffix == kOscDefaultAddrPatternUnsubscribeSuffix) {
+        _handleOscSubscribeMessage(prefix, suffix, atoms);
+        return;
+    }
+
+    // a prefix with wildcards is handled once for each device prefix it matches
+    if (OscAddressPattern::isPattern(prefix)) {
+        string infix;
+        int patternLayer;
+
+        if (_layerFromAddressPatternPrefix(prefix, patternLayer))
+            infix = addressPattern.substr(prefix.size(), indexOfSuffix - prefix.size());
+
+        // a copy, as handling the message may rebuild the canvases and the matches with them.
+        // the expanded messages have no wildcards, so they never come back here to change it.
+        _matchedPrefixes = _prefixesMatching(prefix);
+        vector<string>::iterator i;
+
+        for (i = _matchedPrefixes.begin(); i != _matchedPrefixes.end(); i++) {
+            if (OscAddressPattern::isPattern(*i))
+                continue;
+
+            _expandedAddressPattern.assign(i->data(), i->size());
+            _expandedAddressPattern.append(infix).append(suffix);
+            handleOscMessage(_expandedAddressPattern, atoms);
+        }
+
+        return;
+    }
+
+    vector<MonomeXXhDevice *>::iterator deviceIter;
+    int layer = LedCanvas::kBaseLayer;
+    LedCanvas *canvas = _canvasForPrefix(prefix);
+
+    if (canvas == 0) {
+        // prefix/layer/<id>/led, /led_row, /led_col, /frame and /clear draw on layer id
+        if (!_layerFromAddressPatternPrefix(prefix, layer) || (canvas = _canvasForPrefix(prefix)) == 0)
+            return;
+
+        if (suffix != kOscDefaultAddrPatternLedStateSuffix && suffix != kOscDefaultAddrPatternLedRowSuffix &&
+            suffix != kOscDefaultAddrPatternLedColumnSuffix && suffix != kOscDefaultAddrPatternLedFrameSuffix &&
+            suffix != kOscDefaultAddrPatternLedClearSuffix)
+            return;
+    }
+
+    matchingDevices = canvas->devices();
+
+    FlowCharge flowCharge(this, matchingDevices);
+
+    list<OscAtom *>::iterator atomIter;
+
+	
+    if (suffix == kOscDefaultAddrPatternLedStateSuffix) {
+
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedState))
+            return;
+
+        unsigned int column = (*(atomIter = atoms->begin())++)->valueAsInt();
+        unsigned int row = (*atomIter++)->valueAsInt();
+        bool state = (*atomIter++)->valueAsInt() ? true : false;
+
+        canvas->ledStateChange(column, row, state, layer);
+	}
+
+    else if (suffix == kOscDefaultAddrPatternLedIntensitySuffix) {
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedIntensity))
+            return;
+
+        float intensity = (*(atoms->begin()))->valueAsFloat();
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            (*deviceIter)->oscLedIntensityChangeEvent(intensity);
     }
 
     else if (suffix == kOscDefaultAddrPatternLedTestSuffix) {
@@ -626,6 +1079,12 @@ ApplicationController::handleOscMessage(const string& addressPattern, list <OscA
 
     else if (suffix == kOscDefaultAddrPatternLedClearSuffix) {
 		bool clear;
+
+        if (layer != LedCanvas::kBaseLayer) {
+            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+                (*deviceIter)->oscLayerClearEvent(layer);
+            return;
+        }
 		
 		if (atoms->size() == 0) 
 			clear = false;
@@ -652,11 +1111,12 @@ ApplicationController::handleOscMessage(const string& addressPattern, list <OscA
         int adcIndex = (*(atomIter = atoms->begin())++)->valueAsInt();
         bool adcState = (*atomIter++)->valueAsInt() ? true : false;
         
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++) {
             (*deviceIter)->oscAdcEnableStateChangeEvent(adcIndex, adcState);        
 
-        [_appController updateAdcStates];
-        [_appController updateEncStates];
+            if (_observer != 0)
+                _observer->adcStatesChanged(_serialNumberString(*deviceIter));
+        }
     }
 
     else if (suffix == kOscDefaultAddrPatternShutdownSuffix) {
@@ -699,8 +1159,7 @@ unsigned int stateout =5;
         for (index = 0; atomIter != atoms->end() && index < 256; atomIter++, index++) 
             bitmap[index] = (*atomIter)->valueAsInt();
 
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-            (*deviceIter)->oscLedRowStateChangeEvent(row, index, bitmap);
+        canvas->ledRow(row, index, bitmap, layer);
     }
 
 
@@ -719,8 +1178,7 @@ unsigned int stateout =5;
         for (index = 0; atomIter != atoms->end() && index < 256; atomIter++, index++) 
             bitmap[index] = (*atomIter)->valueAsInt();
 
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-            (*deviceIter)->oscLedColumnStateChangeEvent(column, index, bitmap);
+        canvas->ledColumn(column, index, bitmap, layer);
     }
 
 	
@@ -731,11 +1189,28 @@ unsigned int stateout =5;
         int encIndex = (*(atomIter = atoms->begin())++)->valueAsInt();
         bool encState = (*atomIter++)->valueAsInt() ? true : false;
         
-        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++) {
             (*deviceIter)->oscEncEnableStateChangeEvent(encIndex, encState);        
 
-        [_appController updateAdcStates];
-        [_appController updateEncStates];
+            if (_observer != 0)
+                _observer->encStatesChanged(_serialNumberString(*deviceIter));
+        }
+    }
+
+    else if (suffix == kOscDefaultAddrPatternEncTotalSuffix) {
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsEncTotal))
+            return;
+
+        int encIndex = (*(atoms->begin()))->valueAsInt();
+        list<OscAtom> totalAtoms(2);
+        list<OscAtom>::iterator k;
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++) {
+            (*(k = totalAtoms.begin())++).setValue(encIndex);
+            (*k).setValue((int)(*deviceIter)->encoderTotal(encIndex - (*deviceIter)->oscEncOffset()));
+
+            _oscController.send(_oscHostRef, (*deviceIter)->oscAddressPatternPrefix() + kOscDefaultAddrPatternEncTotalSuffix, &totalAtoms);
+        }
     }
 
     else if (suffix == kOscDefaultAddrPatternLedFrameSuffix) {
@@ -746,8 +1221,7 @@ unsigned int stateout =5;
             for (index = 0, atomIter = atoms->begin(); atomIter != atoms->end(); atomIter++, index++)
                 bitmap[index] = (char) (*atomIter)->valueAsInt();	//possibly cast this as char here to be serial compatible
 
-            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-                (*deviceIter)->oscLedFrameEvent(0, 0, bitmap);        
+            canvas->ledFrame(0, 0, bitmap, layer);
         }
 		
         else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedOffsetFrame)) { // 10 Ints, first 2 for offset
@@ -760,8 +1234,7 @@ unsigned int stateout =5;
             for (index = 0; atomIter != atoms->end(); atomIter++, index++)
                 bitmap[index] = (char) (*atomIter)->valueAsInt();
 
-            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-                (*deviceIter)->oscLedFrameEvent(column, row, bitmap);        
+            canvas->ledFrame(column, row, bitmap, layer);
         }
 
 		        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedOffsetFrame)) { // 2 ints, must assume its 
@@ -774,11 +1247,275 @@ unsigned int stateout =5;
             for (index = 0; atomIter != atoms->end(); atomIter++, index++)
                 bitmap[index] = (char) (*atomIter)->valueAsInt();
 
-            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
-                (*deviceIter)->oscLedFrameEvent(column, row, bitmap);        
+            canvas->ledFrame(column, row, bitmap, layer);
         }
 	
     } //end /frame
+
+    else if (suffix == kOscDefaultAddrPatternLedShiftSuffix) {
+        bool wrap = false;
+
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedShiftWrap))
+            wrap = true;
+        else if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedShift))
+            return;
+
+        int dx = (*(atomIter = atoms->begin())++)->valueAsInt();
+        int dy = (*atomIter++)->valueAsInt();
+
+        if (wrap)
+            wrap = (*atomIter++)->valueAsInt() != 0;
+
+        LedsLock leds(matchingDevices);
+        LedBitmap bitmap = _readLedBitmap(matchingDevices);
+        bitmap.shift(dx, dy, wrap);
+        _writeLedBitmap(matchingDevices, bitmap);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLedBlitSuffix) {
+        if (!_typeCheckBlitMessage(*atoms))
+            return;
+
+        unsigned int column = (*(atomIter = atoms->begin())++)->valueAsInt();
+        unsigned int row = (*atomIter++)->valueAsInt();
+        unsigned int width = (*atomIter++)->valueAsInt();
+        unsigned int height = (*atomIter++)->valueAsInt();
+        unsigned int bitMaps[LedBitmap::kMaxSize];
+        unsigned int index;
+
+        for (index = 0; atomIter != atoms->end() && index < LedBitmap::kMaxSize; atomIter++, index++)
+            bitMaps[index] = (unsigned int)(*atomIter)->valueAsInt();
+
+        if (index < height)
+            height = index;
+
+        LedsLock leds(matchingDevices);
+        LedBitmap bitmap = _readLedBitmap(matchingDevices);
+        bitmap.blit(column, row, width, height, bitMaps);
+        _writeLedBitmap(matchingDevices, bitmap);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLedCopySuffix) {
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedCopy))
+            return;
+
+        unsigned int column = (*(atomIter = atoms->begin())++)->valueAsInt();
+        unsigned int row = (*atomIter++)->valueAsInt();
+        unsigned int width = (*atomIter++)->valueAsInt();
+        unsigned int height = (*atomIter++)->valueAsInt();
+        unsigned int toColumn = (*atomIter++)->valueAsInt();
+        unsigned int toRow = (*atomIter++)->valueAsInt();
+
+        LedsLock leds(matchingDevices);
+        LedBitmap bitmap = _readLedBitmap(matchingDevices);
+        bitmap.copy(column, row, width, height, toColumn, toRow);
+        _writeLedBitmap(matchingDevices, bitmap);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLedFillSuffix) {
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedFill))
+            return;
+
+        unsigned int column = (*(atomIter = atoms->begin())++)->valueAsInt();
+        unsigned int row = (*atomIter++)->valueAsInt();
+        unsigned int width = (*atomIter++)->valueAsInt();
+        unsigned int height = (*atomIter++)->valueAsInt();
+        bool state = (*atomIter++)->valueAsInt() != 0;
+
+        LedsLock leds(matchingDevices);
+        LedBitmap bitmap = _readLedBitmap(matchingDevices);
+        bitmap.fill(column, row, width, height, state);
+        _writeLedBitmap(matchingDevices, bitmap);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLedMapSuffix) {
+        unsigned int column, row, width, height;
+        OscAtom *blob;
+
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedMap)) {
+            _ledBounds(matchingDevices, column, row, width, height);
+            blob = *(atoms->begin());
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedMapRect)) {
+            column = (*(atomIter = atoms->begin())++)->valueAsInt();
+            row = (*atomIter++)->valueAsInt();
+            width = (*atomIter++)->valueAsInt();
+            height = (*atomIter++)->valueAsInt();
+            blob = *atomIter;
+        }
+        else
+            return;
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            (*deviceIter)->oscLedMapEvent(column, row, width, height, (const uint8 *)blob->blobData(), blob->blobSize());
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLayerSuffix) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLayerRemove)) {
+            int id = (*(atoms->begin()))->valueAsInt();
+
+            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+                (*deviceIter)->oscLayerRemoveEvent(id);
+            return;
+        }
+
+        bool clip = _typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLayerClip);
+
+        if (!clip && !_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLayer))
+            return;
+
+        int id = (*(atomIter = atoms->begin())++)->valueAsInt();
+        int z = (*atomIter++)->valueAsInt();
+        MonomeXXhDevice::LayerBlend blend;
+        unsigned int column = 0, row = 0, width = 0, height = 0;
+
+        if (id < 0 || !_layerBlendFromString((*atomIter++)->valueAsString(), blend))
+            return;
+
+        if (clip) {
+            column = (*atomIter++)->valueAsInt();
+            row = (*atomIter++)->valueAsInt();
+            width = (*atomIter++)->valueAsInt();
+            height = (*atomIter++)->valueAsInt();
+        }
+
+        // without a rectangle the layer covers the whole device again
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++) {
+            if ((*deviceIter)->oscLayerEvent(id, z, blend))
+                (*deviceIter)->oscLayerClipEvent(id, column, row, width, height);
+        }
+    }
+
+    else if (suffix == kOscDefaultAddrPatternEchoSuffix) {
+        bool rect = _typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsEchoRect);
+
+        if (!rect && !_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsEcho))
+            return;
+
+        const string &name = (*(atomIter = atoms->begin())++)->valueAsString();
+        MonomeXXhDevice::EchoMode mode;
+        unsigned int column = 0, row = 0, width = 0, height = 0;
+
+        if (name == kOscEchoOff) {
+            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+                (*deviceIter)->oscEchoClearEvent();
+            return;
+        }
+        else if (name == kOscEchoMomentary)
+            mode = MonomeXXhDevice::kEcho_Momentary;
+        else if (name == kOscEchoToggle)
+            mode = MonomeXXhDevice::kEcho_Toggle;
+        else if (name == kOscEchoRadio)
+            mode = MonomeXXhDevice::kEcho_Radio;
+        else
+            return;
+
+        if (rect) {
+            column = (*atomIter++)->valueAsInt();
+            row = (*atomIter++)->valueAsInt();
+            width = (*atomIter++)->valueAsInt();
+            height = (*atomIter++)->valueAsInt();
+        }
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            (*deviceIter)->oscEchoEvent(mode, column, row, width, height);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternDoubleBufferSuffix) {
+        bool autoSwap = _typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsDoubleBufferAuto);
+
+        if (!autoSwap && !_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsDoubleBuffer))
+            return;
+
+        bool doubleBuffered = (*(atomIter = atoms->begin())++)->valueAsInt() != 0;
+        int interval = autoSwap ? (*atomIter++)->valueAsInt() : 0;
+
+        if (interval < 0)
+            return;
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            _setDoubleBuffered(*deviceIter, doubleBuffered, interval);
+    }
+
+    else if (suffix == kOscDefaultAddrPatternSwapSuffix) {
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            (*deviceIter)->swapLeds();
+    }
+
+    else if (suffix == kOscDefaultAddrPatternLedAnimationSuffix) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedAnimationStop)) {
+            if ((*(atoms->begin()))->valueAsString() != "stop")
+                return;
+
+            for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+                (*deviceIter)->stopLedAnimation();
+            return;
+        }
+
+        LedAnimation animation;
+
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsLedAnimationPulse)) {
+            if ((*(atomIter = atoms->begin())++)->valueAsString() != "pulse")
+                return;
+
+            unsigned int interval = (*atomIter++)->valueAsInt();
+            unsigned int steps = (*atomIter++)->valueAsInt();
+            float low = (*atomIter++)->valueAsFloat();
+            float high = (*atomIter++)->valueAsFloat();
+
+            animation.setPulse(low, high);
+            animation.setTiming(interval, steps);
+        }
+        else {
+            if (!_typeCheckAnimationMessage(*atoms))
+                return;
+
+            string mode = (*(atomIter = atoms->begin())++)->valueAsString();
+            unsigned int numArguments = atoms->size() - 7;
+            int dx = 0, dy = 0;
+            uint16 bitMaps[LedAnimation::kMaxFrames * LedAnimation::kMaxRows];
+            unsigned int n;
+
+            unsigned int interval = (*atomIter++)->valueAsInt();
+            unsigned int steps = (*atomIter++)->valueAsInt();
+            unsigned int column = (*atomIter++)->valueAsInt();
+            unsigned int row = (*atomIter++)->valueAsInt();
+            unsigned int width = (*atomIter++)->valueAsInt();
+            unsigned int height = (*atomIter++)->valueAsInt();
+
+            if (mode == "scroll") {
+                if (numArguments < 2)
+                    return;
+
+                dx = (*atomIter++)->valueAsInt();
+                dy = (*atomIter++)->valueAsInt();
+                numArguments -= 2;
+            }
+
+            // blink and scroll take one frame, frames as many as fit
+            if (height == 0 || height > LedAnimation::kMaxRows || numArguments < height || numArguments % height != 0)
+                return;
+            if (mode != "frames" && numArguments != height)
+                return;
+
+            for (n = 0; atomIter != atoms->end() && n < LedAnimation::kMaxFrames * LedAnimation::kMaxRows; atomIter++, n++)
+                bitMaps[n] = (uint16)(*atomIter)->valueAsInt();
+
+            if (mode == "frames")
+                animation.setFrames(column, row, width, height, bitMaps, n / height);
+            else if (mode == "blink")
+                animation.setBlink(column, row, width, height, bitMaps);
+            else if (mode == "scroll")
+                animation.setScroll(column, row, width, height, bitMaps, dx, dy);
+            else
+                return;
+
+            animation.setTiming(interval, steps);
+        }
+
+        for (deviceIter = matchingDevices.begin(); deviceIter != matchingDevices.end(); deviceIter++)
+            _startLedAnimation(*deviceIter, animation);
+    }
 	
 	//mk sys messages, might need to be moved up to handleOsc if they turn out to not be system messages
 	
@@ -860,66 +1597,104 @@ ApplicationController::handleMIDIReceivedOnVirtualDestination(const MIDIPacketLi
 void 
 ApplicationController::handleMIDIReceived(const MIDIPacketList *packetList, CCoreMIDIEndpointRef source)
 {
-    vector<MonomeXXhDevice *>::iterator i;
+    // held through the dispatch: a device leaving rebuilds the index under it before the
+    // device is deleted, so that waits for any input already on its way to the device
+    pthread_mutex_lock(&_midiInputIndexLock);
 
-    for (i = _devices.begin(); i != _devices.end(); i++) {
-        MonomeXXhDevice *device = *i;
+    MIDIInputIndex::const_iterator entry = _midiInputIndex.find(source);
+
+    if (entry == _midiInputIndex.end() || entry->second.empty()) {
+        pthread_mutex_unlock(&_midiInputIndexLock);
+        return;
+    }
+
+    MonomeXXhDevice *const *targets = &entry->second[0];
+    unsigned int numTargets = entry->second.size();
+
+    // parse the whole list once, however many devices share this source.  running
+    // status carries across packets, since some drivers split messages that way.
+    MIDIInputEvent events[kMaxMIDIInputEvents];
+    unsigned int numEvents = 0;
+    unsigned char status = 0, data1 = 0;
+    bool haveData1 = false;
+    unsigned char sysEx[kMaxMIDISysExSize];
+    unsigned int sysExLength = 0;
+
+    const MIDIPacket *packet = &packetList->packet[0];
+    HostTime arrived = EventScheduler::now();
+
+    for (unsigned int i = 0; i < packetList->numPackets; i++) {
+        // a sequencer may stamp packets ahead of time; 0 means now
+        HostTime time = packet->timeStamp != 0 ? packet->timeStamp : arrived;
+
+        for (unsigned int j = 0; j < packet->length; j++) {
+            unsigned char midiByte = packet->data[j];
+
+            if (midiByte >= 0xF8)           // real-time bytes can appear anywhere and leave running status alone
+                continue;
+
+            if (midiByte & 0x80) {
+                if (midiByte == 0xF7 && sysExLength > 0) {
+                    sysEx[sysExLength++] = midiByte;
 
-        if (device->MIDIInputDevice() == source) {
-            const MIDIPacket *packet = &packetList->packet[0];
-
-            for (unsigned int i = 0; i < packetList->numPackets; i++) {
-                unsigned char status, data1, data2, index;
-
-                index = 0;
-
-                for (unsigned int j = 0; j < packet->length; j++) {
-                    unsigned char midiByte = packet->data[j];
-
-                    switch (index) {
-                    case 0:
-                        if (midiByte & 0x80) {
-                            status = midiByte;
-                            index = 1;
-                        }
-                           
-                        break;
-
-                    case 1:
-                        if (midiByte & 0x80) {
-                            status = midiByte;
-                            index = 1;
-                        }
-                        else {
-                            data1 = midiByte;
-                            index = 2;
-                        }
-
-                        break;
-
-                    case 2:
-                        if (midiByte & 0x80) {
-							_handleMIDIMessage(device, status, data1, data2);
-
-                            status = midiByte;
-                            index = 1;
-                        }
-                        else {
-                            data2 = midiByte;
-							_handleMIDIMessage(device, status, data1, data2);
-								
-                            index = 0;
-                        }
-
-                        break;
-                    }
+                    // keep notes and sysex in the order they arrived
+                    _dispatchMIDIInputEvents(targets, numTargets, events, numEvents);
+                    numEvents = 0;
+                    _dispatchMIDISysEx(targets, numTargets, sysEx, sysExLength, time);
                 }
-				
-				if (index != 0)
-					_handleMIDIMessage(device, status, data1, data2);
+
+                sysExLength = 0;
+                if (midiByte == 0xF0)
+                    sysEx[sysExLength++] = midiByte;
+
+                status = midiByte < 0xF0 ? midiByte : 0;  // system common and sysex cancel running status
+                haveData1 = false;
+                continue;
+            }
+
+            if (sysExLength > 0) {
+                // leave room for the F7; anything longer is not ours, so drop it
+                if (sysExLength < kMaxMIDISysExSize - 1)
+                    sysEx[sysExLength++] = midiByte;
+                else
+                    sysExLength = 0;
+                continue;
+            }
+
+            if (status == 0)
+                continue;
+
+            if (!haveData1) {
+                data1 = midiByte;
+                haveData1 = true;
+
+                // program change and channel pressure only carry one data byte
+                if ((status & 0xF0) != 0xC0 && (status & 0xF0) != 0xD0)
+                    continue;
+
+                midiByte = 0;
+            }
+
+            MIDIInputEvent &event = events[numEvents++];
+            event.type = status & 0xF0;
+            event.channel = status & 0x0F;
+            event.data1 = data1;
+            event.data2 = midiByte;
+            event.time = time;
+            haveData1 = false;
+
+            if (numEvents == kMaxMIDIInputEvents) {
+                _dispatchMIDIInputEvents(targets, numTargets, events, numEvents);
+                numEvents = 0;
             }
         }
+
+        packet = MIDIPacketNext(packet);
     }
+
+    _dispatchMIDIInputEvents(targets, numTargets, events, numEvents);
+
+    pthread_mutex_unlock(&_midiInputIndexLock);
 }
 
 void 
@@ -961,7 +1736,10 @@ ApplicationController::handleMIDISystemStateChanged(const MIDINotification *)
         }
     }
 
-    [_appController updateMIDIDevices];
+    _rebuildMIDIInputIndex();
+
+    if (_observer != 0)
+        _observer->midiDeviceListChanged();
 }
 
 void 
@@ -978,6 +1756,60 @@ ApplicationController::_initCoreMIDI(void)
 	_cCoreMIDI->registerForMIDISystemStateChangeNotifications(_ApplicationController_MIDISystemStateChangedCallback, this);
 }
 
+void 
+ApplicationController::_handleOscSubscribeMessage(const string &prefix, const string &suffix, list <OscAtom *> *atoms)
+{
+    list<OscAtom *>::iterator atomIter = atoms->begin();
+    ostringstream port;
+
+    if (suffix == kOscDefaultAddrPatternUnsubscribeSuffix) {
+        if (!_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsUnsubscribe))
+            return;
+
+        string host = (*atomIter++)->valueAsString();
+        port << (*atomIter++)->valueAsInt();
+
+        OscHostRef destination = _oscController.getOscHostRef(host, port.str());
+
+        // drops the subscription's reference as well as the one just taken
+        if (_inputSubscriptions.unsubscribe(prefix, destination))
+            _oscController.releaseOscHostRef(destination);
+
+        _oscController.releaseOscHostRef(destination);
+        return;
+    }
+
+    bool rect = _typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSubscribeRect);
+
+    if (!rect && !_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSubscribe))
+        return;
+
+    // a pattern with an unclosed [ or { would never match
+    if (OscAddressPattern::isPattern(prefix) && !OscAddressPattern(prefix).valid())
+        return;
+
+    string host = (*atomIter++)->valueAsString();
+    port << (*atomIter++)->valueAsInt();
+    unsigned int events;
+    unsigned int column = 0, row = 0, width = 0, height = 0;
+
+    if (!_inputEventsFromString((*atomIter++)->valueAsString(), events))
+        return;
+
+    if (rect) {
+        column = (*atomIter++)->valueAsInt();
+        row = (*atomIter++)->valueAsInt();
+        width = (*atomIter++)->valueAsInt();
+        height = (*atomIter++)->valueAsInt();
+    }
+
+    OscHostRef destination = _oscController.getOscHostRef(host, port.str());
+
+    // a destination already subscribed keeps the reference it took the first time
+    if (!_inputSubscriptions.subscribe(prefix, destination, events, column, row, width, height))
+        _oscController.releaseOscHostRef(destination);
+}
+
 void 
 ApplicationController::_handleOscSystemMessage(const string& addressPattern, list <OscAtom *> *atoms)
 {
@@ -1004,7 +1836,8 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
                  }	
             }
 
-			[_appController updateOscAddressPatternPrefix];
+            if (_observer != 0)
+                _observer->addressPatternPrefixChanged("");
         }
         else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysPrefixSingle)) {
             index = (*(j = atoms->begin())++)->valueAsInt();
@@ -1017,9 +1850,10 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
                 (*k).setValue(device->oscAddressPatternPrefix());
 
                 _oscController.send(_oscHostRef, systemPrefixString, &twoAtoms);
-            }	
-				
-			[_appController updateOscAddressPatternPrefix];
+
+                if (_observer != 0)
+                    _observer->addressPatternPrefixChanged(_serialNumberString(device));
+            }
         }
     }
 
@@ -1041,8 +1875,9 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
 
             for (i = _devices.begin(); i != _devices.end(); i++) 
                 (*i)->setCableOrientation(o);
-				
-			[_appController updateCableOrientation];
+
+            if (_observer != 0)
+                _observer->cableOrientationChanged("");
         }
         else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysCableSingle)) {
             MonomeXXhDevice::CableOrientation o;
@@ -1060,10 +1895,12 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
             else
                 return;
 
-            if ((device = deviceAtIndex(index)) != 0)
+            if ((device = deviceAtIndex(index)) != 0) {
                 device->setCableOrientation(o);
 
-			[_appController updateCableOrientation];
+                if (_observer != 0)
+                    _observer->cableOrientationChanged(_serialNumberString(device));
+            }
         }
     }
 
@@ -1078,7 +1915,8 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
                 device->setOscStartRow(y);
             }
 
-			[_appController updateOscStartRowAndColumn];
+            if (_observer != 0)
+                _observer->offsetChanged("");
         }
         else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysOffsetSingle)) {
             index = (*(j = atoms->begin())++)->valueAsInt();
@@ -1088,41 +1926,154 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
             if ((device = deviceAtIndex(index)) != 0) {
                 device->setOscStartColumn(x);
                 device->setOscStartRow(y);
+
+                if (_observer != 0)
+                    _observer->offsetChanged(_serialNumberString(device));
             }
-			
-			[_appController updateOscStartRowAndColumn];
         }
     }
 
-    else if (addressPattern == kOscDefaultAddrPatternSystemLedIntensity) {
-        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedIntensityAll)) {
-            float intensity = (*(atoms->begin())++)->valueAsFloat();
+    else if (addressPattern == kOscDefaultAddrPatternSystemLedIntensity) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedIntensityAll)) {
+            float intensity = (*(atoms->begin())++)->valueAsFloat();
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->oscLedIntensityChangeEvent(intensity);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedIntensitySingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+            float intensity = (*j++)->valueAsFloat();
+
+            if ((device = deviceAtIndex(index)) != 0)
+                device->oscLedIntensityChangeEvent(intensity);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemLedTest) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedTestAll)) {
+            bool state = (*(atoms->begin())++)->valueAsInt() ? true : false;
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->oscLedTestStateChangeEvent(state);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedTestSingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+            bool state = (*j++)->valueAsInt() ? true : false;
+
+            if ((device = deviceAtIndex(index)) != 0)
+                device->oscLedTestStateChangeEvent(state);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemTimestamp) {
+        MonomeXXhDevice::InputTimestamps timestamps;
+
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysTimestampAll)) {
+            if (!_inputTimestampsFromString((*(atoms->begin()))->valueAsString(), timestamps))
+                return;
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setInputTimestamps(timestamps);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysTimestampSingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+
+            if (!_inputTimestampsFromString((*j++)->valueAsString(), timestamps))
+                return;
+
+            if ((device = deviceAtIndex(index)) != 0)
+                device->setInputTimestamps(timestamps);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemFlow) {
+        MonomeXXhDevice::FlowMode mode;
+
+        if (atoms->size() == 0) {
+            for (i = _devices.begin(); i != _devices.end(); i++)
+                handleFlowEvent(*i);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysFlowAll)) {
+            if (!_flowModeFromString((*(atoms->begin()))->valueAsString(), mode))
+                return;
+
+            for (i = _devices.begin(); i != _devices.end(); i++) {
+                (*i)->setFlowMode(mode);
+                handleFlowEvent(*i);
+            }
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysFlowSingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+
+            if (!_flowModeFromString((*j++)->valueAsString(), mode))
+                return;
+
+            if ((device = deviceAtIndex(index)) != 0) {
+                device->setFlowMode(mode);
+                handleFlowEvent(device);
+            }
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemStats) {
+        static const string statsString = kOscDefaultAddrPatternSystemStats;
+        static list<OscAtom> sixAtoms(6);
+
+        if (atoms->size() != 0)
+            return;
+
+        for (index = 0; index < _devices.size(); index++) {
+            MonomeXXhDevice::LinkStats stats;
+
+            _devices[index]->linkStats(stats);
+
+            (*(k = sixAtoms.begin())++).setValue((int)index);
+            (*k++).setValue(stats.capacity);
+            (*k++).setValue(stats.throughput);
+            (*k++).setValue(stats.writeTime);
+            (*k++).setValue(stats.flushInterval);
+            (*k).setValue((int)stats.interactiveLeds);
+
+            _oscController.send(_oscHostRef, statsString, &sixAtoms);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemClock) {
+        static const string clockString = kOscDefaultAddrPatternSystemClock;
+
+        if (atoms->size() != 0)
+            return;
+
+        // the server's own clock next to the wall clock time stamps are given in, read together
+        HostTime now = EventScheduler::now();
+
+        (*(k = twoAtoms.begin())++).setTimeTag(EventScheduler::ntpTimeFromHostTime(now));
+        (*k).setTimeTag(_ntpTimeFromHostTime(now));
+
+        _oscController.send(_oscHostRef, clockString, &twoAtoms);
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemRealtime) {
+        static const string realtimeString = kOscDefaultAddrPatternSystemRealtime;
 
-            for (i = _devices.begin(); i != _devices.end(); i++) 
-                (*i)->oscLedIntensityChangeEvent(intensity);
-        }
-        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedIntensitySingle)) {
-            index = (*(j = atoms->begin())++)->valueAsInt();
-            float intensity = (*j++)->valueAsFloat();
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysRealtime))
+            RealtimeThread::setEnabled((*(atoms->begin()))->valueAsInt() != 0);
 
-            if ((device = deviceAtIndex(index)) != 0)
-                device->oscLedIntensityChangeEvent(intensity);
-        }
-    }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysRealtimeAffinity)) {
+            RealtimeThread::ThreadClass threadClass;
 
-    else if (addressPattern == kOscDefaultAddrPatternSystemLedTest) {
-        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedTestAll)) {
-            bool state = (*(atoms->begin())++)->valueAsInt() ? true : false;
+            j = atoms->begin();
+            if (!_realtimeThreadClassFromString((*j++)->valueAsString(), threadClass))
+                return;
 
-            for (i = _devices.begin(); i != _devices.end(); i++) 
-                (*i)->oscLedTestStateChangeEvent(state);
+            RealtimeThread::setAffinity(threadClass, (unsigned int)(*j)->valueAsInt());
         }
-        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysLedTestSingle)) {
-            index = (*(j = atoms->begin())++)->valueAsInt();
-            bool state = (*j++)->valueAsInt() ? true : false;
 
-            if ((device = deviceAtIndex(index)) != 0)
-                device->oscLedTestStateChangeEvent(state);
+        else if (atoms->size() == 0) {
+            (*(k = twoAtoms.begin())++).setValue((int)RealtimeThread::enabled());
+            (*k).setValue((int)RealtimeThread::allocationCount());
+
+            _oscController.send(_oscHostRef, realtimeString, &twoAtoms);
         }
     }
 
@@ -1240,7 +2191,74 @@ ApplicationController::_handleOscSystemMessage(const string& addressPattern, lis
             }
         }
 
-    } else if (addressPattern == kOscDefaultAddrPatternSystemGrids)
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemEncInterval) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysEncIntervalAll)) {
+            int interval = (*(atoms->begin()))->valueAsInt();
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setEncoderInterval(interval > 0 ? interval : 0);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysEncIntervalSingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+            int interval = (*j++)->valueAsInt();
+
+            if ((device = deviceAtIndex(index)) != 0)
+                device->setEncoderInterval(interval > 0 ? interval : 0);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemEncAccel) {
+        if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysEncAccelAll)) {
+            float acceleration = (*(atoms->begin()))->valueAsFloat();
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setEncoderAcceleration(acceleration);
+        }
+        else if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysEncAccelSingle)) {
+            index = (*(j = atoms->begin())++)->valueAsInt();
+            float acceleration = (*j++)->valueAsFloat();
+
+            if ((device = deviceAtIndex(index)) != 0)
+                device->setEncoderAcceleration(acceleration);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemFilter) {
+        bool all = _typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysFilterAll);
+
+        if (!all && !_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysFilterSingle))
+            return;
+
+        j = atoms->begin();
+        if (!all && (device = deviceAtIndex((*j++)->valueAsInt())) == 0)
+            return;
+
+        int sensor = (*j++)->valueAsInt();
+        float deadband = (*j++)->valueAsFloat();
+        int interval = (*j++)->valueAsInt();
+        string smoothingString = (*j++)->valueAsString();
+        float amount = (*j++)->valueAsFloat();
+        SensorFilter::Smoothing smoothing;
+
+        if (smoothingString == kOscSensorFilterSmoothingOnePole)
+            smoothing = SensorFilter::kSmoothing_OnePole;
+        else if (smoothingString == kOscSensorFilterSmoothingMedian)
+            smoothing = SensorFilter::kSmoothing_Median;
+        else
+            smoothing = SensorFilter::kSmoothing_None;
+
+        if (all) {
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setSensorFilter(sensor, deadband, interval > 0 ? interval : 0, smoothing, amount);
+        }
+        else {
+            device->setSensorFilter(sensor, deadband, interval > 0 ? interval : 0, smoothing, amount);
+        }
+    }
+
+    else if (addressPattern == kOscDefaultAddrPatternSystemGrids)
 	{
 		if (_typeCheckOscAtoms(*atoms, kOscDefaultTypeTagsSysGrids))
 		{
@@ -1320,7 +2338,7 @@ ApplicationController::handleAuxAnalogValueChangeEvent(MonomeXXhDevice *device,
 		else
 			ccValue = (unsigned char)(value * 127.f);
 		
-		_cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue);
+		_cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue, device->readTime());
 	} */
 	
 #ifdef DEBUG_PRINT
@@ -1508,6 +2526,7 @@ ApplicationController::midiInputDeviceChanged(unsigned int deviceIndex, unsigned
         _cCoreMIDI->MIDIPortConnectSource(device->MIDIInputPort(), endpoint);
 
     device->setMIDIInputDevice(endpoint);
+    _rebuildMIDIInputIndex();
 }
 
 void 
@@ -1862,6 +2881,12 @@ ApplicationController::_typeCheckOscAtoms(list<OscAtom *>& atoms, const char *ty
                 break;
             else
                 return false;
+
+        case 'b':
+            if (atom->isBlob())
+                break;
+            else
+                return false;
         }
     }
 
@@ -1884,34 +2909,413 @@ ApplicationController::_typeCheckRowOrColumnMessage(list<OscAtom *>& atoms)
     return true;
 }
 
+// a mode, then the interval, steps, column, row, width, height and the rest as numbers
+bool 
+ApplicationController::_typeCheckAnimationMessage(list<OscAtom *>& atoms)
+{
+    list<OscAtom *>::iterator i;
+
+    if (atoms.size() < 8 || !(*(i = atoms.begin()))->isString())
+        return false;
+
+    for (i++; i != atoms.end(); i++) {
+        if (!(*i)->isInt() && !(*i)->isFloat())
+            return false;
+    }
+
+    return true;
+}
+
+// the position and size, then a row bitmap for each row
+bool 
+ApplicationController::_typeCheckBlitMessage(list<OscAtom *>& atoms)
+{
+    list<OscAtom *>::iterator i;
+
+    if (atoms.size() < 5)
+        return false;
+
+    for (i = atoms.begin(); i != atoms.end(); i++) {
+        if (!(*i)->isInt())
+            return false;
+    }
+
+    return true;
+}
+
+void 
+ApplicationController::_ledBounds(const vector<MonomeXXhDevice *> &devices, unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height)
+{
+    unsigned int left = UINT_MAX, top = UINT_MAX, right = 0, bottom = 0;
+    vector<MonomeXXhDevice *>::const_iterator i;
+
+    for (i = devices.begin(); i != devices.end(); i++) {
+        unsigned int column, row, width, height;
+
+        (*i)->oscLedBounds(column, row, width, height);
+
+        if (column < left)
+            left = column;
+        if (row < top)
+            top = row;
+        if (column + width > right)
+            right = column + width;
+        if (row + height > bottom)
+            bottom = row + height;
+    }
+
+    if (left > right || top > bottom)
+        left = right = top = bottom = 0;
+
+    column = left;
+    row = top;
+    width = right - left;
+    height = bottom - top;
+}
+
+LedBitmap 
+ApplicationController::_readLedBitmap(const vector<MonomeXXhDevice *> &devices)
+{
+    unsigned int column, row, width, height;
+    vector<MonomeXXhDevice *>::const_iterator i;
+
+    _ledBounds(devices, column, row, width, height);
+
+    LedBitmap bitmap(column, row, width, height);
+
+    for (i = devices.begin(); i != devices.end(); i++)
+        (*i)->readOscLedBitmap(bitmap);
+
+    return bitmap;
+}
+
+void 
+ApplicationController::_writeLedBitmap(const vector<MonomeXXhDevice *> &devices, const LedBitmap &bitmap)
+{
+    vector<MonomeXXhDevice *>::const_iterator i;
+
+    for (i = devices.begin(); i != devices.end(); i++)
+        (*i)->writeOscLedBitmap(bitmap);
+}
+
 void 
-ApplicationController::_handleMIDIMessage(MonomeXXhDevice *device, unsigned char status, unsigned char data1, unsigned char data2)
+ApplicationController::_handleMIDIMessage(MonomeXXhDevice *device, const MIDIInputEvent &event)
 {
 	if (device == 0)
 		return;
 
-	if ((status & 0xF0) == 0x90 && (status & 0xF) == device->MIDIInputChannel())
-		device->MIDILedStateChangeEvent(data1, data2);
-	else if ((status & 0xF0) == 0x80 && (status & 0xF) == device->MIDIInputChannel()) 
-		device->MIDILedStateChangeEvent(data1, 0);
-	else if ((status & 0xF0) == 0xB0 && (status & 0xF) == device->MIDIInputChannel()) {
-		if (data1 < 4) {
-				device->oscAdcEnableStateChangeEvent(data1, data2 >= 64);
-				[_appController updateAdcStates];
-				[_appController updateEncStates];
-		}
-		else if (data1 < 6) {
-			device->oscEncEnableStateChangeEvent(data1 - 4, data2 >= 64);
-			[_appController updateAdcStates];
-			[_appController updateEncStates];
-		}                                    
-	}
-		if ((status & 0xF0) == 0x90 && (status & 0xF) == (device->MIDIInputChannel()+1)%16) //so next channel can reach the other half of the 256 LED's
-		device->MIDILedStateChangeEvent(data1+128, data2);
-	else if ((status & 0xF0) == 0x80 && (status & 0xF) == (device->MIDIInputChannel()+1)%16) 
-		device->MIDILedStateChangeEvent(data1+128, 0);
-	
-	
-	
+    unsigned char channel = device->MIDIInputChannel();
+    MIDILedEvent ledEvent;
+
+    ledEvent.command = kMIDILedNote;
+
+	if (event.channel == channel) {
+        if (event.type == 0x90 || event.type == 0x80) {
+            ledEvent.index = event.data1;
+            ledEvent.velocity = event.type == 0x90 ? event.data2 : 0;
+            _scheduleMIDILedEvent(device, ledEvent, event.time);
+        }
+        else if (event.type == 0xB0) {
+            if (event.data1 < 4) {
+                device->oscAdcEnableStateChangeEvent(event.data1, event.data2 >= 64);
+
+                if (_observer != 0)
+                    _observer->adcStatesChanged(_serialNumberString(device));
+            }
+            else if (event.data1 < 6) {
+                device->oscEncEnableStateChangeEvent(event.data1 - 4, event.data2 >= 64);
+
+                if (_observer != 0)
+                    _observer->encStatesChanged(_serialNumberString(device));
+            }                                    
+        }
+    }
+    else if (event.channel == (channel + 1) % 16) { //so next channel can reach the other half of the 256 LED's
+        if (event.type == 0x90 || event.type == 0x80) {
+            ledEvent.index = event.data1 + 128;
+            ledEvent.velocity = event.type == 0x90 ? event.data2 : 0;
+            _scheduleMIDILedEvent(device, ledEvent, event.time);
+        }
+    }
+}
+
+void 
+ApplicationController::_dispatchMIDIInputEvents(MonomeXXhDevice *const *targets, unsigned int numTargets, const MIDIInputEvent *events, unsigned int numEvents)
+{
+    for (unsigned int i = 0; i < numTargets; i++) {
+        for (unsigned int j = 0; j < numEvents; j++)
+            _handleMIDIMessage(targets[i], events[j]);
+    }
+}
+
+void 
+ApplicationController::_dispatchMIDISysEx(MonomeXXhDevice *const *targets, unsigned int numTargets, const unsigned char *data, unsigned int length, HostTime time)
+{
+    if (length < kMIDISysExHeaderSize + 1 || data[0] != 0xF0 || data[length - 1] != 0xF7 ||
+        data[1] != kMIDISysExManufacturerID || data[2] != kMIDISysExMonomeID)
+        return;
+
+    unsigned char command = (data[3] >> 4) & 0x07;
+    unsigned char channel = data[3] & 0x0F;
+
+    for (unsigned int i = 0; i < numTargets; i++) {
+        if (targets[i]->MIDIInputChannel() == channel)
+            _handleMIDISysEx(targets[i], command, data + kMIDISysExHeaderSize, length - kMIDISysExHeaderSize - 1, time);
+    }
+}
+
+void 
+ApplicationController::_handleMIDISysEx(MonomeXXhDevice *device, unsigned char command, const unsigned char *data, unsigned int length, HostTime time)
+{
+    MIDILedEvent event;
+    uint16 *bitMaps = event.bitMaps;
+    unsigned int index = 0, numBits;
+
+    if (command == kMIDISysExLedLatency || command == kMIDISysExEncInterval || command == kMIDISysExEncAccel) {
+        if (length < 2)
+            return;
+
+        unsigned int value = data[0] | (data[1] << 7);
+
+        // latency takes effect for events received from now on
+        if (command == kMIDISysExLedLatency)
+            device->setMIDILedLatency(value);
+        else if (command == kMIDISysExEncInterval)
+            device->setEncoderInterval(value);
+        else
+            device->setEncoderAcceleration(value / 100.f);
+        return;
+    }
+    else if (command == kMIDISysExSensorFilter) {
+        if (length < 8)
+            return;
+
+        device->setSensorFilter(data[0],
+                                (data[1] | (data[2] << 7)) / 1000.f,
+                                data[3] | (data[4] << 7),
+                                (SensorFilter::Smoothing)(data[5] <= SensorFilter::kSmoothing_Median ? data[5] : SensorFilter::kSmoothing_None),
+                                (data[6] | (data[7] << 7)) / 100.f);
+        return;
+    }
+    else if (command == kMIDISysExLedRow || command == kMIDISysExLedColumn) {
+        if (length < 1)
+            return;
+
+        index = data[0];
+        data++;
+        length--;
+        numBits = command == kMIDISysExLedRow ? device->columns() : device->rows();
+    }
+    else if (command == kMIDISysExLedFrame) {
+        numBits = device->rows() * device->columns();
+    }
+    else {
+        return;
+    }
+
+    // unpack the 7 bit stream: bit n is bit (n % 7) of data byte n / 7, missing bytes read as off
+    memset(event.bitMaps, 0, sizeof(event.bitMaps));
+
+    for (unsigned int n = 0; n < numBits && n / 7 < length; n++) {
+        if (data[n / 7] & (1 << (n % 7))) {
+            if (command == kMIDISysExLedFrame)
+                bitMaps[n / device->columns()] |= 1 << (n % device->columns());
+            else
+                bitMaps[0] |= 1 << n;
+        }
+    }
+
+    event.command = command;
+    event.index = index;
+    _scheduleMIDILedEvent(device, event, time);
+}
+
+void 
+ApplicationController::handleScheduledMIDILedEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+    if (length == sizeof(MIDILedEvent))
+        _applyMIDILedEvent(device, *(const MIDILedEvent *)data);
+}
+
+void 
+ApplicationController::handleLedAnimationEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+    if (length != sizeof(LedAnimationStep))
+        return;
+
+    LedAnimationStep step = *(const LedAnimationStep *)data;
+    unsigned int interval = device->stepLedAnimation(step.generation);
+
+    if (interval == 0)
+        return;
+
+    // steps keep to the animation's own clock, unless drawing has fallen behind it
+    HostTime now = EventScheduler::now();
+
+    step.time += EventScheduler::hostTimeFromMilliseconds(interval);
+    if (step.time < now)
+        step.time = now;
+
+    _ledScheduler.schedule(step.time, _ApplicationController_LedAnimationCallback, this, device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::_startLedAnimation(MonomeXXhDevice *device, const LedAnimation &animation)
+{
+    LedAnimationStep step;
+
+    step.generation = device->startLedAnimation(animation);
+    step.time = EventScheduler::now();
+
+    // the first step is drawn straight away
+    handleLedAnimationEvent(device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::handleAutoSwapEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+    if (length != sizeof(LedAnimationStep))
+        return;
+
+    LedAnimationStep step = *(const LedAnimationStep *)data;
+    unsigned int interval = device->autoSwapLeds(step.generation);
+
+    if (interval == 0)
+        return;
+
+    HostTime now = EventScheduler::now();
+
+    step.time += EventScheduler::hostTimeFromMilliseconds(interval);
+    if (step.time < now)
+        step.time = now;
+
+    _ledScheduler.schedule(step.time, _ApplicationController_AutoSwapCallback, this, device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::_setDoubleBuffered(MonomeXXhDevice *device, bool doubleBuffered, unsigned int autoSwapInterval)
+{
+    LedAnimationStep step;
+
+    step.generation = device->setDoubleBuffered(doubleBuffered, autoSwapInterval);
+    step.time = EventScheduler::now() + EventScheduler::hostTimeFromMilliseconds(autoSwapInterval);
+
+    // a swap already scheduled belongs to the old generation and lapses
+    if (doubleBuffered && autoSwapInterval > 0)
+        _ledScheduler.schedule(step.time, _ApplicationController_AutoSwapCallback, this, device, &step, sizeof(step));
+}
+
+// called on the device's transmit thread once a swapped frame has been written
+void 
+ApplicationController::handleSwapEvent(MonomeXXhDevice *device, double milliseconds)
+{
+    list<OscAtom *> oscAtomList;
+    OscAtom atom;
+
+    if (device == 0 || _protocol != kProtocolType_OpenSoundControl)
+        return;
+
+    string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternSwapSuffix;
+
+    atom.setValue((float)milliseconds);
+    oscAtomList.push_back(&atom);
+
+    _oscController.send(_oscHostRef, oscAddressPattern, &oscAtomList);
+}
+
+// sends the device's flow state to the host, on whichever thread found a report due
+void 
+ApplicationController::handleFlowEvent(MonomeXXhDevice *device)
+{
+    static const string flowString = kOscDefaultAddrPatternSystemFlow;
+    list<OscAtom *> oscAtomList;
+    OscAtom atoms[4];
+    MonomeXXhDevice::FlowState state;
+    unsigned int index;
+
+    if (device == 0)
+        return;
+
+    device->reportFlowState(state);
+
+    if (_protocol != kProtocolType_OpenSoundControl)
+        return;
+
+    for (index = 0; index < _devices.size() && _devices[index] != device; index++)
+        ;
+
+    if (index == _devices.size())
+        return;
+
+    atoms[0].setValue((int)index);
+    atoms[1].setValue((int)state.level);
+    atoms[2].setValue((int)state.credits);
+    atoms[3].setValue(state.utilisation);
+
+    for (unsigned int i = 0; i < 4; i++)
+        oscAtomList.push_back(&atoms[i]);
+
+    _oscController.send(_oscHostRef, flowString, &oscAtomList);
+}
+
+ApplicationController::FlowCharge::~FlowCharge()
+{
+    for (vector<MonomeXXhDevice *>::const_iterator i = _devices.begin(); i != _devices.end(); i++) {
+        if ((*i)->chargeFlowCredit())
+            _controller->handleFlowEvent(*i);
+    }
+}
+
+ApplicationController::LedsLock::LedsLock(const vector<MonomeXXhDevice *> &devices) : _devices(devices)
+{
+    for (vector<MonomeXXhDevice *>::const_iterator i = _devices.begin(); i != _devices.end(); i++)
+        (*i)->lockLeds();
+}
+
+ApplicationController::LedsLock::~LedsLock()
+{
+    for (vector<MonomeXXhDevice *>::const_reverse_iterator i = _devices.rbegin(); i != _devices.rend(); i++)
+        (*i)->unlockLeds();
+}
+
+void 
+ApplicationController::_scheduleMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event, HostTime time)
+{
+    HostTime due = time + EventScheduler::hostTimeFromMilliseconds(device->MIDILedLatency());
+
+    // anything already due goes straight out, unless it would overtake events still queued
+    if (due <= EventScheduler::now() && !_ledScheduler.hasPendingEvents())
+        _applyMIDILedEvent(device, event);
+    else if (!_ledScheduler.schedule(due, _ApplicationController_MIDILedEventCallback, this, device, &event, sizeof(event)))
+        _applyMIDILedEvent(device, event);
+}
+
+void 
+ApplicationController::_applyMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event)
+{
+    if (event.command == kMIDILedNote)
+        device->MIDILedStateChangeEvent(event.index, event.velocity);
+    else if (event.command == kMIDISysExLedRow)
+        device->MIDILedRowEvent(event.index, event.bitMaps[0]);
+    else if (event.command == kMIDISysExLedColumn)
+        device->MIDILedColumnEvent(event.index, event.bitMaps[0]);
+    else if (event.command == kMIDISysExLedFrame)
+        device->MIDILedFrameEvent(event.bitMaps);
 }
 
+void 
+ApplicationController::_rebuildMIDIInputIndex(void)
+{
+    vector<MonomeXXhDevice *>::iterator i;
+
+    pthread_mutex_lock(&_midiInputIndexLock);
+
+    _midiInputIndex.clear();
+
+    for (i = _devices.begin(); i != _devices.end(); i++) {
+        if (*i != 0 && (*i)->MIDIInputDevice() != 0)
+            _midiInputIndex[(*i)->MIDIInputDevice()].push_back(*i);
+    }
+
+    pthread_mutex_unlock(&_midiInputIndexLock);
+}
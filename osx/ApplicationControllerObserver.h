@@ -0,0 +1,47 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __ApplicationControllerObserver_h__
+#define __ApplicationControllerObserver_h__
+
+#include <string>
+
+// what the routing core tells the outside world about its state.  ApplicationController
+// only knows its observer through this interface, so it runs the same with a window, with
+// something else watching, or with no observer at all.
+//
+// calls come from the serial, OSC and MIDI threads.  serialNumber names the device whose
+// settings changed, or is empty when every device changed.
+class ApplicationControllerObserver
+{
+public:
+    virtual ~ApplicationControllerObserver(void) {}
+
+    virtual void deviceListChanged(void) = 0;
+    virtual void midiDeviceListChanged(void) = 0;
+
+    virtual void addressPatternPrefixChanged(const std::string& serialNumber) = 0;
+    virtual void cableOrientationChanged(const std::string& serialNumber) = 0;
+    virtual void offsetChanged(const std::string& serialNumber) = 0;
+    virtual void adcStatesChanged(const std::string& serialNumber) = 0;
+    virtual void encStatesChanged(const std::string& serialNumber) = 0;
+    virtual void midiInputDeviceChanged(const std::string& serialNumber) = 0;
+    virtual void midiOutputDeviceChanged(const std::string& serialNumber) = 0;
+};
+
+#endif // __ApplicationControllerObserver_h__
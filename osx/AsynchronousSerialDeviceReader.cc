@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #include "AsynchronousSerialDeviceReader.h"
+#include "RealtimeThread.h"
 
 void *_AsynchronousSerialDeviceReaderCallbackWrapper(void *userData)
 {
@@ -122,8 +123,11 @@ AsynchronousSerialDeviceReader::_read(void)
     struct timeval timeout;
     size_t bytesToRead;
     ssize_t bytesRead;
+    RealtimeThread realtime(RealtimeThread::kThreadClass_Reader);
 
     while (!_terminate_pthread) {
+        realtime.update();
+
         pthread_mutex_lock(&_deviceContextsLock);
 
         nfds = 0;
@@ -173,11 +177,21 @@ AsynchronousSerialDeviceReader::_read(void)
                                 _serial_rx_in -= _serial_rx_buf_size;
 
                             while (_serial_rx_out != _serial_rx_in) {
-                                if (_serial_rx_in >= _serial_rx_out && _serial_rx_in - _serial_rx_out < context.packetSize)
+                                size_t burstSize;
+
+                                // hand the callback every complete packet in the contiguous part of the
+                                // ring at once, so whatever it sends in response can go out as one burst.
+                                if (_serial_rx_in >= _serial_rx_out)
+                                    burstSize = _serial_rx_in - _serial_rx_out;
+                                else
+                                    burstSize = _serial_rx_buf + _serial_rx_buf_size - _serial_rx_out;
+
+                                burstSize -= burstSize % context.packetSize;
+                                if (burstSize == 0)
                                     break;
 
                                 if (context.callback != 0 && 
-                                    context.callback(device, _serial_rx_out, context.packetSize, context.userData) != 0) {
+                                    context.callback(device, _serial_rx_out, burstSize, context.userData) != 0) {
                                     _serial_rx_out = _serial_rx_in = _serial_rx_buf;
 
                                     device->flush();
@@ -185,7 +199,7 @@ AsynchronousSerialDeviceReader::_read(void)
                                     break;
                                 }
 
-                                _serial_rx_out += context.packetSize;
+                                _serial_rx_out += burstSize;
                                 if (_serial_rx_out >= _serial_rx_buf + _serial_rx_buf_size)
                                     _serial_rx_out -= _serial_rx_buf_size;
                             }
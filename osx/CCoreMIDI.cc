@@ -25,6 +25,8 @@ CCoreMIDI::CCoreMIDI(const string& clientName)
 {
     OSStatus status;
 
+    pthread_mutex_init(&_outputLock, NULL);
+
     CFStringRef clientNameAsCFString = CFStringCreateWithCString(NULL, clientName.c_str(), kCFStringEncodingMacRoman);
     status = MIDIClientCreate(clientNameAsCFString,
                               _cCoreMIDINotificationProc,
@@ -53,6 +55,12 @@ CCoreMIDI::~CCoreMIDI()
 {
     list<MIDIEndpointRef>::iterator i;
     list<MIDIPortRef>::iterator j;
+    map<MIDIEndpointRef, OutputBuffer *>::iterator k;
+
+    for (k = _outputBuffers.begin(); k != _outputBuffers.end(); k++)
+        delete (*k).second;
+
+    _outputBuffers.clear();
 
     for (i = _myMIDISources.begin(); i != _myMIDISources.end(); i++) {
         MIDIEndpointRef endpointRef = *i;
@@ -71,6 +79,8 @@ CCoreMIDI::~CCoreMIDI()
     MIDIPortDispose(_myInputPort);
 
     MIDIClientDispose(_myClientRef);
+
+    pthread_mutex_destroy(&_outputLock);
 }
 
 int 
@@ -282,6 +292,14 @@ CCoreMIDI::createSource(const string& sourceName)
                                     kMIDIPropertyDriverOwner,
                                     clientName);
 
+        pthread_mutex_lock(&_outputLock);
+
+        map<MIDIEndpointRef, OutputBuffer *>::iterator i = _outputBuffers.find(endpointRef);
+        if (i != _outputBuffers.end())
+            (*i).second->isVirtualSource = true;
+
+        pthread_mutex_unlock(&_outputLock);
+
         _myMIDISources.push_back(endpointRef); // here we may want to assign it the same unique id it had the last time the
     }                                           // the application started.  We may want to give this a property like, 'IsMapdSource'.
     
@@ -315,6 +333,16 @@ CCoreMIDI::disposeSource(CCoreMIDIEndpointRef sourceRef)
 {
     MIDIEndpointRef endpointRef = (MIDIEndpointRef)sourceRef;
 
+    pthread_mutex_lock(&_outputLock);
+
+    map<MIDIEndpointRef, OutputBuffer *>::iterator i = _outputBuffers.find(endpointRef);
+    if (i != _outputBuffers.end()) {
+        delete (*i).second;
+        _outputBuffers.erase(i);
+    }
+
+    pthread_mutex_unlock(&_outputLock);
+
     _myMIDISources.remove(endpointRef);
     OSStatus status = MIDIEndpointDispose(endpointRef);
 }
@@ -374,24 +402,108 @@ CCoreMIDI::MIDIPortDispose(CCoreMIDIPortRef port)
 void 
 CCoreMIDI::sendShort(CCoreMIDIEndpointRef destinationRef, char midiStatusByte, char midiDataByte1, char midiDataByte2)
 {
-    OSStatus status;
-    Byte buffer[256];
-    MIDIPacketList *packetList = (MIDIPacketList *)buffer;
-    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    MIDIEndpointRef endpointRef = (MIDIEndpointRef) destinationRef;
+
+    pthread_mutex_lock(&_outputLock);
+
+    OutputBuffer *outputBuffer = _outputBufferForEndpoint(endpointRef);
     Byte midiMessage[] = { (Byte)midiStatusByte, (Byte)midiDataByte1, (Byte)midiDataByte2 };
-    packet = MIDIPacketListAdd(packetList, 
-                               sizeof(buffer), 
-                               packet, 
-                               0, // mach_absolute_time()
-                               3,
-                               midiMessage);
 
+    // anything already staged for this endpoint has to go out first to keep ordering
+    _flushOutputBuffer(endpointRef, outputBuffer);
+
+    outputBuffer->packet = MIDIPacketListAdd(outputBuffer->packetList, 
+                                             sizeof(outputBuffer->buffer), 
+                                             outputBuffer->packet, 
+                                             0, // mach_absolute_time()
+                                             3,
+                                             midiMessage);
+
+    _flushOutputBuffer(endpointRef, outputBuffer);
+
+    pthread_mutex_unlock(&_outputLock);
+}
+
+void 
+CCoreMIDI::queueShort(CCoreMIDIEndpointRef destinationRef, char midiStatusByte, char midiDataByte1, char midiDataByte2, MIDITimeStamp timeStamp)
+{
     MIDIEndpointRef endpointRef = (MIDIEndpointRef) destinationRef;
+    Byte midiMessage[] = { (Byte)midiStatusByte, (Byte)midiDataByte1, (Byte)midiDataByte2 };
+
+    pthread_mutex_lock(&_outputLock);
+
+    OutputBuffer *outputBuffer = _outputBufferForEndpoint(endpointRef);
+
+    // messages with the same timestamp are appended to the current packet, so a burst
+    // from one serial read ends up as a single packet.  CoreMIDI does not allow running status.
+    MIDIPacket *packet = MIDIPacketListAdd(outputBuffer->packetList, 
+                                           sizeof(outputBuffer->buffer), 
+                                           outputBuffer->packet, 
+                                           timeStamp,
+                                           3,
+                                           midiMessage);
 
-    if (_sourceIsVirtualSource(endpointRef))
-        status = MIDIReceived(endpointRef, packetList);
+    if (packet == NULL) {
+        _flushOutputBuffer(endpointRef, outputBuffer);
+
+        packet = MIDIPacketListAdd(outputBuffer->packetList, 
+                                   sizeof(outputBuffer->buffer), 
+                                   outputBuffer->packet, 
+                                   timeStamp,
+                                   3,
+                                   midiMessage);
+    }
+
+    outputBuffer->packet = packet;
+
+    pthread_mutex_unlock(&_outputLock);
+}
+
+void 
+CCoreMIDI::flushOutput(void)
+{
+    map<MIDIEndpointRef, OutputBuffer *>::iterator i;
+
+    pthread_mutex_lock(&_outputLock);
+
+    for (i = _outputBuffers.begin(); i != _outputBuffers.end(); i++)
+        _flushOutputBuffer((*i).first, (*i).second);
+
+    pthread_mutex_unlock(&_outputLock);
+}
+
+CCoreMIDI::OutputBuffer *
+CCoreMIDI::_outputBufferForEndpoint(MIDIEndpointRef endpointRef)
+{
+    map<MIDIEndpointRef, OutputBuffer *>::iterator i = _outputBuffers.find(endpointRef);
+
+    if (i != _outputBuffers.end())
+        return (*i).second;
+
+    OutputBuffer *outputBuffer = new OutputBuffer;
+    outputBuffer->packetList = (MIDIPacketList *)outputBuffer->buffer;
+    outputBuffer->packet = MIDIPacketListInit(outputBuffer->packetList);
+    outputBuffer->isVirtualSource = _sourceIsVirtualSource(endpointRef);
+
+    _outputBuffers[endpointRef] = outputBuffer;
+
+    return outputBuffer;
+}
+
+void 
+CCoreMIDI::_flushOutputBuffer(MIDIEndpointRef endpointRef, OutputBuffer *outputBuffer)
+{
+    OSStatus status;
+
+    if (outputBuffer->packetList->numPackets == 0)
+        return;
+
+    if (outputBuffer->isVirtualSource)
+        status = MIDIReceived(endpointRef, outputBuffer->packetList);
     else 
-        status = MIDISend(_myOutputPort, endpointRef, packetList);
+        status = MIDISend(_myOutputPort, endpointRef, outputBuffer->packetList);
+
+    outputBuffer->packet = MIDIPacketListInit(outputBuffer->packetList);
 }
 
 void 
@@ -23,7 +23,10 @@
 
 #include <CoreMIDI/CoreMIDI.h>
 
+#include <pthread.h>
+
 #include <list>
+#include <map>
 #include <string>
 using namespace std;
 
@@ -62,9 +65,25 @@ public:
 
     void sendShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char midiDataByte1, char midiDataByte2);
 
+    // queueShort stages a message on the endpoint's packet list; flushOutput sends
+    // everything staged since the last flush, one MIDISend/MIDIReceived per endpoint.
+    // timeStamp is host time (mach_absolute_time), 0 for now.
+    void queueShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char midiDataByte1, char midiDataByte2, MIDITimeStamp timeStamp = 0);
+    void flushOutput(void);
+
     void registerForMIDISystemStateChangeNotifications(CCoreMIDINotificationProc callback, void *userData);
 
 private:
+    typedef struct {
+        Byte buffer[1024];
+        MIDIPacketList *packetList;
+        MIDIPacket *packet;
+        bool isVirtualSource;
+    } OutputBuffer;
+
+    OutputBuffer *_outputBufferForEndpoint(MIDIEndpointRef endpointRef);
+    void _flushOutputBuffer(MIDIEndpointRef endpointRef, OutputBuffer *outputBuffer);
+
     void _coreMIDISystemStateChanged(const MIDINotification *message);
     bool _sourceIsVirtualSource(MIDIEndpointRef endpointRef);
     bool _destinationIsVirtualDestination(MIDIEndpointRef endpointRef);
@@ -78,6 +97,10 @@ private:
     list<MIDIPortRef> _myPorts;
     list<pair<CCoreMIDINotificationProc, void *> > _notificationCallbacks;
 
+    // keyed by endpoint, so a send resolves its buffer and virtual-ness without walking _myMIDISources
+    map<MIDIEndpointRef, OutputBuffer *> _outputBuffers;
+    pthread_mutex_t _outputLock;
+
     friend void _cCoreMIDINotificationProc(const MIDINotification *message, void *refCon);
 };
 
@@ -0,0 +1,205 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "CoalescingObserver.h"
+
+CoalescingObserver::CoalescingObserver(ApplicationControllerObserver *observer, unsigned int interval)
+{
+    _observer = observer;
+    _interval = interval;
+    _pending = 0;
+
+    pthread_mutex_init(&_lock, NULL);
+}
+
+CoalescingObserver::~CoalescingObserver(void)
+{
+    stop();
+
+    pthread_mutex_destroy(&_lock);
+}
+
+void 
+CoalescingObserver::start(void)
+{
+    _scheduler.start(false);
+}
+
+void 
+CoalescingObserver::stop(void)
+{
+    _scheduler.stop();
+
+    pthread_mutex_lock(&_lock);
+    _pending = 0;
+    pthread_mutex_unlock(&_lock);
+}
+
+void 
+CoalescingObserver::setInterval(unsigned int milliseconds)
+{
+    _interval = milliseconds;
+}
+
+unsigned int 
+CoalescingObserver::interval(void) const
+{
+    return _interval;
+}
+
+void 
+CoalescingObserver::flush(void)
+{
+    std::string serialNumbers[kNumChanges];
+    unsigned int pending;
+    unsigned int change;
+
+    pthread_mutex_lock(&_lock);
+    pending = _pending;
+    _pending = 0;
+    for (change = 0; change < kNumChanges; change++) {
+        if (pending & (1 << change))
+            serialNumbers[change].swap(_serialNumbers[change]);
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (_observer == 0)
+        return;
+
+    // the device list first, so the rest is read against the current devices
+    for (change = 0; change < kNumChanges; change++) {
+        if (!(pending & (1 << change)))
+            continue;
+
+        const std::string& serialNumber = serialNumbers[change];
+
+        switch (change) {
+        case kChange_DeviceList:
+            _observer->deviceListChanged();
+            break;
+        case kChange_MIDIDeviceList:
+            _observer->midiDeviceListChanged();
+            break;
+        case kChange_AddressPatternPrefix:
+            _observer->addressPatternPrefixChanged(serialNumber);
+            break;
+        case kChange_CableOrientation:
+            _observer->cableOrientationChanged(serialNumber);
+            break;
+        case kChange_Offset:
+            _observer->offsetChanged(serialNumber);
+            break;
+        case kChange_AdcStates:
+            _observer->adcStatesChanged(serialNumber);
+            break;
+        case kChange_EncStates:
+            _observer->encStatesChanged(serialNumber);
+            break;
+        case kChange_MIDIInputDevice:
+            _observer->midiInputDeviceChanged(serialNumber);
+            break;
+        case kChange_MIDIOutputDevice:
+            _observer->midiOutputDeviceChanged(serialNumber);
+            break;
+        }
+    }
+}
+
+void 
+CoalescingObserver::deviceListChanged(void)
+{
+    _mark(kChange_DeviceList, "");
+}
+
+void 
+CoalescingObserver::midiDeviceListChanged(void)
+{
+    _mark(kChange_MIDIDeviceList, "");
+}
+
+void 
+CoalescingObserver::addressPatternPrefixChanged(const std::string& serialNumber)
+{
+    _mark(kChange_AddressPatternPrefix, serialNumber);
+}
+
+void 
+CoalescingObserver::cableOrientationChanged(const std::string& serialNumber)
+{
+    _mark(kChange_CableOrientation, serialNumber);
+}
+
+void 
+CoalescingObserver::offsetChanged(const std::string& serialNumber)
+{
+    _mark(kChange_Offset, serialNumber);
+}
+
+void 
+CoalescingObserver::adcStatesChanged(const std::string& serialNumber)
+{
+    _mark(kChange_AdcStates, serialNumber);
+}
+
+void 
+CoalescingObserver::encStatesChanged(const std::string& serialNumber)
+{
+    _mark(kChange_EncStates, serialNumber);
+}
+
+void 
+CoalescingObserver::midiInputDeviceChanged(const std::string& serialNumber)
+{
+    _mark(kChange_MIDIInputDevice, serialNumber);
+}
+
+void 
+CoalescingObserver::midiOutputDeviceChanged(const std::string& serialNumber)
+{
+    _mark(kChange_MIDIOutputDevice, serialNumber);
+}
+
+void 
+CoalescingObserver::_flushCallback(void *, const void *, unsigned int, void *userData)
+{
+    ((CoalescingObserver *)userData)->flush();
+}
+
+void 
+CoalescingObserver::_mark(Change change, const std::string& serialNumber)
+{
+    bool schedule;
+
+    pthread_mutex_lock(&_lock);
+
+    // nothing waiting means no flush is scheduled yet
+    schedule = _pending == 0;
+
+    if (!(_pending & (1 << change))) {
+        _pending |= 1 << change;
+        _serialNumbers[change] = serialNumber;
+    }
+    else if (_serialNumbers[change] != serialNumber) {
+        _serialNumbers[change].clear();
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    if (schedule)
+        _scheduler.schedule(EventScheduler::now() + EventScheduler::hostTimeFromMilliseconds(_interval), _flushCallback, this, this, 0, 0);
+}
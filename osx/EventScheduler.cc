@@ -0,0 +1,251 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "EventScheduler.h"
+#include "RealtimeThread.h"
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+static mach_timebase_info_data_t _timebaseInfo(void)
+{
+    static mach_timebase_info_data_t timebaseInfo = { 0, 0 };
+
+    if (timebaseInfo.denom == 0)
+        mach_timebase_info(&timebaseInfo);
+
+    return timebaseInfo;
+}
+
+EventScheduler::EventScheduler(void)
+{
+    _running = false;
+    _timeCritical = false;
+    _terminate = false;
+
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_wakeCondition, NULL);
+    pthread_mutex_init(&_deliveryLock, NULL);
+}
+
+EventScheduler::~EventScheduler(void)
+{
+    stop();
+
+    pthread_mutex_destroy(&_deliveryLock);
+    pthread_cond_destroy(&_wakeCondition);
+    pthread_mutex_destroy(&_lock);
+}
+
+void 
+EventScheduler::start(bool timeCritical)
+{
+    if (_running)
+        return;
+
+    _terminate = false;
+    _timeCritical = timeCritical;
+
+    if (pthread_create(&_thread, NULL, _threadProc, this) != 0)
+        return;
+
+    _running = true;
+}
+
+void 
+EventScheduler::stop(void)
+{
+    if (!_running)
+        return;
+
+    pthread_mutex_lock(&_lock);
+    _terminate = true;
+    pthread_cond_signal(&_wakeCondition);
+    pthread_mutex_unlock(&_lock);
+
+    pthread_join(_thread, NULL);
+    _running = false;
+
+    pthread_mutex_lock(&_lock);
+    _events.clear();
+    pthread_mutex_unlock(&_lock);
+}
+
+bool 
+EventScheduler::schedule(HostTime time, EventSchedulerCallback callback, void *userData, void *target, const void *data, unsigned int length)
+{
+    if (callback == 0 || length > kMaxEventDataSize)
+        return false;
+
+    Event event;
+    event.callback = callback;
+    event.userData = userData;
+    event.target = target;
+    event.length = length;
+    memcpy(event.data, data, length);
+
+    pthread_mutex_lock(&_lock);
+
+    // insert after any events at the same time, and wake the thread if this is now the earliest
+    multimap<HostTime, Event>::iterator i = _events.insert(_events.upper_bound(time), make_pair(time, event));
+    if (i == _events.begin())
+        pthread_cond_signal(&_wakeCondition);
+
+    pthread_mutex_unlock(&_lock);
+
+    return true;
+}
+
+void 
+EventScheduler::cancel(void *target)
+{
+    pthread_mutex_lock(&_deliveryLock);
+    pthread_mutex_lock(&_lock);
+
+    multimap<HostTime, Event>::iterator i = _events.begin();
+    while (i != _events.end()) {
+        if (i->second.target == target)
+            _events.erase(i++);
+        else
+            ++i;
+    }
+
+    pthread_mutex_unlock(&_lock);
+    pthread_mutex_unlock(&_deliveryLock);
+}
+
+bool 
+EventScheduler::hasPendingEvents(void)
+{
+    pthread_mutex_lock(&_lock);
+    bool pending = !_events.empty();
+    pthread_mutex_unlock(&_lock);
+
+    return pending;
+}
+
+HostTime 
+EventScheduler::now(void)
+{
+    return mach_absolute_time();
+}
+
+HostTime 
+EventScheduler::hostTimeFromMilliseconds(double milliseconds)
+{
+    mach_timebase_info_data_t timebaseInfo = _timebaseInfo();
+    return (HostTime)(milliseconds * 1000000.0 * timebaseInfo.denom / timebaseInfo.numer);
+}
+
+double 
+EventScheduler::millisecondsFromHostTime(HostTime hostTime)
+{
+    mach_timebase_info_data_t timebaseInfo = _timebaseInfo();
+    return (double)hostTime * timebaseInfo.numer / timebaseInfo.denom / 1000000.0;
+}
+
+NtpTime 
+EventScheduler::ntpNow(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    // unix time counts from 1970, ntp from 1900
+    uint64_t seconds = (uint64_t)tv.tv_sec + 2208988800ULL;
+    uint64_t fraction = ((uint64_t)tv.tv_usec << 32) / 1000000;
+
+    return (seconds << 32) | fraction;
+}
+
+NtpTime 
+EventScheduler::ntpTimeFromHostTime(HostTime hostTime)
+{
+    double seconds = millisecondsFromHostTime(hostTime) / 1000.0;
+    uint64_t whole = (uint64_t)seconds;
+
+    return (whole << 32) | (uint64_t)((seconds - (double)whole) * 4294967296.0);
+}
+
+void *
+EventScheduler::_threadProc(void *parameter)
+{
+    ((EventScheduler *)parameter)->_run();
+    return NULL;
+}
+
+void 
+EventScheduler::_run(void)
+{
+    RealtimeThread realtime(RealtimeThread::kThreadClass_Scheduler);
+
+    // set from the thread itself before real time mode first looks, so leaving real time
+    // mode comes back to this rather than to the default
+    if (_timeCritical) {
+        struct sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_RR);
+        pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+    }
+
+    pthread_mutex_lock(&_lock);
+
+    while (!_terminate) {
+        if (_timeCritical)
+            realtime.update();
+
+        if (_events.empty()) {
+            pthread_cond_wait(&_wakeCondition, &_lock);
+            continue;
+        }
+
+        HostTime time = _events.begin()->first;
+        HostTime current = now();
+
+        if (time > current) {
+            // an earlier event may be scheduled meanwhile, so look again either way
+            double nanoseconds = millisecondsFromHostTime(time - current) * 1000000.0;
+            struct timespec timeout;
+            timeout.tv_sec = (time_t)(nanoseconds / 1000000000.0);
+            timeout.tv_nsec = (long)(nanoseconds - timeout.tv_sec * 1000000000.0);
+
+            pthread_cond_timedwait_relative_np(&_wakeCondition, &_lock, &timeout);
+            continue;
+        }
+
+        // the delivery lock is always taken before _lock
+        pthread_mutex_unlock(&_lock);
+        pthread_mutex_lock(&_deliveryLock);
+        pthread_mutex_lock(&_lock);
+
+        while (!_events.empty() && _events.begin()->first <= now()) {
+            Event event = _events.begin()->second;
+            _events.erase(_events.begin());
+
+            pthread_mutex_unlock(&_lock);
+            event.callback(event.target, event.data, event.length, event.userData);
+            pthread_mutex_lock(&_lock);
+        }
+
+        pthread_mutex_unlock(&_deliveryLock);
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
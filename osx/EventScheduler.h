@@ -0,0 +1,92 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __EventScheduler_h__
+#define __EventScheduler_h__
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <map>
+using namespace std;
+
+// host time is mach_absolute_time, the same clock as CoreMIDI timestamps
+typedef uint64_t HostTime;
+
+// osc time tags: seconds since 1900 in the high 32 bits, the fraction of a second in the low 32
+typedef uint64_t NtpTime;
+
+typedef void (*EventSchedulerCallback)(void *target, const void *data, unsigned int length, void *userData);
+
+// delivers small, copied events on its own thread at a given host time.  events due
+// at the same time go out in the order they were scheduled.
+class EventScheduler
+{
+public:
+    enum { kMaxEventDataSize = 40 };
+
+public:
+    EventScheduler(void);
+    ~EventScheduler(void);
+
+    // timeCritical runs the thread round robin at the top priority, and real time with the
+    // scheduler class while RealtimeThread is enabled; leave it off for events that can wait
+    void start(bool timeCritical = true);
+    void stop(void);
+
+    bool schedule(HostTime time, EventSchedulerCallback callback, void *userData, void *target, const void *data, unsigned int length);
+
+    // drops every pending event for target.  if one is being delivered, waits for it to finish.
+    void cancel(void *target);
+
+    bool hasPendingEvents(void);
+
+    static HostTime now(void);
+    static HostTime hostTimeFromMilliseconds(double milliseconds);
+    static double millisecondsFromHostTime(HostTime hostTime);
+
+    // the wall clock as a time tag, and a span of host time in time tag units
+    static NtpTime ntpNow(void);
+    static NtpTime ntpTimeFromHostTime(HostTime hostTime);
+
+private:
+    typedef struct {
+        EventSchedulerCallback callback;
+        void *userData;
+        void *target;
+        unsigned int length;
+        unsigned char data[kMaxEventDataSize];
+    } Event;
+
+    static void *_threadProc(void *parameter);
+    void _run(void);
+
+private:
+    multimap<HostTime, Event> _events;
+
+    pthread_t _thread;
+    bool _running;
+    bool _timeCritical;
+    bool _terminate;
+
+    pthread_mutex_t _lock;          // guards _events and _terminate
+    pthread_cond_t _wakeCondition;
+    pthread_mutex_t _deliveryLock;  // held while callbacks run, so cancel can wait them out
+};
+
+#endif // __EventScheduler_h__
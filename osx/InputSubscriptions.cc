@@ -0,0 +1,183 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "InputSubscriptions.h"
+
+#include <string.h>
+
+
+InputSubscriptions::InputSubscriptions(void)
+{
+    for (unsigned int s = 0; s < kMaxSubscribers; s++)
+        _subscribers[s].destination = 0;
+
+    _numSubscribers = 0;
+    _layoutGeneration = MonomeXXhDevice::layoutGeneration();
+
+    pthread_mutex_init(&_lock, NULL);
+}
+
+InputSubscriptions::~InputSubscriptions(void)
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+bool 
+InputSubscriptions::subscribe(const string &prefix, OscHostRef destination, unsigned int events, unsigned int column, unsigned int row, unsigned int width, unsigned int height)
+{
+    pthread_mutex_lock(&_lock);
+
+    Subscriber *subscriber = 0;
+    bool added = false;
+
+    for (unsigned int s = 0; s < kMaxSubscribers; s++) {
+        if (_subscribers[s].destination == destination && _subscribers[s].prefix == prefix) {
+            subscriber = &_subscribers[s];
+            break;
+        }
+        else if (_subscribers[s].destination == 0 && subscriber == 0)
+            subscriber = &_subscribers[s];
+    }
+
+    if (subscriber != 0) {
+        if (subscriber->destination == 0) {
+            subscriber->prefix = prefix;
+            subscriber->isPattern = OscAddressPattern::isPattern(prefix);
+            subscriber->pattern = subscriber->isPattern ? OscAddressPattern(prefix) : OscAddressPattern();
+            subscriber->destination = destination;
+            _numSubscribers++;
+            added = true;
+        }
+
+        subscriber->events = events;
+        subscriber->column = column;
+        subscriber->row = row;
+        subscriber->width = width;
+        subscriber->height = height;
+
+        _deviceMasks.clear();
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return added;
+}
+
+bool 
+InputSubscriptions::unsubscribe(const string &prefix, OscHostRef destination)
+{
+    pthread_mutex_lock(&_lock);
+
+    bool removed = false;
+
+    for (unsigned int s = 0; s < kMaxSubscribers; s++) {
+        if (_subscribers[s].destination == destination && _subscribers[s].prefix == prefix) {
+            _subscribers[s].destination = 0;
+            _subscribers[s].prefix.clear();
+            _subscribers[s].pattern = OscAddressPattern();
+            _numSubscribers--;
+            _deviceMasks.clear();
+            removed = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    return removed;
+}
+
+const InputSubscriptions::DeviceMasks &
+InputSubscriptions::_masks(MonomeXXhDevice *device)
+{
+    if (_layoutGeneration != MonomeXXhDevice::layoutGeneration()) {
+        _deviceMasks.clear();
+        _layoutGeneration = MonomeXXhDevice::layoutGeneration();
+    }
+
+    map<MonomeXXhDevice *, DeviceMasks>::iterator i = _deviceMasks.find(device);
+
+    if (i != _deviceMasks.end())
+        return i->second;
+
+    DeviceMasks &masks = _deviceMasks[device];
+    const string &prefix = device->oscAddressPatternPrefix();
+
+    memset(&masks, 0, sizeof(masks));
+
+    for (unsigned int s = 0; s < kMaxSubscribers; s++) {
+        const Subscriber &subscriber = _subscribers[s];
+
+        if (subscriber.destination == 0 || 
+            (subscriber.isPattern ? !subscriber.pattern.match(prefix) : subscriber.prefix != prefix))
+            continue;
+
+        for (unsigned int e = 0; e < kNumEvents; e++) {
+            if (subscriber.events & (1 << e))
+                masks.events[e] |= 1 << s;
+        }
+
+        if ((subscriber.events & (1 << kEvent_Press)) == 0)
+            continue;
+
+        for (unsigned int r = 0; r < 16; r++) {
+            for (unsigned int c = 0; c < 16; c++) {
+                unsigned int oscColumn = c, oscRow = r;
+
+                device->convertLocalCoordinatesToOscCoordinates(oscColumn, oscRow);
+
+                if (subscriber.width == 0 || subscriber.height == 0 || 
+                    (oscColumn - subscriber.column < subscriber.width && oscRow - subscriber.row < subscriber.height))
+                    masks.keys[r][c] |= 1 << s;
+            }
+        }
+    }
+
+    return masks;
+}
+
+InputSubscriptions::Destinations::Destinations(InputSubscriptions &subscriptions, MonomeXXhDevice *device, Event event, unsigned int localColumn, unsigned int localRow)
+    : _subscriptions(subscriptions)
+{
+    pthread_mutex_lock(&_subscriptions._lock);
+
+    _count = 0;
+
+    if (_subscriptions._numSubscribers == 0)
+        return;
+
+    const DeviceMasks &masks = _subscriptions._masks(device);
+    uint32 subscribers;
+
+    if (event != kEvent_Press)
+        subscribers = masks.events[event];
+    else if (localColumn < 16 && localRow < 16)
+        subscribers = masks.keys[localRow][localColumn];
+    else
+        subscribers = 0;
+
+    for (unsigned int s = 0; subscribers != 0; subscribers >>= 1, s++) {
+        if (subscribers & 1)
+            _destinations[_count++] = _subscriptions._subscribers[s].destination;
+    }
+}
+
+InputSubscriptions::Destinations::~Destinations(void)
+{
+    pthread_mutex_unlock(&_subscriptions._lock);
+}
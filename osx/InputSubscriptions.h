@@ -0,0 +1,112 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __InputSubscriptions_h__
+#define __InputSubscriptions_h__
+
+#include "MonomeXXhDevice.h"
+#include "OscController.h"
+#include "OscAddressPattern.h"
+
+#include <map>
+#include <string>
+using namespace std;
+
+// destinations besides the host that want a prefix's input messages, each taking only some
+// kinds of event and, for keys, only those inside a rectangle of osc coordinates.  which
+// subscribers want each key of a device is worked out once, when the subscriptions or the
+// layout change, so sending a key press costs a single lookup.
+class InputSubscriptions
+{
+public:
+    typedef enum {
+        kEvent_Press,
+        kEvent_Enc,
+        kEvent_Adc,
+        kEvent_Tilt,
+        kNumEvents
+    } Event;
+
+    enum { kAllEvents = (1 << kNumEvents) - 1 };    // bit e set takes event e
+    enum { kMaxSubscribers = 32 };
+
+public:
+    InputSubscriptions(void);
+    ~InputSubscriptions(void);
+
+    // adds destination to prefix, or changes what it takes if it is already there.  a width
+    // or height of 0 takes keys from anywhere.  a prefix with wildcards is an osc address
+    // pattern, taking input from every device whose prefix it matches, including those that
+    // arrive later.  returns whether destination is new, so the caller knows to keep its
+    // reference; false too if there are kMaxSubscribers already.
+    bool subscribe(const string &prefix, OscHostRef destination, unsigned int events, unsigned int column, unsigned int row, unsigned int width, unsigned int height);
+    // returns whether destination was subscribed to prefix, a pattern being given as it was
+    // subscribed.  once it returns nothing is sending to destination, so its reference can
+    // be released.
+    bool unsubscribe(const string &prefix, OscHostRef destination);
+
+    // the subscribers to one event from a device, for kEvent_Press only those wanting the key
+    // at localColumn, localRow.  the subscriptions stay locked until it goes out of scope, so
+    // none of them can be released while they are sent to.
+    class Destinations
+    {
+    public:
+        Destinations(InputSubscriptions &subscriptions, MonomeXXhDevice *device, Event event, unsigned int localColumn = 0, unsigned int localRow = 0);
+        ~Destinations(void);
+
+        unsigned int count(void) const { return _count; }
+        OscHostRef operator[](unsigned int i) const { return _destinations[i]; }
+
+    private:
+        InputSubscriptions &_subscriptions;
+        OscHostRef _destinations[kMaxSubscribers];
+        unsigned int _count;
+    };
+
+    friend class Destinations;
+
+private:
+    typedef struct {
+        string prefix;
+        OscHostRef destination;        // 0 if the slot is free
+        unsigned int events;
+        unsigned int column, row, width, height;
+        bool isPattern;
+        OscAddressPattern pattern;    // compiled from prefix if it has wildcards
+    } Subscriber;
+
+    typedef struct {
+        uint32 keys[16][16];        // [local row][local column], bit s set if subscriber s wants it
+        uint32 events[kNumEvents];
+    } DeviceMasks;
+
+    // caller holds the lock
+    const DeviceMasks &_masks(MonomeXXhDevice *device);
+
+private:
+    Subscriber _subscribers[kMaxSubscribers];
+    unsigned int _numSubscribers;
+
+    // built as devices send input, and dropped whenever the subscriptions or the layout change
+    map<MonomeXXhDevice *, DeviceMasks> _deviceMasks;
+    unsigned long _layoutGeneration;
+
+    pthread_mutex_t _lock;
+};
+
+#endif // __InputSubscriptions_h__
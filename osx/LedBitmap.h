@@ -0,0 +1,60 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __LedBitmap_h__
+#define __LedBitmap_h__
+
+#include <vector>
+using namespace std;
+
+// a rectangle of leds in osc coordinates, which can span several devices with the same
+// prefix.  the shift, blit, copy and fill messages read the devices' leds into one,
+// change it and write it back, so each device only sends the leds that changed.
+class LedBitmap
+{
+public:
+    enum { kMaxSize = 256 };    // rectangles are cut down to this many columns and rows
+
+public:
+    LedBitmap(unsigned int column, unsigned int row, unsigned int width, unsigned int height);
+
+    unsigned int column(void) const;
+    unsigned int row(void) const;
+    unsigned int width(void) const;
+    unsigned int height(void) const;
+
+    // leds outside the bitmap read as off, and setting them does nothing
+    bool contains(unsigned int column, unsigned int row) const;
+    bool led(unsigned int column, unsigned int row) const;
+    void setLed(unsigned int column, unsigned int row, bool state);
+
+    // moves every led dx columns right and dy rows down.  the leds moved in are off, or
+    // with wrap, the ones moved out at the other side.
+    void shift(int dx, int dy, bool wrap);
+
+    // bit n of bitMaps[r] is the led at (column + n, row + r), for up to 32 columns
+    void blit(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const unsigned int *bitMaps);
+    void copy(unsigned int fromColumn, unsigned int fromRow, unsigned int width, unsigned int height, unsigned int toColumn, unsigned int toRow);
+    void fill(unsigned int column, unsigned int row, unsigned int width, unsigned int height, bool state);
+
+private:
+    unsigned int _column, _row, _width, _height;
+    vector<unsigned char> _leds;        // row by row from the top left
+};
+
+#endif // __LedBitmap_h__
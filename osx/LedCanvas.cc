@@ -0,0 +1,206 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "LedCanvas.h"
+
+#include <string.h>
+
+
+LedCanvas::LedCanvas(void)
+{
+    memset(_cells, 0, sizeof(_cells));
+    memset(_rowBands, 0, sizeof(_rowBands));
+    memset(_columnBands, 0, sizeof(_columnBands));
+}
+
+void 
+LedCanvas::addDevice(MonomeXXhDevice *device)
+{
+    Tile tile;
+    unsigned int t = _tiles.size();
+
+    device->oscLedBounds(tile.column, tile.row, tile.width, tile.height);
+
+    _devices.push_back(device);
+    _tiles.push_back(tile);
+
+    if (t >= kMaxIndexedTiles || tile.width == 0 || tile.height == 0)
+        return;
+
+    for (unsigned int r = tile.row / kCellSize; r <= (tile.row + tile.height - 1) / kCellSize && r < kMaxCells; r++) {
+        _rowBands[r] |= 1 << t;
+
+        for (unsigned int c = tile.column / kCellSize; c <= (tile.column + tile.width - 1) / kCellSize && c < kMaxCells; c++)
+            _cells[r][c] |= 1 << t;
+    }
+
+    for (unsigned int c = tile.column / kCellSize; c <= (tile.column + tile.width - 1) / kCellSize && c < kMaxCells; c++)
+        _columnBands[c] |= 1 << t;
+}
+
+const vector<MonomeXXhDevice *>& 
+LedCanvas::devices(void) const
+{
+    return _devices;
+}
+
+void 
+LedCanvas::ledStateChange(unsigned int column, unsigned int row, bool state, int layer)
+{
+    uint32 candidates = _tilesInRect(column, row, 1, 1);
+    uint16 bitMap = state ? 1 : 0;
+
+    for (unsigned int t = 0; t < _tiles.size(); t++) {
+        if (!_overlaps(t, candidates, column, row, 1, 1))
+            continue;
+
+        if (layer == kBaseLayer)
+            _devices[t]->oscLedStateChangeEvent(column, row, state);
+        else
+            _drawRegion(t, layer, column, row, 1, 1, &bitMap, 0);
+    }
+}
+
+void 
+LedCanvas::ledRow(unsigned int row, unsigned int numBitMaps, const unsigned int *bitMaps, int layer)
+{
+    uint32 candidates = row / kCellSize < kMaxCells ? _rowBands[row / kCellSize] : ~0U;
+
+    for (unsigned int t = 0; t < _tiles.size(); t++) {
+        const Tile &tile = _tiles[t];
+
+        // a row that stops short of a device leaves it alone, and one that stops partway only
+        // sets the 8 columns its last byte reaches, like the device's own row messages
+        if (!_overlaps(t, candidates, tile.column, row, 1, 1) || tile.column >= numBitMaps * 8)
+            continue;
+
+        unsigned int width = _sliceLength(numBitMaps, tile.column, tile.width);
+        uint16 keep;
+        uint16 slice = _slice(numBitMaps, bitMaps, tile.column, width, keep);
+        _drawRegion(t, layer, tile.column, row, width, 1, &slice, &keep);
+    }
+}
+
+void 
+LedCanvas::ledColumn(unsigned int column, unsigned int numBitMaps, const unsigned int *bitMaps, int layer)
+{
+    uint32 candidates = column / kCellSize < kMaxCells ? _columnBands[column / kCellSize] : ~0U;
+
+    for (unsigned int t = 0; t < _tiles.size(); t++) {
+        const Tile &tile = _tiles[t];
+        uint16 rows[16], keepRows[16];
+
+        if (!_overlaps(t, candidates, column, tile.row, 1, 1) || tile.row >= numBitMaps * 8)
+            continue;
+
+        unsigned int height = _sliceLength(numBitMaps, tile.row, tile.height);
+        uint16 keep;
+        uint16 slice = _slice(numBitMaps, bitMaps, tile.row, height, keep);
+        for (unsigned int r = 0; r < height; r++) {
+            rows[r] = (slice >> r) & 1;
+            keepRows[r] = (keep >> r) & 1;
+        }
+
+        _drawRegion(t, layer, column, tile.row, 1, height, rows, keepRows);
+    }
+}
+
+void 
+LedCanvas::ledFrame(unsigned int column, unsigned int row, unsigned char bitMaps[8], int layer)
+{
+    uint32 candidates = _tilesInRect(column, row, 8, 8);
+    uint16 rows[8];
+
+    for (unsigned int r = 0; r < 8; r++)
+        rows[r] = bitMaps[r];
+
+    for (unsigned int t = 0; t < _tiles.size(); t++) {
+        if (!_overlaps(t, candidates, column, row, 8, 8))
+            continue;
+
+        if (layer == kBaseLayer)
+            _devices[t]->oscLedFrameEvent(column, row, bitMaps);
+        else
+            _drawRegion(t, layer, column, row, 8, 8, rows, 0);
+    }
+}
+
+void 
+LedCanvas::_drawRegion(unsigned int tile, int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep)
+{
+    if (layer == kBaseLayer)
+        _devices[tile]->oscLedRegionEvent(column, row, width, height, bitMaps, keep);
+    else
+        _devices[tile]->oscLayerRegionEvent(layer, column, row, width, height, bitMaps, keep);
+}
+
+// the indexed tiles that might overlap the rectangle; all of them if it runs past the index
+uint32 
+LedCanvas::_tilesInRect(unsigned int column, unsigned int row, unsigned int width, unsigned int height) const
+{
+    unsigned int lastColumn = (column + width - 1) / kCellSize, lastRow = (row + height - 1) / kCellSize;
+    uint32 tiles = 0;
+
+    if (lastColumn >= kMaxCells || lastRow >= kMaxCells)
+        return ~0U;
+
+    for (unsigned int r = row / kCellSize; r <= lastRow; r++) {
+        for (unsigned int c = column / kCellSize; c <= lastColumn; c++)
+            tiles |= _cells[r][c];
+    }
+
+    return tiles;
+}
+
+bool 
+LedCanvas::_overlaps(unsigned int tile, uint32 candidates, unsigned int column, unsigned int row, unsigned int width, unsigned int height) const
+{
+    if (tile < kMaxIndexedTiles && (candidates & (1 << tile)) == 0)
+        return false;
+
+    const Tile &t = _tiles[tile];
+
+    return column < t.column + t.width && t.column < column + width &&
+        row < t.row + t.height && t.row < row + height;
+}
+
+// how many of count bits from bit first on a /led_row or /led_col sets: 8 if only one byte is
+// left from first's byte on, all of them otherwise
+unsigned int 
+LedCanvas::_sliceLength(unsigned int numBitMaps, unsigned int first, unsigned int count) const
+{
+    return first / 8 + 1 == numBitMaps && count > 8 ? 8 : count;
+}
+
+// count bits (at most 16) of a /led_row or /led_col bitmap from bit first on; bits past the end
+// are off.  keep gets the bits whose value was 256 or more, which leave their leds alone.
+uint16 
+LedCanvas::_slice(unsigned int numBitMaps, const unsigned int *bitMaps, unsigned int first, unsigned int count, uint16 &keep) const
+{
+    unsigned int k = first / 8;
+    uint32 bits = 0, dontCare = 0;
+
+    for (unsigned int b = 0; b < 3 && k + b < numBitMaps; b++) {
+        bits |= (uint32)(bitMaps[k + b] & 0xff) << (8 * b);
+        if (bitMaps[k + b] >= 256)
+            dontCare |= 0xffU << (8 * b);
+    }
+
+    keep = (uint16)((dontCare >> (first % 8)) & ((1U << count) - 1));
+    return (uint16)((bits >> (first % 8)) & ((1U << count) - 1));
+}
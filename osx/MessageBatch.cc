@@ -0,0 +1,195 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "MessageBatch.h"
+
+#ifdef __SSE2__
+#define MESSAGE_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+// the vector path finds key messages with one mask on the opcode
+MESSAGE_STATIC_ASSERT(Message40h::ButtonPress::kOpcode == 0, button_press_is_opcode_0);
+MESSAGE_STATIC_ASSERT(MessageSeries::KeyDown::kOpcode == 0 && MessageSeries::KeyUp::kOpcode == 1, keys_are_opcodes_0_and_1);
+MESSAGE_STATIC_ASSERT(Message40h::ButtonPress::kLength == 2 && MessageSeries::KeyDown::kLength == 2, keys_are_two_bytes);
+
+
+MessageBatch::MessageBatch(void)
+{
+    count = 0;
+    time = 0;
+}
+
+bool 
+MessageBatch::decode40h(const uint8 *data, unsigned int length, unsigned int &used)
+{
+    count = 0;
+    used = 0;
+
+    while (used < length && count < kMaxEvents) {
+        const uint8 *message = data + used;
+        unsigned int size = Message40h::inputLength(message[0]);
+
+        if (size == 0)
+            return false;
+
+        if (used + size > length)
+            break;
+
+        switch (MessageOpcodeField::get(message)) {
+            case Message40h::ButtonPress::kOpcode:
+                {
+                    unsigned int n = _decodeKeyRun(message, (length - used) / size, false);
+
+                    if (n > 0) {
+                        used += n * size;
+                        continue;
+                    }
+                }
+
+                _append(kEvent_Key, Message40h::ButtonX::get(message), Message40h::ButtonY::get(message), Message40h::ButtonState::get(message) > 0);
+                break;
+
+            case Message40h::AdcVal::kOpcode:
+                _append(kEvent_Adc, Message40h::AdcPort::get(message), 0, Message40h::adcValue(message));
+                break;
+
+            case Message40h::EncVal::kOpcode:
+                _append(kEvent_Encoder, Message40h::EncPort::get(message), 0, Message40h::EncValue::get(message));
+                break;
+        }
+
+        used += size;
+    }
+
+    return true;
+}
+
+bool 
+MessageBatch::decodeSeries(const uint8 *data, unsigned int length, unsigned int &used)
+{
+    count = 0;
+    used = 0;
+
+    while (used < length && count < kMaxEvents) {
+        const uint8 *message = data + used;
+        unsigned int size = MessageSeries::inputLength(message[0]);
+
+        if (size == 0)
+            return false;
+
+        if (used + size > length)
+            break;
+
+        switch (MessageOpcodeField::get(message)) {
+            case MessageSeries::KeyDown::kOpcode:
+            case MessageSeries::KeyUp::kOpcode:
+                {
+                    unsigned int n = _decodeKeyRun(message, (length - used) / size, true);
+
+                    if (n > 0) {
+                        used += n * size;
+                        continue;
+                    }
+                }
+
+                _append(kEvent_Key, MessageSeries::KeyX::get(message), MessageSeries::KeyY::get(message), MessageSeries::KeyDown::match(message));
+                break;
+
+            case MessageSeries::Tilt::kOpcode:
+                _append(kEvent_Tilt, MessageSeries::TiltAxis::get(message), 0, MessageSeries::TiltValue::get(message));
+                break;
+
+            case MessageSeries::AuxiliaryInput::kOpcode:
+                _append(kEvent_Encoder, MessageSeries::AuxPort::get(message), 0, MessageSeries::AuxValue::get(message));
+                break;
+        }
+
+        used += size;
+    }
+
+    return true;
+}
+
+unsigned int 
+MessageBatch::keyRunLength(unsigned int index) const
+{
+    unsigned int i;
+
+    for (i = index; i < count && type[i] == kEvent_Key; i++)
+        ;
+
+    return i - index;
+}
+
+void 
+MessageBatch::_append(EventType eventType, unsigned int eventX, unsigned int eventY, unsigned int eventValue)
+{
+    type[count] = (uint8)eventType;
+    x[count] = (uint8)eventX;
+    y[count] = (uint8)eventY;
+    value[count] = (uint16)eventValue;
+    count++;
+}
+
+// decodes key messages eight at a time for as long as all eight are keys, and returns
+// how many it decoded.  the rest, and everything without sse2, goes through the switch.
+unsigned int 
+MessageBatch::_decodeKeyRun(const uint8 *data, unsigned int messages, bool series)
+{
+    unsigned int n = 0;
+
+#ifdef MESSAGE_BATCH_SSE2
+    const __m128i firstByte = _mm_set1_epi16(0x00FF);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i keys = _mm_set1_epi8(kEvent_Key);
+    // the opcode bits that are clear in every key message
+    const __m128i notKey = _mm_set1_epi8(series ? (char)0xE0 : (char)0xF0);
+
+    while (n + 8 <= messages && count + 8 <= kMaxEvents) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + n * 2));
+
+        // the eight first bytes in the low half and the eight second bytes in the high half
+        __m128i bytes = _mm_packus_epi16(_mm_and_si128(v, firstByte), _mm_srli_epi16(v, 8));
+
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(bytes, notKey), zero)) & 0xFF) != 0xFF)
+            break;
+
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble);
+        __m128i low = _mm_and_si128(bytes, nibble);
+        __m128i state;
+
+        if (series)
+            state = _mm_xor_si128(high, one);                            // key down is opcode 0, key up 1
+        else
+            state = _mm_andnot_si128(_mm_cmpeq_epi8(low, zero), one);    // any state bit is down
+
+        _mm_storel_epi64((__m128i *)(type + count), keys);
+        _mm_storel_epi64((__m128i *)(x + count), _mm_unpackhi_epi64(high, high));
+        _mm_storel_epi64((__m128i *)(y + count), _mm_unpackhi_epi64(low, low));
+        _mm_storeu_si128((__m128i *)(value + count), _mm_unpacklo_epi8(state, zero));
+
+        count += 8;
+        n += 8;
+    }
+#endif
+
+    return n;
+}
@@ -0,0 +1,66 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __MessageBatch_h__
+#define __MessageBatch_h__
+
+#include "MessageProtocol.h"
+#include "EventScheduler.h"
+
+// the input messages from one serial read, decoded in one pass into parallel arrays so
+// the stages after it (coordinate remapping, osc and midi encoding) can each run over a
+// whole run of events.  runs of key messages, which is what a full hand on a 256 sends,
+// are decoded eight at a time with sse2 where the compiler has it.
+class MessageBatch
+{
+public:
+    typedef enum {
+        kEvent_Key,
+        kEvent_Adc,
+        kEvent_Encoder,
+        kEvent_Tilt
+    } EventType;
+
+    enum { kMaxEvents = 256 };
+
+public:
+    MessageBatch(void);
+
+    // decode as many whole messages from data as fit in the batch, replacing what it held,
+    // and set used to the bytes decoded.  returns false at a message the family doesn't
+    // send; the events before it are still in the batch.
+    bool decode40h(const uint8 *data, unsigned int length, unsigned int &used);
+    bool decodeSeries(const uint8 *data, unsigned int length, unsigned int &used);
+
+    // the number of key events from index on before an event of another type
+    unsigned int keyRunLength(unsigned int index) const;
+
+public:
+    unsigned int count;
+    HostTime time;              // when the bytes were read; the decoders leave it to the caller
+    uint8 type[kMaxEvents];
+    uint8 x[kMaxEvents];        // key column, or the adc, encoder or tilt axis index
+    uint8 y[kMaxEvents];        // key row
+    uint16 value[kMaxEvents];    // key state, raw adc value, encoder steps or tilt value
+
+private:
+    void _append(EventType eventType, unsigned int eventX, unsigned int eventY, unsigned int eventValue);
+    unsigned int _decodeKeyRun(const uint8 *data, unsigned int messages, bool series);
+};
+
+#endif // __MessageBatch_h__
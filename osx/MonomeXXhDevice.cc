@@ -20,6 +20,11 @@
 #include "message.h"
 #include "message256.h"
 #include "messageMK.h"
+#include "osc.h"
+#include "RealtimeThread.h"
+
+#include <stdlib.h>
+#include <libkern/OSAtomic.h>
 static const unsigned char myswap[] = 
 {
   0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0, 
@@ -47,6 +52,8 @@ m128-020 - 128 serial number 20
 m64-0084 - 64 serial number 84
 */
 
+volatile int32_t MonomeXXhDevice::_layoutGeneration = 0;
+
 MonomeXXhDevice::MonomeXXhDevice(const string& bsdFilePath)
     : SerialDevice(bsdFilePath)
 {
@@ -60,6 +67,16 @@ MonomeXXhDevice::MonomeXXhDevice(const string& bsdFilePath)
     _midiOutputDevice = 0;
     _midiInputChannel = 0;
     _midiOutputChannel = 0;
+    _midiLedLatency = 0;
+    memset(_encoders, 0, sizeof(_encoders));
+    _encoderInterval = 0;
+    _encoderAcceleration = 0.f;
+    for (unsigned int sensor = kSensor_Adc0; sensor < kSensor_TiltX; sensor++)
+        _sensorFilters[sensor].setRange(1.f, 0x3FF);    // 10 bit, sent as 0-1
+    _sensorFilters[kSensor_TiltX].setRange(255.f, 255);
+    _sensorFilters[kSensor_TiltY].setRange(255.f, 255);
+    memset(_sensorSampleTimes, 0, sizeof(_sensorSampleTimes));
+    _inputTimestamps = kInputTimestamps_Off;
     _midiInputPortRef = 0;    
     _adcState[0] = false;
     _adcState[1] = false;
@@ -73,6 +90,42 @@ MonomeXXhDevice::MonomeXXhDevice(const string& bsdFilePath)
 	for (int i=0; i<16; ++i)
 		for (int j=0; j<16; ++j)
 			_state256[i][j] = (bool) 0;
+
+	memset(_ledFrame, 0, sizeof(_ledFrame));
+	memset(_sentFrame, 0, sizeof(_sentFrame));
+	_doubleBuffered = false;
+	_autoSwapInterval = 0;
+	_autoSwapGeneration = 0;
+	_swapTime = 0;
+	_swapCallback = 0;
+	_swapCallbackUserData = 0;
+	_flowMode = kFlow_Off;
+	_flowCharged = 0;
+	_flowRetired = 0;
+	_flowReportedCredits = kFlowCredits;
+	_flowReportedLevel = kFlowLevel_Clear;
+	_flowWriteFailed = false;
+	_flowWindowStart = EventScheduler::now();
+	_flowWindowBytes = 0;
+	_flowUtilisation = 0.f;
+	_flowWindowBusy = 0;
+	_linkCapacity = kLinkBytesPerSecond;
+	_linkThroughput = 0.f;
+	_writeTime = 0.f;
+	_flushInterval = 0.f;
+	_lastFlushTime = 0;
+	_linkFreeTime = 0;
+	_interactiveLeds = kMaxInteractiveLeds / 2;
+	_flowCallback = 0;
+	_flowCallbackUserData = 0;
+	_staleRows = 0xFFFF;
+	_numLayers = 0;
+	_numEchoRules = 0;
+	_tiltState = false;
+	_ledIntensity = -1;
+	_ledMode = -1;
+	_ledAnimationGeneration = 0;
+	OSAtomicIncrement32Barrier(&_layoutGeneration);
 	
 // device-specific stuff
 // first determines device type- simple checks, would need improving in theory
@@ -157,12 +210,29 @@ switch (_type)
 	 break;
 	}
 
+    _buildOscInputAddressPatterns();
 
     pthread_mutex_init(&_lock, NULL);
+
+    _transmitTerminate = false;
+    pthread_cond_init(&_transmitCondition, NULL);
+    pthread_cond_init(&_transmitSpaceCondition, NULL);
+    pthread_create(&_transmitThread, NULL, _transmitThreadProc, this);
 }
 
 MonomeXXhDevice::~MonomeXXhDevice()
 {
+    pthread_mutex_lock(&_lock);
+    _transmitTerminate = true;
+    pthread_cond_signal(&_transmitCondition);
+    pthread_cond_broadcast(&_transmitSpaceCondition);
+    pthread_mutex_unlock(&_lock);
+
+    pthread_join(_transmitThread, NULL);
+    pthread_cond_destroy(&_transmitCondition);
+    pthread_cond_destroy(&_transmitSpaceCondition);
+
+    OSAtomicIncrement32Barrier(&_layoutGeneration);
     pthread_mutex_destroy(&_lock);
 }
 
@@ -198,7 +268,7 @@ MonomeXXhDevice::rows(void)
 }
 
 unsigned int
-MonomeXXhDevice::DeviceOrientation(void) 
+MonomeXXhDevice::DeviceOrientation(void) const
 {
 
 if (_type == kDeviceType_128) return (_orientation+3)%4;
@@ -227,6 +297,8 @@ MonomeXXhDevice::setCableOrientation(CableOrientation orientation)
         _orientation = kCableOrientation_Left;
     else
         _orientation = orientation;
+
+    OSAtomicIncrement32Barrier(&_layoutGeneration);
 }
 
 MonomeXXhDevice::CableOrientation 
@@ -249,6 +321,24 @@ MonomeXXhDevice::setOscAddressPatternPrefix(const string& oscAddressPatternPrefi
         _oscAddressPatternPrefix = oscAddressPatternPrefix.substr(0, oscAddressPatternPrefix.size() - 1);
     else
         _oscAddressPatternPrefix = oscAddressPatternPrefix;
+
+    _buildOscInputAddressPatterns();
+    OSAtomicIncrement32Barrier(&_layoutGeneration);
+}
+
+const string& 
+MonomeXXhDevice::oscInputAddressPattern(InputAddress address) const
+{
+    return _oscInputAddressPatterns[address];
+}
+
+void 
+MonomeXXhDevice::_buildOscInputAddressPatterns(void)
+{
+    _oscInputAddressPatterns[kInputAddress_Press] = _oscAddressPatternPrefix + kOscDefaultAddrPatternButtonPressSuffix;
+    _oscInputAddressPatterns[kInputAddress_Adc] = _oscAddressPatternPrefix + kOscDefaultAddrPatternAdcValueSuffix;
+    _oscInputAddressPatterns[kInputAddress_Tilt] = _oscAddressPatternPrefix + kOscDefaultAddrPatternTiltValueSuffix;
+    _oscInputAddressPatterns[kInputAddress_Enc] = _oscAddressPatternPrefix + kOscDefaultAddrPatternEncValueSuffix;
 }
 
 const string& 
@@ -265,6 +355,8 @@ MonomeXXhDevice::setOscStartColumn(unsigned int column)
     MonomeXXhDeviceLock(this);
 
     _oscStartColumn = column; 
+
+    OSAtomicIncrement32Barrier(&_layoutGeneration);
 }
 
 unsigned int 
@@ -281,6 +373,8 @@ MonomeXXhDevice::setOscStartRow(unsigned int row)
     MonomeXXhDeviceLock(this);
 
     _oscStartRow = row; 
+
+    OSAtomicIncrement32Barrier(&_layoutGeneration);
 }
 
 unsigned int 
@@ -421,6 +515,206 @@ MonomeXXhDevice::MIDIOutputChannel(void) const
     return _midiOutputChannel;
 }
 
+void 
+MonomeXXhDevice::setMIDILedLatency(unsigned int milliseconds)
+{
+    _midiLedLatency = milliseconds;
+}
+
+unsigned int 
+MonomeXXhDevice::MIDILedLatency(void) const
+{
+    return _midiLedLatency;
+}
+
+void 
+MonomeXXhDevice::setEncoderInterval(unsigned int milliseconds)
+{
+    _encoderInterval = milliseconds;
+}
+
+unsigned int 
+MonomeXXhDevice::encoderInterval(void) const
+{
+    return _encoderInterval;
+}
+
+void 
+MonomeXXhDevice::setEncoderAcceleration(float acceleration)
+{
+    _encoderAcceleration = acceleration > 0.f ? acceleration : 0.f;
+}
+
+float 
+MonomeXXhDevice::encoderAcceleration(void) const
+{
+    return _encoderAcceleration;
+}
+
+HostTime 
+MonomeXXhDevice::addEncoderSteps(unsigned int localIndex, int steps, HostTime time)
+{
+    if (localIndex >= kMaxEncoders)
+        return 0;
+
+    MonomeXXhDeviceLock lock(this);
+    EncoderAccumulator &encoder = _encoders[localIndex];
+    float scaled = (float)steps;
+
+    if (_encoderAcceleration > 0.f && encoder.lastStep != 0) {
+        double milliseconds = EventScheduler::millisecondsFromHostTime(time - encoder.lastStep);
+
+        if (milliseconds < 1.0)
+            milliseconds = 1.0;
+
+        scaled *= 1.f + _encoderAcceleration * (float)(abs(steps) / milliseconds);
+    }
+
+    // whole steps go out, the fraction waits for the next packet
+    encoder.fraction += scaled;
+    encoder.pending += (int)encoder.fraction;
+    encoder.fraction -= (int)encoder.fraction;
+    encoder.total += steps;
+    encoder.lastStep = time;
+
+    if (encoder.pending == 0 || encoder.sendDue)
+        return 0;
+
+    encoder.sendDue = true;
+    return encoder.lastSent + EventScheduler::hostTimeFromMilliseconds(_encoderInterval);
+}
+
+int 
+MonomeXXhDevice::takeEncoderSteps(unsigned int localIndex, int minSteps, int maxSteps, HostTime time, HostTime &nextSendTime)
+{
+    nextSendTime = 0;
+
+    if (localIndex >= kMaxEncoders)
+        return 0;
+
+    MonomeXXhDeviceLock lock(this);
+    EncoderAccumulator &encoder = _encoders[localIndex];
+    int steps = encoder.pending;
+
+    if (steps < minSteps)
+        steps = minSteps;
+    else if (steps > maxSteps)
+        steps = maxSteps;
+
+    encoder.pending -= steps;
+
+    if (steps != 0)
+        encoder.lastSent = time;
+
+    if (encoder.pending != 0 && _encoderInterval != 0)
+        nextSendTime = time + EventScheduler::hostTimeFromMilliseconds(_encoderInterval);
+    else
+        encoder.sendDue = false;
+
+    return steps;
+}
+
+unsigned int 
+MonomeXXhDevice::pendingEncoders(void) const
+{
+    MonomeXXhDeviceLock lock(this);
+    unsigned int pending = 0;
+
+    for (unsigned int i = 0; i < kMaxEncoders; i++) {
+        if (_encoders[i].pending != 0)
+            pending |= 1 << i;
+    }
+
+    return pending;
+}
+
+long 
+MonomeXXhDevice::encoderTotal(unsigned int localIndex) const
+{
+    if (localIndex >= kMaxEncoders)
+        return 0;
+
+    MonomeXXhDeviceLock lock(this);
+    return _encoders[localIndex].total;
+}
+
+void 
+MonomeXXhDevice::setSensorFilter(unsigned int sensor, float deadband, unsigned int interval, SensorFilter::Smoothing smoothing, float amount)
+{
+    if (sensor >= kNumSensors)
+        return;
+
+    MonomeXXhDeviceLock lock(this);
+    SensorFilter &filter = _sensorFilters[sensor];
+
+    filter.setDeadband(deadband);
+    filter.setInterval(interval);
+    filter.setSmoothing(smoothing, amount);
+}
+
+const SensorFilter& 
+MonomeXXhDevice::sensorFilter(unsigned int sensor) const
+{
+    return _sensorFilters[sensor < kNumSensors ? sensor : (unsigned int)kSensor_Adc0];
+}
+
+bool 
+MonomeXXhDevice::filterSensorSample(unsigned int sensor, float sample, unsigned int outputSteps, HostTime time, float &value, HostTime &retryTime)
+{
+    retryTime = 0;
+
+    if (sensor >= kNumSensors)
+        return false;
+
+    MonomeXXhDeviceLock lock(this);
+    _sensorSampleTimes[sensor] = time;
+    return _sensorFilters[sensor].process(sample, outputSteps, time, value, retryTime);
+}
+
+bool 
+MonomeXXhDevice::retrySensorSample(unsigned int sensor, HostTime time, float &value, HostTime &retryTime)
+{
+    retryTime = 0;
+
+    if (sensor >= kNumSensors)
+        return false;
+
+    MonomeXXhDeviceLock lock(this);
+    return _sensorFilters[sensor].retry(time, value, retryTime);
+}
+
+HostTime 
+MonomeXXhDevice::encoderStepTime(unsigned int localIndex) const
+{
+    if (localIndex >= kMaxEncoders)
+        return 0;
+
+    MonomeXXhDeviceLock lock(this);
+    return _encoders[localIndex].lastStep;
+}
+
+HostTime 
+MonomeXXhDevice::sensorSampleTime(unsigned int sensor) const
+{
+    if (sensor >= kNumSensors)
+        return 0;
+
+    MonomeXXhDeviceLock lock(this);
+    return _sensorSampleTimes[sensor];
+}
+
+void 
+MonomeXXhDevice::setInputTimestamps(InputTimestamps timestamps)
+{
+    _inputTimestamps = timestamps;
+}
+
+MonomeXXhDevice::InputTimestamps 
+MonomeXXhDevice::inputTimestamps(void) const
+{
+    return _inputTimestamps;
+}
+
 void 
 MonomeXXhDevice::setMIDIInputPort(CCoreMIDIPortRef midiInputPort)
 {
@@ -467,6 +761,43 @@ MonomeXXhDevice::convertLocalCoordinatesToOscCoordinates(unsigned int &column, u
 
 }
 
+void 
+MonomeXXhDevice::convertLocalCoordinatesToOscCoordinates(const uint8 *localColumns, const uint8 *localRows, unsigned int *oscColumns, unsigned int *oscRows, unsigned int count)
+{
+    unsigned int i;
+    unsigned int lastColumn = columns() - 1 + _oscStartColumn, lastRow = rows() - 1 + _oscStartRow;
+
+    switch (DeviceOrientation()) {
+		case kCableOrientation_Left:
+			for (i = 0; i < count; i++) {
+				oscColumns[i] = localColumns[i] + _oscStartColumn;
+				oscRows[i] = localRows[i] + _oscStartRow;
+			}
+			break;
+
+		case kCableOrientation_Top:
+			for (i = 0; i < count; i++) {
+				oscColumns[i] = lastColumn - localRows[i];
+				oscRows[i] = localColumns[i] + _oscStartRow;
+			}
+			break;
+
+		case kCableOrientation_Right:
+			for (i = 0; i < count; i++) {
+				oscColumns[i] = lastColumn - localColumns[i];
+				oscRows[i] = lastRow - localRows[i];
+			}
+			break;
+
+		case kCableOrientation_Bottom:
+			for (i = 0; i < count; i++) {
+				oscColumns[i] = localRows[i] + _oscStartColumn;
+				oscRows[i] = lastRow - localColumns[i];
+			}
+			break;
+    }
+}
+
 void 
 MonomeXXhDevice::convertOscCoordinatesToLocalCoordinates(unsigned int &column, unsigned int &row)
 {
@@ -587,14 +918,14 @@ MonomeXXhDevice::oscLedStateChangeEvent(unsigned int column, unsigned int row, b
 	if (_type == kDeviceType_40h) {
 		t_message message;
 		messagePackLedStateChange(&message, state ? 1 : 0, column, row);	
-		write((char *)&message, sizeof(t_message));
+		_writeLed((char *)&message, sizeof(t_message));
 		}
 	else  if (_type <= kDeviceType_mk) {//256 128 64
 		t_message message;
 		if (state == 1) messagePack_256_led_on(&message, column, row);
 		else messagePack_256_led_off(&message, column, row);
 		_state256[column][row] = state;
-		write((char *)&message, sizeof(t_message));
+		_writeLed((char *)&message, sizeof(t_message));
 	}
 }
 
@@ -611,17 +942,18 @@ MonomeXXhDevice::oscLedIntensityChangeEvent(float intensity) //m256
         intensity = 0.f;
 
     i = ((unsigned char)(intensity * (float)0xF)) & 0xF;
+	_ledIntensity = i;
 	//fprintf(stderr, "\n  ---- TEMPORARY DEBUG! REINTENSITY %i:", i);
 
 if (_type == kDeviceType_40h)
 { t_message message;
     messagePackLedIntensity(&message, i);
-	  write((char *)&message, sizeof(t_message));
+	  _queueWrite((char *)&message, sizeof(t_message));
 	}
 if (_type <= kDeviceType_mk)//256 128 64
 	{ t_256_1byte_message message;
  messagePack_256_intensity(&message, i);
-  write((char *)&message, sizeof(t_256_1byte_message));
+  _queueWrite((char *)&message, sizeof(t_256_1byte_message));
  }
 
     
@@ -630,20 +962,21 @@ if (_type <= kDeviceType_mk)//256 128 64
 void 
 MonomeXXhDevice::oscLedTestStateChangeEvent(bool testState)  //m256 ?
 {
+	_ledMode = testState ? 1 : 2;
   
 	
 	if (_type == kDeviceType_40h)
 	{
 	  t_message message;
     messagePackLedTest(&message, testState ? 1 : 0);
-	    write((char *)&message, sizeof(t_message));
+	    _queueWrite((char *)&message, sizeof(t_message));
 	
 	}
 	else 
 	{
 	  t_256_1byte_message message;
 	messagePack_256_mode(&message, testState ? 1 : 0);
-	write((char *)&message, sizeof(t_256_1byte_message));
+	_queueWrite((char *)&message, sizeof(t_256_1byte_message));
 	
 	}
 	
@@ -685,7 +1018,7 @@ MonomeXXhDevice::oscLedClearEvent(bool clear)  //m256
 		  t_message message;
     for (unsigned int i = 0; i < _rows; i++) {
 			messagePackLedRow(&message, i, clear ? 0xFF : 0x00);
-			write((char *)&message, sizeof(t_message));
+			_writeLed((char *)&message, sizeof(t_message));
 		  }
 		}
 	else //m256 has clear message
@@ -695,7 +1028,7 @@ MonomeXXhDevice::oscLedClearEvent(bool clear)  //m256
 		for (int i=0; i<16; ++i)
 			for (int j=0; j<16; ++j)
 				_state256[i][j] = (bool) 0;
-	write((char *)&message, sizeof(t_256_1byte_message));
+	_writeLed((char *)&message, sizeof(t_256_1byte_message));
 	
 	}
 }
@@ -703,16 +1036,17 @@ MonomeXXhDevice::oscLedClearEvent(bool clear)  //m256
 void 
 MonomeXXhDevice::oscShutdownStateChangeEvent(bool shutdownState) //m256
 {
+	_ledMode = shutdownState ? 0 : 2;
    
 	if (_type == kDeviceType_40h)
 	{ t_message message;
     messagePackShutdown(&message, shutdownState ? 0 : 1);
-	    write((char *)&message, sizeof(t_message));
+	    _queueWrite((char *)&message, sizeof(t_message));
 	}
 	else { 
 		t_256_1byte_message message;
 	  messagePack_256_mode(&message, shutdownState ? 2 : 0);
-	 write((char *)&message, sizeof(t_256_1byte_message));
+	 _queueWrite((char *)&message, sizeof(t_256_1byte_message));
 	
 	}
 
@@ -758,7 +1092,7 @@ MonomeXXhDevice::oscLedRowStateChangeEvent(unsigned int row, unsigned int numBit
 				break;
 		}    
 
-		write((char *)&message, sizeof(t_message));    
+		_writeLed((char *)&message, sizeof(t_message));    
 	}//40h
 	else if (_type <= kDeviceType_mk) // 256, 128 and 64
 	{
@@ -795,7 +1129,7 @@ MonomeXXhDevice::oscLedRowStateChangeEvent(unsigned int row, unsigned int numBit
 					messagePack_256_led_col1(&message, columns() - r - 1, bitMap);
 					break;
 			}
-			write((char *)&message, sizeof(t_message));  
+			_writeLed((char *)&message, sizeof(t_message));  
 		}
 		// 2-byte row command: numBitMaps > 1
 		//  - 256 -> column offset not in last bitMap
@@ -844,135 +1178,7 @@ MonomeXXhDevice::oscLedRowStateChangeEvent(unsigned int row, unsigned int numBit
 			}
 			//fprintf(stderr, "\n");
 			
-			write((char *)&message3, sizeof(t_256_3byte_message));  
-		}
-	} // 256/128/64
-}
-
-void 
-MonomeXXhDevice::oscLedColumnStateChangeEvent(unsigned int column, unsigned int numBitMaps, unsigned int bitMaps[])
-{
-	// added by dan - check that column offset is not greater than the highest value in the bitmap
-    if (column < _oscStartColumn || column >= _oscStartColumn + columns() || _oscStartRow >= numBitMaps * 8)
-        return;
-
-	// use columns() and rows() instead of _columns and _rows to get correct values in case _type == kDeviceType_128
-	unsigned int c = column - _oscStartColumn; 
-	unsigned int index = _oscStartRow / 8; 
-	unsigned int shift = _oscStartRow % 8; 
-	unsigned int dontCare = bitMaps[index]/256;
-	unsigned char bitMap = (unsigned char) bitMaps[index] >> shift; 
-
-	if (index + 1 < numBitMaps)
-		bitMap |= bitMaps[index + 1] << (8 - shift);
-
-	if (_type == kDeviceType_40h) {  // maybe include 64 here too, and select the appropriate messagePackLedRow macro?
-		t_message message;
-
-		switch (DeviceOrientation()) 
-		{
-			case kCableOrientation_Left:
-				messagePackLedColumn(&message, c, bitMap);
-				break;
-		
-			case kCableOrientation_Top:
-				messagePackLedRow(&message, _rows - c - 1, bitMap);
-				break;
-
-			case kCableOrientation_Right:
-				messagePackLedColumn(&message, _columns - c - 1, myswap[bitMap]);
-				break;
-
-			case kCableOrientation_Bottom:
-				messagePackLedRow(&message, c, myswap[bitMap]);
-				break;
-		}    
-
-		write((char *)&message, sizeof(t_message));    
-	}//40h
-	else if (_type <= kDeviceType_mk) // 256, 128 and 64
-	{
-		// 1-byte col command:
-		//	- 64 -> always use this, since there is only 1 byte-col
-		//  - 256 -> if there is only 1 bitMap, or offsets allow use of last bitMap only
-		//  - 126 -> cable is up or down, or if left or right then offsets allow use of last bitMap only
-		if (rows() <= 8 || index + 1 == numBitMaps)
-		{
-			t_message message;
-			
-			//fprintf(stderr, "map: %b\n _state256: ", bitMap);
-			for (int i=0; i<8; ++i) {
-				_state256[c][i] = bitMap & (1 << i);
-				//fprintf(stderr, "%b", _state256[c][i]);
-			}
-			//fprintf(stderr, "\n");
-			
-			switch (DeviceOrientation()) 
-			{
-				case kCableOrientation_Left:	
-					messagePack_256_led_col1(&message, c, bitMap);		
-					break;
-				case kCableOrientation_Top:		
-					messagePack_256_led_row1(&message, _rows - c - 1, bitMap);	
-					break;
-				case kCableOrientation_Right:   
-					messagePack_256_led_col1(&message, _columns - c - 1, myswap[bitMap]);
-					break;
-				case kCableOrientation_Bottom:  
-					messagePack_256_led_row1(&message, c, myswap[bitMap]);
-					break;
-			}
-			write((char *)&message, sizeof(t_message));  
-
-		}
-		// 2-byte col command: numBitMaps > 1
-		//  - 256 -> row offset not in last bitMap
-		//  - 128 -> cable is left or right, AND row offset not in last bitMap
-		else {
-			t_256_3byte_message message3;
-			unsigned char bitMap2 = bitMaps[index + 1] >> shift; 
-
-			if (index + 2 < numBitMaps)
-				bitMap2 |= bitMaps[index + 2] << (8 - shift);
-
-			if (dontCare) {
-				bitMap = 0;
-				for (int i=0; i<8; ++i) {
-					bitMap |= _state256[c][i] << i;
-				}
-			} else {
-				fprintf(stderr, "map: %d\n _state256: ", bitMap);
-				for (int i=0; i<8; ++i) {
-					_state256[c][i] = bitMap & (1 << i);
-					fprintf(stderr, "%d", _state256[c][i]);
-				}
-				fprintf(stderr, "\n");
-			}
-			
-			switch (DeviceOrientation())
-			{
-				case kCableOrientation_Left:    
-					messagePack_256_led_col2(&message3, c, bitMap, bitMap2);									
-					break;
-				case kCableOrientation_Top:     
-					messagePack_256_led_row2(&message3, _rows - c - 1, bitMap, bitMap2);						
-					break;
-				case kCableOrientation_Right:   
-					messagePack_256_led_col2(&message3, _columns - c - 1,  myswap[bitMap2], myswap[bitMap]);	
-					break;
-				case kCableOrientation_Bottom:  
-					messagePack_256_led_row2(&message3, c, myswap[bitMap2],  myswap[bitMap]);					
-					break;
-			}
-			
-			//fprintf(stderr, "map: %b\n _state256: ", bitMap);
-			for (int i=8; i<16; ++i) {
-				_state256[c][i] = bitMap & (1 << i);
-				//fprintf(stderr, "%b", _state256[c][i]);
-			}
-			//fprintf(stderr, "\n");
-			
-			write((char *)&message3, sizeof(t_256_3byte_message));  
+			_writeLed((char *)&message3, sizeof(t_256_3byte_message));  
 		}
 	} // 256/128/64
 }
@@ -1022,7 +1228,7 @@ MonomeXXhDevice::oscLedFrameEvent(unsigned int column, unsigned int row, unsigne
 			case kCableOrientation_Left:
 				for (i = 0; i < 8; i++) {
 					messagePackLedRow(&message, i, map[i]);
-					write((char *)&message, sizeof(t_message));
+					_writeLed((char *)&message, sizeof(t_message));
 				}
 				break;
 
@@ -1038,14 +1244,14 @@ MonomeXXhDevice::oscLedFrameEvent(unsigned int column, unsigned int row, unsigne
 
 				for (i = 0; i < 8; i++) {
 					messagePackLedRow(&message, i, rmap[i]);
-					write((char *)&message, sizeof(t_message));
+					_writeLed((char *)&message, sizeof(t_message));
 				}
 				break;
 
 			case kCableOrientation_Right:
 				for (i = 0; i < 8; i++) {
 					messagePackLedRow(&message, 7 - i, myswap[map[i]]);
-					write((char *)&message, sizeof(t_message));
+					_writeLed((char *)&message, sizeof(t_message));
 				}
 
 				break;
@@ -1062,7 +1268,7 @@ MonomeXXhDevice::oscLedFrameEvent(unsigned int column, unsigned int row, unsigne
 
 				for (i = 0; i < 8; i++) {
 					messagePackLedRow(&message, i, rmap[i]);
-					write((char *)&message, sizeof(t_message));
+					_writeLed((char *)&message, sizeof(t_message));
 				}
 				break;
 		}
@@ -1135,7 +1341,7 @@ MonomeXXhDevice::oscLedFrameEvent(unsigned int column, unsigned int row, unsigne
 			messagePack_256_led_frame(&message, quadrant, rmap[0], rmap[1], rmap[2], 
 									  rmap[3], rmap[4], rmap[5], rmap[6], rmap[7]);
 
-			write((char *)&message, sizeof(t_256_frame_message));
+			_writeLed((char *)&message, sizeof(t_256_frame_message));
 		}
 		else
 		{
@@ -1199,7 +1405,7 @@ MonomeXXhDevice::oscAdcEnableStateChangeEvent(unsigned int adcIndex, bool adcEna
 		{
 		 t_message message;
 		messagePackAdcEnable(&message, adcIndex, adcEnableState ? 1 : 0);
-		write((char *)&message, sizeof(t_message));
+		_queueWrite((char *)&message, sizeof(t_message));
 		}   
 	else if (_type <= kDeviceType_mk) //256 128 64
 		{
@@ -1207,7 +1413,7 @@ MonomeXXhDevice::oscAdcEnableStateChangeEvent(unsigned int adcIndex, bool adcEna
 		if (adcEnableState) messagePack_256_activatePort(&message, adcIndex);
 		else				messagePack_256_deactivatePort(&message, adcIndex);
 		
-		write((char *)&message, sizeof(t_256_1byte_message));
+		_queueWrite((char *)&message, sizeof(t_256_1byte_message));
 		}
 		
 }    
@@ -1220,13 +1426,15 @@ MonomeXXhDevice::oscTiltEnableStateChangeEvent(bool tiltEnableState)
 
 	if (_type == kDeviceType_40h) return;
 
-	else if (_type <= kDeviceType_mk) //256 128 64
+	_tiltState = tiltEnableState;
+
+	if (_type <= kDeviceType_mk) //256 128 64
 		{
 		t_256_1byte_message  message;
 		if (tiltEnableState) messagePack_256_activatePort(&message, 1);
 		else				messagePack_256_activatePort(&message, 0); //was *de*activate, but its msg 12 either way
 		
-		write((char *)&message, sizeof(t_256_1byte_message));
+		_queueWrite((char *)&message, sizeof(t_256_1byte_message));
 		//fprintf(stderr, "sent message to enable tiltmode %i", int(tiltEnableState)); //bobo
 		}
 		
@@ -1250,7 +1458,7 @@ if (_type != kDeviceType_40h) return;
 	}
 
     messagePackEncEnable(&message, encIndex, encEnableState ? 1 : 0);
-    write((char *)&message, sizeof(t_message));
+    _queueWrite((char *)&message, sizeof(t_message));
 }    
 
 
@@ -1273,7 +1481,1434 @@ else  if (_type <= kDeviceType_mk)//256 128 64
 	}
 
    
-    write((char *)&message, sizeof(t_message));
+    _writeLed((char *)&message, sizeof(t_message));
+}
+
+void
+MonomeXXhDevice::MIDILedRowEvent(unsigned int row, uint16 bitMap)
+{
+	uint16 frame[16];
+
+	if (row >= rows())
+		return;
+
+	MonomeXXhDeviceLock lock(this);
+
+	_localLedFrame(frame);
+
+	for (unsigned int c = 0; c < columns(); c++)
+		_setMIDILedState(frame, row * columns() + c, (bitMap & (1 << c)) != 0);
+
+	_writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::MIDILedColumnEvent(unsigned int column, uint16 bitMap)
+{
+	uint16 frame[16];
+
+	if (column >= columns())
+		return;
+
+	MonomeXXhDeviceLock lock(this);
+
+	_localLedFrame(frame);
+
+	for (unsigned int r = 0; r < rows(); r++)
+		_setMIDILedState(frame, r * columns() + column, (bitMap & (1 << r)) != 0);
+
+	_writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::MIDILedFrameEvent(const uint16 bitMaps[16])
+{
+	uint16 frame[16];
+
+	memset(frame, 0, sizeof(frame));
+
+	for (unsigned int r = 0; r < rows(); r++) {
+		for (unsigned int c = 0; c < columns(); c++)
+			_setMIDILedState(frame, r * columns() + c, (bitMaps[r] & (1 << c)) != 0);
+	}
+
+	writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::localLedFrame(uint16 frame[16]) const
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_localLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::_localLedFrame(uint16 frame[16]) const
+{
+	memcpy(frame, _numLayers > 0 ? _baseFrame : _drawFrame(), sizeof(_ledFrame));
+}
+
+unsigned int
+MonomeXXhDevice::setDoubleBuffered(bool doubleBuffered, unsigned int autoSwapInterval)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	if (doubleBuffered && !_doubleBuffered)
+		memcpy(_backFrame, _ledFrame, sizeof(_backFrame));
+	else if (!doubleBuffered && _doubleBuffered)
+		_swapLeds();
+
+	_doubleBuffered = doubleBuffered;
+	_autoSwapInterval = doubleBuffered ? autoSwapInterval : 0;
+
+	return ++_autoSwapGeneration;
+}
+
+bool
+MonomeXXhDevice::swapLeds(void)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	return _doubleBuffered && _swapLeds();
+}
+
+unsigned int
+MonomeXXhDevice::autoSwapLeds(unsigned int generation)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	if (generation != _autoSwapGeneration || !_doubleBuffered || _autoSwapInterval == 0)
+		return 0;
+
+	_swapLeds();
+
+	return _autoSwapInterval;
+}
+
+void
+MonomeXXhDevice::setSwapCallback(SwapCallback callback, void *userData)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_swapCallback = callback;
+	_swapCallbackUserData = userData;
+}
+
+void
+MonomeXXhDevice::setFlowMode(FlowMode mode)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	// credit mode starts with every credit to spend
+	if (mode == kFlow_Credit && _flowMode != kFlow_Credit) {
+		_flowRetired = _flowCharged;
+		_flowReportedCredits = kFlowCredits;
+	}
+
+	_flowMode = mode;
+}
+
+bool
+MonomeXXhDevice::chargeFlowCredit(void)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	if (_flowMode != kFlow_Credit)
+		return false;
+
+	_flowCharged++;
+
+	// a message that left nothing waiting to be written is paid for straight away
+	if (_transmitQueue.next() == SerialTransmitQueue::kNumClasses)
+		_flowRetired = _flowCharged;
+
+	return _flowReportDue(EventScheduler::now());
+}
+
+void
+MonomeXXhDevice::reportFlowState(FlowState &state)
+{
+	MonomeXXhDeviceLock lock(this);
+	HostTime now = EventScheduler::now();
+
+	_updateFlowUtilisation(now);
+
+	state.level = _flowLevel(now);
+	state.credits = _flowCredits();
+	state.utilisation = _flowUtilisation;
+
+	_flowReportedLevel = state.level;
+	_flowReportedCredits = state.credits;
+}
+
+void
+MonomeXXhDevice::setFlowCallback(FlowCallback callback, void *userData)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_flowCallback = callback;
+	_flowCallbackUserData = userData;
+}
+
+void
+MonomeXXhDevice::linkStats(LinkStats &stats) const
+{
+	MonomeXXhDeviceLock lock(this);
+
+	stats.capacity = _linkCapacity;
+	stats.throughput = _linkThroughput;
+	stats.writeTime = _writeTime;
+	stats.flushInterval = _flushInterval;
+	stats.interactiveLeds = _interactiveLeds;
+}
+
+// makes the back buffer the leds to show and has them written ahead of the other bulk
+// data, as one burst.  a swap asked for before the last one went out joins it.  caller
+// holds the lock.
+bool
+MonomeXXhDevice::_swapLeds(void)
+{
+	if (memcmp(_backFrame, _ledFrame, sizeof(_ledFrame)) == 0 && _staleRows == 0)
+		return false;
+
+	HostTime now = EventScheduler::now();
+
+	memcpy(_ledFrame, _backFrame, sizeof(_ledFrame));
+	_transmitQueue.markBulk(now, true);
+
+	if (_swapTime == 0)
+		_swapTime = now;
+
+	_signalTransmit();
+
+	return true;
+}
+
+void
+MonomeXXhDevice::outputState(OutputState &state) const
+{
+	MonomeXXhDeviceLock lock(this);
+
+	memcpy(state.ledFrame, _ledFrame, sizeof(_ledFrame));
+	state.ledIntensity = _ledIntensity;
+	state.ledMode = _ledMode;
+	state.tiltState = _tiltState;
+}
+
+void
+MonomeXXhDevice::restoreOutputState(const OutputState &state)
+{
+	// a new device's rows are all stale, so the clear and the frame write after it go
+	// out together as one bulk write of every row
+	oscLedClearEvent(false);
+
+	if (state.ledIntensity >= 0)
+		oscLedIntensityChangeEvent(((float)state.ledIntensity + 0.5f) / (float)0xF);
+
+	if (state.ledMode == 0 || state.ledMode == 1)
+		oscLed_ModeStateChangeEvent(state.ledMode);
+
+	if (state.tiltState)
+		oscTiltEnableStateChangeEvent(true);
+
+	writeLocalLedFrame(state.ledFrame);
+}
+
+void
+MonomeXXhDevice::writeLocalLedFrame(const uint16 frame[16])
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::_writeLocalLedFrame(const uint16 frame[16])
+{
+	if (_numLayers > 0) {
+		uint16 rows = 0;
+
+		for (unsigned int r = 0; r < 16; r++) {
+			if (_baseFrame[r] != frame[r])
+				rows |= 1 << r;
+		}
+
+		memcpy(_baseFrame, frame, sizeof(_baseFrame));
+		_composeLayers(rows);
+	}
+	else
+		_writeLedFrame(frame);
+}
+
+// queues the leds that differ from _ledFrame, or keeps them for the next swap while double
+// buffered.  caller holds the lock.
+void
+MonomeXXhDevice::_writeLedFrame(const uint16 frame[16])
+{
+	uint16 columnMask = (uint16)((1 << _columns) - 1);
+
+	if (_doubleBuffered) {
+		for (unsigned int r = 0; r < 16; r++)
+			_backFrame[r] = r < _rows ? frame[r] & columnMask : 0;
+		return;
+	}
+
+	_presentLedFrame(frame);
+}
+
+// queues the leds that differ from _ledFrame, double buffered or not.  caller holds the lock.
+void
+MonomeXXhDevice::_presentLedFrame(const uint16 frame[16])
+{
+	uint16 columnMask = (uint16)((1 << _columns) - 1);
+	uint16 diff[16];
+	unsigned int changed = 0;
+	unsigned int r, c;
+
+	for (r = 0; r < 16; r++) {
+		diff[r] = r < _rows ? (_ledFrame[r] ^ frame[r]) & columnMask : 0;
+
+		for (uint16 d = diff[r]; d != 0; d &= d - 1)
+			changed++;
+	}
+
+	if (changed == 0 && _staleRows == 0)
+		return;
+
+	HostTime now = EventScheduler::now();
+
+	// a led or few, like the answer to a press, goes ahead of any redraw waiting as single
+	// led messages.  anything more is left for the bulk class to encode when its turn comes.
+	if (changed > 0 && changed <= _interactiveLeds && 
+		changed * sizeof(t_message) <= _transmitQueue.space(SerialTransmitQueue::kClass_Interactive)) {
+		for (r = 0; r < _rows; r++) {
+			for (c = 0; diff[r] != 0 && c < _columns; c++) {
+				if ((diff[r] & (1 << c)) == 0)
+					continue;
+
+				t_message message;
+				bool state = (frame[r] & (1 << c)) != 0;
+
+				if (_type == kDeviceType_40h)
+					messagePackLedStateChange(&message, state ? 1 : 0, c, r);
+				else if (state)
+					messagePack_256_led_on(&message, c, r);
+				else
+					messagePack_256_led_off(&message, c, r);
+
+				_transmitQueue.push(SerialTransmitQueue::kClass_Interactive, &message, sizeof(t_message), now);
+				_trackLedMessage((const uint8 *)&message, _sentFrame);
+			}
+		}
+	}
+	else
+		_transmitQueue.markBulk(now);
+
+	for (r = 0; r < 16; r++)
+		_ledFrame[r] = r < _rows ? frame[r] & columnMask : 0;
+
+	_signalTransmit();
+}
+
+// the messages taking the leds from _sentFrame to frame, picking whichever row, led and
+// quadrant frame messages take the fewest bytes.  stale rows are sent whole.
+unsigned int
+MonomeXXhDevice::_encodeLedFrame(const uint16 frame[16], uint8 *buffer)
+{
+	unsigned int len = 0;
+	uint16 diff[16];
+	unsigned int r, c;
+
+	uint16 columnMask = (uint16)((1 << _columns) - 1);
+
+	for (r = 0; r < 16; r++)
+		diff[r] = r < _rows ? ((_sentFrame[r] ^ frame[r]) | ((_staleRows & (1 << r)) ? 0xFFFF : 0)) & columnMask : 0;
+
+	if (_type == kDeviceType_40h) {
+		t_message message;
+		unsigned int changedRows = 0;
+		uint16 changedColumns = 0;
+
+		for (r = 0; r < _rows; r++) {
+			if (diff[r]) {
+				changedRows++;
+				changedColumns |= diff[r];
+			}
+		}
+
+		unsigned int numChangedColumns = 0;
+		for (c = 0; c < _columns; c++) {
+			if (changedColumns & (1 << c))
+				numChangedColumns++;
+		}
+
+		// every 40h led message is 2 bytes, so the fewer messages wins
+		if (changedRows <= numChangedColumns) {
+			for (r = 0; r < _rows; r++) {
+				if (diff[r]) {
+					messagePackLedRow(&message, r, (uint8)frame[r]);
+					_appendLedMessage(buffer, len, &message, sizeof(t_message));
+				}
+			}
+		}
+		else {
+			for (c = 0; c < _columns; c++) {
+				if (changedColumns & (1 << c)) {
+					uint8 bitMap = 0;
+					for (r = 0; r < _rows; r++) {
+						if (frame[r] & (1 << c))
+							bitMap |= 1 << r;
+					}
+					messagePackLedColumn(&message, c, bitMap);
+					_appendLedMessage(buffer, len, &message, sizeof(t_message));
+				}
+			}
+		}
+	}
+	else if (_type <= kDeviceType_mk) { // 256 128 64 mk
+		// quadrant frames are 9 bytes, so only worth it when they replace more than 9 bytes
+		// of row messages.  try every set of quadrants (at most 16 on a 256) and keep the cheapest.
+		unsigned int numQuadrants = 0;
+		if (_type != kDeviceType_mk)	// frame is broken on mk
+			numQuadrants = (_columns / 8) * (_rows / 8);
+
+		unsigned int bestQuadrants = 0, bestCost = ~0U;
+
+		for (unsigned int quadrants = 0; quadrants < (1U << numQuadrants); quadrants++) {
+			unsigned int cost = 0;
+
+			for (unsigned int q = 0; q < numQuadrants; q++) {
+				if (quadrants & (1 << q))
+					cost += sizeof(t_256_frame_message);
+			}
+
+			for (r = 0; r < _rows; r++) {
+				uint16 d = diff[r];
+				for (unsigned int q = 0; q < numQuadrants; q++) {
+					if ((quadrants & (1 << q)) && (q >> 1) == r / 8)
+						d &= (uint16)~(0xFF << ((q & 1) * 8));
+				}
+
+				if (d == 0)
+					continue;
+				else if ((d & 0xFF00) == 0 || (d & (d - 1)) == 0)
+					cost += 2; // row1 or a single led_on/led_off
+				else
+					cost += 3; // row2
+			}
+
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestQuadrants = quadrants;
+			}
+		}
+
+		for (unsigned int q = 0; q < numQuadrants; q++) {
+			if (bestQuadrants & (1 << q)) {
+				t_256_frame_message message;
+				const uint16 *rowData = frame + (q >> 1) * 8;
+				unsigned int shift = (q & 1) * 8;
+
+				messagePack_256_led_frame(&message, q, 
+										  (uint8)(rowData[0] >> shift), (uint8)(rowData[1] >> shift), 
+										  (uint8)(rowData[2] >> shift), (uint8)(rowData[3] >> shift), 
+										  (uint8)(rowData[4] >> shift), (uint8)(rowData[5] >> shift), 
+										  (uint8)(rowData[6] >> shift), (uint8)(rowData[7] >> shift));
+				_appendLedMessage(buffer, len, &message, sizeof(t_256_frame_message));
+
+				for (r = 0; r < 8; r++)
+					diff[(q >> 1) * 8 + r] &= (uint16)~(0xFF << shift);
+			}
+		}
+
+		for (r = 0; r < _rows; r++) {
+			uint16 d = diff[r];
+
+			if (d == 0)
+				continue;
+			else if ((d & 0xFF00) == 0) {
+				t_message message;
+				messagePack_256_led_row1(&message, r, (uint8)frame[r]);
+				_appendLedMessage(buffer, len, &message, sizeof(t_message));
+			}
+			else if ((d & (d - 1)) == 0) {
+				t_message message;
+				for (c = 0; (d & (1 << c)) == 0; c++)
+					;
+				if (frame[r] & d)
+					messagePack_256_led_on(&message, c, r);
+				else
+					messagePack_256_led_off(&message, c, r);
+				_appendLedMessage(buffer, len, &message, sizeof(t_message));
+			}
+			else {
+				t_256_3byte_message message;
+				messagePack_256_led_row2(&message, r, (uint8)frame[r], (uint8)(frame[r] >> 8));
+				_appendLedMessage(buffer, len, &message, sizeof(t_256_3byte_message));
+			}
+		}
+	}
+
+	return len;
+}
+
+void
+MonomeXXhDevice::oscLedRegionEvent(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep)
+{
+	MonomeXXhDeviceLock lock(this);
+	uint16 frame[16];
+
+	_localLedFrame(frame);
+	_drawOscRegion(frame, column, row, width, height, bitMaps, keep);
+	_writeLocalLedFrame(frame);
+}
+
+bool
+MonomeXXhDevice::oscLayerEvent(int layer, int z, LayerBlend blend)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	Layer *l = _layer(layer, true);
+
+	if (l == 0)
+		return false;
+
+	if (l->z != z || l->blend != blend) {
+		l->z = z;
+		l->blend = blend;
+		_sortLayers();
+		_composeLayers(0xFFFF);
+	}
+
+	return true;
+}
+
+void
+MonomeXXhDevice::oscLayerClipEvent(int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	Layer *l = _layer(layer, true);
+
+	if (l == 0)
+		return;
+
+	for (unsigned int r = 0; r < 16; r++) {
+		l->clip[r] = 0;
+
+		for (unsigned int c = 0; c < _columns && r < _rows; c++) {
+			unsigned int oscColumn = c, oscRow = r;
+
+			convertLocalCoordinatesToOscCoordinates(oscColumn, oscRow);
+
+			if (width == 0 || height == 0 || (oscColumn - column < width && oscRow - row < height))
+				l->clip[r] |= 1 << c;
+		}
+	}
+
+	_composeLayers(0xFFFF);
+}
+
+void
+MonomeXXhDevice::oscLayerRemoveEvent(int layer)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	Layer *l = _layer(layer, false);
+
+	if (l == 0)
+		return;
+
+	for (unsigned int i = l - _layers; i + 1 < _numLayers; i++)
+		_layers[i] = _layers[i + 1];
+
+	if (--_numLayers > 0)
+		_composeLayers(0xFFFF);
+	else
+		_writeLedFrame(_baseFrame);
+}
+
+void
+MonomeXXhDevice::oscLayerClearEvent(int layer)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	Layer *l = _layer(layer, false);
+
+	if (l == 0)
+		return;
+
+	uint16 rows = 0;
+
+	for (unsigned int r = 0; r < 16; r++) {
+		if (l->leds[r] != 0)
+			rows |= 1 << r;
+	}
+
+	memset(l->leds, 0, sizeof(l->leds));
+	_composeLayers(rows);
+}
+
+void
+MonomeXXhDevice::oscLayerRegionEvent(int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	Layer *l = _layer(layer, true);
+
+	if (l != 0)
+		_composeLayers(_drawOscRegion(l->leds, column, row, width, height, bitMaps, keep));
+}
+
+bool
+MonomeXXhDevice::oscEchoEvent(EchoMode mode, unsigned int column, unsigned int row, unsigned int width, unsigned int height)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	if (_numEchoRules == kMaxEchoRules)
+		return false;
+
+	EchoRule &rule = _echoRules[_numEchoRules];
+
+	rule.mode = mode;
+
+	for (unsigned int r = 0; r < 16; r++) {
+		rule.keys[r] = 0;
+
+		for (unsigned int c = 0; c < _columns && r < _rows; c++) {
+			unsigned int oscColumn = c, oscRow = r;
+
+			convertLocalCoordinatesToOscCoordinates(oscColumn, oscRow);
+
+			if (width == 0 || height == 0 || (oscColumn - column < width && oscRow - row < height))
+				rule.keys[r] |= 1 << c;
+		}
+	}
+
+	_numEchoRules++;
+
+	return true;
+}
+
+void
+MonomeXXhDevice::oscEchoClearEvent(void)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_numEchoRules = 0;
+}
+
+void
+MonomeXXhDevice::echoButtonPresses(const uint8 *localColumns, const uint8 *localRows, const uint16 *states, unsigned int count)
+{
+	// only a hint, so presses skip the lock while there are no rules; the rules themselves
+	// are only read under it
+	if (_numEchoRules == 0)
+		return;
+
+	MonomeXXhDeviceLock lock(this);
+
+	uint16 frame[16], drawn[16];
+	unsigned int numEchoRules = _numEchoRules;
+	bool echoed = false;
+
+	_localLedFrame(frame);
+	memcpy(drawn, _drawFrame(), sizeof(drawn));
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int row = localRows[i];
+		const EchoRule *rule = 0;
+
+		if (localColumns[i] >= 16 || row >= 16)
+			continue;
+
+		uint16 key = (uint16)(1 << localColumns[i]);
+
+		for (unsigned int j = numEchoRules; j > 0; j--) {
+			if (_echoRules[j - 1].keys[row] & key) {
+				rule = &_echoRules[j - 1];
+				break;
+			}
+		}
+
+		if (rule == 0)
+			continue;
+
+		switch (rule->mode) {
+			case kEcho_Momentary:
+				if (states[i])
+					frame[row] |= key;
+				else
+					frame[row] &= ~key;
+				break;
+
+			case kEcho_Toggle:
+				if (states[i])
+					frame[row] ^= key;
+				break;
+
+			case kEcho_Radio:
+				if (states[i]) {
+					for (unsigned int r = 0; r < 16; r++)
+						frame[r] &= ~rule->keys[r];
+					frame[row] |= key;
+				}
+				break;
+		}
+
+		echoed = true;
+	}
+
+	if (!echoed)
+		return;
+
+	_writeLocalLedFrame(frame);
+
+	// double buffered, the echo still shows at once rather than at the client's next swap:
+	// the leds it changed in the back buffer go straight onto the presented frame too
+	if (_doubleBuffered) {
+		uint16 presented[16];
+
+		for (unsigned int r = 0; r < 16; r++) {
+			uint16 changed = drawn[r] ^ _backFrame[r];
+
+			presented[r] = (_ledFrame[r] & ~changed) | (_backFrame[r] & changed);
+		}
+
+		_presentLedFrame(presented);
+	}
+}
+
+void
+MonomeXXhDevice::echoButtonPress(unsigned int localColumn, unsigned int localRow, bool state)
+{
+	uint8 column = (uint8)localColumn, row = (uint8)localRow;
+	uint16 value = state ? 1 : 0;
+
+	if (localColumn < 16 && localRow < 16)
+		echoButtonPresses(&column, &row, &value, 1);
+}
+
+// finds layer id, or adds it over the others with z = id, kLayerBlend_Or and no clip.  the
+// first layer takes a copy of the leds as they are to composite over.
+MonomeXXhDevice::Layer *
+MonomeXXhDevice::_layer(int id, bool create)
+{
+	unsigned int i;
+
+	for (i = 0; i < _numLayers; i++) {
+		if (_layers[i].id == id)
+			return &_layers[i];
+	}
+
+	if (!create || _numLayers == kMaxLayers)
+		return 0;
+
+	if (_numLayers == 0)
+		memcpy(_baseFrame, _drawFrame(), sizeof(_baseFrame));
+
+	Layer &l = _layers[_numLayers++];
+
+	l.id = id;
+	l.z = id;
+	l.blend = kLayerBlend_Or;
+	memset(l.leds, 0, sizeof(l.leds));
+	for (i = 0; i < 16; i++)
+		l.clip[i] = i < _rows ? (uint16)((1 << _columns) - 1) : 0;
+
+	_sortLayers();
+
+	for (i = 0; i < _numLayers; i++) {
+		if (_layers[i].id == id)
+			return &_layers[i];
+	}
+
+	return 0;
+}
+
+// insertion sort on z, keeping the order layers were added in for equal z
+void
+MonomeXXhDevice::_sortLayers(void)
+{
+	for (unsigned int i = 1; i < _numLayers; i++) {
+		Layer l = _layers[i];
+		unsigned int j;
+
+		for (j = i; j > 0 && _layers[j - 1].z > l.z; j--)
+			_layers[j] = _layers[j - 1];
+
+		_layers[j] = l;
+	}
+}
+
+// recomputes the rows set in rows from _baseFrame and the layers and sends what changed
+void
+MonomeXXhDevice::_composeLayers(uint16 rows)
+{
+	uint16 frame[16];
+
+	if (rows == 0)
+		return;
+
+	memcpy(frame, _drawFrame(), sizeof(frame));
+
+	for (unsigned int r = 0; r < _rows; r++) {
+		if ((rows & (1 << r)) == 0)
+			continue;
+
+		uint16 leds = _baseFrame[r];
+
+		for (unsigned int i = 0; i < _numLayers; i++) {
+			const Layer &l = _layers[i];
+
+			switch (l.blend) {
+				case kLayerBlend_Or:
+					leds |= l.leds[r] & l.clip[r];
+					break;
+
+				case kLayerBlend_Mask:
+					leds &= (uint16)(l.leds[r] | ~l.clip[r]);
+					break;
+
+				case kLayerBlend_Xor:
+					leds ^= l.leds[r] & l.clip[r];
+					break;
+
+				case kLayerBlend_Replace:
+					leds = (uint16)((leds & ~l.clip[r]) | (l.leds[r] & l.clip[r]));
+					break;
+			}
+		}
+
+		frame[r] = leds;
+	}
+
+	_writeLedFrame(frame);
+}
+
+// sets the leds of a region in osc coordinates in a local frame, other than those marked in
+// keep, returning the rows it touched
+uint16
+MonomeXXhDevice::_drawOscRegion(uint16 frame[16], unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep)
+{
+	uint16 rows = 0;
+
+	for (unsigned int r = 0; r < height; r++) {
+		for (unsigned int c = 0; c < width && c < 16; c++) {
+			unsigned int localColumn = column + c, localRow = row + r;
+
+			convertOscCoordinatesToLocalCoordinates(localColumn, localRow);
+
+			if (localColumn >= _columns || localRow >= _rows || (keep != 0 && (keep[r] & (1 << c))))
+				continue;
+
+			if (bitMaps[r] & (1 << c))
+				frame[localRow] |= 1 << localColumn;
+			else
+				frame[localRow] &= ~(1 << localColumn);
+
+			rows |= 1 << localRow;
+		}
+	}
+
+	return rows;
+}
+
+void
+MonomeXXhDevice::oscLedMapEvent(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint8 *data, unsigned int size)
+{
+	MonomeXXhDeviceLock lock(this);
+	uint16 frame[16];
+	unsigned int stride = (width + 7) / 8;
+
+	_localLedFrame(frame);
+
+	if (DeviceOrientation() == kCableOrientation_Left && _oscStartColumn >= column && 
+		_oscStartColumn + _columns <= column + width && (_oscStartColumn - column) % 8 == 0) {
+		// the device's rows start on a byte of the map, so each one comes straight off the blob
+		unsigned int offset = (_oscStartColumn - column) / 8;
+		unsigned int bytes = (_columns + 7) / 8;
+		uint16 mask = (uint16)((1 << _columns) - 1);
+
+		for (unsigned int r = 0; r < _rows; r++) {
+			unsigned int mapRow = _oscStartRow + r - row;
+			unsigned int k = mapRow * stride + offset;
+
+			if (mapRow >= height || k + bytes > size)
+				continue;
+
+			frame[r] = (uint16)(bytes > 1 ? data[k] | data[k + 1] << 8 : data[k]) & mask;
+		}
+	}
+	else {
+		for (unsigned int r = 0; r < _rows; r++) {
+			for (unsigned int c = 0; c < _columns; c++) {
+				unsigned int mapColumn = c, mapRow = r, k;
+
+				convertLocalCoordinatesToOscCoordinates(mapColumn, mapRow);
+				mapColumn -= column;
+				mapRow -= row;
+				k = mapRow * stride + mapColumn / 8;
+
+				if (mapColumn >= width || mapRow >= height || k >= size)
+					continue;
+
+				if (data[k] & (1 << (mapColumn % 8)))
+					frame[r] |= 1 << c;
+				else
+					frame[r] &= ~(1 << c);
+			}
+		}
+	}
+
+	_writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::oscLedBounds(unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height) const
+{
+	column = _oscStartColumn;
+	row = _oscStartRow;
+
+	// turned a quarter either way, local rows run along osc columns
+	if (DeviceOrientation() == kCableOrientation_Top || DeviceOrientation() == kCableOrientation_Bottom) {
+		width = _rows;
+		height = _columns;
+	}
+	else {
+		width = _columns;
+		height = _rows;
+	}
+}
+
+void
+MonomeXXhDevice::readOscLedBitmap(LedBitmap &bitmap)
+{
+	uint16 frame[16];
+
+	_localLedFrame(frame);
+
+	for (unsigned int r = 0; r < _rows; r++) {
+		for (unsigned int c = 0; c < _columns; c++) {
+			unsigned int column = c, row = r;
+
+			convertLocalCoordinatesToOscCoordinates(column, row);
+			bitmap.setLed(column, row, (frame[r] & (1 << c)) != 0);
+		}
+	}
+}
+
+void
+MonomeXXhDevice::writeOscLedBitmap(const LedBitmap &bitmap)
+{
+	uint16 frame[16];
+
+	_localLedFrame(frame);
+
+	for (unsigned int r = 0; r < _rows; r++) {
+		for (unsigned int c = 0; c < _columns; c++) {
+			unsigned int column = c, row = r;
+
+			convertLocalCoordinatesToOscCoordinates(column, row);
+
+			if (!bitmap.contains(column, row))
+				continue;
+
+			if (bitmap.led(column, row))
+				frame[r] |= 1 << c;
+			else
+				frame[r] &= ~(1 << c);
+		}
+	}
+
+	_writeLocalLedFrame(frame);
+}
+
+void
+MonomeXXhDevice::lockLeds(void)
+{
+	pthread_mutex_lock(&_lock);
+}
+
+void
+MonomeXXhDevice::unlockLeds(void)
+{
+	pthread_mutex_unlock(&_lock);
+}
+
+unsigned int
+MonomeXXhDevice::startLedAnimation(const LedAnimation &animation)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_ledAnimation = animation;
+	return ++_ledAnimationGeneration;
+}
+
+void
+MonomeXXhDevice::stopLedAnimation(void)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	_ledAnimation.stop();
+	_ledAnimationGeneration++;
+}
+
+unsigned int
+MonomeXXhDevice::stepLedAnimation(unsigned int generation)
+{
+	uint16 bitMaps[LedAnimation::kMaxRows];
+	unsigned int column, row, width, height, interval;
+	float intensity;
+	bool drawsLeds, more;
+
+	{
+		MonomeXXhDeviceLock lock(this);
+
+		if (generation != _ledAnimationGeneration || _ledAnimation.type() == LedAnimation::kAnimation_None)
+			return 0;
+
+		column = _ledAnimation.column();
+		row = _ledAnimation.row();
+		width = _ledAnimation.width();
+		height = _ledAnimation.height();
+		interval = _ledAnimation.interval();
+		drawsLeds = _ledAnimation.drawsLeds();
+		_ledAnimation.frame(bitMaps);
+		intensity = _ledAnimation.intensity();
+
+		if (!(more = _ledAnimation.advance()))
+			_ledAnimation.stop();
+	}
+
+	// drawn outside the lock, which oscLedRegionEvent holds across its read and write
+	if (drawsLeds)
+		oscLedRegionEvent(column, row, width, height, bitMaps);
+	else
+		oscLedIntensityChangeEvent(intensity);
+
+	return more ? interval : 0;
+}
+
+int
+MonomeXXhDevice::_writeLed(char *data, unsigned int len)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	// under layers an led message draws on the base, and what shows is composited from that
+	if (_numLayers > 0) {
+		uint16 frame[16];
+
+		memcpy(frame, _baseFrame, sizeof(frame));
+
+		if (_trackLedMessage((const uint8 *)data, _baseFrame)) {
+			uint16 rows = 0;
+
+			for (unsigned int r = 0; r < 16; r++) {
+				if (_baseFrame[r] != frame[r])
+					rows |= 1 << r;
+			}
+
+			_composeLayers(rows);
+			return len;
+		}
+	}
+
+	uint16 frame[16];
+
+	// led messages are drawn into the frame, and go out as whichever class the change needs
+	memcpy(frame, _drawFrame(), sizeof(frame));
+
+	if (_trackLedMessage((const uint8 *)data, frame)) {
+		_writeLedFrame(frame);
+		return len;
+	}
+
+	return _queueControl(data, len);
+}
+
+int
+MonomeXXhDevice::_queueWrite(char *data, unsigned int len)
+{
+	MonomeXXhDeviceLock lock(this);
+
+	return _queueControl(data, len);
+}
+
+// caller holds the lock.  the control class only fills up when the link is far behind;
+// writing around it then would put this message on the port alongside the transmit
+// thread's and ahead of the ones still queued, so it waits for the room instead.
+int
+MonomeXXhDevice::_queueControl(char *data, unsigned int len)
+{
+	if (len > SerialTransmitQueue::kQueueSize)
+		return 0;
+
+	while (!_transmitQueue.push(SerialTransmitQueue::kClass_Control, data, len, EventScheduler::now())) {
+		if (_transmitTerminate)
+			return 0;
+
+		_signalTransmit();
+		pthread_cond_wait(&_transmitSpaceCondition, &_lock);
+	}
+
+	_signalTransmit();
+	return len;
+}
+
+void *
+MonomeXXhDevice::_transmitThreadProc(void *parameter)
+{
+	((MonomeXXhDevice *)parameter)->_transmit();
+	return NULL;
+}
+
+// writes whatever goes next outside the lock, so drawing never waits on the serial port,
+// and sleeps while there is nothing to write
+void
+MonomeXXhDevice::_transmit(void)
+{
+	uint8 buffer[kTransmitBufferSize];
+	RealtimeThread realtime(RealtimeThread::kThreadClass_Transmit);
+
+	pthread_mutex_lock(&_lock);
+
+	while (!_transmitTerminate) {
+		HostTime swapTime, holdTime;
+		unsigned int len;
+
+		realtime.update();
+		len = _nextTransmission(buffer, swapTime, holdTime);
+
+		if (len == 0) {
+			HostTime now = EventScheduler::now();
+
+			if (holdTime == 0)
+				pthread_cond_wait(&_transmitCondition, &_lock);
+			else if (holdTime > now) {
+				// bulk data is being paced, though a queued message may wake it sooner
+				double nanoseconds = EventScheduler::millisecondsFromHostTime(holdTime - now) * 1000000.0;
+				struct timespec timeout;
+				timeout.tv_sec = (time_t)(nanoseconds / 1000000000.0);
+				timeout.tv_nsec = (long)(nanoseconds - timeout.tv_sec * 1000000000.0);
+
+				pthread_cond_timedwait_relative_np(&_transmitCondition, &_lock, &timeout);
+			}
+			continue;
+		}
+
+		// the credits charged so far come back with this write if it leaves nothing waiting
+		unsigned int retire = _transmitQueue.next() == SerialTransmitQueue::kNumClasses ? _flowCharged : _flowRetired;
+
+		// whatever waits on a full control class can try again
+		pthread_cond_broadcast(&_transmitSpaceCondition);
+		pthread_mutex_unlock(&_lock);
+
+		HostTime writeStart = EventScheduler::now();
+		long written = (long)write((char *)buffer, len);
+
+		if (swapTime != 0 && _swapCallback != 0)
+			_swapCallback(this, EventScheduler::millisecondsFromHostTime(EventScheduler::now() - swapTime), _swapCallbackUserData);
+
+		pthread_mutex_lock(&_lock);
+
+		if (_transmitted(len, written, retire, writeStart) && _flowCallback != 0) {
+			pthread_mutex_unlock(&_lock);
+			_flowCallback(this, _flowCallbackUserData);
+			pthread_mutex_lock(&_lock);
+		}
+	}
+
+	pthread_mutex_unlock(&_lock);
+}
+
+// caller holds the lock
+void
+MonomeXXhDevice::_signalTransmit(void)
+{
+	pthread_cond_signal(&_transmitCondition);
+}
+
+// accounts for a write of len bytes started at writeStart, of which written went out,
+// giving back the credits charged up to retire.  true if a report is due.  caller holds
+// the lock.
+bool
+MonomeXXhDevice::_transmitted(unsigned int len, long written, unsigned int retire, HostTime writeStart)
+{
+	HostTime now = EventScheduler::now();
+	unsigned int bytes = written > 0 ? written : 0;
+
+	_flowWindowBytes += bytes;
+	_flowWindowBusy += now - writeStart;
+	_writeTime += ((float)EventScheduler::millisecondsFromHostTime(now - writeStart) - _writeTime) / 8;
+
+	// the link is taken to be busy with these bytes until they drain at the paced rate,
+	// and bulk data waits for it.  a write that blocked has mostly waited it out already.
+	HostTime drain = EventScheduler::hostTimeFromMilliseconds(bytes * 100000.0 / (kTargetUtilisation * _linkCapacity));
+	_linkFreeTime = (_linkFreeTime > writeStart ? _linkFreeTime : writeStart) + drain;
+
+	_updateFlowUtilisation(now);
+
+	// the device may be showing anything after a failed write, so every row goes out whole
+	// with the next change.  retrying from here would spin on a device that has gone.
+	if ((_flowWriteFailed = written < (long)len))
+		_staleRows = 0xFFFF;
+
+	if ((int)(retire - _flowRetired) > 0)
+		_flowRetired = retire;
+
+	return _flowReportDue(now);
+}
+
+// caller holds the lock
+unsigned int
+MonomeXXhDevice::_flowCredits(void) const
+{
+	unsigned int outstanding = _flowCharged - _flowRetired;
+
+	return outstanding < kFlowCredits ? kFlowCredits - outstanding : 0;
+}
+
+// caller holds the lock
+MonomeXXhDevice::FlowLevel
+MonomeXXhDevice::_flowLevel(HostTime now) const
+{
+	if (_flowWriteFailed || _transmitQueue.overdue(now))
+		return kFlowLevel_Congested;
+
+	return _transmitQueue.next() == SerialTransmitQueue::kNumClasses ? kFlowLevel_Clear : kFlowLevel_Busy;
+}
+
+// whether congestion has started or ended, or enough credits have come back, since the
+// last report.  caller holds the lock.
+bool
+MonomeXXhDevice::_flowReportDue(HostTime now)
+{
+	if (_flowMode == kFlow_Off)
+		return false;
+
+	if ((_flowLevel(now) == kFlowLevel_Congested) != (_flowReportedLevel == kFlowLevel_Congested))
+		return true;
+
+	if (_flowMode != kFlow_Credit)
+		return false;
+
+	unsigned int credits = _flowCredits();
+
+	// spending needs no report, the client knows what it has sent
+	if (credits < _flowReportedCredits)
+		_flowReportedCredits = credits;
+
+	return credits >= _flowReportedCredits + kFlowCredits / 4 ||
+		(credits == kFlowCredits && _flowReportedCredits < kFlowCredits);
+}
+
+// closes the measuring window once it has run its length, and has the adaptive refresh
+// controller follow what it measured.  caller holds the lock.
+void
+MonomeXXhDevice::_updateFlowUtilisation(HostTime now)
+{
+	HostTime elapsed = now - _flowWindowStart;
+
+	if (elapsed < EventScheduler::hostTimeFromMilliseconds(kFlowWindow))
+		return;
+
+	double seconds = EventScheduler::millisecondsFromHostTime(elapsed) / 1000.0;
+	double busy = EventScheduler::millisecondsFromHostTime(_flowWindowBusy) / 1000.0;
+
+	// writes block once the driver's buffer is full, so a window spent writing shows what the
+	// link really carries.  one that wasn't shows only that it carries more than was asked of
+	// it, and the estimate creeps back up towards the line rate.
+	if (_flowWindowBytes >= kMinSampleBytes) {
+		double sample = busy > 0.0 ? _flowWindowBytes / busy : (double)kLinkBytesPerSecond;
+
+		if (sample > kLinkBytesPerSecond)
+			sample = kLinkBytesPerSecond;
+		else if (sample < kLinkBytesPerSecond / 16)
+			sample = kLinkBytesPerSecond / 16;
+
+		_linkCapacity += ((float)sample - _linkCapacity) / 4;
+	}
+
+	_linkThroughput = (float)(_flowWindowBytes / seconds);
+
+	float utilisation = _linkThroughput / _linkCapacity;
+	_flowUtilisation = utilisation < 1.f ? utilisation : 1.f;
+
+	// single led messages skip the pacing and take more bytes than the bulk encoding of the
+	// same leds, so the busier the link the fewer leds a change may have to go that way
+	if (_flowUtilisation < 0.5f)
+		_interactiveLeds = kMaxInteractiveLeds;
+	else if (_flowUtilisation < 0.8f)
+		_interactiveLeds = kMaxInteractiveLeds / 2;
+	else
+		_interactiveLeds = 1;
+
+	_flowWindowStart = now;
+	_flowWindowBytes = 0;
+	_flowWindowBusy = 0;
+}
+
+// the bytes to write next, and when the swap they present was asked for, or 0.  when only
+// bulk data is waiting and it is being held back to the paced rate, none, and in holdTime
+// when to look again.  caller holds the lock.
+unsigned int
+MonomeXXhDevice::_nextTransmission(uint8 *buffer, HostTime &swapTime, HostTime &holdTime)
+{
+	HostTime now = EventScheduler::now();
+	bool hold = now < _linkFreeTime;
+	SerialTransmitQueue::Class next = _transmitQueue.next(!hold);
+	unsigned int len;
+
+	swapTime = 0;
+	holdTime = 0;
+
+	switch (next) {
+		case SerialTransmitQueue::kClass_Interactive:
+		case SerialTransmitQueue::kClass_Control:
+			return _transmitQueue.take(next, buffer);
+
+		case SerialTransmitQueue::kClass_Bulk:
+			// waiting single leds were queued before the bulk change and are already in
+			// _sentFrame, so they have to go out ahead of it
+			len = _transmitQueue.take(SerialTransmitQueue::kClass_Interactive, buffer);
+			len += _encodeLedFrame(_ledFrame, buffer + len);
+			memcpy(_sentFrame, _ledFrame, sizeof(_sentFrame));
+			_staleRows = 0;
+			_transmitQueue.takeBulk();
+			swapTime = _swapTime;
+			_swapTime = 0;
+
+			if (_lastFlushTime != 0)
+				_flushInterval += ((float)EventScheduler::millisecondsFromHostTime(now - _lastFlushTime) - _flushInterval) / 4;
+			_lastFlushTime = now;
+			return len;
+
+		default:
+			if (hold && _transmitQueue.next() == SerialTransmitQueue::kClass_Bulk)
+				holdTime = _linkFreeTime;
+			return 0;
+	}
+}
+
+void
+MonomeXXhDevice::_appendLedMessage(uint8 *buffer, unsigned int &len, const void *message, unsigned int size)
+{
+	memcpy(buffer + len, message, size);
+	len += size;
+}
+
+// keeps frame in step with one outgoing led message, returning false if it doesn't set
+// any leds.  caller holds the lock.
+bool
+MonomeXXhDevice::_trackLedMessage(const uint8 *data, uint16 frame[16])
+{
+	bool tracked = true;
+
+	unsigned int type = data[0] >> 4;
+	unsigned int index = data[0] & 0x0F;
+	uint16 columnMask = (uint16)((1 << _columns) - 1);
+	unsigned int r;
+
+	if (_type == kDeviceType_40h) {
+		switch (type) {
+			case kMessageTypeLedStateChange:
+				if (index)
+					frame[data[1] & 0x0F] |= 1 << (data[1] >> 4);
+				else
+					frame[data[1] & 0x0F] &= ~(1 << (data[1] >> 4));
+				break;
+
+			case kMessageTypeLedSetRow:
+				frame[index] = data[1];
+				break;
+
+			case kMessageTypeLedSetColumn:
+				for (r = 0; r < 8; r++) {
+					if (data[1] & (1 << r))
+						frame[r] |= 1 << index;
+					else
+						frame[r] &= ~(1 << index);
+				}
+				break;
+
+			default:
+				tracked = false;
+				break;
+		}
+	}
+	else if (_type <= kDeviceType_mk) { // 256 128 64 mk
+		switch (type) {
+			case kMessageType_256_led_on:
+				frame[data[1] & 0x0F] |= 1 << (data[1] >> 4);
+				break;
+
+			case kMessageType_256_led_off:
+				frame[data[1] & 0x0F] &= ~(1 << (data[1] >> 4));
+				break;
+
+			case kMessageType_256_led_row1:
+				frame[index] = (frame[index] & 0xFF00) | data[1];
+				break;
+
+			case kMessageType_256_led_row2:
+				frame[index] = data[1] | (data[2] << 8);
+				break;
+
+			case kMessageType_256_led_col1:
+			case kMessageType_256_led_col2:
+				for (r = 0; r < 16; r++) {
+					if (r >= 8 && type == kMessageType_256_led_col1)
+						break;
+
+					if ((r < 8 ? data[1] >> r : data[2] >> (r - 8)) & 1)
+						frame[r] |= 1 << index;
+					else
+						frame[r] &= ~(1 << index);
+				}
+				break;
+
+			case kMessageType_256_led_frame:
+				for (r = 0; r < 8; r++) {
+					uint16 &row = frame[(index >> 1) * 8 + r];
+					row = (row & ~(0xFF << ((index & 1) * 8))) | (data[1 + r] << ((index & 1) * 8));
+				}
+				break;
+
+			case kMessageType_256_clear:
+				for (r = 0; r < 16; r++)
+					frame[r] = index ? columnMask : 0;
+				break;
+
+			default:
+				tracked = false;
+				break;
+		}
+	}
+	else
+		tracked = false;
+
+	for (r = 0; r < 16; r++)
+		frame[r] = r < _rows ? (frame[r] & columnMask) : 0;
+
+	return tracked;
+}
+
+void
+MonomeXXhDevice::_setMIDILedState(uint16 frame[16], unsigned char MIDINoteNumber, bool state)
+{
+	unsigned int column = 0, row = 0;
+
+	convertMIDINoteNumberToLocalCoordinates(MIDINoteNumber, column, row);
+
+	if (column >= _columns || row >= _rows)
+		return;
+
+	if (state)
+		frame[row] |= 1 << column;
+	else
+		frame[row] &= ~(1 << column);
 }
 
 
@@ -1288,7 +2923,7 @@ MonomeXXhDevice::oscAuxVersionRequestEvent(void)
 	
 
 	messagePack_mk_auxin(&message, kMessage_AuxIn_Version, 0, 0);
-	write((char*)&message, sizeof(t_mk_3byte_message));
+	_queueWrite((char *)&message, sizeof(t_mk_3byte_message));
 		
 }
 void
@@ -1300,7 +2935,7 @@ MonomeXXhDevice::oscAuxEnableEvent(unsigned int portF, unsigned int portA)
 	
 	
     messagePack_mk_auxin(&message, kMessage_AuxIn_Enable, portF, portA);
-    write((char *)&message, sizeof(t_mk_3byte_message));
+    _queueWrite((char *)&message, sizeof(t_mk_3byte_message));
 }
 void MonomeXXhDevice::oscAuxDirectionEvent(unsigned int portF, unsigned int portA)
 {
@@ -1320,6 +2955,6 @@ MonomeXXhDevice::oscGridsEvent(unsigned int nGrids)
 	if (_type != kDeviceType_mk) return;
 	
 	messagePack_mk_grids(&message, nGrids);
-	write((char*)&message, sizeof(t_mk_1byte_message));
+	_queueWrite((char *)&message, sizeof(t_mk_1byte_message));
 	
 }
@@ -21,6 +21,11 @@
 
 #include "SerialDevice.h"
 #include "CCoreMIDI.h"
+#include "EventScheduler.h"
+#include "SensorFilter.h"
+#include "SerialTransmitQueue.h"
+#include "LedAnimation.h"
+#include "LedBitmap.h"
 #include <pthread.h>
 
 #define kMonomeXXhDevice_SerialNumberLength 6
@@ -78,7 +83,7 @@ public:
 
     unsigned int columns(void) ;// { return _columns; }
     unsigned int rows(void) ;
-	unsigned int DeviceOrientation(void) ;
+	unsigned int DeviceOrientation(void) const ;
 	
     DeviceType type(void) const { return _type; }
     unsigned int messageSize(void) const;
@@ -89,6 +94,18 @@ public:
     void setOscAddressPatternPrefix(const string& oscAddressPatternPrefix);
     const string& oscAddressPatternPrefix(void) const;
 
+    // the prefix with each input message's suffix, built with the prefix so that input
+    // goes out without building a string on the reader thread
+    typedef enum {
+        kInputAddress_Press,
+        kInputAddress_Adc,
+        kInputAddress_Tilt,
+        kInputAddress_Enc,
+        kNumInputAddresses
+    } InputAddress;
+
+    const string& oscInputAddressPattern(InputAddress address) const;
+
     void setOscStartColumn(unsigned int column);
     unsigned int oscStartColumn(void) const;
 
@@ -118,14 +135,233 @@ public:
     unsigned char MIDIInputChannel(void) const;
     void setMIDIOutputChannel(unsigned char channel);
     unsigned char MIDIOutputChannel(void) const;    
+
+    // how far behind its MIDI timestamp an incoming led event is shown, in milliseconds.
+    // a constant delay trades latency for steady timing against the sender's clock.
+    void setMIDILedLatency(unsigned int milliseconds);
+    unsigned int MIDILedLatency(void) const;
+
+    // encoder steps are summed per encoder and sent at most once per interval, or once per
+    // serial read when the interval is 0.  acceleration scales each step by
+    // 1 + acceleration * steps per millisecond.  the total counts every step the hardware
+    // reported, however it was sent.
+    enum { kMaxEncoders = 16 };
+
+    void setEncoderInterval(unsigned int milliseconds);
+    unsigned int encoderInterval(void) const;
+    void setEncoderAcceleration(float acceleration);
+    float encoderAcceleration(void) const;
+
+    // returns when the encoder may next send, or 0 if a send is already due
+    HostTime addEncoderSteps(unsigned int localIndex, int steps, HostTime time);
+    // takes what is pending, clipped to minSteps..maxSteps.  nextSendTime is when the rest
+    // may go, or 0 if nothing is left.
+    int takeEncoderSteps(unsigned int localIndex, int minSteps, int maxSteps, HostTime time, HostTime &nextSendTime);
+    unsigned int pendingEncoders(void) const;   // bit n is set while encoder n has steps waiting
+    long encoderTotal(unsigned int localIndex) const;
+
+    // analog inputs go through a SensorFilter each before they are sent
+    enum {
+        kSensor_Adc0 = 0,       // 40h adcs 0-3
+        kSensor_TiltX = 4,      // 64 tilt
+        kSensor_TiltY = 5,
+        kNumSensors = 6
+    };
+
+    void setSensorFilter(unsigned int sensor, float deadband, unsigned int interval, SensorFilter::Smoothing smoothing, float amount);
+    const SensorFilter& sensorFilter(unsigned int sensor) const;
+    bool filterSensorSample(unsigned int sensor, float sample, unsigned int outputSteps, HostTime time, float &value, HostTime &retryTime);
+    bool retrySensorSample(unsigned int sensor, HostTime time, float &value, HostTime &retryTime);
+
+    // when the last encoder step and sensor sample were read, for the time stamps on
+    // sends that go out after the read they came from
+    HostTime encoderStepTime(unsigned int localIndex) const;
+    HostTime sensorSampleTime(unsigned int sensor) const;
+
+    // how key, encoder and analog messages carry the time their serial read came in
+    typedef enum {
+        kInputTimestamps_Off,
+        kInputTimestamps_Bundle,    // each message goes in a bundle with it as the time tag
+        kInputTimestamps_Argument   // it is added as a time tag after the other arguments
+    } InputTimestamps;
+
+    void setInputTimestamps(InputTimestamps timestamps);
+    InputTimestamps inputTimestamps(void) const;
+
     void setMIDIInputPort(CCoreMIDIPortRef midiInputPort);
     CCoreMIDIPortRef MIDIInputPort(void) const;
     
     void convertLocalCoordinatesToOscCoordinates(unsigned int &column, unsigned int &row);
+    // the same for a run of decoded key events, with the orientation looked up once
+    void convertLocalCoordinatesToOscCoordinates(const uint8 *localColumns, const uint8 *localRows, unsigned int *oscColumns, unsigned int *oscRows, unsigned int count);
     void convertOscCoordinatesToLocalCoordinates(unsigned int &column, unsigned int &row);
     unsigned char convertLocalCoordinatesToMIDINoteNumber(unsigned int &column, unsigned int &row);
     void convertMIDINoteNumberToLocalCoordinates(unsigned char MIDINoteNumber, unsigned int &column, unsigned int &row);
  void MIDILedStateChangeEvent(unsigned char MIDINoteNumber, unsigned char MIDIVelocity);
+
+	// bulk led updates from SysEx, in MIDI note space: bit n of a row bitmap is column n,
+	// bit n of a column bitmap is row n, and bitMaps[r] is row r of the whole grid.
+	void MIDILedRowEvent(unsigned int row, uint16 bitMap);
+	void MIDILedColumnEvent(unsigned int column, uint16 bitMap);
+	void MIDILedFrameEvent(const uint16 bitMaps[16]);
+
+	// the leds as last drawn, in local coordinates (bit n of frame[r] is local column n of
+	// local row r).  writeLocalLedFrame sends only what differs from that: a led or few go
+	// straight to the transmit queue, anything more is encoded in whichever row, led and
+	// quadrant frame messages take the fewest bytes once the bulk class's turn comes.
+	void localLedFrame(uint16 frame[16]) const;
+	void writeLocalLedFrame(const uint16 frame[16]);
+
+	// double buffered, the led messages draw into a back buffer that only reaches the device
+	// when it is swapped in, as one burst of whatever differs, so a redraw of several
+	// messages never tears and leds overwritten before the swap cost nothing.  an auto swap
+	// interval swaps every that many milliseconds, 0 only on swapLeds.  returns the generation
+	// that tells this auto swap from earlier ones.  going back to single buffering swaps first.
+	unsigned int setDoubleBuffered(bool doubleBuffered, unsigned int autoSwapInterval);
+	bool doubleBuffered(void) const { return _doubleBuffered; }
+	// false if the back buffer holds nothing new
+	bool swapLeds(void);
+	// swaps for auto swap generation, returning the milliseconds to the next swap, or 0
+	// once it has been stopped or replaced
+	unsigned int autoSwapLeds(unsigned int generation);
+
+	// called on the transmit thread once a swap has been written, with the milliseconds
+	// since it was asked for
+	typedef void (*SwapCallback)(MonomeXXhDevice *device, double milliseconds, void *userData);
+	void setSwapCallback(SwapCallback callback, void *userData);
+
+	// flow control tells clients how far behind the serial link is, so they can draw no
+	// faster than it carries.  the link is congested when anything waiting has missed its
+	// class's budget or the last write failed.  in credit mode each message to the device
+	// costs one of kFlowCredits credits, and they come back once everything the messages
+	// queued has been written.
+	typedef enum {
+		kFlow_Off,
+		kFlow_Report,		// reports when congestion starts and ends
+		kFlow_Credit		// and when credits come back
+	} FlowMode;
+
+	typedef enum {
+		kFlowLevel_Clear,		// nothing waiting
+		kFlowLevel_Busy,		// waiting, within budget
+		kFlowLevel_Congested
+	} FlowLevel;
+
+	typedef struct {
+		FlowLevel level;
+		unsigned int credits;
+		float utilisation;		// share of the link's measured capacity written lately, 0-1
+	} FlowState;
+
+	enum { kFlowCredits = 32 };
+
+	void setFlowMode(FlowMode mode);
+	FlowMode flowMode(void) const { return _flowMode; }
+	// charges a credit for a message just handled; true if a report is due
+	bool chargeFlowCredit(void);
+	// the state as it is now, counted as reported to the client
+	void reportFlowState(FlowState &state);
+
+	// called on the transmit thread when a report is due
+	typedef void (*FlowCallback)(MonomeXXhDevice *device, void *userData);
+	void setFlowCallback(FlowCallback callback, void *userData);
+
+	// what the adaptive refresh controller has measured of the link, and set from it
+	typedef struct {
+		float capacity;					// bytes per second the link is measured to carry
+		float throughput;				// bytes per second written lately
+		float writeTime;				// milliseconds a write takes to complete
+		float flushInterval;			// milliseconds between bulk led writes
+		unsigned int interactiveLeds;	// the most leds a change may have and still go as single led messages
+	} LinkStats;
+
+	void linkStats(LinkStats &stats) const;
+
+	// what the device was last told to show, so one that drops off and comes back can be
+	// put back as it was with no client traffic.  intensity and led mode are -1 if never set.
+	typedef struct {
+		uint16 ledFrame[16];
+		int ledIntensity;	// 0-15
+		int ledMode;		// as /led_mode: 0 off, 1 test, 2 normal
+		bool tiltState;
+	} OutputState;
+
+	void outputState(OutputState &state) const;
+	// clears the leds and writes back only those lit, then sends whichever of intensity,
+	// led mode and tilt differ from how a device starts up
+	void restoreOutputState(const OutputState &state);
+
+	// leds in osc coordinates: bit n of bitMaps[r] is the led at (column + n, row + r).
+	// leds outside this device are left to the devices they belong to, and those whose bit
+	// is set in keep[r], if given, are left as they are.
+	void oscLedRegionEvent(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep = 0);
+
+	// a packed map of the leds from column, row to column + width, row + height in osc coordinates:
+	// (width + 7) / 8 bytes a row, bit n of byte k in a row being column 8k + n.  rows past the
+	// end of a short map are left as they are.
+	void oscLedMapEvent(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint8 *data, unsigned int size);
+
+	// layers let several clients draw on the same device without wiping out each other's
+	// leds.  each keeps its own leds and is composited over what the plain led messages
+	// drew, lowest z first, recomputing only the rows that changed.  the first layer
+	// starts the compositing and removing the last puts the plain leds back.
+	typedef enum {
+		kLayerBlend_Or,			// lights its leds
+		kLayerBlend_Mask,		// leaves lit only what is lit on the layer too
+		kLayerBlend_Xor,		// flips its leds
+		kLayerBlend_Replace		// shows exactly its leds
+	} LayerBlend;
+
+	enum { kMaxLayers = 8 };
+
+	// sets up layer, creating it if need be; false if there are kMaxLayers already
+	bool oscLayerEvent(int layer, int z, LayerBlend blend);
+	// confines layer to a rectangle in osc coordinates; a width or height of 0 lifts the clip
+	void oscLayerClipEvent(int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height);
+	void oscLayerRemoveEvent(int layer);
+	void oscLayerClearEvent(int layer);
+	// as oscLedRegionEvent, on layer.  a new layer is created with z = layer and kLayerBlend_Or.
+	void oscLayerRegionEvent(int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep = 0);
+
+	// local echo lights leds straight from key presses, on the serial thread before the
+	// presses go out as osc, so the feedback takes no round trip through a client.  the
+	// leds are drawn as by the plain led messages, which can still change them after.
+	typedef enum {
+		kEcho_Momentary,	// lit while held
+		kEcho_Toggle,		// each press flips it
+		kEcho_Radio			// a press lights it and puts out the rest of the rule's rectangle
+	} EchoMode;
+
+	enum { kMaxEchoRules = 8 };
+
+	// adds a rule over a rectangle in osc coordinates, the whole device if width or height is
+	// 0.  a key under several rules follows the latest.  false if there are kMaxEchoRules already.
+	bool oscEchoEvent(EchoMode mode, unsigned int column, unsigned int row, unsigned int width, unsigned int height);
+	void oscEchoClearEvent(void);
+	// applies the rules to a run of key presses with one write for all of them
+	void echoButtonPresses(const uint8 *localColumns, const uint8 *localRows, const uint16 *states, unsigned int count);
+	void echoButtonPress(unsigned int localColumn, unsigned int localRow, bool state);
+
+	// the rectangle of osc coordinates this device's leds fall in
+	void oscLedBounds(unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height) const;
+	// changes whenever a device is created or destroyed or changes its prefix, osc start
+	// column or row, or cable orientation, so anything laid out from the devices can rebuild
+	static unsigned long layoutGeneration(void) { return (unsigned long)_layoutGeneration; }
+	// copies this device's leds into the bitmap, and writes back the ones it covers.  both
+	// expect lockLeds held, across the change to the bitmap as well, so nothing another
+	// thread draws in between is written over.
+	void readOscLedBitmap(LedBitmap &bitmap);
+	void writeOscLedBitmap(const LedBitmap &bitmap);
+	void lockLeds(void);
+	void unlockLeds(void);
+
+	// one server side led animation per device; starting one replaces the last.  the
+	// generation returned tells the steps of this animation from those of earlier ones.
+	unsigned int startLedAnimation(const LedAnimation &animation);
+	void stopLedAnimation(void);
+	// draws the current step of animation generation and moves on.  returns the
+	// milliseconds to the next step, or 0 once the animation has ended or been replaced.
+	unsigned int stepLedAnimation(unsigned int generation);
  
     void oscLedStateChangeEvent(unsigned int column, unsigned int row, bool state);
     void oscLedIntensityChangeEvent(float intensity);
@@ -133,8 +369,8 @@ public:
 	void oscLed_ModeStateChangeEvent(int State); //"led_mode" - a macro of sorts, added with 256x support but supported on 40h also
     void oscLedClearEvent(bool clear);
     void oscShutdownStateChangeEvent(bool shutdownState);
+    // only oscLedFrameEvent's rows come through here; /led_row and /led_col go through LedCanvas
     void oscLedRowStateChangeEvent(unsigned int row, unsigned int numBitMaps, unsigned int bitMaps[]);
-    void oscLedColumnStateChangeEvent(unsigned int column, unsigned int numBitMaps, unsigned int bitMaps[]);
     void oscAdcEnableStateChangeEvent(unsigned int localAdcIndex, bool adcEnableState);
     void oscEncEnableStateChangeEvent(unsigned int localEncIndex, bool encEnableState);
     void oscLedFrameEvent(unsigned int column, unsigned int row, unsigned char bitMaps[8]);
@@ -167,9 +403,20 @@ private:
 
 		bool _state256[16][16];
 
+	uint16 _ledFrame[16];
+	uint16 _baseFrame[16];	// what the led messages drew, under the layers; only kept while there are layers
+	int _ledIntensity;
+	int _ledMode;
+
+	LedAnimation _ledAnimation;
+	unsigned int _ledAnimationGeneration;
+
+	static volatile int32_t _layoutGeneration;
+
     CableOrientation _orientation;
 
     string _oscAddressPatternPrefix;
+    string _oscInputAddressPatterns[kNumInputAddresses];
     unsigned int _oscStartColumn;
     unsigned int _oscStartRow;
 
@@ -180,14 +427,143 @@ private:
     bool _encState[2];
 	
 	bool _testModeState;
+	bool _tiltState;
 	string _lastLedMessage;
 
     CCoreMIDIEndpointRef _midiInputDevice;
     CCoreMIDIEndpointRef _midiOutputDevice;
     unsigned char _midiInputChannel;
     unsigned char _midiOutputChannel;
+    unsigned int _midiLedLatency;
+
+    typedef struct {
+        int pending;        // accelerated steps not sent yet
+        float fraction;     // the part of a step acceleration has added so far
+        long total;
+        HostTime lastStep;
+        HostTime lastSent;
+        bool sendDue;       // a send is scheduled, or waiting for the end of the read
+    } EncoderAccumulator;
+
+    EncoderAccumulator _encoders[kMaxEncoders];
+    unsigned int _encoderInterval;
+    float _encoderAcceleration;
+
+    SensorFilter _sensorFilters[kNumSensors];
+    HostTime _sensorSampleTimes[kNumSensors];
+    InputTimestamps _inputTimestamps;
     CCoreMIDIPortRef _midiInputPortRef;
 
+	enum { kLedFrameBufferSize = 96 };	// 4 quadrant frames + 16 3-byte rows, the most _encodeLedFrame can emit
+	enum { kTransmitBufferSize = SerialTransmitQueue::kQueueSize + kLedFrameBufferSize };
+	enum { kMaxInteractiveLeds = 4 };	// changes of up to this many leds may go as single led messages
+
+	// every write goes out on the device's transmit thread, in the order the queue's
+	// classes and deadlines give
+	SerialTransmitQueue _transmitQueue;
+	uint16 _sentFrame[16];		// the leds as queued or written; bulk sends bring it up to _ledFrame
+	uint16 _staleRows;			// rows the device may not be showing as _sentFrame says, sent whole
+
+	bool _doubleBuffered;
+	uint16 _backFrame[16];		// what the led messages drew since the last swap, while double buffered
+	unsigned int _autoSwapInterval;
+	unsigned int _autoSwapGeneration;
+	HostTime _swapTime;			// when the swap waiting to be written was asked for, or 0
+	SwapCallback _swapCallback;
+	void *_swapCallbackUserData;
+
+	// the frame the led messages draw over
+	const uint16 *_drawFrame(void) const { return _doubleBuffered ? _backFrame : _ledFrame; }
+
+	enum { kLinkBytesPerSecond = 11520 };	// the line rate: 115200 baud, 10 bits a byte
+	enum { kFlowWindow = 250 };				// milliseconds utilisation is measured over
+
+	FlowMode _flowMode;
+	unsigned int _flowCharged;			// credits charged, and those of them given back; both wrap
+	unsigned int _flowRetired;
+	unsigned int _flowReportedCredits;	// as last reported, or fewer once the client spends them
+	FlowLevel _flowReportedLevel;
+	bool _flowWriteFailed;
+	HostTime _flowWindowStart;
+	unsigned int _flowWindowBytes;
+	float _flowUtilisation;
+
+	// the adaptive refresh controller paces bulk led data to kTargetUtilisation of what the
+	// link is measured to carry, so frames wait in _ledFrame, where a later one supersedes
+	// them, rather than in the driver's buffer, where they only add latency
+	enum { kTargetUtilisation = 90 };	// percent
+	enum { kMinSampleBytes = 64 };		// a window with fewer bytes written says nothing of capacity
+
+	HostTime _flowWindowBusy;			// spent in write this window
+	float _linkCapacity;				// bytes per second
+	float _linkThroughput;
+	float _writeTime;					// milliseconds, smoothed
+	float _flushInterval;				// milliseconds, smoothed
+	HostTime _lastFlushTime;
+	HostTime _linkFreeTime;				// when what has been written will have drained at the paced rate
+	unsigned int _interactiveLeds;		// up to kMaxInteractiveLeds, fewer the busier the link
+	FlowCallback _flowCallback;
+	void *_flowCallbackUserData;
+
+	pthread_t _transmitThread;
+	pthread_cond_t _transmitCondition;	// waits on _lock
+	pthread_cond_t _transmitSpaceCondition;	// waits on _lock, for room in the control class
+	bool _transmitTerminate;
+
+	static void *_transmitThreadProc(void *parameter);
+	void _transmit(void);
+
+	int _writeLed(char *data, unsigned int len);
+	int _queueWrite(char *data, unsigned int len);
+	void _appendLedMessage(uint8 *buffer, unsigned int &len, const void *message, unsigned int size);
+	bool _trackLedMessage(const uint8 *data, uint16 frame[16]);
+
+	// the following expect the caller to hold the lock as well
+	void _writeLedFrame(const uint16 frame[16]);
+	void _presentLedFrame(const uint16 frame[16]);
+	unsigned int _encodeLedFrame(const uint16 frame[16], uint8 *buffer);
+	int _queueControl(char *data, unsigned int len);
+	unsigned int _nextTransmission(uint8 *buffer, HostTime &swapTime, HostTime &holdTime);
+	bool _swapLeds(void);
+	void _signalTransmit(void);
+	bool _transmitted(unsigned int len, long written, unsigned int retire, HostTime writeStart);
+	unsigned int _flowCredits(void) const;
+	FlowLevel _flowLevel(HostTime now) const;
+	bool _flowReportDue(HostTime now);
+	void _updateFlowUtilisation(HostTime now);
+
+	typedef struct {
+		int id;
+		int z;
+		LayerBlend blend;
+		uint16 leds[16];	// local coordinates, like _ledFrame
+		uint16 clip[16];	// the leds the layer may change
+	} Layer;
+
+	Layer _layers[kMaxLayers];	// lowest z first
+	unsigned int _numLayers;
+
+	typedef struct {
+		EchoMode mode;
+		uint16 keys[16];	// local coordinates, like _ledFrame
+	} EchoRule;
+
+	EchoRule _echoRules[kMaxEchoRules];		// latest last
+	volatile unsigned int _numEchoRules;	// read unlocked, so presses skip the lock while there are none
+
+	void _buildOscInputAddressPatterns(void);
+
+	// the following expect the caller to hold the lock.  a read of the local frame, a
+	// change to it and the write back all go under one hold, or whatever another thread
+	// draws in between is lost.
+	void _localLedFrame(uint16 frame[16]) const;
+	void _writeLocalLedFrame(const uint16 frame[16]);
+	Layer *_layer(int id, bool create);
+	void _sortLayers(void);
+	void _composeLayers(uint16 rows);
+	uint16 _drawOscRegion(uint16 frame[16], unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep);
+	void _setMIDILedState(uint16 frame[16], unsigned char MIDINoteNumber, bool state);
+
     pthread_mutex_t _lock;
 
     class MonomeXXhDeviceLock {
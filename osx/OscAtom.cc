@@ -18,11 +18,16 @@
  */
 #include "OscAtom.h"
 
+#include <string.h>
+
 OscAtom::OscAtom()
 {
     _type = kOscAtomTypeNullAtom;
     _i = 0;
     _f = 0.f;
+    _b = 0;
+    _bSize = 0;
+    _t = 0;
 }
 
 OscAtom::OscAtom(int value)
@@ -30,6 +35,9 @@ OscAtom::OscAtom(int value)
     _type = kOscAtomTypeInt;
     _i = value;
     _f = 0.f;
+    _b = 0;
+    _bSize = 0;
+    _t = 0;
 }
 
 OscAtom::OscAtom(float value)
@@ -37,6 +45,9 @@ OscAtom::OscAtom(float value)
     _type = kOscAtomTypeFloat;
     _f = value;
     _i = 0;
+    _b = 0;
+    _bSize = 0;
+    _t = 0;
 }
 
 OscAtom::OscAtom(const string &value)
@@ -45,6 +56,9 @@ OscAtom::OscAtom(const string &value)
     _s = value;
     _i = 0;
     _f = 0.f;
+    _b = 0;
+    _bSize = 0;
+    _t = 0;
 }
 
 OscAtom::OscAtom(const char *value)
@@ -53,6 +67,19 @@ OscAtom::OscAtom(const char *value)
     _s = string(value);
     _i = 0;
     _f = 0.f;
+    _b = 0;
+    _bSize = 0;
+    _t = 0;
+}
+
+OscAtom::OscAtom(const void *data, unsigned int size)
+{
+    _type = kOscAtomTypeBlob;
+    _b = data;
+    _bSize = size;
+    _i = 0;
+    _f = 0.f;
+    _t = 0;
 }
 
 OscAtom::~OscAtom()
@@ -78,6 +105,14 @@ OscAtom::setValue(OscAtom& atom)
         case kOscAtomTypeString:
             setValue(atom.valueAsString());
             break;
+
+        case kOscAtomTypeBlob:
+            setValue(atom.blobData(), atom.blobSize());
+            break;
+
+        case kOscAtomTypeTimeTag:
+            setTimeTag(atom.valueAsTimeTag());
+            break;
         }
     }
 }
@@ -110,6 +145,21 @@ OscAtom::setValue(const char *value)
     _s = string(value);
 }
 
+void 
+OscAtom::setValue(const void *data, unsigned int size)
+{
+    _type = kOscAtomTypeBlob;
+    _b = data;
+    _bSize = size;
+}
+
+void 
+OscAtom::setTimeTag(uint64_t value)
+{
+    _type = kOscAtomTypeTimeTag;
+    _t = value;
+}
+
 void 
 OscAtom::setNull(void)
 {
@@ -173,6 +223,36 @@ OscAtom::valueAsCString(void) const
     return _s.c_str();
 }
 
+bool 
+OscAtom::isBlob(void) const
+{
+    return _type == kOscAtomTypeBlob;
+}
+
+bool 
+OscAtom::isTimeTag(void) const
+{
+    return _type == kOscAtomTypeTimeTag;
+}
+
+uint64_t 
+OscAtom::valueAsTimeTag(void) const
+{
+    return _t;
+}
+
+const void *
+OscAtom::blobData(void) const
+{
+    return _b;
+}
+
+unsigned int 
+OscAtom::blobSize(void) const
+{
+    return _bSize;
+}
+
 bool 
 OscAtom::isNullAtom(void)
 {
@@ -197,6 +277,12 @@ bool operator ==(const OscAtom& atom1, const OscAtom& atom2)
     case OscAtom::kOscAtomTypeString:
         return atom1.valueAsString() == atom2.valueAsString();
 
+    case OscAtom::kOscAtomTypeBlob:
+        return atom1.blobSize() == atom2.blobSize() && memcmp(atom1.blobData(), atom2.blobData(), atom1.blobSize()) == 0;
+
+    case OscAtom::kOscAtomTypeTimeTag:
+        return atom1.valueAsTimeTag() == atom2.valueAsTimeTag();
+
     default:
         return false;
     }
@@ -221,6 +307,12 @@ operator !=(const OscAtom& atom1, const OscAtom& atom2)
     case OscAtom::kOscAtomTypeString:
         return atom1.valueAsString() != atom2.valueAsString();
 
+    case OscAtom::kOscAtomTypeBlob:
+        return atom1.blobSize() != atom2.blobSize() || memcmp(atom1.blobData(), atom2.blobData(), atom1.blobSize()) != 0;
+
+    case OscAtom::kOscAtomTypeTimeTag:
+        return atom1.valueAsTimeTag() != atom2.valueAsTimeTag();
+
     default:
         return true;
     }
@@ -19,6 +19,7 @@
 #ifndef __OSCATOM_H__
 #define __OSCATOM_H__
 
+#include <stdint.h>
 #include <string>
 using namespace std;
 
@@ -39,6 +40,7 @@ public:
     OscAtom(float value);
     OscAtom(const string &value);
     OscAtom(const char *value);
+    OscAtom(const void *data, unsigned int size);
     ~OscAtom();
 
     void setValue(OscAtom& atom);
@@ -46,17 +48,26 @@ public:
     void setValue(float value);
     void setValue(const string &value);
     void setValue(const char *value);
+    void setValue(const void *data, unsigned int size);
     void setNull(void);
+    void setTimeTag(uint64_t value);    // an ntp time tag; no constructor, it would be ambiguous with int
     
     int type(void) const;
     bool isInt(void) const;
     bool isFloat(void) const;
     bool isString(void) const;
+    bool isBlob(void) const;
+    bool isTimeTag(void) const;
 
     int valueAsInt(void) const;
     float valueAsFloat(void) const;
     const string& valueAsString(void) const;
     const char *valueAsCString(void) const;
+    uint64_t valueAsTimeTag(void) const;
+
+    // blob atoms point into the received packet and are only valid while it is being handled
+    const void *blobData(void) const;
+    unsigned int blobSize(void) const;
 
     bool isNullAtom(void);
 
@@ -68,7 +79,9 @@ public:
         kOscAtomTypeNullAtom,
         kOscAtomTypeInt,
         kOscAtomTypeFloat,
-        kOscAtomTypeString
+        kOscAtomTypeString,
+        kOscAtomTypeBlob,
+        kOscAtomTypeTimeTag
     };
 
 private:
@@ -76,6 +89,9 @@ private:
     int _i;
     float _f;
     string _s;
+    const void *_b;
+    unsigned int _bSize;
+    uint64_t _t;
 };
 
 #endif
@@ -28,6 +28,7 @@ extern "C" void OscControllerLoErrorHandler(int num, const char *msg, const char
 //static string _oscErrWhere;
 
 OscController::OscController()
+    : _realtime(RealtimeThread::kThreadClass_Osc)
 {
     _hostAddresses = new hash_map<string, OscHostAddress *, hash<string>, oscHostAddressEqstr>;
     _oscMessageHandlers = new hash_map<string, OscMessageHandlerContext *, hash<string>, oscHostAddressEqstr>;
@@ -127,80 +128,126 @@ OscHostAddress *OscController::_getOscHostAddress(const string& hostString)
     return hostAddress;
 }
 
+static void _addOscAtom(lo_message message, const OscAtom &atom)
+{
+    switch (atom.type()) {
+    case OscAtom::kOscAtomTypeInt:
+        lo_message_add_int32(message, atom.valueAsInt());
+        break;
+
+    case OscAtom::kOscAtomTypeFloat:
+        lo_message_add_float(message, atom.valueAsFloat());
+        break;
+
+    case OscAtom::kOscAtomTypeString:
+        lo_message_add_string(message, atom.valueAsString().c_str());
+        break;
+
+    case OscAtom::kOscAtomTypeTimeTag:
+        {
+            lo_timetag time;
+
+            time.sec = (uint32_t)(atom.valueAsTimeTag() >> 32);
+            time.frac = (uint32_t)atom.valueAsTimeTag();
+            lo_message_add_timetag(message, time);
+        }
+        break;
+
+    default:
+        throw OscException(OscException::kOscExceptionTypeInvalidOscAtomType, 0);
+    }
+}
+
 void OscController::send(OscHostRef hostRef, const string& addressPattern, list<OscAtom *> *atoms)
+{
+    send(&hostRef, 1, addressPattern, atoms);
+}
+
+void OscController::send(OscHostRef hostRef, const string& addressPattern, list<OscAtom> *atoms)
+{
+    OscHostAddress *hostAddress;
+    lo_message message;
+    list<OscAtom>::iterator i;
+
+    if (hostRef == 0 || addressPattern.length() == 0)
+        return;
+
+    hostAddress = (OscHostAddress *)hostRef;
+    message = lo_message_new();
+
+    for (i = atoms->begin(); i != atoms->end(); ++i)
+        _addOscAtom(message, *i);
+
+    lo_send_message(hostAddress->getHostAddress(), addressPattern.c_str(), message);
+    lo_message_free(message);
+}
+
+void OscController::send(OscHostRef hostRef, const string& addressPattern, list<OscAtom *> *atoms, uint64_t timeTag)
+{
+    send(&hostRef, 1, addressPattern, atoms, timeTag);
+}
+
+void OscController::send(const OscHostRef *hostRefs, unsigned int count, const string& addressPattern, list<OscAtom *> *atoms)
 {
     OscHostAddress *hostAddress;
     lo_message message;
     list<OscAtom *>::iterator i;
     OscAtom *atom;
+    unsigned int host;
     int error;
 
-    if (hostRef == 0 || addressPattern.length() == 0)
+    if (count == 0 || addressPattern.length() == 0)
         return;
 
-    hostAddress = (OscHostAddress *)hostRef;
     message = lo_message_new();
 
     for (i = atoms->begin(); i != atoms->end(); ++i) {
         atom = *i;
+        _addOscAtom(message, *atom);
+    }
 
-        switch (atom->type()) {
-        case OscAtom::kOscAtomTypeInt:
-            lo_message_add_int32(message, atom->valueAsInt());
-            break;
-
-        case OscAtom::kOscAtomTypeFloat:
-            lo_message_add_float(message, atom->valueAsFloat());
-            break;
-
-        case OscAtom::kOscAtomTypeString:
-            lo_message_add_string(message, atom->valueAsString().c_str());
-            break;
+    for (host = 0; host < count; host++) {
+        if ((hostAddress = (OscHostAddress *)hostRefs[host]) == 0)
+            continue;
 
-        default:
-            throw OscException(OscException::kOscExceptionTypeInvalidOscAtomType, 0);
-        }
+        error = lo_send_message(hostAddress->getHostAddress(), addressPattern.c_str(), message);
+        //cout << error << endl;
+        //cout << strerror(lo_address_errno(hostAddress->getHostAddress())) << endl;
     }
 
-    error = lo_send_message(hostAddress->getHostAddress(), addressPattern.c_str(), message);
-    //cout << error << endl;
-    //cout << strerror(lo_address_errno(hostAddress->getHostAddress())) << endl;
     //lo_message_pp(message);
     lo_message_free(message);
 }
 
-void OscController::send(OscHostRef hostRef, const string& addressPattern, list<OscAtom> *atoms)
+void OscController::send(const OscHostRef *hostRefs, unsigned int count, const string& addressPattern, list<OscAtom *> *atoms, uint64_t timeTag)
 {
     OscHostAddress *hostAddress;
     lo_message message;
-    list<OscAtom>::iterator i;
+    lo_bundle bundle;
+    lo_timetag time;
+    list<OscAtom *>::iterator i;
+    unsigned int host;
 
-    if (hostRef == 0 || addressPattern.length() == 0)
+    if (count == 0 || addressPattern.length() == 0)
         return;
 
-    hostAddress = (OscHostAddress *)hostRef;
     message = lo_message_new();
 
-    for (i = atoms->begin(); i != atoms->end(); ++i) {
-        switch ((*i).type()) {
-        case OscAtom::kOscAtomTypeInt:
-            lo_message_add_int32(message, (*i).valueAsInt());
-            break;
+    for (i = atoms->begin(); i != atoms->end(); ++i)
+        _addOscAtom(message, **i);
 
-        case OscAtom::kOscAtomTypeFloat:
-            lo_message_add_float(message, (*i).valueAsFloat());
-            break;
+    time.sec = (uint32_t)(timeTag >> 32);
+    time.frac = (uint32_t)timeTag;
 
-        case OscAtom::kOscAtomTypeString:
-            lo_message_add_string(message, (*i).valueAsString().c_str());
-            break;
+    bundle = lo_bundle_new(time);
+    lo_bundle_add_message(bundle, addressPattern.c_str(), message);
 
-        default:
-            throw OscException(OscException::kOscExceptionTypeInvalidOscAtomType, 0);
-        }
+    for (host = 0; host < count; host++) {
+        if ((hostAddress = (OscHostAddress *)hostRefs[host]) != 0)
+            lo_send_bundle(hostAddress->getHostAddress(), bundle);
     }
 
-    lo_send_message(hostAddress->getHostAddress(), addressPattern.c_str(), message);
+    lo_bundle_free(bundle);
     lo_message_free(message);
 }
 
@@ -299,7 +346,7 @@ void OscController::removeOscMessageHandler(const string& addressPattern)
 
 /** IMPORTANT: since this method allocates memory for the atoms that get passed the user-defined callback and
  *             deletes these atoms before returning, the user must handle the message immediately or copy the list
- *             of atoms if he wants to defer handling.  also, for string atoms, the atom's value just points into argv.
+ *             of atoms if he wants to defer handling.  also, for string and blob atoms, the atom's value just points into argv.
  *             no way to know what will be there after this method returns.  
  *             this should be documented somewhere other than here.
  */
@@ -312,6 +359,8 @@ void OscController::loMethodHandler(string path, const char *types, lo_arg **arg
     OscAtom *currentAtom;
 
     (void) msg;
+
+    _realtime.update();
     
     do {
         for (i = 0; i < argc; i++) {
@@ -330,6 +379,11 @@ void OscController::loMethodHandler(string path, const char *types, lo_arg **arg
                 currentAtom = new OscAtom(&(argv[i]->s));
                 atoms.push_back(currentAtom);
                 break;
+
+            case 'b':
+                currentAtom = new OscAtom(lo_blob_dataptr((lo_blob)argv[i]), lo_blob_datasize((lo_blob)argv[i]));
+                atoms.push_back(currentAtom);
+                break;
             }
         }
         
@@ -22,6 +22,7 @@
 #include "OscAtom.h"
 #include "OscContext.h"
 #include "OscHostAddress.h"
+#include "RealtimeThread.h"
 #include <lo/lo.h>
 #include <string>
 #include <list>
@@ -68,6 +69,11 @@ public:
 
     void send(OscHostRef hostRef, const string& addressPattern, list<OscAtom *> *atoms);
     void send(OscHostRef hostRef, const string& addressPattern, list<OscAtom> *atoms);
+    // sends the message alone in a bundle, with timeTag (an ntp time tag) as the bundle's time
+    void send(OscHostRef hostRef, const string& addressPattern, list<OscAtom *> *atoms, uint64_t timeTag);
+    // send the same message to count hosts, building it only once
+    void send(const OscHostRef *hostRefs, unsigned int count, const string& addressPattern, list<OscAtom *> *atoms);
+    void send(const OscHostRef *hostRefs, unsigned int count, const string& addressPattern, list<OscAtom *> *atoms, uint64_t timeTag);
 
     void startListening(const string& port);
     void stopListening(void);
@@ -85,6 +91,7 @@ private:
     hash_map<string, OscMessageHandlerContext *, hash<string>, oscHostAddressEqstr> *_oscMessageHandlers;
     vector<OscMessageHandlerContext> _oscGenericMessageHandlers;
     lo_server_thread _oscServerThread;
+    RealtimeThread _realtime;
 };
 
 #endif
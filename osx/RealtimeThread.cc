@@ -0,0 +1,182 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "RealtimeThread.h"
+
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <libkern/OSAtomic.h>
+#include <sys/mman.h>
+
+#ifdef DEBUG_PRINT
+#include <stdlib.h>
+#include <new>
+#define REALTIME_THREAD_COUNT_ALLOCATIONS
+#endif
+
+typedef struct {
+    int policy;
+    int belowMaximum;
+} RealtimeSchedule;
+
+static const RealtimeSchedule kRealtimeSchedule[RealtimeThread::kNumThreadClasses] = {
+    { SCHED_FIFO, 0 },  // reader
+    { SCHED_RR, 1 },    // osc
+    { SCHED_RR, 1 },    // midi
+    { SCHED_FIFO, 0 },  // transmit
+    { SCHED_RR, 0 }     // scheduler
+};
+
+volatile int32_t RealtimeThread::_generation = 0;
+bool RealtimeThread::_enabled = false;
+unsigned int RealtimeThread::_affinity[RealtimeThread::kNumThreadClasses] = { 0, 0, 0, 0, 0 };
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+static pthread_key_t _onRealtimeThreadKey;
+static pthread_once_t _onRealtimeThreadKeyOnce = PTHREAD_ONCE_INIT;
+static bool _onRealtimeThreadKeyCreated = false;
+static volatile int32_t _realtimeAllocations = 0;
+
+static void _createOnRealtimeThreadKey(void)
+{
+    _onRealtimeThreadKeyCreated = (pthread_key_create(&_onRealtimeThreadKey, NULL) == 0);
+}
+
+static void *_countedAllocation(size_t size)
+{
+    void *p;
+
+    if (_onRealtimeThreadKeyCreated && pthread_getspecific(_onRealtimeThreadKey) != NULL)
+        OSAtomicIncrement32Barrier(&_realtimeAllocations);
+
+    p = malloc(size != 0 ? size : 1);
+    if (p == 0)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new(size_t size) throw (std::bad_alloc) { return _countedAllocation(size); }
+void *operator new[](size_t size) throw (std::bad_alloc) { return _countedAllocation(size); }
+void operator delete(void *p) throw () { free(p); }
+void operator delete[](void *p) throw () { free(p); }
+#endif
+
+
+RealtimeThread::RealtimeThread(ThreadClass threadClass)
+{
+    _threadClass = threadClass;
+    _hasThread = false;
+    _appliedGeneration = -1;
+    _realtime = false;
+    _defaultPolicy = SCHED_OTHER;
+    _defaultParam.sched_priority = 0;
+}
+
+void 
+RealtimeThread::setEnabled(bool enabled)
+{
+    if (enabled == _enabled)
+        return;
+
+    // needs the memory lock limit raised to do anything; without it the threads still go real time
+    if (enabled)
+        mlockall(MCL_CURRENT | MCL_FUTURE);
+    else
+        munlockall();
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+    pthread_once(&_onRealtimeThreadKeyOnce, _createOnRealtimeThreadKey);
+#endif
+
+    _enabled = enabled;
+    OSAtomicIncrement32Barrier(&_generation);
+}
+
+void 
+RealtimeThread::setAffinity(ThreadClass threadClass, unsigned int tag)
+{
+    if (threadClass < 0 || threadClass >= kNumThreadClasses)
+        return;
+
+    _affinity[threadClass] = tag;
+    OSAtomicIncrement32Barrier(&_generation);
+}
+
+unsigned int 
+RealtimeThread::affinity(ThreadClass threadClass)
+{
+    if (threadClass < 0 || threadClass >= kNumThreadClasses)
+        return 0;
+
+    return _affinity[threadClass];
+}
+
+unsigned long 
+RealtimeThread::allocationCount(void)
+{
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+    return (unsigned long)_realtimeAllocations;
+#else
+    return 0;
+#endif
+}
+
+void 
+RealtimeThread::_apply(void)
+{
+    pthread_t thread = pthread_self();
+    int32_t generation = _generation;
+    struct sched_param param;
+    thread_affinity_policy_data_t affinityPolicy;
+
+    if (!_hasThread || !pthread_equal(thread, _thread)) {
+        // first call, or whatever owns this has started a new thread since
+        _thread = thread;
+        _hasThread = true;
+        _realtime = false;
+        pthread_getschedparam(thread, &_defaultPolicy, &_defaultParam);
+    }
+
+    _appliedGeneration = generation;
+
+    if (!_enabled && !_realtime)
+        return;
+
+    if (_enabled) {
+        const RealtimeSchedule& schedule = kRealtimeSchedule[_threadClass];
+
+        param.sched_priority = sched_get_priority_max(schedule.policy) - schedule.belowMaximum;
+        pthread_setschedparam(thread, schedule.policy, &param);
+        affinityPolicy.affinity_tag = _affinity[_threadClass];
+        _realtime = true;
+    }
+    else {
+        pthread_setschedparam(thread, _defaultPolicy, &_defaultParam);
+        affinityPolicy.affinity_tag = THREAD_AFFINITY_TAG_NULL;
+        _realtime = false;
+    }
+
+    thread_policy_set(pthread_mach_thread_np(thread), THREAD_AFFINITY_POLICY, 
+                      (thread_policy_t)&affinityPolicy, THREAD_AFFINITY_POLICY_COUNT);
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+    if (_onRealtimeThreadKeyCreated)
+        pthread_setspecific(_onRealtimeThreadKey, _realtime ? (void *)1 : NULL);
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __RealtimeThread_h__
+#define __RealtimeThread_h__
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+// opt-in real time scheduling for the threads on the input and output paths.  each keeps a
+// RealtimeThread and calls update() from its own loop; the settings are process wide,
+// so update() only does any work the first time round after one of them changes.
+class RealtimeThread
+{
+public:
+    typedef enum {
+        kThreadClass_Reader,    // the serial device reader
+        kThreadClass_Osc,       // the osc listener
+        kThreadClass_Midi,      // midi input; core midi runs its own read thread, so nothing here yet
+        kThreadClass_Transmit,  // the serial device transmit threads, one for each device
+        kThreadClass_Scheduler, // the led and input event schedulers
+        kNumThreadClasses
+    } ThreadClass;
+
+public:
+    RealtimeThread(ThreadClass threadClass);
+
+    // applies the current settings to the calling thread if they changed since the last call
+    void update(void)
+    {
+        if (_generation != _appliedGeneration || !_hasThread || !pthread_equal(pthread_self(), _thread))
+            _apply();
+    }
+
+    // runs the reader, transmit, scheduler, osc and midi threads fifo or round robin near the
+    // top priority and locks the process' pages in memory while on.  the observer's scheduler
+    // only feeds the interface, so it is left at its low priority.
+    static void setEnabled(bool enabled);
+    static bool enabled(void) { return _enabled; }
+
+    // an affinity tag for a thread class; threads with the same tag are kept on processors
+    // that share a cache.  os x has no hard processor masks, so this is a hint.  0 clears it.
+    static void setAffinity(ThreadClass threadClass, unsigned int tag);
+    static unsigned int affinity(ThreadClass threadClass);
+
+    // in debug builds, the number of heap allocations made on a thread while it ran real time
+    static unsigned long allocationCount(void);
+
+private:
+    void _apply(void);
+
+private:
+    ThreadClass _threadClass;
+    pthread_t _thread;
+    bool _hasThread;
+    int32_t _appliedGeneration;
+    bool _realtime;
+    int _defaultPolicy;
+    struct sched_param _defaultParam;
+
+    static volatile int32_t _generation;
+    static bool _enabled;
+    static unsigned int _affinity[kNumThreadClasses];
+};
+
+#endif // __RealtimeThread_h__
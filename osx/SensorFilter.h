@@ -0,0 +1,88 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __SensorFilter_h__
+#define __SensorFilter_h__
+
+#include "EventScheduler.h"
+
+// decimates one analog input before it is sent: smooths the raw samples, drops changes
+// smaller than a deadband or too small to show at the output's resolution, and holds
+// back changes that come faster than a minimum interval.  the newest held value always
+// goes out once the interval is up, so the last sent value never goes stale.
+class SensorFilter
+{
+public:
+    typedef enum {
+        kSmoothing_None,
+        kSmoothing_OnePole,        // amount is how much of each new sample gets through, 0-1
+        kSmoothing_Median        // amount is the window, up to kMaxMedianWindow samples
+    } Smoothing;
+
+    enum { kMaxMedianWindow = 7 };
+
+public:
+    SensorFilter(void);
+
+    // fullScale is the largest raw value, steps how many distinct values the input reports
+    void setRange(float fullScale, unsigned int steps);
+
+    void setDeadband(float deadband);    // fraction of full scale a value must move to be sent
+    float deadband(void) const;
+    void setInterval(unsigned int milliseconds);
+    unsigned int interval(void) const;
+    void setSmoothing(Smoothing smoothing, float amount);
+    Smoothing smoothing(void) const;
+    float smoothingAmount(void) const;
+
+    // feeds one raw sample.  returns true if value should be sent now.  if a change is held
+    // back, retryTime is when to call retry(), otherwise 0.  outputSteps is the resolution
+    // the value is sent at, 0 for the input's own.
+    bool process(float sample, unsigned int outputSteps, HostTime time, float &value, HostTime &retryTime);
+    bool retry(HostTime time, float &value, HostTime &retryTime);
+
+private:
+    float _smooth(float sample);
+
+private:
+    float _fullScale;
+    unsigned int _steps;
+
+    float _deadband;
+    unsigned int _interval;
+    Smoothing _smoothing;
+    float _amount;
+
+    float _history[kMaxMedianWindow];
+    unsigned int _historyLength;
+    unsigned int _historyIndex;
+    float _smoothed;
+    bool _primed;
+
+    bool _sent;
+    float _lastSent;
+    long _lastStep;
+    HostTime _lastSentTime;
+
+    bool _holding;
+    float _held;
+    long _heldStep;
+    bool _retryScheduled;
+};
+
+#endif // __SensorFilter_h__
@@ -30,6 +30,7 @@
 #include <sys/select.h>
 #include <sys/time.h>
 #include <time.h>
+#include <mach/mach_time.h>
 #include <iostream>
 #include <sstream>
 using namespace std;
@@ -62,6 +63,7 @@ SerialDevice::SerialDevice(const string& bsdFilePath)
 
     _bsdFilePath = bsdFilePath;
     _fileDescriptor = kSerialDeviceErrReturn;
+    _readTime = 0;
     _unexpectedDeviceRemovalFlag = false;
 
 	do {
@@ -200,7 +202,12 @@ SerialDevice::read(char *buffer, size_t len)
     if (_fileDescriptor == kSerialDeviceErrReturn)
         return -1;
 
-    return ::read(_fileDescriptor, buffer, len);
+    ssize_t result = ::read(_fileDescriptor, buffer, len);
+
+    if (result > 0)
+        _readTime = mach_absolute_time();
+
+    return result;
 }
 
 void SerialDevice::flush(void)
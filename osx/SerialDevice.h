@@ -22,6 +22,7 @@
 #include <termios.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <string>
 using namespace std;
@@ -48,6 +49,9 @@ public:
     ssize_t read(char *buffer, size_t len);
     void flush(void);
 
+    // host time (mach_absolute_time) at which the last successful read returned
+    uint64_t readTime(void) const;
+
     const string& bsdFilePath(void) const;
     int fileDescriptor(void) const;
 
@@ -58,6 +62,7 @@ private:
     string _bsdFilePath;
     int _fileDescriptor;
     struct termios _originalTTYAttrs;
+    uint64_t _readTime;
 
     bool _unexpectedDeviceRemovalFlag;  // We set this flag if the device is unexpectedly removed so we don't call
                                         // tcdrain in the destructor with unpleasant consequences.
@@ -75,6 +80,12 @@ SerialDevice::fileDescriptor(void) const
     return _fileDescriptor;
 }
 
+inline uint64_t 
+SerialDevice::readTime(void) const
+{
+    return _readTime;
+}
+
 inline void
 SerialDevice::setUnexpectedDeviceRemovalFlag(bool flag)
 {
@@ -0,0 +1,77 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef __SerialTransmitQueue_h__
+#define __SerialTransmitQueue_h__
+
+#include "EventScheduler.h"
+#include "types.h"
+
+// what a device has waiting to be written, in three classes.  each class may keep its
+// oldest message waiting for a budget of time, and whichever class is nearest its deadline
+// goes next, so a led answering a press gets ahead of a redraw that is already waiting
+// without the redraw ever being starved.  bulk led data is not queued as bytes: the device
+// marks its frame dirty and encodes the difference when bulk's turn comes, so a later
+// frame supersedes an earlier one still waiting.  the owner's lock guards it.
+class SerialTransmitQueue
+{
+public:
+    typedef enum {
+        kClass_Interactive,     // single leds, such as the feedback to a press
+        kClass_Control,         // intensity, modes and the other settings
+        kClass_Bulk,            // frames, rows and columns
+        kNumClasses
+    } Class;
+
+    enum { kQueueSize = 64 };   // bytes held for each of the interactive and control classes
+
+public:
+    SerialTransmitQueue(void);
+
+    // queues a message of the interactive or control class.  false if it doesn't fit.
+    bool push(Class c, const void *data, unsigned int len, HostTime time);
+    unsigned int space(Class c) const { return kQueueSize - _queues[c].length; }
+
+    // bulk data is waiting.  its deadline runs from the first mark since it last went out,
+    // or is time itself when urgent, for a swap that should show as soon as it can.
+    void markBulk(HostTime time, bool urgent = false);
+
+    // the class to send next, or kNumClasses if nothing is waiting.  without bulk, only
+    // the queued classes are considered, for while bulk data is being held back.
+    Class next(bool bulk = true) const;
+    // something waiting has already missed its deadline: the link is behind the budgets
+    bool overdue(HostTime now) const;
+
+    // copies out everything waiting in the interactive or control class, returning its length
+    unsigned int take(Class c, uint8 *buffer);
+    // the bulk data has been encoded
+    void takeBulk(void) { _bulkPending = false; }
+
+private:
+    typedef struct {
+        uint8 data[kQueueSize];
+        unsigned int length;
+        HostTime deadline;      // of the oldest message waiting
+    } Queue;
+
+    Queue _queues[kClass_Bulk]; // interactive and control
+    bool _bulkPending;
+    HostTime _bulkDeadline;
+};
+
+#endif // __SerialTransmitQueue_h__
@@ -50,9 +50,7 @@ typedef enum {
     kMessage_256_NumTypes //15
 } e256MessageTypes;
 
-//this doesn't seem to ever be used -- xkn 07.21.2010
-const int kMessageSize_256[15] = {2,2,2,2, 2,2,3,3,
-								  9,1,1,1, 1,1,2};
+// message lengths, for both directions, are in MessageProtocol.h
 
 
 typedef struct {
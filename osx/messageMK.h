@@ -67,9 +67,7 @@ typedef enum {
 	kMessage_AuxOut_NumTypes
 } eMkMessage_AuxOut_Types;
 	
-//as noted in message256.h, this doesn't seem to be used anywhere...
-const int kMessageSize_mk[15] = {2,2,2,2, 2,2,3,3,
-								  9,1,1,1, 1,3,3};
+// message lengths, for both directions, are in MessageProtocol.h
 
 
 typedef struct {
@@ -30,10 +30,13 @@
 
 #include "serial/message.h"
 #include "serial/message256.h"
+#include "serial/MessageProtocol.h"
 #include "osc/osc.h"
 #include "midi/ShortMsg.h"
+#include "RealtimeThread.h"
 
 #include <exception>
+#include <climits>
 #include <sstream>
 
 #ifdef DEBUG_PRINT
@@ -46,10 +49,134 @@ using namespace std;
 using namespace osc;
 
 
+static string _intToString(int i)
+{
+	ostringstream oss;
+	oss << i;
+
+	return oss.str();
+}
+
+static bool _inputTimestampsFromString(const string &name, MonomeXXhDevice::InputTimestamps &timestamps)
+{
+	if (name == kOscInputTimestampsOff)
+		timestamps = MonomeXXhDevice::kInputTimestamps_Off;
+	else if (name == kOscInputTimestampsBundle)
+		timestamps = MonomeXXhDevice::kInputTimestamps_Bundle;
+	else if (name == kOscInputTimestampsArgument)
+		timestamps = MonomeXXhDevice::kInputTimestamps_Argument;
+	else
+		return false;
+
+	return true;
+}
+
+static bool _flowModeFromString(const string &name, MonomeXXhDevice::FlowMode &mode)
+{
+	if (name == kOscFlowOff)
+		mode = MonomeXXhDevice::kFlow_Off;
+	else if (name == kOscFlowReport)
+		mode = MonomeXXhDevice::kFlow_Report;
+	else if (name == kOscFlowCredit)
+		mode = MonomeXXhDevice::kFlow_Credit;
+	else
+		return false;
+
+	return true;
+}
+
+static bool _realtimeThreadClassFromString(const string &name, RealtimeThread::ThreadClass &threadClass)
+{
+	if (name == kOscRealtimeThreadReader)
+		threadClass = RealtimeThread::kThreadClass_Reader;
+	else if (name == kOscRealtimeThreadOsc)
+		threadClass = RealtimeThread::kThreadClass_Osc;
+	else if (name == kOscRealtimeThreadMidi)
+		threadClass = RealtimeThread::kThreadClass_Midi;
+	else if (name == kOscRealtimeThreadTransmit)
+		threadClass = RealtimeThread::kThreadClass_Transmit;
+	else if (name == kOscRealtimeThreadScheduler)
+		threadClass = RealtimeThread::kThreadClass_Scheduler;
+	else
+		return false;
+
+	return true;
+}
+
+static bool _layerBlendFromString(const string &name, MonomeXXhDevice::LayerBlend &blend)
+{
+	if (name == kOscLayerBlendOr)
+		blend = MonomeXXhDevice::kLayerBlend_Or;
+	else if (name == kOscLayerBlendMask)
+		blend = MonomeXXhDevice::kLayerBlend_Mask;
+	else if (name == kOscLayerBlendXor)
+		blend = MonomeXXhDevice::kLayerBlend_Xor;
+	else if (name == kOscLayerBlendReplace)
+		blend = MonomeXXhDevice::kLayerBlend_Replace;
+	else
+		return false;
+
+	return true;
+}
+
+// a comma separated list of press, enc, adc and tilt, or all
+static bool _inputEventsFromString(const string &names, unsigned int &events)
+{
+	string::size_type start = 0, end;
+
+	events = 0;
+
+	do {
+		end = names.find(',', start);
+		string name = names.substr(start, end == string::npos ? string::npos : end - start);
+
+		if (name == kOscInputEventAll)
+			events |= InputSubscriptions::kAllEvents;
+		else if (name == kOscInputEventPress)
+			events |= 1 << InputSubscriptions::kEvent_Press;
+		else if (name == kOscInputEventEnc)
+			events |= 1 << InputSubscriptions::kEvent_Enc;
+		else if (name == kOscInputEventAdc)
+			events |= 1 << InputSubscriptions::kEvent_Adc;
+		else if (name == kOscInputEventTilt)
+			events |= 1 << InputSubscriptions::kEvent_Tilt;
+		else
+			return false;
+
+		start = end + 1;
+	} while (end != string::npos);
+
+	return true;
+}
+
+// splits prefix/layer/<id> into the prefix and the layer id
+static bool _layerFromAddressPatternPrefix(string &prefix, int &layer)
+{
+	string::size_type i = prefix.rfind(kOscDefaultAddrPatternLayerInfix);
+
+	if (i == string::npos)
+		return false;
+
+	string id = prefix.substr(i + strlen(kOscDefaultAddrPatternLayerInfix));
+
+	if (id.empty() || id.size() > 4 || id.find_first_not_of("0123456789") != string::npos)
+		return false;
+
+	layer = atoi(id.c_str());
+	prefix.erase(i);
+
+	return true;
+}
+
 extern "C" int _ApplicationController_SerialDeviceMessageReceivedCallback(SerialDevice *device, char *data, size_t len, void *userData)
 {
     ApplicationController *SELF = (ApplicationController *)userData;
-    return SELF->handleSerialDeviceMessageReceivedEvent(static_cast<MonomeXXhDevice *>(device), data, len);
+    int result = SELF->handleSerialDeviceMessageReceivedEvent(static_cast<MonomeXXhDevice *>(device), data, len);
+
+	// MIDI generated by the whole burst goes to the drivers in one call per endpoint
+	SELF->coreMIDI()->flushOutput();
+
+	return result;
 }
 
 extern "C" void _ApplicationController_OSCMessageReceivedCallback(const osc::ReceivedMessage &msg, void *userData)
@@ -58,16 +185,66 @@ extern "C" void _ApplicationController_OSCMessageReceivedCallback(const osc::Rec
     SELF->handleOscMessage(msg);
 }
 
-extern "C" void _ApplicationController_MIDIReceivedCallback(DWORD msg, CCoreMIDIEndpointRef source, void* userData)
+extern "C" void _ApplicationController_MIDIReceivedCallback(DWORD msg, DWORD timeStamp, CCoreMIDIEndpointRef source, void* userData)
 {
     ApplicationController *SELF = (ApplicationController *)userData;
-    SELF->handleMIDIReceived(msg, source);
+    SELF->handleMIDIReceived(msg, ((CCoreMIDIReceive *)source)->performanceCounterForTimeStamp(timeStamp), source);
 }
 
+extern "C" void _ApplicationController_MIDISysExReceivedCallback(const unsigned char *data, DWORD length, DWORD timeStamp, CCoreMIDIEndpointRef source, void* userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleMIDISysExReceived(data, length, ((CCoreMIDIReceive *)source)->performanceCounterForTimeStamp(timeStamp), source);
+}
+
+extern "C" void _ApplicationController_EncoderSendCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleEncoderSendEvent((MonomeXXhDevice *)target, *(const unsigned int *)data);
+}
+
+extern "C" void _ApplicationController_SensorRetryCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleSensorRetryEvent((MonomeXXhDevice *)target, *(const unsigned int *)data);
+}
+
+extern "C" void _ApplicationController_MIDILedEventCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleScheduledMIDILedEvent((MonomeXXhDevice *)target, data, length);
+}
+
+extern "C" void _ApplicationController_LedAnimationCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleLedAnimationEvent((MonomeXXhDevice *)target, data, length);
+}
+
+extern "C" void _ApplicationController_AutoSwapCallback(void *target, const void *data, unsigned int length, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleAutoSwapEvent((MonomeXXhDevice *)target, data, length);
+}
 
-ApplicationController::ApplicationController(CMonomeSerialDlg* appController)
+extern "C" void _ApplicationController_SwapCallback(MonomeXXhDevice *device, double milliseconds, void *userData)
 {
-	_appController = appController;
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleSwapEvent(device, milliseconds);
+}
+
+extern "C" void _ApplicationController_FlowCallback(MonomeXXhDevice *device, void *userData)
+{
+    ApplicationController *SELF = (ApplicationController *)userData;
+    SELF->handleFlowEvent(device);
+}
+
+
+ApplicationController::ApplicationController(ApplicationControllerObserver *observer)
+	: _coalescingObserver(observer)
+{
+	_observer = observer != 0 ? &_coalescingObserver : 0;
+	_coalescingObserver.start();
 	
     _protocol = kProtocolType_OpenSoundControl;
 
@@ -75,10 +252,22 @@ ApplicationController::ApplicationController(CMonomeSerialDlg* appController)
     _oscHostPort = "8000";
     _oscListenPort = "8080";
 
+	_devicesGeneration = 0;
+	_canvasDevicesGeneration = -1;
+	_canvasLayoutGeneration = 0;
+	_canvasesGeneration = 0;
+	_matchedPrefixes.reserve(kMaxMatchedPrefixes);
+
     _initCoreMIDI();
 
 	InitializeCriticalSection(&_readLock);
 
+	_clockHostTime = EventScheduler::now();
+	_clockNtpTime = EventScheduler::ntpNow();
+
+	_ledScheduler.start();
+	_inputScheduler.start();
+
 	_defaults = new MonomeSerialDefaults(this);
 
 	_initOpenSoundControl();
@@ -92,6 +281,10 @@ ApplicationController::ApplicationController(CMonomeSerialDlg* appController)
 
 ApplicationController::~ApplicationController(void)
 {
+	_coalescingObserver.stop();
+	_ledScheduler.stop();
+	_inputScheduler.stop();
+
     while (_devices.size()) {
         MonomeXXhDevice *device = _devices.front();
 		_deviceReader.removeSerialDevice(device); // this will call device->setUnexpectedDeviceRemovalFlag() and kill read thread
@@ -136,11 +329,13 @@ ApplicationController::handleSerialDeviceDiscoveredEvent(const string& serialNum
 	MonomeXXhDevice *device = new MonomeXXhDevice(serialNumber);
 
     _defaults->setDeviceStateFromDefaults(device);
+	device->setSwapCallback(_ApplicationController_SwapCallback, this);
+	device->setFlowCallback(_ApplicationController_FlowCallback, this);
 
 	// Port toggle on open fix.
 	if (device->OscHostRef() == 0)
 	{
-		string oscHostPortString = CMonomeSerialDlg::IntToString(device->OscHostPort());
+		string oscHostPortString = _intToString(device->OscHostPort());
 
 		OscHostRef newHostRef = 0;
 		newHostRef = _oscController.getOscHostRef(device->OscHostAddress(), oscHostPortString, false);
@@ -154,7 +349,7 @@ ApplicationController::handleSerialDeviceDiscoveredEvent(const string& serialNum
     
 	if (device->OscListenRef() == 0)
 	{
-		string oscListenPortString = CMonomeSerialDlg::IntToString(device->OscListenPort());
+		string oscListenPortString = _intToString(device->OscListenPort());
 
 		OscHostRef newListenRef = 0;
 		newListenRef = _oscController.getOscListenRef(oscListenPortString, false);
@@ -170,12 +365,16 @@ ApplicationController::handleSerialDeviceDiscoveredEvent(const string& serialNum
 
 
     _devices.push_back(device);
+	_rebuildMIDIInputIndex();
+	InterlockedIncrement(&_devicesGeneration);
 
     _deviceReader.addSerialDevice(device, device->messageSize(), _ApplicationController_SerialDeviceMessageReceivedCallback, this);
 
-	device->oscLedClearEvent(false);
+	if (!_restoreDetachedDevice(device))
+		device->oscLedClearEvent(false);
 
-	_appController->updateDeviceList();
+	if (_observer != 0)
+		_observer->deviceListChanged();
 
 
 #ifdef DEBUG_PRINT
@@ -195,12 +394,118 @@ ApplicationController::handleSerialDeviceTerminatedEvent(const string& serialNum
 		if (device != 0 && device->serialNumber() == serialNumber) {
             _deviceReader.removeSerialDevice(device);
 			_devices.erase(i);
+			_rebuildMIDIInputIndex();
+			InterlockedIncrement(&_devicesGeneration);
+			_ledScheduler.cancel(device);
+			_inputScheduler.cancel(device);
+
+			_defaults->setDefaultsFromDeviceState(device);
+
+			DetachedDevice &detached = _detachedDevices[device->serialNumber()];
+			device->outputState(detached.state);
+			detached.time = EventScheduler::now();
+
             delete device;
 			device = 0;
 			break;
         }
     }
-	_appController->updateDeviceList();
+	if (_observer != 0)
+		_observer->deviceListChanged();
+}
+
+// puts back what device was showing if it dropped off within the grace period, and
+// forgets any other devices that have been gone longer
+bool
+ApplicationController::_restoreDetachedDevice(MonomeXXhDevice *device)
+{
+	map<string, DetachedDevice>::iterator i;
+	HostTime now = EventScheduler::now();
+	HostTime gracePeriod = EventScheduler::hostTimeFromMilliseconds(kDeviceRestoreGracePeriod);
+	bool restored = false;
+
+	for (i = _detachedDevices.begin(); i != _detachedDevices.end(); ) {
+		bool expired = now - i->second.time > gracePeriod;
+
+		if (i->first == device->serialNumber()) {
+			if (!expired) {
+				device->restoreOutputState(i->second.state);
+				restored = true;
+			}
+			_detachedDevices.erase(i++);
+		}
+		else if (expired)
+			_detachedDevices.erase(i++);
+		else
+			i++;
+	}
+
+	return restored;
+}
+
+void 
+ApplicationController::_updateCanvases(void)
+{
+	unsigned long layoutGeneration = MonomeXXhDevice::layoutGeneration();
+	long devicesGeneration = _devicesGeneration;
+
+	if (layoutGeneration != _canvasLayoutGeneration || devicesGeneration != _canvasDevicesGeneration) {
+		vector<MonomeXXhDevice *>::iterator i;
+
+		_canvases.clear();
+		for (i = _devices.begin(); i != _devices.end(); i++) {
+			if (*i != 0)
+				_canvases[(*i)->oscAddressPatternPrefix()].addDevice(*i);
+		}
+
+		_canvasLayoutGeneration = layoutGeneration;
+		_canvasDevicesGeneration = devicesGeneration;
+		_canvasesGeneration++;
+	}
+}
+
+LedCanvas *
+ApplicationController::_canvasForPrefix(const string &prefix)
+{
+	_updateCanvases();
+
+	map<string, LedCanvas>::iterator canvas = _canvases.find(prefix);
+
+	return canvas != _canvases.end() ? &canvas->second : 0;
+}
+
+const vector<string> &
+ApplicationController::_prefixesMatching(const string &pattern)
+{
+	_updateCanvases();
+
+	map<string, PrefixPattern>::iterator i = _prefixPatterns.find(pattern);
+
+	if (i == _prefixPatterns.end()) {
+		// a client generating patterns shouldn't grow this without bound
+		if (_prefixPatterns.size() >= kMaxPrefixPatterns)
+			_prefixPatterns.clear();
+
+		i = _prefixPatterns.insert(make_pair(pattern, PrefixPattern())).first;
+		i->second.pattern = OscAddressPattern(pattern);
+		i->second.canvasesGeneration = _canvasesGeneration - 1;
+	}
+
+	PrefixPattern &prefixPattern = i->second;
+
+	if (prefixPattern.canvasesGeneration != _canvasesGeneration) {
+		map<string, LedCanvas>::iterator canvas;
+
+		prefixPattern.prefixes.clear();
+		for (canvas = _canvases.begin(); canvas != _canvases.end(); canvas++) {
+			if (prefixPattern.pattern.match(canvas->first))
+				prefixPattern.prefixes.push_back(canvas->first);
+		}
+
+		prefixPattern.canvasesGeneration = _canvasesGeneration;
+	}
+
+	return prefixPattern.prefixes;
 }
 
 int
@@ -211,73 +516,140 @@ ApplicationController::handleSerialDeviceMessageReceivedEvent(MonomeXXhDevice *d
     if (device == 0)
         return 0;
 
-	unsigned int i = 0;
-
-	while (i < len) {
-		t_message *message = (t_message *)data;
-
 #ifdef DEBUG_PRINT
-		serialDebugger.printIncomingSerialMessage(device, message);
+	for (unsigned int n = 0; n + device->messageSize() <= len; n += device->messageSize())
+		serialDebugger.printIncomingSerialMessage(device, (t_message *)(data + n));
 #endif
 
-		if (device->type() == MonomeXXhDevice::kDeviceType_40h) {
-			switch (messageGetType(*message)) {
-				case kMessageTypeButtonPress:
-					handleButtonPressEvent(device, 
-										   messageGetButtonX(*message), 
-										   messageGetButtonY(*message),
-										   messageGetButtonState(*message) > 0);
-					break;
-
-				case kMessageTypeAdcVal:
-					handleAdcValueChangeEvent(device, messageGetAdcPort(*message), (float)(messageGetAdcVal(*message)) / (float)0x3FF);
-					break;
-
-				case kMessageTypeEncVal:
-					handleRotaryEncoderEvent(device, messageGetEncPort(*message), messageGetEncVal(*message));
-					break;
-
-				default:
-					return -1;
-			}
+	const uint8 *message = (const uint8 *)data;
+	unsigned int remaining = (unsigned int)len;
+	unsigned int used;
+	int result = 0;
+	MessageBatch batch;
+
+	batch.time = device->readTime();
+
+	// the whole read is decoded at once; a read too big for one batch takes a few passes
+	while (remaining > 0) {
+		bool known;
+
+		if (device->type() == MonomeXXhDevice::kDeviceType_40h)
+			known = batch.decode40h(message, remaining, used);
+		else //always 2 bytes from 256device
+			known = batch.decodeSeries(message, remaining, used);
+
+		_handleMessageBatch(device, batch);
+
+		if (!known) {
+			result = -1;
+			break;
 		}
-		else if (device->type() <= MonomeXXhDevice::kDeviceType_mk) {//always 2 bytes from 256device {
-			switch (messageGetType(*message)) {
-				case kMessageType_256_keydown:
-					handleButtonPressEvent(device, 
-						                   messageGetButtonX(*message), 
-							               messageGetButtonY(*message), 1);
-					break;
-
-				case kMessageType_256_keyup:
-					handleButtonPressEvent(	device, 
-											messageGetButtonX(*message), 
-											messageGetButtonY(*message), 0);
-					break;	
-									   
-				case kMessageType_256_auxiliaryInput	:
-					handleRotaryEncoderEvent(	device, 
-												messageGetEncPort(*message), 
-												messageGetEncVal(*message));		
-					break;
-									
-				case kMessageTypeTiltEvent:
-					handleTiltValueChangeEvent(	device, 	
-												messageGetTiltAxis(*message),  
-												(messageGetEncVal(*message)));		
-					break;	
-																								
-            default:
-                return -1;
-				
-            }
+
+		if (used == 0)
+			break;
+
+		message += used;
+		remaining -= used;
+	}
+
+	// encoders without an interval send what the whole read added up to
+	if (device->encoderInterval() == 0) {
+		unsigned int pending = device->pendingEncoders();
+
+		for (unsigned int n = 0; pending != 0; pending >>= 1, n++) {
+			if (pending & 1)
+				_sendEncoderSteps(device, n);
+		}
+	}
+
+	return result;
+}
+
+void 
+ApplicationController::_handleMessageBatch(MonomeXXhDevice *device, const MessageBatch &batch)
+{
+	unsigned int i = 0;
+
+	while (i < batch.count) {
+		switch (batch.type[i]) {
+			case MessageBatch::kEvent_Key:
+				{
+					unsigned int run = batch.keyRunLength(i);
+
+					_handleButtonPressRun(device, batch, i, run);
+					i += run;
+				}
+				continue;
+
+			case MessageBatch::kEvent_Adc:
+				_filterSensorSample(device, MonomeXXhDevice::kSensor_Adc0 + batch.x[i], (float)batch.value[i] / (float)0x3FF, batch.time);
+				break;
+
+			case MessageBatch::kEvent_Encoder:
+				_accumulateEncoderSteps(device, batch.x[i], batch.value[i], batch.time);
+				break;
+
+			case MessageBatch::kEvent_Tilt:
+				_filterSensorSample(device, batch.x[i] == 0 ? MonomeXXhDevice::kSensor_TiltX : MonomeXXhDevice::kSensor_TiltY, batch.value[i], batch.time);
+				break;
 		}
 
-		data += device->messageSize();
-		i += device->messageSize();
+		i++;
 	}
+}
+
+// handleButtonPressEvent for a run of keys: the address pattern, the remap and the midi
+// output are looked up once for the run instead of once per key
+void 
+ApplicationController::_handleButtonPressRun(MonomeXXhDevice *device, const MessageBatch &batch, unsigned int first, unsigned int count)
+{
+	unsigned int i;
+
+	// local echo lights the leds before the presses leave, in one write for the run
+	device->echoButtonPresses(batch.x + first, batch.y + first, batch.value + first, count);
+
+    if (_protocol == kProtocolType_OpenSoundControl) {
+		char buffer[OUTPUT_BUFFER_SIZE];
+		osc::OutboundPacketStream stream(buffer, sizeof(buffer) / sizeof(char));
+		unsigned int columns[MessageBatch::kMaxEvents], rows[MessageBatch::kMaxEvents];
+
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Press);
+
+		device->convertLocalCoordinatesToOscCoordinates(batch.x + first, batch.y + first, columns, rows, count);
+
+		// still one message per key, so clients see the same packets as before
+		for (i = 0; i < count; i++) {
+			stream.Clear();
+			MonomeXXhDevice::InputTimestamps timestamps = _beginInputMessage(stream, device, oscAddressPattern.c_str(), batch.time);
+			stream << (int)columns[i] << (int)rows[i] << (int)batch.value[first + i];
+			_endInputMessage(stream, timestamps, batch.time);
+
+			_sendInputMessage(device, stream, InputSubscriptions::kEvent_Press, batch.x[first + i], batch.y[first + i]);
+		}
+    }
+    else if(_protocol == kProtocolType_MIDI){
+        CCoreMIDIEndpointRef endpointRef;
+
+        if ((endpointRef = device->MIDIOutputDevice()) == 0)
+            return;
 
-	return 0;
+		unsigned char channel = device->MIDIOutputChannel();
+
+		for (i = first; i < first + count; i++) {
+			unsigned int column = batch.x[i], row = batch.y[i];
+			unsigned char MIDINoteNumber = device->convertLocalCoordinatesToMIDINoteNumber(column, row);
+			unsigned char Channelspill = channel;
+
+			//wrap > 127 notes from 256	
+			if (MIDINoteNumber > 127) { //wrap MIDI notes to next channel
+				MIDINoteNumber = (MIDINoteNumber%128); 
+				Channelspill++;
+				if (Channelspill > 16) Channelspill = 1;
+			}
+
+			_cCoreMIDI->queueShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, batch.value[i] ? 127 : 0);
+		}
+    }
 }
 
 void 
@@ -286,19 +658,22 @@ ApplicationController::handleButtonPressEvent(MonomeXXhDevice *device, unsigned
 	if (device == 0)
         return;
 
+	device->echoButtonPress(localColumn, localRow, state);
+
     if (_protocol == kProtocolType_OpenSoundControl) {
 		char buffer[OUTPUT_BUFFER_SIZE];
 		osc::OutboundPacketStream stream(buffer, sizeof(buffer) / sizeof(char));
 
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternButtonPressSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Press);
+		unsigned int column = localColumn, row = localRow;
 
-        device->convertLocalCoordinatesToOscCoordinates(localColumn, localRow);
+        device->convertLocalCoordinatesToOscCoordinates(column, row);
 
 		stream << osc::BeginMessage( oscAddressPattern.c_str() ) 
-			<< (int)localColumn << (int)localRow << (state ? 1 : 0)
+			<< (int)column << (int)row << (state ? 1 : 0)
 			<< osc::EndMessage;
 
-		_oscController.send(device->OscHostRef(), stream);
+		_sendInputMessage(device, stream, InputSubscriptions::kEvent_Press, localColumn, localRow);
     }
     else if(_protocol == kProtocolType_MIDI){
         CCoreMIDIEndpointRef endpointRef;
@@ -319,7 +694,7 @@ ApplicationController::handleButtonPressEvent(MonomeXXhDevice *device, unsigned
 			if (Channelspill > 16) Channelspill = 1;
 			}
 		
-        _cCoreMIDI->sendShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, state ? 127 : 0);
+        _cCoreMIDI->queueShort(endpointRef, 0x90 | Channelspill, MIDINoteNumber, state ? 127 : 0);
     }
 
 //#ifdef DEBUG_PRINT
@@ -337,13 +712,14 @@ ApplicationController::handleAdcValueChangeEvent(MonomeXXhDevice *device, unsign
 		char buffer[OUTPUT_BUFFER_SIZE];
 		osc::OutboundPacketStream stream(buffer, sizeof(buffer) / sizeof(char));
 
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternAdcValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Adc);
+		HostTime time = device->sensorSampleTime(MonomeXXhDevice::kSensor_Adc0 + localAdcIndex);
         
-		stream << osc::BeginMessage(oscAddressPattern.c_str())
-			<< (int)(device->oscAdcOffset() + localAdcIndex) << (float)value
-			<< osc::EndMessage;
+		MonomeXXhDevice::InputTimestamps timestamps = _beginInputMessage(stream, device, oscAddressPattern.c_str(), time);
+		stream << (int)(device->oscAdcOffset() + localAdcIndex) << (float)value;
+		_endInputMessage(stream, timestamps, time);
         
-		_oscController.send(device->OscHostRef(), stream);
+		_sendInputMessage(device, stream, InputSubscriptions::kEvent_Adc);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -359,7 +735,7 @@ ApplicationController::handleAdcValueChangeEvent(MonomeXXhDevice *device, unsign
         else
             ccValue = (unsigned char)(value * 127.f);
                 
-        _cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue);
+        _cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localAdcIndex, ccValue);
     }
 }
 
@@ -377,14 +753,15 @@ ApplicationController::handleTiltValueChangeEvent(MonomeXXhDevice *device, int W
 		char buffer[OUTPUT_BUFFER_SIZE];
 		osc::OutboundPacketStream stream(buffer, sizeof(buffer) / sizeof(char));
 
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternTiltValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Tilt);
+		HostTime time = device->sensorSampleTime(MonomeXXhDevice::kSensor_TiltX + WhichAxis);
         
-		stream << osc::BeginMessage(oscAddressPattern.c_str())
-			<< (float)device->LastTiltX
-			<< (float)device->LastTiltY
-			<< osc::EndMessage;
+		MonomeXXhDevice::InputTimestamps timestamps = _beginInputMessage(stream, device, oscAddressPattern.c_str(), time);
+		stream << (float)device->LastTiltX
+			<< (float)device->LastTiltY;
+		_endInputMessage(stream, timestamps, time);
         
-        _oscController.send(device->OscHostRef(), stream);
+        _sendInputMessage(device, stream, InputSubscriptions::kEvent_Tilt);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -400,7 +777,7 @@ ApplicationController::handleTiltValueChangeEvent(MonomeXXhDevice *device, int W
         else
             ccValue = (unsigned char)(value * 127.f);
                 
-        _cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), 6, ccValue);
+        _cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), 6, ccValue);
     }
 }
 
@@ -414,13 +791,14 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 		char buffer[OUTPUT_BUFFER_SIZE];
 		osc::OutboundPacketStream stream(buffer, sizeof(buffer) / sizeof(char));
 
-        string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternEncValueSuffix;
+        const string &oscAddressPattern = device->oscInputAddressPattern(MonomeXXhDevice::kInputAddress_Enc);
+		HostTime time = device->encoderStepTime(localEncoderIndex);
 
-		stream << osc::BeginMessage(oscAddressPattern.c_str())
-			<< (int)(device->oscEncOffset() + localEncoderIndex) << steps // the oscEncOffset was oscAdcOffset for some reason
-			<< osc::EndMessage;
+		MonomeXXhDevice::InputTimestamps timestamps = _beginInputMessage(stream, device, oscAddressPattern.c_str(), time);
+		stream << (int)(device->oscEncOffset() + localEncoderIndex) << steps; // the oscEncOffset was oscAdcOffset for some reason
+		_endInputMessage(stream, timestamps, time);
 
-		_oscController.send(device->OscHostRef(), stream);
+		_sendInputMessage(device, stream, InputSubscriptions::kEvent_Enc);
     }
     else {
         CCoreMIDIEndpointRef endpointRef;
@@ -436,7 +814,7 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 			else 
 				stepsUsed = steps;
 				
-			_cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
+			_cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
 			
 			steps -= stepsUsed;
 		}
@@ -449,13 +827,146 @@ ApplicationController::handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigne
 			else 
 				stepsUsed = steps;
 				
-			_cCoreMIDI->sendShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
+			_cCoreMIDI->queueShort(endpointRef, 0xB0 | device->MIDIOutputChannel(), localEncoderIndex + 4, stepsUsed + 64); // offset by the number of adcs
 			
 			steps += stepsUsed;
 		}
     }
 }
 
+void 
+ApplicationController::handleEncoderSendEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex)
+{
+	_sendEncoderSteps(device, localEncoderIndex);
+	_cCoreMIDI->flushOutput();
+}
+
+void 
+ApplicationController::_accumulateEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps, HostTime time)
+{
+	if (device == 0)
+		return;
+
+	HostTime now = EventScheduler::now();
+	HostTime sendTime = device->addEncoderSteps(localEncoderIndex, steps, time);
+
+	// with no interval the steps wait for the end of the serial read
+	if (sendTime == 0 || device->encoderInterval() == 0)
+		return;
+
+	if (sendTime <= now)
+		_sendEncoderSteps(device, localEncoderIndex);
+	else
+		_inputScheduler.schedule(sendTime, _ApplicationController_EncoderSendCallback, this, device, &localEncoderIndex, sizeof(localEncoderIndex));
+}
+
+void 
+ApplicationController::_sendEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex)
+{
+	HostTime nextSendTime;
+	int minSteps = INT_MIN, maxSteps = INT_MAX;
+
+	// one CC carries -64..63; when rate limited, the rest goes next time round
+	if (_protocol == kProtocolType_MIDI && device->encoderInterval() != 0) {
+		minSteps = -64;
+		maxSteps = 63;
+	}
+
+	int steps = device->takeEncoderSteps(localEncoderIndex, minSteps, maxSteps, EventScheduler::now(), nextSendTime);
+
+	if (steps != 0)
+		handleRotaryEncoderEvent(device, localEncoderIndex, steps);
+
+	if (nextSendTime != 0)
+		_inputScheduler.schedule(nextSendTime, _ApplicationController_EncoderSendCallback, this, device, &localEncoderIndex, sizeof(localEncoderIndex));
+}
+
+void 
+ApplicationController::handleSensorRetryEvent(MonomeXXhDevice *device, unsigned int sensor)
+{
+	float value;
+	HostTime retryTime;
+
+	if (device->retrySensorSample(sensor, EventScheduler::now(), value, retryTime)) {
+		_sendSensorValue(device, sensor, value);
+		_cCoreMIDI->flushOutput();
+	}
+}
+
+void 
+ApplicationController::_filterSensorSample(MonomeXXhDevice *device, unsigned int sensor, float sample, HostTime time)
+{
+	if (device == 0)
+		return;
+
+	float value;
+	HostTime retryTime;
+
+	// adcs go out as 7 bit CCs in MIDI mode; changes below that are not worth a message
+	unsigned int outputSteps = _protocol == kProtocolType_MIDI && sensor < MonomeXXhDevice::kSensor_TiltX ? 127 : 0;
+
+	if (device->filterSensorSample(sensor, sample, outputSteps, time, value, retryTime))
+		_sendSensorValue(device, sensor, value);
+	else if (retryTime != 0)
+		_inputScheduler.schedule(retryTime, _ApplicationController_SensorRetryCallback, this, device, &sensor, sizeof(sensor));
+}
+
+void 
+ApplicationController::_sendSensorValue(MonomeXXhDevice *device, unsigned int sensor, float value)
+{
+	if (sensor < MonomeXXhDevice::kSensor_TiltX)
+		handleAdcValueChangeEvent(device, sensor - MonomeXXhDevice::kSensor_Adc0, value);
+	else
+		handleTiltValueChangeEvent(device, sensor - MonomeXXhDevice::kSensor_TiltX, value);
+}
+
+MonomeXXhDevice::InputTimestamps 
+ApplicationController::_beginInputMessage(osc::OutboundPacketStream &stream, MonomeXXhDevice *device, const char *addressPattern, HostTime time)
+{
+	MonomeXXhDevice::InputTimestamps timestamps = device->inputTimestamps();
+
+	if (timestamps == MonomeXXhDevice::kInputTimestamps_Bundle)
+		stream << osc::BeginBundle(_ntpTimeFromHostTime(time));
+
+	stream << osc::BeginMessage(addressPattern);
+	return timestamps;
+}
+
+void 
+ApplicationController::_endInputMessage(osc::OutboundPacketStream &stream, MonomeXXhDevice::InputTimestamps timestamps, HostTime time)
+{
+	if (timestamps == MonomeXXhDevice::kInputTimestamps_Argument)
+		stream << osc::TimeTag(_ntpTimeFromHostTime(time));
+
+	stream << osc::EndMessage;
+
+	if (timestamps == MonomeXXhDevice::kInputTimestamps_Bundle)
+		stream << osc::EndBundle;
+}
+
+NtpTime 
+ApplicationController::_ntpTimeFromHostTime(HostTime time) const
+{
+	if (time >= _clockHostTime)
+		return _clockNtpTime + EventScheduler::ntpTimeFromHostTime(time - _clockHostTime);
+	else
+		return _clockNtpTime - EventScheduler::ntpTimeFromHostTime(_clockHostTime - time);
+}
+
+void 
+ApplicationController::_sendInputMessage(MonomeXXhDevice *device, const osc::OutboundPacketStream &stream, InputSubscriptions::Event event, unsigned int localColumn, unsigned int localRow)
+{
+	InputSubscriptions::Destinations destinations(_inputSubscriptions, device, event, localColumn, localRow);
+
+	_oscController.send(device->OscHostRef(), stream);
+
+	// the same encoded packet goes to each, skipping any that is the host already
+	for (unsigned int i = 0; i < destinations.count(); i++) {
+		if (destinations[i] != device->OscHostRef())
+			_oscController.send(destinations[i], stream);
+	}
+}
+
 void 
 ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 {
@@ -465,6 +976,12 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 
 	OscMessageStream stream(recmsg);
 
+	_handleOscMessage(stream);
+}
+
+void 
+ApplicationController::_handleOscMessage(OscMessageStream &stream)
+{
     static vector<MonomeXXhDevice *> matchingDevices;
 	string suffix(stream.getAddressPatternSuffix());
 
@@ -474,16 +991,51 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
     }
 
     vector<MonomeXXhDevice *>::iterator i;
+	string prefix(stream.getAddressPatternPrefix());
 
-    matchingDevices.clear();
-    for (i = _devices.begin(); i != _devices.end(); i++) {
-		if ((*i)->oscAddressPatternPrefix() == stream.getAddressPatternPrefix())
-            matchingDevices.push_back(*i);
-    }
+	// subscriptions go by prefix alone, so a client can subscribe before the devices arrive.
+	// a prefix with wildcards is kept as a pattern and matched as each device sends input.
+	if (suffix == kOscDefaultAddrPatternSubscribeSuffix || suffix == kOscDefaultAddrPatternUnsubscribeSuffix) {
+		_handleOscSubscribeMessage(stream, prefix, suffix);
+		return;
+	}
 
-    if (matchingDevices.size() == 0)
-        return;
+	// a prefix with wildcards is handled once for each device prefix it matches
+	if (OscAddressPattern::isPattern(prefix)) {
+		// a copy, as handling the message may rebuild the canvases and the matches with them.
+		// the expanded messages have no wildcards, so they never come back here to change it.
+		_matchedPrefixes = _prefixesMatching(prefix);
+		vector<string>::iterator p;
+
+		for (p = _matchedPrefixes.begin(); p != _matchedPrefixes.end(); p++) {
+			if (OscAddressPattern::isPattern(*p))
+				continue;
 
+			_expandedAddressPattern.assign(*p).append(suffix);
+			OscMessageStream expanded(stream, _expandedAddressPattern);
+			_handleOscMessage(expanded);
+		}
+
+		return;
+	}
+
+	int layer = LedCanvas::kBaseLayer;
+	LedCanvas *canvas = _canvasForPrefix(prefix);
+
+	if (canvas == 0) {
+		// prefix/layer/<id>/led, /led_row, /led_col, /frame and /clear draw on layer id
+		if (!_layerFromAddressPatternPrefix(prefix, layer) || (canvas = _canvasForPrefix(prefix)) == 0)
+			return;
+
+		if (suffix != kOscDefaultAddrPatternLedStateSuffix && suffix != kOscDefaultAddrPatternLedRowSuffix &&
+			suffix != kOscDefaultAddrPatternLedColumnSuffix && suffix != kOscDefaultAddrPatternLedFrameSuffix &&
+			suffix != kOscDefaultAddrPatternLedClearSuffix)
+			return;
+	}
+
+	matchingDevices = canvas->devices();
+
+	FlowCharge flowCharge(this, matchingDevices);
 
     if (suffix == kOscDefaultAddrPatternLedStateSuffix) {  /* prefix/led */
 
@@ -494,8 +1046,7 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
         unsigned int row = stream.getInt32();
         bool state = stream.getInt32() ? true : false;
 
-        for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
-            (*i)->oscLedStateChangeEvent(column, row, state);
+        canvas->ledStateChange(column, row, state, layer);
 	}
     else if (suffix == kOscDefaultAddrPatternLedIntensitySuffix) { /* prefix/intensity */
 		if (!stream.typetagMatch(kOscDefaultTypeTagsLedIntensity))
@@ -517,6 +1068,12 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
     }
     else if (suffix == kOscDefaultAddrPatternLedClearSuffix) { /* prefix/clear */
 		bool clear;
+
+		if (layer != LedCanvas::kBaseLayer) {
+			for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+				(*i)->oscLayerClearEvent(layer);
+			return;
+		}
 		
 		if (stream.argumentCount() == 0) 
 			clear = false;
@@ -537,9 +1094,9 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
         
 		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++) {
             (*i)->oscAdcEnableStateChangeEvent(adcIndex, adcState);
-			
-			// update GUI
-			_appController->UpdateAdcStates();
+
+			if (_observer != 0)
+				_observer->adcStatesChanged((*i)->serialNumber());
 		}
     }
     else if (suffix == kOscDefaultAddrPatternShutdownSuffix) { /* prefix/shutdown */
@@ -573,13 +1130,12 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 		unsigned int row = stream.getInt32();
 
         unsigned int index = 0;
-        unsigned char bitmap[256];
+        unsigned int bitmap[256];
 
-		while (!stream.endOfStream()) 
+		while (!stream.endOfStream() && index < 256) 
 			bitmap[index++] = stream.getInt32();
 
-        for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
-            (*i)->oscLedRowStateChangeEvent(row, index, bitmap);
+        canvas->ledRow(row, index, bitmap, layer);
     }
     else if (suffix == kOscDefaultAddrPatternLedColumnSuffix) { /* prefix/led_col */
         if (!_typeCheckRowOrColumnMessage(stream))
@@ -588,14 +1144,13 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 		unsigned int column = stream.getInt32();
 
         unsigned int index = 0;
-        unsigned char bitmap[256];
+        unsigned int bitmap[256];
 
-		while(!stream.endOfStream()) {
+		while(!stream.endOfStream() && index < 256) {
 			bitmap[index++] = stream.getInt32();
 		}
 
-        for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
-            (*i)->oscLedColumnStateChangeEvent(column, index, bitmap);
+        canvas->ledColumn(column, index, bitmap, layer);
     }
     else if (suffix == kOscDefaultAddrPatternEncEnableSuffix) { /* prefix/enc_enable */
 		if (!stream.typetagMatch(kOscDefaultTypeTagsEncEnable))
@@ -607,8 +1162,26 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++) {
             (*i)->oscEncEnableStateChangeEvent(encIndex, encState);
 
-			// update GUI
-			_appController->UpdateEncStates();
+			if (_observer != 0)
+				_observer->encStatesChanged((*i)->serialNumber());
+		}
+    }
+    else if (suffix == kOscDefaultAddrPatternEncTotalSuffix) { /* prefix/enc_total */
+		if (!stream.typetagMatch(kOscDefaultTypeTagsEncTotal))
+            return;
+
+		int encIndex = stream.getInt32();
+
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++) {
+			char buffer[OUTPUT_BUFFER_SIZE];
+			osc::OutboundPacketStream packet(buffer, sizeof(buffer) / sizeof(char));
+			string oscAddressPattern = (*i)->oscAddressPatternPrefix() + kOscDefaultAddrPatternEncTotalSuffix;
+
+			packet << osc::BeginMessage(oscAddressPattern.c_str())
+				<< encIndex << (int)(*i)->encoderTotal(encIndex - (*i)->oscEncOffset())
+				<< osc::EndMessage;
+
+			_oscController.send((*i)->OscHostRef(), packet);
 		}
     }
     else if (suffix == kOscDefaultAddrPatternLedFrameSuffix) { /* prefix/frame */
@@ -623,8 +1196,7 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 				bitmap[index++] = stream.getInt32();
 			}
 
-            for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
-                (*i)->oscLedFrameEvent(column, row, bitmap);   
+            canvas->ledFrame(column, row, bitmap, layer);
 		       
         }
 		else if (stream.typetagMatch(kOscDefaultTypeTagsLedFrame)) { // 8 Ints
@@ -635,10 +1207,264 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 				bitmap[index++] = stream.getInt32();
 			}
 
-            for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
-                (*i)->oscLedFrameEvent(0, 0, bitmap);        
+            canvas->ledFrame(0, 0, bitmap, layer);
         }
     } //end /frame
+    else if (suffix == kOscDefaultAddrPatternLedShiftSuffix) { /* prefix/shift */
+		bool wrap = false;
+
+		if (stream.typetagMatch(kOscDefaultTypeTagsLedShiftWrap))
+			wrap = true;
+		else if (!stream.typetagMatch(kOscDefaultTypeTagsLedShift))
+			return;
+
+		int dx = stream.getInt32();
+		int dy = stream.getInt32();
+
+		if (wrap)
+			wrap = stream.getInt32() != 0;
+
+		LedsLock leds(matchingDevices);
+		LedBitmap bitmap = _readLedBitmap(matchingDevices);
+		bitmap.shift(dx, dy, wrap);
+		_writeLedBitmap(matchingDevices, bitmap);
+    }
+    else if (suffix == kOscDefaultAddrPatternLedBlitSuffix) { /* prefix/blit */
+		if (!_typeCheckBlitMessage(stream))
+			return;
+
+		unsigned int column = stream.getInt32();
+		unsigned int row = stream.getInt32();
+		unsigned int width = stream.getInt32();
+		unsigned int height = stream.getInt32();
+		unsigned int bitMaps[LedBitmap::kMaxSize];
+		unsigned int index = 0;
+
+		while (!stream.endOfStream() && index < LedBitmap::kMaxSize)
+			bitMaps[index++] = (unsigned int)stream.getInt32();
+
+		if (index < height)
+			height = index;
+
+		LedsLock leds(matchingDevices);
+		LedBitmap bitmap = _readLedBitmap(matchingDevices);
+		bitmap.blit(column, row, width, height, bitMaps);
+		_writeLedBitmap(matchingDevices, bitmap);
+    }
+    else if (suffix == kOscDefaultAddrPatternLedCopySuffix) { /* prefix/copy */
+		if (!stream.typetagMatch(kOscDefaultTypeTagsLedCopy))
+			return;
+
+		unsigned int column = stream.getInt32();
+		unsigned int row = stream.getInt32();
+		unsigned int width = stream.getInt32();
+		unsigned int height = stream.getInt32();
+		unsigned int toColumn = stream.getInt32();
+		unsigned int toRow = stream.getInt32();
+
+		LedsLock leds(matchingDevices);
+		LedBitmap bitmap = _readLedBitmap(matchingDevices);
+		bitmap.copy(column, row, width, height, toColumn, toRow);
+		_writeLedBitmap(matchingDevices, bitmap);
+    }
+    else if (suffix == kOscDefaultAddrPatternLedFillSuffix) { /* prefix/fill */
+		if (!stream.typetagMatch(kOscDefaultTypeTagsLedFill))
+			return;
+
+		unsigned int column = stream.getInt32();
+		unsigned int row = stream.getInt32();
+		unsigned int width = stream.getInt32();
+		unsigned int height = stream.getInt32();
+		bool state = stream.getInt32() != 0;
+
+		LedsLock leds(matchingDevices);
+		LedBitmap bitmap = _readLedBitmap(matchingDevices);
+		bitmap.fill(column, row, width, height, state);
+		_writeLedBitmap(matchingDevices, bitmap);
+    }
+    else if (suffix == kOscDefaultAddrPatternLedMapSuffix) { /* prefix/led_map */
+		unsigned int column, row, width, height;
+		const void *data;
+		unsigned long size;
+
+		if (stream.typetagMatch(kOscDefaultTypeTagsLedMap))
+			_ledBounds(matchingDevices, column, row, width, height);
+		else if (stream.typetagMatch(kOscDefaultTypeTagsLedMapRect)) {
+			column = stream.getInt32();
+			row = stream.getInt32();
+			width = stream.getInt32();
+			height = stream.getInt32();
+		}
+		else
+			return;
+
+		stream.getBlob(data, size);
+
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+			(*i)->oscLedMapEvent(column, row, width, height, (const uint8 *)data, size);
+    }
+    else if (suffix == kOscDefaultAddrPatternLayerSuffix) { /* prefix/layer */
+		if (stream.typetagMatch(kOscDefaultTypeTagsLayerRemove)) {
+			int id = stream.getInt32();
+
+			for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+				(*i)->oscLayerRemoveEvent(id);
+			return;
+		}
+
+		bool clip = stream.typetagMatch(kOscDefaultTypeTagsLayerClip);
+
+		if (!clip && !stream.typetagMatch(kOscDefaultTypeTagsLayer))
+			return;
+
+		int id = stream.getInt32();
+		int z = stream.getInt32();
+		MonomeXXhDevice::LayerBlend blend;
+		unsigned int column = 0, row = 0, width = 0, height = 0;
+
+		if (id < 0 || !_layerBlendFromString(stream.getString(), blend))
+			return;
+
+		if (clip) {
+			column = stream.getInt32();
+			row = stream.getInt32();
+			width = stream.getInt32();
+			height = stream.getInt32();
+		}
+
+		// without a rectangle the layer covers the whole device again
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++) {
+			if ((*i)->oscLayerEvent(id, z, blend))
+				(*i)->oscLayerClipEvent(id, column, row, width, height);
+		}
+    }
+    else if (suffix == kOscDefaultAddrPatternEchoSuffix) { /* prefix/echo */
+		bool rect = stream.typetagMatch(kOscDefaultTypeTagsEchoRect);
+
+		if (!rect && !stream.typetagMatch(kOscDefaultTypeTagsEcho))
+			return;
+
+		string name(stream.getString());
+		MonomeXXhDevice::EchoMode mode;
+		unsigned int column = 0, row = 0, width = 0, height = 0;
+
+		if (name == kOscEchoOff) {
+			for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+				(*i)->oscEchoClearEvent();
+			return;
+		}
+		else if (name == kOscEchoMomentary)
+			mode = MonomeXXhDevice::kEcho_Momentary;
+		else if (name == kOscEchoToggle)
+			mode = MonomeXXhDevice::kEcho_Toggle;
+		else if (name == kOscEchoRadio)
+			mode = MonomeXXhDevice::kEcho_Radio;
+		else
+			return;
+
+		if (rect) {
+			column = stream.getInt32();
+			row = stream.getInt32();
+			width = stream.getInt32();
+			height = stream.getInt32();
+		}
+
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+			(*i)->oscEchoEvent(mode, column, row, width, height);
+    }
+    else if (suffix == kOscDefaultAddrPatternDoubleBufferSuffix) { /* prefix/double_buffer */
+		bool autoSwap = stream.typetagMatch(kOscDefaultTypeTagsDoubleBufferAuto);
+
+		if (!autoSwap && !stream.typetagMatch(kOscDefaultTypeTagsDoubleBuffer))
+			return;
+
+		bool doubleBuffered = stream.getInt32() != 0;
+		int interval = autoSwap ? stream.getInt32() : 0;
+
+		if (interval < 0)
+			return;
+
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+			_setDoubleBuffered(*i, doubleBuffered, interval);
+    }
+    else if (suffix == kOscDefaultAddrPatternSwapSuffix) { /* prefix/swap */
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+			(*i)->swapLeds();
+    }
+    else if (suffix == kOscDefaultAddrPatternLedAnimationSuffix) { /* prefix/anim */
+		if (stream.typetagMatch(kOscDefaultTypeTagsLedAnimationStop)) {
+			if (stream.getString() != "stop")
+				return;
+
+			for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+				(*i)->stopLedAnimation();
+			return;
+		}
+
+		LedAnimation animation;
+
+		if (stream.typetagMatch(kOscDefaultTypeTagsLedAnimationPulse)) {
+			if (stream.getString() != "pulse")
+				return;
+
+			unsigned int interval = stream.getInt32();
+			unsigned int steps = stream.getInt32();
+			float low = stream.getFloat();
+			float high = stream.getFloat();
+
+			animation.setPulse(low, high);
+			animation.setTiming(interval, steps);
+		}
+		else {
+			if (!_typeCheckAnimationMessage(stream))
+				return;
+
+			string mode(stream.getString());
+			unsigned int numArguments = stream.argumentCount() - 7;
+			int dx = 0, dy = 0;
+			uint16 bitMaps[LedAnimation::kMaxFrames * LedAnimation::kMaxRows];
+			unsigned int n;
+
+			unsigned int interval = stream.getInt32();
+			unsigned int steps = stream.getInt32();
+			unsigned int column = stream.getInt32();
+			unsigned int row = stream.getInt32();
+			unsigned int width = stream.getInt32();
+			unsigned int height = stream.getInt32();
+
+			if (mode == "scroll") {
+				if (numArguments < 2)
+					return;
+
+				dx = stream.getInt32();
+				dy = stream.getInt32();
+				numArguments -= 2;
+			}
+
+			// blink and scroll take one frame, frames as many as fit
+			if (height == 0 || height > LedAnimation::kMaxRows || numArguments < height || numArguments % height != 0)
+				return;
+			if (mode != "frames" && numArguments != height)
+				return;
+
+			for (n = 0; n < numArguments && n < LedAnimation::kMaxFrames * LedAnimation::kMaxRows; n++)
+				bitMaps[n] = (uint16)stream.getInt32();
+
+			if (mode == "frames")
+				animation.setFrames(column, row, width, height, bitMaps, n / height);
+			else if (mode == "blink")
+				animation.setBlink(column, row, width, height, bitMaps);
+			else if (mode == "scroll")
+				animation.setScroll(column, row, width, height, bitMaps, dx, dy);
+			else
+				return;
+
+			animation.setTiming(interval, steps);
+		}
+
+		for (i = matchingDevices.begin(); i != matchingDevices.end(); i++)
+			_startLedAnimation(*i, animation);
+    }
 	// Tilt - 64 only! - (added by Steve)
 	else if (suffix == kOscDefaultAddrPatternTilt_ModeSuffix) { // 1 int, as bool
 		if (!stream.typetagMatch(kOscDefaultTypeTagsTiltMode))
@@ -717,29 +1543,207 @@ ApplicationController::handleOscMessage(const osc::ReceivedMessage &recmsg)
 }
 
 void 
-ApplicationController::handleMIDIReceived(DWORD msg, CCoreMIDIEndpointRef source)
+ApplicationController::handleMIDIReceived(DWORD msg, HostTime time, CCoreMIDIEndpointRef source)
 {
 	if (this->protocol() != this->kProtocolType_MIDI)
 		return;
 
-    vector<MonomeXXhDevice *>::iterator i;
+	// held through the dispatch: a device leaving rebuilds the index under it before the
+	// device is deleted, so that waits for any input already on its way to the device
+	ApplicationControllerLock lock(this);
+
+	MIDIInputIndex::const_iterator entry = _midiInputIndex.find(source);
+	if (entry == _midiInputIndex.end())
+		return;
+
+	// parse once, however many devices share this input
+	MIDIInputEvent event;
+	unsigned char status;
+
+	CShortMsg::UnpackShortMsg(msg, status, event.data1, event.data2);
+	event.type = status & 0xF0;
+	event.channel = status & 0x0F;
+	event.time = time;
+
+	vector<MonomeXXhDevice *>::const_iterator i;
+	for (i = entry->second.begin(); i != entry->second.end(); i++)
+		_handleMIDIMessage(*i, event);
+}
+
+void 
+ApplicationController::handleMIDISysExReceived(const unsigned char *data, unsigned int length, HostTime time, CCoreMIDIEndpointRef source)
+{
+	if (this->protocol() != this->kProtocolType_MIDI)
+		return;
+
+	// only complete monome messages; anything split across driver buffers is dropped
+	if (length < kMIDISysExHeaderSize + 1 || data[0] != 0xF0 || data[length - 1] != 0xF7 ||
+		data[1] != kMIDISysExManufacturerID || data[2] != kMIDISysExMonomeID)
+		return;
+
+	// held through the dispatch, as in handleMIDIReceived
+	ApplicationControllerLock lock(this);
+
+	MIDIInputIndex::const_iterator entry = _midiInputIndex.find(source);
+	if (entry == _midiInputIndex.end())
+		return;
+
+	unsigned char command = (data[3] >> 4) & 0x07;
+	unsigned char channel = data[3] & 0x0F;
+
+	vector<MonomeXXhDevice *>::const_iterator i;
+	for (i = entry->second.begin(); i != entry->second.end(); i++) {
+		if ((*i)->MIDIInputChannel() == channel)
+			_handleMIDISysEx(*i, command, data + kMIDISysExHeaderSize, length - kMIDISysExHeaderSize - 1, time);
+	}
+}
+
+void 
+ApplicationController::handleScheduledMIDILedEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+	if (length == sizeof(MIDILedEvent))
+		_applyMIDILedEvent(device, *(const MIDILedEvent *)data);
+}
+
+void 
+ApplicationController::handleLedAnimationEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+	if (length != sizeof(LedAnimationStep))
+		return;
+
+	LedAnimationStep step = *(const LedAnimationStep *)data;
+	unsigned int interval = device->stepLedAnimation(step.generation);
+
+	if (interval == 0)
+		return;
+
+	// steps keep to the animation's own clock, unless drawing has fallen behind it
+	HostTime now = EventScheduler::now();
+
+	step.time += EventScheduler::hostTimeFromMilliseconds(interval);
+	if (step.time < now)
+		step.time = now;
+
+	_ledScheduler.schedule(step.time, _ApplicationController_LedAnimationCallback, this, device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::_startLedAnimation(MonomeXXhDevice *device, const LedAnimation &animation)
+{
+	LedAnimationStep step;
+
+	step.generation = device->startLedAnimation(animation);
+	step.time = EventScheduler::now();
+
+	// the first step is drawn straight away
+	handleLedAnimationEvent(device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::handleAutoSwapEvent(MonomeXXhDevice *device, const void *data, unsigned int length)
+{
+	if (length != sizeof(LedAnimationStep))
+		return;
+
+	LedAnimationStep step = *(const LedAnimationStep *)data;
+	unsigned int interval = device->autoSwapLeds(step.generation);
+
+	if (interval == 0)
+		return;
+
+	HostTime now = EventScheduler::now();
+
+	step.time += EventScheduler::hostTimeFromMilliseconds(interval);
+	if (step.time < now)
+		step.time = now;
+
+	_ledScheduler.schedule(step.time, _ApplicationController_AutoSwapCallback, this, device, &step, sizeof(step));
+}
+
+void 
+ApplicationController::_setDoubleBuffered(MonomeXXhDevice *device, bool doubleBuffered, unsigned int autoSwapInterval)
+{
+	LedAnimationStep step;
+
+	step.generation = device->setDoubleBuffered(doubleBuffered, autoSwapInterval);
+	step.time = EventScheduler::now() + EventScheduler::hostTimeFromMilliseconds(autoSwapInterval);
+
+	// a swap already scheduled belongs to the old generation and lapses
+	if (doubleBuffered && autoSwapInterval > 0)
+		_ledScheduler.schedule(step.time, _ApplicationController_AutoSwapCallback, this, device, &step, sizeof(step));
+}
+
+// called on the device's transmit thread once a swapped frame has been written
+void 
+ApplicationController::handleSwapEvent(MonomeXXhDevice *device, double milliseconds)
+{
+	if (device == 0 || _protocol != kProtocolType_OpenSoundControl)
+		return;
+
+	char buffer[OUTPUT_BUFFER_SIZE];
+	osc::OutboundPacketStream packet(buffer, sizeof(buffer) / sizeof(char));
+	string oscAddressPattern = device->oscAddressPatternPrefix() + kOscDefaultAddrPatternSwapSuffix;
+
+	packet << osc::BeginMessage(oscAddressPattern.c_str()) << (float)milliseconds << osc::EndMessage;
+
+	_oscController.send(device->OscHostRef(), packet);
+}
+
+// sends the device's flow state to its host, on whichever thread found a report due
+void 
+ApplicationController::handleFlowEvent(MonomeXXhDevice *device)
+{
+	MonomeXXhDevice::FlowState state;
+	unsigned int index;
+
+	if (device == 0)
+		return;
+
+	device->reportFlowState(state);
+
+	if (_protocol != kProtocolType_OpenSoundControl)
+		return;
+
+	for (index = 0; index < _devices.size() && _devices[index] != device; index++)
+		;
+
+	if (index == _devices.size())
+		return;
+
+	char buffer[OUTPUT_BUFFER_SIZE];
+	osc::OutboundPacketStream packet(buffer, sizeof(buffer) / sizeof(char));
+
+	packet << osc::BeginMessage(kOscDefaultAddrPatternSystemFlow) << (int)index << (int)state.level
+		<< (int)state.credits << state.utilisation << osc::EndMessage;
 
-    for (i = _devices.begin(); i != _devices.end(); i++) {
-        MonomeXXhDevice *device = *i;
+	_oscController.send(device->OscHostRef(), packet);
+}
 
-        if (device->MIDIInputDevice() == source) {
-			unsigned char status, data1, data2;
-			CShortMsg::UnpackShortMsg(msg, status, data1, data2);
-			_handleMIDIMessage(device, status, data1, data2);
-		}
+ApplicationController::FlowCharge::~FlowCharge()
+{
+	for (vector<MonomeXXhDevice *>::const_iterator i = _devices.begin(); i != _devices.end(); i++) {
+		if ((*i)->chargeFlowCredit())
+			_controller->handleFlowEvent(*i);
 	}
 }
 
+ApplicationController::LedsLock::LedsLock(const vector<MonomeXXhDevice *> &devices) : _devices(devices)
+{
+	for (vector<MonomeXXhDevice *>::const_iterator i = _devices.begin(); i != _devices.end(); i++)
+		(*i)->lockLeds();
+}
+
+ApplicationController::LedsLock::~LedsLock()
+{
+	for (vector<MonomeXXhDevice *>::const_reverse_iterator i = _devices.rbegin(); i != _devices.rend(); i++)
+		(*i)->unlockLeds();
+}
+
 
 void 
 ApplicationController::_initCoreMIDI(void)
 {
-    _cCoreMIDI = new CCoreMIDI(_ApplicationController_MIDIReceivedCallback, this);
+    _cCoreMIDI = new CCoreMIDI(_ApplicationController_MIDIReceivedCallback, this, _ApplicationController_MIDISysExReceivedCallback);
 
 #ifdef DEBUG_PRINT
 	cout << "successfully created CCoreMIDI midi controller." << endl;
@@ -747,6 +1751,56 @@ ApplicationController::_initCoreMIDI(void)
 }
 
 
+void 
+ApplicationController::_handleOscSubscribeMessage(OscMessageStream &stream, const string &prefix, const string &suffix)
+{
+	if (suffix == kOscDefaultAddrPatternUnsubscribeSuffix) {
+		if (!stream.typetagMatch(kOscDefaultTypeTagsUnsubscribe))
+			return;
+
+		string host(stream.getString());
+		string port(_intToString(stream.getInt32()));
+		OscHostRef destination = _oscController.getOscHostRef(host, port, true);
+
+		// drops the subscription's reference as well as the one just taken
+		if (_inputSubscriptions.unsubscribe(prefix, destination))
+			_oscController.releaseOscHostRef(destination);
+
+		_oscController.releaseOscHostRef(destination);
+		return;
+	}
+
+	bool rect = stream.typetagMatch(kOscDefaultTypeTagsSubscribeRect);
+
+	if (!rect && !stream.typetagMatch(kOscDefaultTypeTagsSubscribe))
+		return;
+
+	// a pattern with an unclosed [ or { would never match
+	if (OscAddressPattern::isPattern(prefix) && !OscAddressPattern(prefix).valid())
+		return;
+
+	string host(stream.getString());
+	string port(_intToString(stream.getInt32()));
+	unsigned int events;
+	unsigned int column = 0, row = 0, width = 0, height = 0;
+
+	if (!_inputEventsFromString(stream.getString(), events))
+		return;
+
+	if (rect) {
+		column = stream.getInt32();
+		row = stream.getInt32();
+		width = stream.getInt32();
+		height = stream.getInt32();
+	}
+
+	OscHostRef destination = _oscController.getOscHostRef(host, port, true);
+
+	// a destination already subscribed keeps the reference it took the first time
+	if (!_inputSubscriptions.subscribe(prefix, destination, events, column, row, width, height))
+		_oscController.releaseOscHostRef(destination);
+}
+
 void 
 ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 {
@@ -776,9 +1830,11 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 					packet << osc::BeginMessage(systemPrefixString.c_str()) << (int)index << newPrefix.c_str() << osc::EndMessage;
 
 					_oscController.send(device->OscHostRef(), packet);
-					_appController->updateAddressPatternPrefix();
 				}
 			}
+
+			if (_observer != 0)
+				_observer->addressPatternPrefixChanged("");
 		}
 		else {
 			if (msg.typetagMatch(kOscDefaultTypeTagsSysPrefixSingle)) {
@@ -809,10 +1865,9 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 				<< device->oscAddressPatternPrefix().c_str() << osc::EndMessage;
 
 			_oscController.send(device->OscHostRef(), p);
-			if ( device->serialNumber() == _appController->getSelectedSerial() ) {
-				// update GUI
-				_appController->updateAddressPatternPrefix();
-			}
+
+			if (_observer != 0)
+				_observer->addressPatternPrefixChanged(device->serialNumber());
 		}
 	}
 	else if (addressPattern == kOscDefaultAddrPatternSystemCable) {
@@ -833,10 +1888,9 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 
             for (i = _devices.begin(); i != _devices.end(); i++) 
                 (*i)->setCableOrientation(o);
-				
-			// update GUI
 
-			_appController->updateCable();
+			if (_observer != 0)
+				_observer->cableOrientationChanged("");
 		}
 		else {
             if (msg.typetagMatch(kOscDefaultTypeTagsSysCableSingle)) {
@@ -871,10 +1925,8 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 
 			device->setCableOrientation(o);
 
-			if ( device->serialNumber() == _appController->getSelectedSerial() ) {
-				// update GUI
-				_appController->updateCable();
-			}
+			if (_observer != 0)
+				_observer->cableOrientationChanged(device->serialNumber());
 		}
     }
     else if (addressPattern == kOscDefaultAddrPatternSystemOffset) {
@@ -889,9 +1941,8 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
                 device->setOscStartRow(y);
             }
 
-			// update GUI
-			_appController->updateStartingColumn();
-			_appController->updateStartingRow();
+			if (_observer != 0)
+				_observer->offsetChanged("");
         }
 		else {
 			if (msg.typetagMatch(kOscDefaultTypeTagsSysOffsetSingle)) {
@@ -915,11 +1966,9 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
             
 			device->setOscStartColumn(x);
             device->setOscStartRow(y);	
-			// update GUI
-			if ( device->serialNumber() == _appController->getSelectedSerial() ) {
-				_appController->updateStartingColumn();
-				_appController->updateStartingRow();
-			}
+
+			if (_observer != 0)
+				_observer->offsetChanged(device->serialNumber());
         }
     }
     else if (addressPattern == kOscDefaultAddrPatternSystemLedIntensity) {
@@ -979,6 +2028,107 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 
             device->oscLedTestStateChangeEvent(state);
         }
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemEncInterval) {
+		if (msg.typetagMatch(kOscDefaultTypeTagsSysEncIntervalAll)) {
+			int interval = msg.getInt32();
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setEncoderInterval(interval > 0 ? interval : 0);
+        }
+		else {
+			if (msg.typetagMatch(kOscDefaultTypeTagsSysEncIntervalSingle)) {
+				index = msg.getInt32();
+				device = deviceAtIndex(index);
+			}
+			else if(msg.typetagMatch(kOscDefaultTypeTagsSysEncIntervalSingleSerial)) {
+				std::string serialNum = msg.getString();
+				device = deviceBySerial(serialNum, index);
+			}
+			else {
+				return;
+			}
+
+			if (!device) {
+				return;
+			}
+
+			int interval = msg.getInt32();
+
+            device->setEncoderInterval(interval > 0 ? interval : 0);
+        }
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemEncAccel) {
+		if (msg.typetagMatch(kOscDefaultTypeTagsSysEncAccelAll)) {
+			float acceleration = msg.getFloat();
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setEncoderAcceleration(acceleration);
+        }
+		else {
+			if (msg.typetagMatch(kOscDefaultTypeTagsSysEncAccelSingle)) {
+				index = msg.getInt32();
+				device = deviceAtIndex(index);
+			}
+			else if(msg.typetagMatch(kOscDefaultTypeTagsSysEncAccelSingleSerial)) {
+				std::string serialNum = msg.getString();
+				device = deviceBySerial(serialNum, index);
+			}
+			else {
+				return;
+			}
+
+			if (!device) {
+				return;
+			}
+
+			float acceleration = msg.getFloat();
+
+            device->setEncoderAcceleration(acceleration);
+        }
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemFilter) {
+		bool all = msg.typetagMatch(kOscDefaultTypeTagsSysFilterAll);
+
+		if (!all) {
+			if (msg.typetagMatch(kOscDefaultTypeTagsSysFilterSingle)) {
+				index = msg.getInt32();
+				device = deviceAtIndex(index);
+			}
+			else if(msg.typetagMatch(kOscDefaultTypeTagsSysFilterSingleSerial)) {
+				std::string serialNum = msg.getString();
+				device = deviceBySerial(serialNum, index);
+			}
+			else {
+				return;
+			}
+
+			if (!device) {
+				return;
+			}
+		}
+
+		int sensor = msg.getInt32();
+		float deadband = msg.getFloat();
+		int interval = msg.getInt32();
+		string smoothingString = msg.getString();
+		float amount = msg.getFloat();
+		SensorFilter::Smoothing smoothing;
+
+		if (smoothingString == kOscSensorFilterSmoothingOnePole)
+			smoothing = SensorFilter::kSmoothing_OnePole;
+		else if (smoothingString == kOscSensorFilterSmoothingMedian)
+			smoothing = SensorFilter::kSmoothing_Median;
+		else
+			smoothing = SensorFilter::kSmoothing_None;
+
+		if (all) {
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setSensorFilter(sensor, deadband, interval > 0 ? interval : 0, smoothing, amount);
+		}
+		else {
+			device->setSensorFilter(sensor, deadband, interval > 0 ? interval : 0, smoothing, amount);
+		}
     }
 	else if (addressPattern == kOscDefaultAddrPatternSystemGrids)
 	{
@@ -993,6 +2143,132 @@ ApplicationController::_handleOscSystemMessage(OscMessageStream msg)
 		}
 	}
 
+    else if (addressPattern == kOscDefaultAddrPatternSystemTimestamp) {
+		MonomeXXhDevice::InputTimestamps timestamps;
+
+		if (msg.typetagMatch(kOscDefaultTypeTagsSysTimestampAll)) {
+			if (!_inputTimestampsFromString(msg.getString(), timestamps))
+				return;
+
+            for (i = _devices.begin(); i != _devices.end(); i++) 
+                (*i)->setInputTimestamps(timestamps);
+        }
+		else {
+			if (msg.typetagMatch(kOscDefaultTypeTagsSysTimestampSingle)) {
+				index = msg.getInt32();
+				device = deviceAtIndex(index);
+			}
+			else if(msg.typetagMatch(kOscDefaultTypeTagsSysTimestampSingleSerial)) {
+				std::string serialNum = msg.getString();
+				device = deviceBySerial(serialNum, index);
+			}
+			else {
+				return;
+			}
+
+			if (!device || !_inputTimestampsFromString(msg.getString(), timestamps)) {
+				return;
+			}
+
+            device->setInputTimestamps(timestamps);
+        }
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemFlow) {
+		MonomeXXhDevice::FlowMode mode;
+
+		if (msg.argumentCount() == 0) {
+			for (i = _devices.begin(); i != _devices.end(); i++)
+				handleFlowEvent(*i);
+		}
+		else if (msg.typetagMatch(kOscDefaultTypeTagsSysFlowAll)) {
+			if (!_flowModeFromString(msg.getString(), mode))
+				return;
+
+			for (i = _devices.begin(); i != _devices.end(); i++) {
+				(*i)->setFlowMode(mode);
+				handleFlowEvent(*i);
+			}
+		}
+		else {
+			if (msg.typetagMatch(kOscDefaultTypeTagsSysFlowSingle)) {
+				index = msg.getInt32();
+				device = deviceAtIndex(index);
+			}
+			else if (msg.typetagMatch(kOscDefaultTypeTagsSysFlowSingleSerial)) {
+				std::string serialNum = msg.getString();
+				device = deviceBySerial(serialNum, index);
+			}
+			else {
+				return;
+			}
+
+			if (!device || !_flowModeFromString(msg.getString(), mode)) {
+				return;
+			}
+
+			device->setFlowMode(mode);
+			handleFlowEvent(device);
+		}
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemStats) {
+		if (msg.argumentCount() != 0)
+			return;
+
+		for (index = 0; index < _devices.size(); index++) {
+			MonomeXXhDevice::LinkStats stats;
+			char buffer[OUTPUT_BUFFER_SIZE];
+			osc::OutboundPacketStream packet( buffer, OUTPUT_BUFFER_SIZE );
+
+			device = _devices[index];
+			device->linkStats(stats);
+
+			packet << osc::BeginMessage( kOscDefaultAddrPatternSystemStats ) << (int)index
+				<< stats.capacity << stats.throughput << stats.writeTime << stats.flushInterval
+				<< (int)stats.interactiveLeds << osc::EndMessage;
+
+			_oscController.send(device->OscHostRef(), packet);
+		}
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemClock) {
+		if (msg.argumentCount() != 0)
+			return;
+
+		// the server's own clock next to the wall clock time stamps are given in, read together
+		char buffer[OUTPUT_BUFFER_SIZE];
+		osc::OutboundPacketStream packet( buffer, OUTPUT_BUFFER_SIZE );
+		HostTime now = EventScheduler::now();
+
+		packet << osc::BeginMessage( kOscDefaultAddrPatternSystemClock )
+			<< osc::TimeTag(EventScheduler::ntpTimeFromHostTime(now))
+			<< osc::TimeTag(_ntpTimeFromHostTime(now))
+			<< osc::EndMessage;
+
+		_oscController.send(_oscController.getOscHostRef(_oscHostAddressString, _oscHostPort, false), packet);
+    }
+    else if (addressPattern == kOscDefaultAddrPatternSystemRealtime) {
+		if (msg.typetagMatch(kOscDefaultTypeTagsSysRealtime)) {
+			RealtimeThread::setEnabled(msg.getInt32() != 0);
+		}
+		else if (msg.typetagMatch(kOscDefaultTypeTagsSysRealtimeAffinity)) {
+			RealtimeThread::ThreadClass threadClass;
+
+			if (!_realtimeThreadClassFromString(msg.getString(), threadClass))
+				return;
+
+			RealtimeThread::setAffinity(threadClass, (DWORD_PTR)(unsigned int)msg.getInt32());
+		}
+		else if (msg.argumentCount() == 0) {
+			char buffer[OUTPUT_BUFFER_SIZE];
+			osc::OutboundPacketStream packet( buffer, OUTPUT_BUFFER_SIZE );
+
+			packet << osc::BeginMessage( kOscDefaultAddrPatternSystemRealtime )
+				<< (int)RealtimeThread::enabled()
+				<< (int)RealtimeThread::allocationCount()
+				<< osc::EndMessage;
+
+			_oscController.send(_oscController.getOscHostRef(_oscHostAddressString, _oscHostPort, false), packet);
+		}
+    }
     else if (addressPattern == kOscDefaultAddrPatternSystemReport) {
 
 		OscHostRef oscHost = _oscController.getOscHostRef(_oscHostAddressString, _oscHostPort,false);
@@ -1265,7 +2541,7 @@ ApplicationController::oscHostAddressTextFieldChanged(unsigned int deviceIndex,
 
 	const string& oldHostAddressStr = device->OscHostAddress();
 	unsigned int oscHostPort = device->OscHostPort();
-	const string oscHostPortStr = CMonomeSerialDlg::IntToString(oscHostPort);
+	const string oscHostPortStr = _intToString(oscHostPort);
 
 	if (oscHostAddressString == oldHostAddressStr)
 		return;
@@ -1297,8 +2573,8 @@ ApplicationController::oscHostPortTextFieldChanged(unsigned int deviceIndex, con
 	if (!device) return;
 
 	unsigned int oldOscHostPort = device->OscHostPort();
-	unsigned int newOscHostPort = CMonomeSerialDlg::StringToInt(oscHostPortString);
-	string oldOscHostPortStr = CMonomeSerialDlg::IntToString(oldOscHostPort);
+	unsigned int newOscHostPort = atoi(oscHostPortString.c_str());
+	string oldOscHostPortStr = _intToString(oldOscHostPort);
 
 	// if ports are the same, don't do anything
 	if (oldOscHostPort == newOscHostPort)
@@ -1332,8 +2608,8 @@ ApplicationController::oscListenPortTextFieldChanged(unsigned int deviceIndex, c
 	if (!device) return;
 
 	unsigned int oldOscListenPort = device->OscListenPort();
-	unsigned int newOscListenPort = CMonomeSerialDlg::StringToInt(oscListenPortString);
-	string oldOscListenPortStr = CMonomeSerialDlg::IntToString(oldOscListenPort);
+	unsigned int newOscListenPort = atoi(oscListenPortString.c_str());
+	string oldOscListenPortStr = _intToString(oldOscListenPort);
 
 	if (oldOscListenPort == newOscListenPort)
 		return;
@@ -1381,10 +2657,12 @@ ApplicationController::midiInputDeviceChanged(unsigned int deviceIndex, unsigned
 	}
 	catch(...) {
 		endpoint = 0;
-		_appController->updateMidiInputDevice();
+		if (_observer != 0)
+			_observer->midiInputDeviceChanged(device->serialNumber());
 	}
 
 	device->setMIDIInputDevice(endpoint);
+	_rebuildMIDIInputIndex();
 
 	// if oldEndpoint is NULL, or endpoint == oldEndpoint (no change), we can return...
     if (oldEndpoint == 0 || oldEndpoint == endpoint)
@@ -1438,7 +2716,8 @@ ApplicationController::midiOutputDeviceChanged(unsigned int deviceIndex, unsigne
 	}
 	catch(...) {
 		endpoint = 0;
-		_appController->updateMidiOutputDevice();
+		if (_observer != 0)
+			_observer->midiOutputDeviceChanged(device->serialNumber());
 	}
 
 	device->setMIDIOutputDevice(endpoint);
@@ -1780,36 +3059,237 @@ ApplicationController::_typeCheckRowOrColumnMessage(OscMessageStream msg)
 	return msg.typetagMatch("ii") || msg.typetagMatch("iii");
 }
 
+// a mode, then the interval, steps, column, row, width, height and the rest as numbers
+bool 
+ApplicationController::_typeCheckAnimationMessage(OscMessageStream msg)
+{
+	const char *typetags = msg.typetags();
+
+	if (msg.argumentCount() < 8 || typetags[0] != 's')
+		return false;
+
+	for (int i = 1; i < msg.argumentCount(); i++) {
+		if (typetags[i] != 'i' && typetags[i] != 'f')
+			return false;
+	}
+
+	return true;
+}
+
+// the position and size, then a row bitmap for each row
+bool 
+ApplicationController::_typeCheckBlitMessage(OscMessageStream msg)
+{
+	const char *typetags = msg.typetags();
+
+	if (msg.argumentCount() < 5)
+		return false;
+
+	for (int i = 0; i < msg.argumentCount(); i++) {
+		if (typetags[i] != 'i')
+			return false;
+	}
+
+	return true;
+}
+
+void 
+ApplicationController::_ledBounds(const vector<MonomeXXhDevice *> &devices, unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height)
+{
+	unsigned int left = UINT_MAX, top = UINT_MAX, right = 0, bottom = 0;
+	vector<MonomeXXhDevice *>::const_iterator i;
+
+	for (i = devices.begin(); i != devices.end(); i++) {
+		unsigned int column, row, width, height;
+
+		(*i)->oscLedBounds(column, row, width, height);
+
+		if (column < left)
+			left = column;
+		if (row < top)
+			top = row;
+		if (column + width > right)
+			right = column + width;
+		if (row + height > bottom)
+			bottom = row + height;
+	}
+
+	if (left > right || top > bottom)
+		left = right = top = bottom = 0;
+
+	column = left;
+	row = top;
+	width = right - left;
+	height = bottom - top;
+}
+
+LedBitmap 
+ApplicationController::_readLedBitmap(const vector<MonomeXXhDevice *> &devices)
+{
+	unsigned int column, row, width, height;
+	vector<MonomeXXhDevice *>::const_iterator i;
+
+	_ledBounds(devices, column, row, width, height);
+
+	LedBitmap bitmap(column, row, width, height);
+
+	for (i = devices.begin(); i != devices.end(); i++)
+		(*i)->readOscLedBitmap(bitmap);
+
+	return bitmap;
+}
+
+void 
+ApplicationController::_writeLedBitmap(const vector<MonomeXXhDevice *> &devices, const LedBitmap &bitmap)
+{
+	vector<MonomeXXhDevice *>::const_iterator i;
+
+	for (i = devices.begin(); i != devices.end(); i++)
+		(*i)->writeOscLedBitmap(bitmap);
+}
+
 void 
-ApplicationController::_handleMIDIMessage(MonomeXXhDevice *device, unsigned char status, unsigned char data1, unsigned char data2)
+ApplicationController::_handleMIDIMessage(MonomeXXhDevice *device, const MIDIInputEvent &event)
 {
 	if (device == 0)
 		return;
 
-	if ((status & 0xF0) == 0x90 && (status & 0xF) == device->MIDIInputChannel()) {
-		device->MIDILedStateChangeEvent(data1, data2);
+	unsigned char channel = device->MIDIInputChannel();
+	MIDILedEvent ledEvent;
+
+	ledEvent.command = kMIDILedNote;
+
+	if (event.channel == channel) {
+		if (event.type == 0x90 || event.type == 0x80) {
+			ledEvent.index = event.data1;
+			ledEvent.velocity = event.type == 0x90 ? event.data2 : 0;
+			_scheduleMIDILedEvent(device, ledEvent, event.time);
+		}
+		else if (event.type == 0xB0) {
+			if (event.data1 < 4) {
+				device->oscAdcEnableStateChangeEvent(event.data1, event.data2 >= 64);
+
+				if (_observer != 0)
+					_observer->adcStatesChanged(device->serialNumber());
+			}
+			else if (event.data1 < 6) {
+				device->oscEncEnableStateChangeEvent(event.data1 - 4, event.data2 >= 64);
+
+				if (_observer != 0)
+					_observer->encStatesChanged(device->serialNumber());
+			}
+		}
 	}
-	else if ((status & 0xF0) == 0x80 && (status & 0xF) == device->MIDIInputChannel()) {
-		device->MIDILedStateChangeEvent(data1, 0);
+	else if (event.channel == (channel + 1) % 16) { //so next channel can reach the other half of the 256 LED's
+		if (event.type == 0x90 || event.type == 0x80) {
+			ledEvent.index = event.data1 + 128;
+			ledEvent.velocity = event.type == 0x90 ? event.data2 : 0;
+			_scheduleMIDILedEvent(device, ledEvent, event.time);
+		}
 	}
-	else if ((status & 0xF0) == 0xB0 && (status & 0xF) == device->MIDIInputChannel()) {
-		if (data1 < 4) {
-			device->oscAdcEnableStateChangeEvent(data1, data2 >= 64);
+}
 
-			// update GUI
-			_appController->UpdateAdcStates();
-		}
-		else if (data1 < 6) {
-			device->oscEncEnableStateChangeEvent(data1 - 4, data2 >= 64);
+void 
+ApplicationController::_handleMIDISysEx(MonomeXXhDevice *device, unsigned char command, const unsigned char *data, unsigned int length, HostTime time)
+{
+	MIDILedEvent event;
+	uint16 *bitMaps = event.bitMaps;
+	unsigned int index = 0, numBits;
+
+	if (command == kMIDISysExLedLatency || command == kMIDISysExEncInterval || command == kMIDISysExEncAccel) {
+		if (length < 2)
+			return;
+
+		unsigned int value = data[0] | (data[1] << 7);
+
+		// latency takes effect for events received from now on
+		if (command == kMIDISysExLedLatency)
+			device->setMIDILedLatency(value);
+		else if (command == kMIDISysExEncInterval)
+			device->setEncoderInterval(value);
+		else
+			device->setEncoderAcceleration(value / 100.f);
+		return;
+	}
+	else if (command == kMIDISysExSensorFilter) {
+		if (length < 8)
+			return;
+
+		device->setSensorFilter(data[0],
+								(data[1] | (data[2] << 7)) / 1000.f,
+								data[3] | (data[4] << 7),
+								(SensorFilter::Smoothing)(data[5] <= SensorFilter::kSmoothing_Median ? data[5] : SensorFilter::kSmoothing_None),
+								(data[6] | (data[7] << 7)) / 100.f);
+		return;
+	}
+	else if (command == kMIDISysExLedRow || command == kMIDISysExLedColumn) {
+		if (length < 1)
+			return;
+
+		index = data[0];
+		data++;
+		length--;
+		numBits = command == kMIDISysExLedRow ? device->columns() : device->rows();
+	}
+	else if (command == kMIDISysExLedFrame) {
+		numBits = device->rows() * device->columns();
+	}
+	else {
+		return;
+	}
+
+	// unpack the 7 bit stream: bit n is bit (n % 7) of data byte n / 7, missing bytes read as off
+	memset(event.bitMaps, 0, sizeof(event.bitMaps));
 
-				// update GUI
-			_appController->UpdateEncStates();
-		}                                    
+	for (unsigned int n = 0; n < numBits && n / 7 < length; n++) {
+		if (data[n / 7] & (1 << (n % 7))) {
+			if (command == kMIDISysExLedFrame)
+				bitMaps[n / device->columns()] |= 1 << (n % device->columns());
+			else
+				bitMaps[0] |= 1 << n;
+		}
 	}
 
-	if ((status & 0xF0) == 0x90 && (status & 0xF) == (device->MIDIInputChannel()+1)%16) //so next channel can reach the other half of the 256 LED's
-		device->MIDILedStateChangeEvent(data1+128, data2);
-	else if ((status & 0xF0) == 0x80 && (status & 0xF) == (device->MIDIInputChannel()+1)%16) 
-		device->MIDILedStateChangeEvent(data1+128, 0);	
+	event.command = command;
+	event.index = index;
+	_scheduleMIDILedEvent(device, event, time);
+}
+
+void 
+ApplicationController::_scheduleMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event, HostTime time)
+{
+	HostTime due = time + EventScheduler::hostTimeFromMilliseconds(device->MIDILedLatency());
+
+	// anything already due goes straight out, unless it would overtake events still queued
+	if (due <= EventScheduler::now() && !_ledScheduler.hasPendingEvents())
+		_applyMIDILedEvent(device, event);
+	else if (!_ledScheduler.schedule(due, _ApplicationController_MIDILedEventCallback, this, device, &event, sizeof(event)))
+		_applyMIDILedEvent(device, event);
+}
+
+void 
+ApplicationController::_applyMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event)
+{
+	if (event.command == kMIDILedNote)
+		device->MIDILedStateChangeEvent(event.index, event.velocity);
+	else if (event.command == kMIDISysExLedRow)
+		device->MIDILedRowEvent(event.index, event.bitMaps[0]);
+	else if (event.command == kMIDISysExLedColumn)
+		device->MIDILedColumnEvent(event.index, event.bitMaps[0]);
+	else if (event.command == kMIDISysExLedFrame)
+		device->MIDILedFrameEvent(event.bitMaps);
 }
 
+void 
+ApplicationController::_rebuildMIDIInputIndex(void)
+{
+	ApplicationControllerLock lock(this);
+
+	_midiInputIndex.clear();
+
+	vector<MonomeXXhDevice *>::iterator i;
+	for (i = _devices.begin(); i != _devices.end(); i++) {
+		if (*i != 0 && (*i)->MIDIInputDevice() != 0)
+			_midiInputIndex[(*i)->MIDIInputDevice()].push_back(*i);
+	}
+}
@@ -26,14 +26,21 @@
 #ifndef __ApplicationController_h__
 #define __ApplicationController_h__
 
-#include "MonomeSerialDlg.h"
+#include "ApplicationControllerObserver.h"
+#include "CoalescingObserver.h"
 #include "serial/MonomeXXhDevice.h"
+#include "serial/LedCanvas.h"
+#include "serial/MessageBatch.h"
 #include "serial/AsynchronousSerialDeviceReader.h"
 #include "osc/OscController.h"
 #include "osc/OscMessageStream.h"
+#include "osc/OscAddressPattern.h"
 #include "MonomeSerialDefaults.h"
+#include "EventScheduler.h"
+#include "InputSubscriptions.h"
 
 #include <vector>
+#include <map>
 using namespace std;
 using namespace osc;
 
@@ -49,7 +56,7 @@ typedef enum {
 } ProtocolType;
 
 public:
-	ApplicationController(CMonomeSerialDlg* appController);
+	ApplicationController(ApplicationControllerObserver *observer);	// observer may be 0
 	~ApplicationController(void);
 
 	void registerForSerialDeviceNotifications(void);
@@ -63,13 +70,21 @@ public:
     void handleButtonPressEvent(MonomeXXhDevice *device, unsigned int localColumn, unsigned int localRow, bool state);
     void handleAdcValueChangeEvent(MonomeXXhDevice *device, unsigned int localAdcIndex, float value);
     void handleRotaryEncoderEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps);
+	void handleEncoderSendEvent(MonomeXXhDevice *device, unsigned int localEncoderIndex);
+	void handleSensorRetryEvent(MonomeXXhDevice *device, unsigned int sensor);
 
 	// Handler for 64 aux message, which is Tilt - thanks steve!
 	void handleTiltValueChangeEvent(MonomeXXhDevice *device, int WhichAxis, float value);
 
     // Handlers for OpenSoundControl/MIDI events:
     void handleOscMessage(const osc::ReceivedMessage &msg);
-    void handleMIDIReceived(DWORD msg, CCoreMIDIEndpointRef source);
+    void handleMIDIReceived(DWORD msg, HostTime time, CCoreMIDIEndpointRef source);
+    void handleMIDISysExReceived(const unsigned char *data, unsigned int length, HostTime time, CCoreMIDIEndpointRef source);
+	void handleScheduledMIDILedEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+	void handleLedAnimationEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+	void handleAutoSwapEvent(MonomeXXhDevice *device, const void *data, unsigned int length);
+	void handleSwapEvent(MonomeXXhDevice *device, double milliseconds);
+	void handleFlowEvent(MonomeXXhDevice *device);
 
     // Handlers for UI events:
     void protocolPopUpMenuChanged(unsigned int index);
@@ -120,7 +135,136 @@ private:
     void _initOpenSoundControl(void);
     bool _typeCheckOscAtoms(const osc::ReceivedMessage &msg, const char *typetags);
     bool _typeCheckRowOrColumnMessage(OscMessageStream msg);
-	void _handleMIDIMessage(MonomeXXhDevice *device, unsigned char status, unsigned char data1, unsigned char data2);
+	bool _typeCheckAnimationMessage(OscMessageStream msg);
+	bool _typeCheckBlitMessage(OscMessageStream msg);
+
+	// the rectangle of osc coordinates covered by every device in devices
+	void _ledBounds(const vector<MonomeXXhDevice *> &devices, unsigned int &column, unsigned int &row, unsigned int &width, unsigned int &height);
+	// the leds of every device in devices, as one bitmap over the osc coordinates they
+	// cover.  the reads and the write back go under one LedsLock of the devices.
+	LedBitmap _readLedBitmap(const vector<MonomeXXhDevice *> &devices);
+	void _writeLedBitmap(const vector<MonomeXXhDevice *> &devices, const LedBitmap &bitmap);
+
+	// the next step of a device's led animation, or its next automatic swap, for the led scheduler
+	typedef struct {
+		unsigned int generation;
+		HostTime time;			// when the step is due
+	} LedAnimationStep;
+
+	void _startLedAnimation(MonomeXXhDevice *device, const LedAnimation &animation);
+	void _setDoubleBuffered(MonomeXXhDevice *device, bool doubleBuffered, unsigned int autoSwapInterval);
+
+	// charges each device a message went to its flow credit once the message has been
+	// handled, however handling it returns
+	class FlowCharge {
+	public:
+		FlowCharge(ApplicationController *controller, const vector<MonomeXXhDevice *> &devices) : _controller(controller), _devices(devices) { }
+		~FlowCharge();
+
+	private:
+		ApplicationController *_controller;
+		const vector<MonomeXXhDevice *> &_devices;
+	};
+
+	// holds the leds of every device a canvas operation reads, changes and writes back, so
+	// nothing drawn on them meanwhile is lost.  only the osc thread holds more than one
+	// device at a time, so taking them in the canvas' order can't deadlock.
+	class LedsLock {
+	public:
+		LedsLock(const vector<MonomeXXhDevice *> &devices);
+		~LedsLock();
+
+	private:
+		const vector<MonomeXXhDevice *> &_devices;
+	};
+
+	// a short MIDI message, decoded once and then applied to every device listening on its source
+	typedef struct {
+		unsigned char type;		// status with the channel masked off: 0x80, 0x90, 0xB0...
+		unsigned char channel;
+		unsigned char data1;
+		unsigned char data2;
+		HostTime time;			// when the driver received it
+	} MIDIInputEvent;
+
+	// an led update from MIDI, copied into the scheduler until its timestamp comes round
+	typedef struct {
+		unsigned char command;	// kMIDILedNote or one of the SysEx led commands
+		unsigned char index;	// note number, row or column
+		unsigned char velocity;
+		uint16 bitMaps[16];
+	} MIDILedEvent;
+
+	typedef map<CCoreMIDIEndpointRef, vector<MonomeXXhDevice *> > MIDIInputIndex;
+
+	// bulk led SysEx, documented in README.md:
+	//   F0 7D 6D <command << 4 | channel> [row or column] <bitmap, 7 bits per byte> F7
+	enum {
+		kMIDISysExManufacturerID = 0x7D,	// reserved for non-commercial use
+		kMIDISysExMonomeID = 0x6D,			// 'm'
+		kMIDISysExHeaderSize = 4,
+		kMIDISysExLedRow = 1,
+		kMIDISysExLedColumn = 2,
+		kMIDISysExLedFrame = 3,
+		kMIDISysExLedLatency = 4,		// F0 7D 6D <4 << 4 | channel> <ms, low 7 bits> <ms, high 7 bits> F7
+		kMIDISysExEncInterval = 5,		// same layout, in milliseconds
+		kMIDISysExEncAccel = 6,			// same layout, in hundredths
+		kMIDISysExSensorFilter = 7,		// <input> <deadband, thousandths> <interval, ms> <smoothing> <amount, hundredths>, 14 bit values
+		kMIDILedNote = 0
+	};
+
+	void _handleMIDIMessage(MonomeXXhDevice *device, const MIDIInputEvent &event);
+	void _handleMIDISysEx(MonomeXXhDevice *device, unsigned char command, const unsigned char *data, unsigned int length, HostTime time);
+	void _scheduleMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event, HostTime time);
+	void _applyMIDILedEvent(MonomeXXhDevice *device, const MIDILedEvent &event);
+	void _rebuildMIDIInputIndex(void);
+
+	// a device that drops off keeps what it was showing this long, so coming back in time
+	// puts the grid back as it was without the clients redrawing
+	enum { kDeviceRestoreGracePeriod = 60000 };	// milliseconds
+
+	typedef struct {
+		MonomeXXhDevice::OutputState state;
+		HostTime time;		// when it dropped off
+	} DetachedDevice;
+
+	bool _restoreDetachedDevice(MonomeXXhDevice *device);
+
+	// the canvas of devices with prefix, rebuilt when a device comes or goes or moves; 0 if none
+	LedCanvas *_canvasForPrefix(const string &prefix);
+	void _updateCanvases(void);
+
+	// a compiled prefix pattern and the prefixes it matched when the canvases were last rebuilt
+	enum { kMaxPrefixPatterns = 32 };
+
+	typedef struct {
+		OscAddressPattern pattern;
+		unsigned long canvasesGeneration;
+		vector<string> prefixes;
+	} PrefixPattern;
+
+	// the prefixes of the present devices that pattern matches
+	const vector<string> &_prefixesMatching(const string &pattern);
+
+	void _handleOscMessage(OscMessageStream &stream);
+
+	void _handleMessageBatch(MonomeXXhDevice *device, const MessageBatch &batch);
+	void _handleButtonPressRun(MonomeXXhDevice *device, const MessageBatch &batch, unsigned int first, unsigned int count);
+
+	void _accumulateEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex, int steps, HostTime time);
+	void _sendEncoderSteps(MonomeXXhDevice *device, unsigned int localEncoderIndex);
+	void _filterSensorSample(MonomeXXhDevice *device, unsigned int sensor, float sample, HostTime time);
+	void _sendSensorValue(MonomeXXhDevice *device, unsigned int sensor, float value);
+
+	// key, encoder and analog messages, time stamped with the serial read they came from
+	// however the device's input timestamps are set.  begin returns the setting for end, so
+	// a change between the two can't leave a bundle open.
+	MonomeXXhDevice::InputTimestamps _beginInputMessage(osc::OutboundPacketStream &stream, MonomeXXhDevice *device, const char *addressPattern, HostTime time);
+	void _endInputMessage(osc::OutboundPacketStream &stream, MonomeXXhDevice::InputTimestamps timestamps, HostTime time);
+	NtpTime _ntpTimeFromHostTime(HostTime time) const;
+	// sends an input message to the host and on to the subscribers that want it
+	void _sendInputMessage(MonomeXXhDevice *device, const osc::OutboundPacketStream &stream, InputSubscriptions::Event event, unsigned int localColumn = 0, unsigned int localRow = 0);
+	void _handleOscSubscribeMessage(OscMessageStream &stream, const string &prefix, const string &suffix);
 
 
 private:
@@ -133,13 +277,51 @@ private:
 
     vector<MonomeXXhDevice *> _devices;
 
+	// source endpoint -> devices with that MIDI input, rebuilt whenever a device or its input changes
+	MIDIInputIndex _midiInputIndex;
+
+	// serial number -> devices that dropped off in the last kDeviceRestoreGracePeriod
+	map<string, DetachedDevice> _detachedDevices;
+
+	// osc prefix -> its devices' canvas, only touched on the osc thread
+	map<string, LedCanvas> _canvases;
+	unsigned long _canvasLayoutGeneration;
+	long _canvasDevicesGeneration;
+	unsigned long _canvasesGeneration;		// bumped after every rebuild of _canvases
+
+	// prefix pattern -> its compiled form and matches, only touched on the osc thread
+	map<string, PrefixPattern> _prefixPatterns;
+	// the matches of the pattern being handled and each expanded address, kept across
+	// messages so expanding a pattern doesn't allocate once they have grown to fit
+	enum { kMaxMatchedPrefixes = 64 };
+	vector<string> _matchedPrefixes;
+	string _expandedAddressPattern;
+	volatile long _devicesGeneration;	// bumped after every change to _devices
+
+	// plays incoming MIDI led events at their driver timestamp plus the device's latency
+	EventScheduler _ledScheduler;
+
+	// sends accumulated encoder steps and held back sensor values once their interval is up
+	EventScheduler _inputScheduler;
+
+	// destinations besides the host that take some of each prefix's input
+	InputSubscriptions _inputSubscriptions;
+
+	// host time and the wall clock read together at launch.  time stamps count on from
+	// there in host time, so they never jump when the wall clock is set.
+	HostTime _clockHostTime;
+	NtpTime _clockNtpTime;
+
     AsynchronousSerialDeviceReader _deviceReader;
 	
     OscController _oscController;
 
     MonomeSerialDefaults *_defaults;
 
-	CMonomeSerialDlg* _appController;
+	// the observer is only ever called through _coalescingObserver, so a client flooding
+	// /sys or /adc_enable messages never waits on it.  0 when there is no observer.
+	ApplicationControllerObserver *_observer;
+	CoalescingObserver _coalescingObserver;
 
 	// lock needed for Windows version because each device reads on a differant thread.
 	CRITICAL_SECTION _readLock;
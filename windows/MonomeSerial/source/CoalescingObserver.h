@@ -0,0 +1,95 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#ifndef __CoalescingObserver_h__
+#define __CoalescingObserver_h__
+
+#include "ApplicationControllerObserver.h"
+#include "EventScheduler.h"
+
+#include <string>
+
+// stands between ApplicationController and its real observer.  each call only marks what
+// changed and returns; the marks are handed on from a low priority scheduler thread at most
+// once per interval, one call per kind of change.  when the same kind of change hits more
+// than one device inside an interval it goes on as a change to every device.
+class CoalescingObserver : public ApplicationControllerObserver
+{
+public:
+	enum { kDefaultInterval = 50 };	// milliseconds
+
+public:
+	CoalescingObserver(ApplicationControllerObserver *observer, unsigned int interval = kDefaultInterval);
+	virtual ~CoalescingObserver(void);
+
+	void start(void);
+	void stop(void);		// drops anything not handed on yet
+
+	void setInterval(unsigned int milliseconds);
+	unsigned int interval(void) const;
+
+	void flush(void);		// hands on the pending changes now
+
+	virtual void deviceListChanged(void);
+	virtual void midiDeviceListChanged(void);
+	virtual void addressPatternPrefixChanged(const std::string& serialNumber);
+	virtual void cableOrientationChanged(const std::string& serialNumber);
+	virtual void offsetChanged(const std::string& serialNumber);
+	virtual void adcStatesChanged(const std::string& serialNumber);
+	virtual void encStatesChanged(const std::string& serialNumber);
+	virtual void midiInputDeviceChanged(const std::string& serialNumber);
+	virtual void midiOutputDeviceChanged(const std::string& serialNumber);
+
+private:
+	typedef enum {
+		kChange_DeviceList,
+		kChange_MIDIDeviceList,
+		kChange_AddressPatternPrefix,
+		kChange_CableOrientation,
+		kChange_Offset,
+		kChange_AdcStates,
+		kChange_EncStates,
+		kChange_MIDIInputDevice,
+		kChange_MIDIOutputDevice,
+		kNumChanges
+	} Change;
+
+	static void _flushCallback(void *target, const void *data, unsigned int length, void *userData);
+
+	void _mark(Change change, const std::string& serialNumber);
+
+private:
+	ApplicationControllerObserver *_observer;
+	EventScheduler _scheduler;
+	unsigned int _interval;
+
+	CRITICAL_SECTION _lock;
+	unsigned int _pending;							// bit n is set while change n waits
+	std::string _serialNumbers[kNumChanges];		// the one device that changed, or empty for all
+};
+
+#endif // __CoalescingObserver_h__
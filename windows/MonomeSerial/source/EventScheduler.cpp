@@ -0,0 +1,251 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#include "stdafx.h"
+#include "EventScheduler.h"
+#include "RealtimeThread.h"
+
+#include <mmsystem.h>
+
+
+EventScheduler::EventScheduler(void)
+{
+	_thread = 0;
+	_timeCritical = false;
+	_terminate = false;
+	_wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	_timer = CreateWaitableTimer(NULL, FALSE, NULL);
+
+	InitializeCriticalSection(&_lock);
+	InitializeCriticalSection(&_deliveryLock);
+}
+
+EventScheduler::~EventScheduler(void)
+{
+	stop();
+
+	CloseHandle(_timer);
+	CloseHandle(_wakeEvent);
+
+	DeleteCriticalSection(&_deliveryLock);
+	DeleteCriticalSection(&_lock);
+}
+
+void 
+EventScheduler::start(bool timeCritical)
+{
+	if (_thread != 0)
+		return;
+
+	// waitable timers only fire as often as the system timer ticks
+	timeBeginPeriod(1);
+
+	_terminate = false;
+	_timeCritical = timeCritical;
+	_thread = CreateThread(NULL, 0, _threadProc, this, 0, NULL);
+}
+
+void 
+EventScheduler::stop(void)
+{
+	if (_thread == 0)
+		return;
+
+	_terminate = true;
+	SetEvent(_wakeEvent);
+	WaitForSingleObject(_thread, INFINITE);
+	CloseHandle(_thread);
+	_thread = 0;
+
+	timeEndPeriod(1);
+
+	EventSchedulerLock lock(&_lock);
+	_events.clear();
+}
+
+bool 
+EventScheduler::schedule(HostTime time, EventSchedulerCallback callback, void *userData, void *target, const void *data, unsigned int length)
+{
+	if (callback == 0 || length > kMaxEventDataSize)
+		return false;
+
+	Event event;
+	event.callback = callback;
+	event.userData = userData;
+	event.target = target;
+	event.length = length;
+	memcpy(event.data, data, length);
+
+	EventSchedulerLock lock(&_lock);
+
+	// insert after any events at the same time, and wake the thread if this is now the earliest
+	multimap<HostTime, Event>::iterator i = _events.insert(_events.upper_bound(time), make_pair(time, event));
+	if (i == _events.begin())
+		SetEvent(_wakeEvent);
+
+	return true;
+}
+
+void 
+EventScheduler::cancel(void *target)
+{
+	EventSchedulerLock deliveryLock(&_deliveryLock);
+	EventSchedulerLock lock(&_lock);
+
+	multimap<HostTime, Event>::iterator i = _events.begin();
+	while (i != _events.end()) {
+		if (i->second.target == target)
+			_events.erase(i++);
+		else
+			++i;
+	}
+}
+
+bool 
+EventScheduler::hasPendingEvents(void)
+{
+	EventSchedulerLock lock(&_lock);
+	return !_events.empty();
+}
+
+HostTime 
+EventScheduler::now(void)
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+HostTime 
+EventScheduler::hostTimeFromMilliseconds(double milliseconds)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (HostTime)(milliseconds * (double)frequency.QuadPart / 1000.0);
+}
+
+double 
+EventScheduler::millisecondsFromHostTime(HostTime hostTime)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (double)hostTime * 1000.0 / (double)frequency.QuadPart;
+}
+
+NtpTime 
+EventScheduler::ntpNow(void)
+{
+	FILETIME fileTime;
+	GetSystemTimeAsFileTime(&fileTime);
+
+	// filetime counts 100ns from 1601, ntp seconds from 1900
+	unsigned __int64 ticks = ((unsigned __int64)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+	unsigned __int64 seconds = ticks / 10000000 - 9435484800;
+	unsigned __int64 fraction = ((ticks % 10000000) << 32) / 10000000;
+
+	return (seconds << 32) | fraction;
+}
+
+NtpTime 
+EventScheduler::ntpTimeFromHostTime(HostTime hostTime)
+{
+	double seconds = millisecondsFromHostTime(hostTime) / 1000.0;
+	unsigned __int64 whole = (unsigned __int64)seconds;
+
+	return (whole << 32) | (unsigned __int64)((seconds - (double)whole) * 4294967296.0);
+}
+
+DWORD WINAPI 
+EventScheduler::_threadProc(LPVOID parameter)
+{
+	((EventScheduler *)parameter)->_run();
+	return 0;
+}
+
+void 
+EventScheduler::_run(void)
+{
+	HANDLE handles[2] = { _wakeEvent, _timer };
+	RealtimeThread realtime(RealtimeThread::kThreadClass_Scheduler);
+
+	// set from the thread itself before real time mode first looks, so leaving real time
+	// mode comes back to this rather than to the default
+	SetThreadPriority(GetCurrentThread(), _timeCritical ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_BELOW_NORMAL);
+
+	while (!_terminate) {
+		HostTime time;
+		bool pending;
+
+		if (_timeCritical)
+			realtime.update();
+
+		{
+			EventSchedulerLock lock(&_lock);
+			pending = !_events.empty();
+			if (pending)
+				time = _events.begin()->first;
+		}
+
+		if (!pending) {
+			WaitForSingleObject(_wakeEvent, INFINITE);
+			continue;
+		}
+
+		HostTime current = now();
+		if (time > current) {
+			// relative due times are negative, in 100ns units
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -(LONGLONG)(millisecondsFromHostTime(time - current) * 10000.0);
+			if (dueTime.QuadPart == 0)
+				dueTime.QuadPart = -1;
+
+			SetWaitableTimer(_timer, &dueTime, 0, NULL, NULL, FALSE);
+
+			// an earlier event may have been scheduled meanwhile, so look again either way
+			WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+			continue;
+		}
+
+		EventSchedulerLock deliveryLock(&_deliveryLock);
+
+		for (;;) {
+			Event event;
+
+			{
+				EventSchedulerLock lock(&_lock);
+
+				if (_events.empty() || _events.begin()->first > now())
+					break;
+
+				event = _events.begin()->second;
+				_events.erase(_events.begin());
+			}
+
+			event.callback(event.target, event.data, event.length, event.userData);
+		}
+	}
+}
@@ -1234,6 +1234,76 @@ void CMonomeSerialDlg::UpdateEncStates()
 	}
 }
 
+bool 
+CMonomeSerialDlg::_isSelectedDevice(const std::string& serialNumber)
+{
+	return serialNumber.empty() || serialNumber == getSelectedSerial();
+}
+
+void 
+CMonomeSerialDlg::deviceListChanged(void)
+{
+	updateDeviceList();
+}
+
+void 
+CMonomeSerialDlg::midiDeviceListChanged(void)
+{
+	updateMidiInputDevice();
+	updateMidiOutputDevice();
+}
+
+void 
+CMonomeSerialDlg::addressPatternPrefixChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		updateAddressPatternPrefix();
+}
+
+void 
+CMonomeSerialDlg::cableOrientationChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		updateCable();
+}
+
+void 
+CMonomeSerialDlg::offsetChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber)) {
+		updateStartingColumn();
+		updateStartingRow();
+	}
+}
+
+void 
+CMonomeSerialDlg::adcStatesChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		UpdateAdcStates();
+}
+
+void 
+CMonomeSerialDlg::encStatesChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		UpdateEncStates();
+}
+
+void 
+CMonomeSerialDlg::midiInputDeviceChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		updateMidiInputDevice();
+}
+
+void 
+CMonomeSerialDlg::midiOutputDeviceChanged(const std::string& serialNumber)
+{
+	if (_isSelectedDevice(serialNumber))
+		updateMidiOutputDevice();
+}
+
 void CMonomeSerialDlg::UpdateGuiProtocol(unsigned int index)
 {
 	if (index == ApplicationController::kProtocolType_OpenSoundControl) {
@@ -31,6 +31,7 @@
 #include <string>
 #include <list>
 #include "MonomeSerial.h"
+#include "ApplicationControllerObserver.h"
 
 using namespace std;
 
@@ -56,7 +57,7 @@ typedef struct _deviceTerminatedContext {
 
 
 // CMonomeSerialDlg dialog
-class CMonomeSerialDlg : public CDialog
+class CMonomeSerialDlg : public CDialog, public ApplicationControllerObserver
 {
 	/* ------------- generated code ------------- */
 // Construction
@@ -121,6 +122,21 @@ public:
 	UINT getSelectedDeviceIndex(CString &device);
 	std::string getSelectedSerial(void);
 
+public:
+	// ApplicationControllerObserver
+	virtual void deviceListChanged(void);
+	virtual void midiDeviceListChanged(void);
+	virtual void addressPatternPrefixChanged(const std::string& serialNumber);
+	virtual void cableOrientationChanged(const std::string& serialNumber);
+	virtual void offsetChanged(const std::string& serialNumber);
+	virtual void adcStatesChanged(const std::string& serialNumber);
+	virtual void encStatesChanged(const std::string& serialNumber);
+	virtual void midiInputDeviceChanged(const std::string& serialNumber);
+	virtual void midiOutputDeviceChanged(const std::string& serialNumber);
+
+private:
+	bool _isSelectedDevice(const std::string& serialNumber);
+
 	void AddMidiInputDevices(const list<string>& devices);
 	void AddMidiOutputDevices(const list<string>& devices);
 
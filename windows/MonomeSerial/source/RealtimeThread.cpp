@@ -0,0 +1,185 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#include "stdafx.h"
+#include "RealtimeThread.h"
+
+#if defined(DEBUG_PRINT) && defined(_DEBUG)
+#include <crtdbg.h>
+#define REALTIME_THREAD_COUNT_ALLOCATIONS
+#endif
+
+// the nearest windows has to locking every page: a working set floor big enough to hold
+// the whole process, so the memory manager has no reason to page any of it out
+#define kRealtimeWorkingSetMinimum	(16 * 1024 * 1024)
+#define kRealtimeWorkingSetMaximum	(64 * 1024 * 1024)
+
+static const int kRealtimePriority[RealtimeThread::kNumThreadClasses] = {
+	THREAD_PRIORITY_TIME_CRITICAL,	// reader
+	THREAD_PRIORITY_HIGHEST,		// osc
+	THREAD_PRIORITY_HIGHEST,		// midi
+	THREAD_PRIORITY_TIME_CRITICAL,	// transmit
+	THREAD_PRIORITY_TIME_CRITICAL	// scheduler
+};
+
+volatile long RealtimeThread::_generation = 0;
+bool RealtimeThread::_enabled = false;
+DWORD_PTR RealtimeThread::_affinity[RealtimeThread::kNumThreadClasses] = { 0, 0, 0, 0, 0 };
+
+static DWORD _defaultPriorityClass = NORMAL_PRIORITY_CLASS;
+static SIZE_T _defaultWorkingSetMinimum = 0;
+static SIZE_T _defaultWorkingSetMaximum = 0;
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+static __declspec(thread) bool _onRealtimeThread = false;
+static volatile long _realtimeAllocations = 0;
+static _CRT_ALLOC_HOOK _previousAllocHook = 0;
+
+static int __cdecl 
+_RealtimeThreadAllocHook(int allocType, void *userData, size_t size, int blockType, 
+						 long requestNumber, const unsigned char *filename, int lineNumber)
+{
+	if (_onRealtimeThread && allocType != _HOOK_FREE)
+		InterlockedIncrement(&_realtimeAllocations);
+
+	if (_previousAllocHook != 0)
+		return _previousAllocHook(allocType, userData, size, blockType, requestNumber, filename, lineNumber);
+
+	return TRUE;
+}
+#endif
+
+
+RealtimeThread::RealtimeThread(ThreadClass threadClass)
+{
+	_threadClass = threadClass;
+	_threadId = 0;
+	_appliedGeneration = -1;
+	_realtime = false;
+	_defaultPriority = THREAD_PRIORITY_NORMAL;
+}
+
+void 
+RealtimeThread::setEnabled(bool enabled)
+{
+	if (enabled == _enabled)
+		return;
+
+	HANDLE process = GetCurrentProcess();
+
+	if (enabled) {
+		_defaultPriorityClass = GetPriorityClass(process);
+		SetPriorityClass(process, HIGH_PRIORITY_CLASS);
+
+		if (GetProcessWorkingSetSize(process, &_defaultWorkingSetMinimum, &_defaultWorkingSetMaximum))
+			SetProcessWorkingSetSize(process, kRealtimeWorkingSetMinimum, kRealtimeWorkingSetMaximum);
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+		if (_previousAllocHook == 0)
+			_previousAllocHook = _CrtSetAllocHook(_RealtimeThreadAllocHook);
+#endif
+	}
+	else {
+		SetPriorityClass(process, _defaultPriorityClass);
+
+		if (_defaultWorkingSetMinimum != 0)
+			SetProcessWorkingSetSize(process, _defaultWorkingSetMinimum, _defaultWorkingSetMaximum);
+	}
+
+	_enabled = enabled;
+	InterlockedIncrement(&_generation);
+}
+
+void 
+RealtimeThread::setAffinity(ThreadClass threadClass, DWORD_PTR mask)
+{
+	if (threadClass < 0 || threadClass >= kNumThreadClasses)
+		return;
+
+	_affinity[threadClass] = mask;
+	InterlockedIncrement(&_generation);
+}
+
+DWORD_PTR 
+RealtimeThread::affinity(ThreadClass threadClass)
+{
+	if (threadClass < 0 || threadClass >= kNumThreadClasses)
+		return 0;
+
+	return _affinity[threadClass];
+}
+
+unsigned long 
+RealtimeThread::allocationCount(void)
+{
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+	return (unsigned long)_realtimeAllocations;
+#else
+	return 0;
+#endif
+}
+
+void 
+RealtimeThread::_apply(void)
+{
+	HANDLE thread = GetCurrentThread();
+	DWORD threadId = GetCurrentThreadId();
+	long generation = _generation;
+	DWORD_PTR processMask, systemMask, mask;
+
+	if (threadId != _threadId) {
+		// first call, or whatever owns this has started a new thread since
+		_threadId = threadId;
+		_realtime = false;
+		_defaultPriority = GetThreadPriority(thread);
+	}
+
+	_appliedGeneration = generation;
+
+	if (!_enabled && !_realtime)
+		return;
+
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		processMask = 0;
+
+	if (_enabled) {
+		SetThreadPriority(thread, kRealtimePriority[_threadClass]);
+		mask = _affinity[_threadClass] & processMask;
+		_realtime = true;
+	}
+	else {
+		SetThreadPriority(thread, _defaultPriority);
+		mask = 0;
+		_realtime = false;
+	}
+
+	SetThreadAffinityMask(thread, mask != 0 ? mask : processMask);
+
+#ifdef REALTIME_THREAD_COUNT_ALLOCATIONS
+	_onRealtimeThread = _realtime;
+#endif
+}
@@ -0,0 +1,84 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#ifndef __RealtimeThread_h__
+#define __RealtimeThread_h__
+
+// opt-in real time scheduling for the threads on the input and output paths.  each keeps a
+// RealtimeThread and calls update() from its own loop; the settings are process wide,
+// so update() only does any work the first time round after one of them changes.
+class RealtimeThread
+{
+public:
+	typedef enum {
+		kThreadClass_Reader,		// the serial device reader
+		kThreadClass_Osc,			// the osc listener
+		kThreadClass_Midi,			// the midi input header thread
+		kThreadClass_Transmit,		// the serial device transmit threads, one for each device
+		kThreadClass_Scheduler,		// the led and input event schedulers
+		kNumThreadClasses
+	} ThreadClass;
+
+public:
+	RealtimeThread(ThreadClass threadClass);
+
+	// applies the current settings to the calling thread if they changed since the last call
+	void update(void)
+	{
+		if (_generation != _appliedGeneration || GetCurrentThreadId() != _threadId)
+			_apply();
+	}
+
+	// raises the reader, transmit, scheduler, osc and midi threads to the top priorities and
+	// keeps the process' pages resident while on.  the observer's scheduler only feeds the
+	// interface, so it is left at its low priority.
+	static void setEnabled(bool enabled);
+	static bool enabled(void) { return _enabled; }
+
+	// the processors a thread class may run on; 0 lets it run anywhere
+	static void setAffinity(ThreadClass threadClass, DWORD_PTR mask);
+	static DWORD_PTR affinity(ThreadClass threadClass);
+
+	// in debug builds, the number of heap allocations made on a thread while it ran real time
+	static unsigned long allocationCount(void);
+
+private:
+	void _apply(void);
+
+private:
+	ThreadClass _threadClass;
+	DWORD _threadId;
+	long _appliedGeneration;
+	bool _realtime;
+	int _defaultPriority;
+
+	static volatile long _generation;
+	static bool _enabled;
+	static DWORD_PTR _affinity[kNumThreadClasses];
+};
+
+#endif // __RealtimeThread_h__
@@ -30,10 +30,13 @@
 #include <iostream>
 #endif
 
-CCoreMIDI::CCoreMIDI(CCoreMIDIReceiveCallback receiveCallback, void* owner)
+CCoreMIDI::CCoreMIDI(CCoreMIDIReceiveCallback receiveCallback, void* owner, CCoreMIDISysExCallback sysExCallback)
 {
 	_receiveCallback = receiveCallback;
+	_sysExCallback = sysExCallback;
 	_owner = owner;
+
+	InitializeCriticalSection(&_outputLock);
 }
 
 CCoreMIDI::~CCoreMIDI()
@@ -51,6 +54,8 @@ CCoreMIDI::~CCoreMIDI()
 		delete recv;
 	}
 	_myInputDevices.clear();
+
+	DeleteCriticalSection(&_outputLock);
 }
 
 
@@ -197,7 +202,7 @@ CCoreMIDI::createInputDevice(const string& destinationName)
 	}
 
 	try {
-		ref = new CCoreMIDIReceive(destinationName, this->_receiveCallback, this->_owner);
+		ref = new CCoreMIDIReceive(destinationName, this->_receiveCallback, this->_sysExCallback, this->_owner);
 	}
 	catch (CMIDIInException &ex) {
 		AfxMessageBox(L"An error has occured while attempting to create a new MIDI In Connection.");
@@ -223,7 +228,7 @@ CCoreMIDI::createInputDevice(int deviceID)
 	}
 
 	try {
-		ref = new CCoreMIDIReceive(deviceID, this->_receiveCallback, this->_owner);
+		ref = new CCoreMIDIReceive(deviceID, this->_receiveCallback, this->_sysExCallback, this->_owner);
 	}
 	catch (CMIDIInException &ex) {
 		AfxMessageBox(L"An error has occured while attempting to create a new MIDI In Connection.");
@@ -275,6 +280,7 @@ CCoreMIDI::createOutputDevice(const string& sourceName)
 		return 0;
 	}
 
+	CCoreMIDIOutputLock lock(this);
 	_myOutputDevices.push_back(ref);
 
 	return ref;
@@ -299,6 +305,7 @@ CCoreMIDI::createOutputDevice(int deviceID)
 		return 0;
 	}
 
+	CCoreMIDIOutputLock lock(this);
 	_myOutputDevices.push_back(ref);
 
 	return ref;
@@ -329,6 +336,8 @@ CCoreMIDI::closeOutputDevice(CCoreMIDIEndpointRef sourceRef)
 		return;
 	}
 
+	CCoreMIDIOutputLock lock(this);
+
 	list<CCoreMIDIEndpoint*>::iterator i;
 	for (i = _myOutputDevices.begin(); i != _myOutputDevices.end(); i++) {
 		CCoreMIDIEndpoint *ep = *i;
@@ -347,14 +356,54 @@ CCoreMIDI::sendShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char
 		return;
 	}
 
+	CCoreMIDIOutputLock lock(this);
+
+	CCoreMIDISend *midiSend = _openSender(endpointRef);
+	if (midiSend != NULL) {
+		// anything already staged for this endpoint has to go out first to keep ordering
+		midiSend->flush();
+		midiSend->sendMessage(midiStatusByte, midiDataByte1, midiDataByte2);
+	}
+}
+
+void 
+CCoreMIDI::queueShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char midiDataByte1, char midiDataByte2)
+{
+	if (endpointRef == 0) {
+		return;
+	}
+
+	CCoreMIDIOutputLock lock(this);
+
+	CCoreMIDISend *midiSend = _openSender(endpointRef);
+	if (midiSend != NULL) {
+		midiSend->queueMessage(midiStatusByte, midiDataByte1, midiDataByte2);
+	}
+}
+
+CCoreMIDISend *
+CCoreMIDI::_openSender(CCoreMIDIEndpointRef endpointRef)
+{
+	list<CCoreMIDIEndpoint*>::iterator i;
+	for (i = _myOutputDevices.begin(); i != _myOutputDevices.end(); i++) {
+		if (*i == endpointRef) {
+			return (*i)->sender();
+		}
+	}
+
+	return NULL;
+}
+
+void 
+CCoreMIDI::flushOutput(void)
+{
+	CCoreMIDIOutputLock lock(this);
+
 	list<CCoreMIDIEndpoint*>::iterator i;
 	for (i = _myOutputDevices.begin(); i != _myOutputDevices.end(); i++) {
-		if (endpointRef == *i) {
-			CCoreMIDISend *midiSend = dynamic_cast<CCoreMIDISend*>((CCoreMIDIEndpoint*)endpointRef);
-			
-			if (midiSend != NULL) {
-				midiSend->sendMessage(midiStatusByte, midiDataByte1, midiDataByte2);
-			}
+		CCoreMIDISend *midiSend = (*i)->sender();
+		if (midiSend != NULL && midiSend->hasPendingMessages()) {
+			midiSend->flush();
 		}
 	}
-}
\ No newline at end of file
+}
@@ -36,7 +36,7 @@ using namespace std;
 class CCoreMIDI
 {
 public:
-	CCoreMIDI(CCoreMIDIReceiveCallback receiveCallback, void* owner);
+	CCoreMIDI(CCoreMIDIReceiveCallback receiveCallback, void* owner, CCoreMIDISysExCallback sysExCallback = 0);
     ~CCoreMIDI();
 
 public: // public interface
@@ -60,6 +60,11 @@ public: // public interface
 
 	void sendShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char midiDataByte1, char midiDataByte2);
 
+	// queueShort stages a message on the endpoint's output buffer; flushOutput sends
+	// everything staged since the last flush, one driver call per endpoint.
+	void queueShort(CCoreMIDIEndpointRef endpointRef, char midiStatusByte, char midiDataByte1, char midiDataByte2);
+	void flushOutput(void);
+
 	void* getOwner()
 	{
 		return _owner;
@@ -123,7 +128,31 @@ private:
     list<CCoreMIDIEndpoint *> _myInputDevices;
 
 	CCoreMIDIReceiveCallback _receiveCallback;
+	CCoreMIDISysExCallback _sysExCallback;
 	void* _owner;
+
+	// guards the output staging buffers, which are filled from the serial reader thread
+	CRITICAL_SECTION _outputLock;
+
+	class CCoreMIDIOutputLock
+	{
+	public:
+		CCoreMIDIOutputLock(CCoreMIDI *coreMIDI) 
+		{ 
+			EnterCriticalSection(_lock = &(coreMIDI->_outputLock)); 
+		}
+		~CCoreMIDIOutputLock() { LeaveCriticalSection(_lock); }
+
+	private:
+		CRITICAL_SECTION *_lock;
+	};
+
+	friend class CCoreMIDIOutputLock;
+
+	// the sender of endpointRef if it is still open, or NULL once closeOutputDevice has
+	// deleted it.  a device can hold on to a closed ref, so nothing dereferences one
+	// before checking it here.  caller holds the output lock.
+	CCoreMIDISend *_openSender(CCoreMIDIEndpointRef endpointRef);
 };
 
 
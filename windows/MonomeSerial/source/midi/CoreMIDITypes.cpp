@@ -7,16 +7,25 @@
 
 CCoreMIDISend::CCoreMIDISend(unsigned int deviceID)
 {
+	_pendingLength = 0;
+	_pendingMessages = 0;
+	_runningStatus = 0;
+
 	outDevice = new CMIDIOutDevice(deviceID);
 }
 
 CCoreMIDISend::CCoreMIDISend(const string &deviceName)
 {
+	_pendingLength = 0;
+	_pendingMessages = 0;
+	_runningStatus = 0;
+
 	outDevice = new CMIDIOutDevice(CCoreMIDISend::getMidiOutputDeviceByName(deviceName));
 }
 
 CCoreMIDISend::~CCoreMIDISend()
 {
+	flush();
 	outDevice->Close();
 	delete outDevice;
 }
@@ -48,22 +57,113 @@ CCoreMIDISend::sendMessage(char midiStatusByte, char midiDataByte1, char midiDat
 	msg.SendMsg(*outDevice);
 }
 
+void 
+CCoreMIDISend::queueMessage(char midiStatusByte, char midiDataByte1, char midiDataByte2)
+{
+	unsigned char status = (unsigned char)midiStatusByte;
+
+	if (_pendingLength + 3 > kOutputBufferSize) {
+		flush();
+	}
+
+	// channel messages sharing a status byte with the previous one only need their data bytes
+	if (status != _runningStatus || status >= 0xF0) {
+		_pending[_pendingLength++] = midiStatusByte;
+		_runningStatus = status < 0xF0 ? status : 0;
+	}
+
+	_pending[_pendingLength++] = midiDataByte1 & 0x7F;
+	_pending[_pendingLength++] = midiDataByte2 & 0x7F;
+	_pendingMessages++;
+}
+
+void 
+CCoreMIDISend::flush(void)
+{
+	if (_pendingLength == 0) {
+		return;
+	}
+
+	try {
+		if (_pendingMessages == 1) {
+			// a lone message is cheaper as a short message than as a prepared header
+			CShortMsg msg(_pending[0], _pending[1], _pending[2], 0);
+			msg.SendMsg(*outDevice);
+		}
+		else {
+			outDevice->SendMsg(_pending, _pendingLength);
+		}
+	}
+	catch (CMIDIOutException &ex) {
+#ifdef DEBUG_PRINT
+		cout << "Error in CCoreMIDISend::flush : CMIDIOutException = " << ex.what() << endl;
+#endif
+	}
+	catch (CMIDIOutMemFailure &ex) {
+#ifdef DEBUG_PRINT
+		cout << "Error in CCoreMIDISend::flush : CMIDIOutMemFailure = " << ex.what() << endl;
+#endif
+	}
+
+	// every buffer handed to the driver has to start with a status byte
+	_pendingLength = 0;
+	_pendingMessages = 0;
+	_runningStatus = 0;
+}
+
 //---------------------------------------------
 
-CCoreMIDIReceive::CCoreMIDIReceive(unsigned int deviceID, CCoreMIDIReceiveCallback callback, void *userData)
+CCoreMIDIReceive::CCoreMIDIReceive(unsigned int deviceID, CCoreMIDIReceiveCallback callback, CCoreMIDISysExCallback sysExCallback, void *userData)
 {
-	receiver = new CMIDIReceive(callback, this, userData);
+	receiver = new CMIDIReceive(callback, sysExCallback, this, userData);
 	inDevice = new CMIDIInDevice(deviceID, *receiver);
-	inDevice->StartRecording();
+	_addSysExBuffers();
+	_startRecording();
 }
 
-CCoreMIDIReceive::CCoreMIDIReceive(const string &deviceName, CCoreMIDIReceiveCallback callback, void *userData)
+CCoreMIDIReceive::CCoreMIDIReceive(const string &deviceName, CCoreMIDIReceiveCallback callback, CCoreMIDISysExCallback sysExCallback, void *userData)
 {
-	receiver = new CMIDIReceive(callback, this, userData);
+	receiver = new CMIDIReceive(callback, sysExCallback, this, userData);
 	inDevice = new CMIDIInDevice(CCoreMIDIReceive::getMidiInputDeviceByName(deviceName), *receiver);
+	_addSysExBuffers();
+	_startRecording();
+}
+
+void
+CCoreMIDIReceive::_startRecording(void)
+{
+	// driver timestamps count milliseconds from midiInStart
+	QueryPerformanceFrequency(&_counterFrequency);
+	QueryPerformanceCounter(&_recordingStarted);
 	inDevice->StartRecording();
 }
 
+unsigned __int64
+CCoreMIDIReceive::performanceCounterForTimeStamp(DWORD timeStamp) const
+{
+	return _recordingStarted.QuadPart + (unsigned __int64)timeStamp * _counterFrequency.QuadPart / 1000;
+}
+
+void
+CCoreMIDIReceive::_addSysExBuffers(void)
+{
+	// without buffers the driver drops sysex; short messages still work if this fails
+	try {
+		for (int i = 0; i < kNumSysExBuffers; i++)
+			inDevice->AddSysExBuffer(_sysExBuffers[i], kSysExBufferSize);
+	}
+	catch (CMIDIInException &ex) {
+#ifdef DEBUG_PRINT
+		cout << "Error in CCoreMIDIReceive::_addSysExBuffers : CMIDIInException = " << ex.what() << endl;
+#endif
+	}
+	catch (CMIDIInMemFailure &ex) {
+#ifdef DEBUG_PRINT
+		cout << "Error in CCoreMIDIReceive::_addSysExBuffers : CMIDIInMemFailure = " << ex.what() << endl;
+#endif
+	}
+}
+
 CCoreMIDIReceive::~CCoreMIDIReceive()
 {
 	inDevice->Close();
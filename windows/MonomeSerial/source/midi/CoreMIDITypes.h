@@ -17,8 +17,15 @@
 using namespace std;
 using namespace midi;
 
-typedef void *CCoreMIDIEndpointRef;
-typedef void (*CCoreMIDIReceiveCallback)(DWORD msg, CCoreMIDIEndpointRef source, void* userData);
+class CCoreMIDIEndpoint;
+class CCoreMIDISend;
+
+// endpoint refs are the endpoint objects themselves, so resolving one costs a
+// pointer dereference rather than a walk over CCoreMIDI's device lists.
+typedef CCoreMIDIEndpoint *CCoreMIDIEndpointRef;
+// timeStamp is the driver's, in milliseconds since the input started recording
+typedef void (*CCoreMIDIReceiveCallback)(DWORD msg, DWORD timeStamp, CCoreMIDIEndpointRef source, void* userData);
+typedef void (*CCoreMIDISysExCallback)(const unsigned char *data, DWORD length, DWORD timeStamp, CCoreMIDIEndpointRef source, void* userData);
 
 
 class CCoreMIDIEndpoint
@@ -28,16 +35,20 @@ public:
 	virtual ~CCoreMIDIEndpoint() {}
 	virtual string getDeviceName() const = 0;
 	virtual unsigned int getDeviceID() const = 0;
+
+	// returns the output side of this endpoint, or 0 for an input endpoint
+	virtual CCoreMIDISend *sender() { return 0; }
 };
 
 
 class CMIDIReceive : public CMIDIReceiver
 {
 public:
-	CMIDIReceive(CCoreMIDIReceiveCallback callbackMethod, CCoreMIDIEndpointRef coreMIDIReceive, void* userData)
+	CMIDIReceive(CCoreMIDIReceiveCallback callbackMethod, CCoreMIDISysExCallback sysExCallbackMethod, CCoreMIDIEndpointRef coreMIDIReceive, void* userData)
 	{
 		owner = userData;
 		callback = callbackMethod;
+		sysExCallback = sysExCallbackMethod;
 		midiReceive = coreMIDIReceive;
 	}
 	~CMIDIReceive(void) {}
@@ -45,7 +56,7 @@ public:
 private:
     // Receives short messages
 	void ReceiveMsg(DWORD Msg, DWORD TimeStamp) {
-		callback(Msg, midiReceive, owner);
+		callback(Msg, TimeStamp, midiReceive, owner);
 	}
 
     // Called when an invalid short message is received
@@ -53,11 +64,16 @@ private:
 		// ----
 	}
 
-	void ReceiveMsg(LPSTR Msg, DWORD bytesRecorded, DWORD TimeStamp) {}
+	// Receives system exclusive messages, one sysex buffer at a time
+	void ReceiveMsg(LPSTR Msg, DWORD bytesRecorded, DWORD TimeStamp) {
+		if (sysExCallback != 0 && bytesRecorded > 0)
+			sysExCallback((const unsigned char *)Msg, bytesRecorded, TimeStamp, midiReceive, owner);
+	}
 	void OnError(LPSTR Msg, DWORD BytesRecorded, DWORD TimeStamp) {}
 
 private:
 	CCoreMIDIReceiveCallback callback;
+	CCoreMIDISysExCallback sysExCallback;
 	CCoreMIDIEndpointRef midiReceive;
 	void* owner;
 };
@@ -74,8 +90,15 @@ public:
 	virtual string getDeviceName() const;
 	virtual unsigned int getDeviceID() const;
 	MIDIOUTCAPS getDeviceCaps() const;
+	virtual CCoreMIDISend *sender() { return this; }
 	void sendMessage(char midiStatusByte, char midiDataByte1, char midiDataByte2);
 
+	// stages a message in the output buffer using running status; nothing
+	// reaches the driver until flush() hands it the whole burst at once.
+	void queueMessage(char midiStatusByte, char midiDataByte1, char midiDataByte2);
+	void flush(void);
+	bool hasPendingMessages(void) const { return _pendingLength > 0; }
+
 #pragma region Static Output Interface
 public:
 	static int getNumberOfOutputDevices(void) { return CMIDIOutDevice::GetNumDevs(); }
@@ -133,7 +156,14 @@ public:
 #pragma endregion
 
 private:
+	enum { kOutputBufferSize = 512 };
+
 	CMIDIOutDevice *outDevice;
+
+	char _pending[kOutputBufferSize];
+	DWORD _pendingLength;
+	DWORD _pendingMessages;
+	unsigned char _runningStatus;
 };
 
 
@@ -141,8 +171,8 @@ private:
 class CCoreMIDIReceive : public CCoreMIDIEndpoint
 {
 public:
-	CCoreMIDIReceive(unsigned int deviceID, CCoreMIDIReceiveCallback callback, void *userData);
-	CCoreMIDIReceive(const string &deviceName, CCoreMIDIReceiveCallback callback, void *userData);
+	CCoreMIDIReceive(unsigned int deviceID, CCoreMIDIReceiveCallback callback, CCoreMIDISysExCallback sysExCallback, void *userData);
+	CCoreMIDIReceive(const string &deviceName, CCoreMIDIReceiveCallback callback, CCoreMIDISysExCallback sysExCallback, void *userData);
 	virtual ~CCoreMIDIReceive();
 
 public:
@@ -150,6 +180,9 @@ public:
 	virtual unsigned int getDeviceID() const;
 	MIDIINCAPS getDeviceCaps() const;
 
+	// the performance counter value a driver timestamp corresponds to
+	unsigned __int64 performanceCounterForTimeStamp(DWORD timeStamp) const;
+
 
 #pragma region Static Input Interface
 public:
@@ -208,8 +241,19 @@ public:
 #pragma endregion
 
 private:
+	void _addSysExBuffers(void);
+	void _startRecording(void);
+
+private:
+	// a bulk led SysEx is at most ~45 bytes; a few buffers cover bursts while
+	// the header thread hands used ones back to the driver
+	enum { kSysExBufferSize = 256, kNumSysExBuffers = 4 };
+
 	CMIDIInDevice *inDevice;
 	CMIDIReceive *receiver;
+	LARGE_INTEGER _recordingStarted;
+	LARGE_INTEGER _counterFrequency;
+	char _sysExBuffers[kNumSysExBuffers][kSysExBufferSize];
 };
 
 
@@ -31,6 +31,7 @@
 #include "../stdafx.h"
 #include "MIDIInDevice.h"
 #include "midi.h"
+#include "../RealtimeThread.h"
 
 #ifdef DEBUG_PRINT
 #include <iostream>
@@ -87,6 +88,9 @@ CMIDIInDevice::CMIDIInHeader::~CMIDIInHeader()
 // Add system exclusive buffer to queue
 void CMIDIInDevice::CMIDIInHeader::AddSysExBuffer()
 {
+    m_MIDIHdr.dwFlags &= ~MHDR_DONE;
+    m_MIDIHdr.dwBytesRecorded = 0;
+
     MMRESULT Result = ::midiInAddBuffer(m_DevHandle, &m_MIDIHdr,
                                         sizeof m_MIDIHdr);
 
@@ -98,6 +102,13 @@ void CMIDIInDevice::CMIDIInHeader::AddSysExBuffer()
 }
 
 
+// Determines if the driver has returned the buffer
+bool CMIDIInDevice::CMIDIInHeader::IsDone() const
+{
+    return (m_MIDIHdr.dwFlags & MHDR_DONE) != 0;
+}
+
+
 //--------------------------------------------------------------------
 // CHeaderQueue implementation
 //--------------------------------------------------------------------
@@ -146,6 +157,36 @@ void CMIDIInDevice::CHeaderQueue::RemoveHeader()
 }
 
 
+// Give every finished header back to the driver. The driver fills
+// buffers in the order they were added, so the finished ones are always
+// at the front of the queue.
+void CMIDIInDevice::CHeaderQueue::RecycleDoneHeaders()
+{
+    ::EnterCriticalSection(&m_CriticalSection);
+
+    std::queue<CMIDIInHeader *>::size_type Count = m_HdrQueue.size();
+
+    while(Count-- > 0 && m_HdrQueue.front()->IsDone())
+    {
+        CMIDIInHeader *Header = m_HdrQueue.front();
+        m_HdrQueue.pop();
+
+        try
+        {
+            Header->AddSysExBuffer();
+            m_HdrQueue.push(Header);
+        }
+        // If the driver will not take the buffer back, drop it
+        catch(const CMIDIInException &)
+        {
+            delete Header;
+        }
+    }
+
+    ::LeaveCriticalSection(&m_CriticalSection);
+}
+
+
 // Empty header queue
 void CMIDIInDevice::CHeaderQueue::RemoveAll()
 {
@@ -529,19 +570,24 @@ void CALLBACK CMIDIInDevice::MidiInProc(HMIDIIN MidiIn, UINT Msg,
 DWORD CMIDIInDevice::HeaderProc(LPVOID Parameter)
 {
     CMIDIInDevice *Device; 
+    RealtimeThread Realtime(RealtimeThread::kThreadClass_Midi);
     
     Device = reinterpret_cast<CMIDIInDevice *>(Parameter);
 
     // Continue while the MIDI input device is recording
     while(Device->m_State == RECORDING)
     {
+        Realtime.update();
+
         ::WaitForSingleObject(Device->m_Event, INFINITE);
 
         // Make sure we are still recording
         if(Device->m_State == RECORDING)
         {
-            // Remove the finished header
-            Device->m_HdrQueue.RemoveHeader();
+            // Hand the finished headers back to the driver. Several
+            // messages can arrive per wakeup, so recycle every header
+            // that is done rather than just one.
+            Device->m_HdrQueue.RecycleDoneHeaders();
         }
     }
 
@@ -170,7 +170,9 @@ namespace midi
         // Closes the MIDI input device
         void Close();
 
-        // Adds a buffer to receive system exclusive messages
+        // Adds a buffer to receive system exclusive messages. The buffer
+        // is given back to the driver each time the receiver has been
+        // handed its contents, so it stays in use until recording stops.
         void AddSysExBuffer(LPSTR Buffer, DWORD BufferLength);
 
         // Starts the recording process
@@ -229,6 +231,9 @@ namespace midi
             // Add the buffer for receiving system exclusive messages
             void AddSysExBuffer();
 
+            // Returns true once the driver has finished with the buffer
+            bool IsDone() const;
+
         private:
             HMIDIIN m_DevHandle;
             MIDIHDR m_MIDIHdr;
@@ -244,6 +249,7 @@ namespace midi
 
             void AddHeader(CMIDIInHeader *Header);
             void RemoveHeader();
+            void RecycleDoneHeaders();
             void RemoveAll();
             bool IsEmpty();
 
@@ -53,8 +53,10 @@ CMIDIOutDevice::CMIDIOutHeader::CMIDIOutHeader(HMIDIOUT DevHandle,
                                                DWORD MsgLength) :
 m_DevHandle(DevHandle)
 {
-    // Initialize header
-    m_MIDIHdr.lpData         = Msg;
+    // Initialize header with its own copy of the message, so callers 
+    // can reuse their buffer as soon as SendMsg returns
+    m_MIDIHdr.lpData         = new char[MsgLength];
+    memcpy(m_MIDIHdr.lpData, Msg, MsgLength);
     m_MIDIHdr.dwBufferLength = MsgLength;
     m_MIDIHdr.dwFlags        = 0;
 
@@ -65,6 +67,7 @@ m_DevHandle(DevHandle)
     // If an error occurred, throw exception
     if(Result != MMSYSERR_NOERROR)
     {
+        delete [] m_MIDIHdr.lpData;
         throw CMIDIOutException(Result);
     }
 }
@@ -75,6 +78,8 @@ CMIDIOutDevice::CMIDIOutHeader::~CMIDIOutHeader()
 {
     ::midiOutUnprepareHeader(m_DevHandle, &m_MIDIHdr, 
                              sizeof m_MIDIHdr);
+
+    delete [] m_MIDIHdr.lpData;
 }
 
 
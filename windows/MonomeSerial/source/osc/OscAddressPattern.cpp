@@ -0,0 +1,231 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+#include "../stdafx.h"
+#include "OscAddressPattern.h"
+
+#include <string.h>
+
+OscAddressPattern::OscAddressPattern(void)
+{
+	Instruction end = { kOp_End, 0 };
+
+	_program.push_back(end);
+	_valid = false;
+}
+
+OscAddressPattern::OscAddressPattern(const string &pattern)
+{
+	_valid = _compile(pattern);
+
+	// a malformed pattern compiles to one that matches nothing
+	if (!_valid) {
+		Instruction end = { kOp_End, 0 };
+
+		_program.clear();
+		_program.push_back(end);
+	}
+}
+
+bool 
+OscAddressPattern::match(const string &address) const
+{
+	return _valid && _match(0, address.c_str());
+}
+
+bool 
+OscAddressPattern::isPattern(const string &s)
+{
+	return s.find_first_of("*?[{") != string::npos;
+}
+
+bool 
+OscAddressPattern::_compile(const string &pattern)
+{
+	string::size_type i = 0, n = pattern.size();
+
+	while (i < n) {
+		Instruction instruction;
+		char c = pattern[i];
+
+		if (c == '?') {
+			instruction.op = kOp_Any;
+			instruction.arg = 0;
+			i++;
+		}
+		else if (c == '*') {
+			// a run of stars is one star
+			while (i < n && pattern[i] == '*')
+				i++;
+
+			instruction.op = kOp_Star;
+			instruction.arg = 0;
+		}
+		else if (c == '[') {
+			CharSet set;
+			bool negate = false;
+
+			memset(&set, 0, sizeof(set));
+
+			if (++i < n && pattern[i] == '!') {
+				negate = true;
+				i++;
+			}
+
+			while (i < n && pattern[i] != ']') {
+				unsigned char first = (unsigned char)pattern[i], last = first;
+
+				// a '-' that ends the set is only itself
+				if (i + 2 < n && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+					last = (unsigned char)pattern[i + 2];
+					i += 3;
+				}
+				else
+					i++;
+
+				for (unsigned int ch = first; ch <= last; ch++)
+					set.bits[ch >> 3] |= 1 << (ch & 7);
+			}
+
+			if (i++ >= n)
+				return false;
+
+			if (negate) {
+				for (unsigned int b = 0; b < sizeof(set.bits); b++)
+					set.bits[b] = (unsigned char)~set.bits[b];
+			}
+
+			// never the end of the address, nor across a '/'
+			set.bits[0] &= (unsigned char)~1;
+			set.bits['/' >> 3] &= (unsigned char)~(1 << ('/' & 7));
+
+			instruction.op = kOp_Set;
+			instruction.arg = _sets.size();
+			_sets.push_back(set);
+		}
+		else if (c == '{') {
+			string::size_type close = pattern.find('}', i);
+			vector<string> choices;
+
+			if (close == string::npos)
+				return false;
+
+			for (string::size_type start = i + 1; ; ) {
+				string::size_type comma = pattern.find(',', start);
+
+				if (comma == string::npos || comma > close)
+					comma = close;
+
+				choices.push_back(pattern.substr(start, comma - start));
+
+				if (comma == close)
+					break;
+				start = comma + 1;
+			}
+
+			instruction.op = kOp_Choice;
+			instruction.arg = _choices.size();
+			_choices.push_back(choices);
+			i = close + 1;
+		}
+		else {
+			string::size_type end = pattern.find_first_of("*?[{", i);
+
+			if (end == string::npos)
+				end = n;
+
+			instruction.op = kOp_Literal;
+			instruction.arg = _literals.size();
+			_literals.push_back(pattern.substr(i, end - i));
+			i = end;
+		}
+
+		_program.push_back(instruction);
+	}
+
+	Instruction end = { kOp_End, 0 };
+	_program.push_back(end);
+
+	return true;
+}
+
+// runs the program from pc against the rest of the address, backtracking only at stars
+// and choices
+bool 
+OscAddressPattern::_match(unsigned int pc, const char *s) const
+{
+	for (;;) {
+		const Instruction &instruction = _program[pc++];
+
+		switch (instruction.op) {
+		case kOp_Literal: {
+			const string &literal = _literals[instruction.arg];
+
+			if (strncmp(s, literal.c_str(), literal.size()) != 0)
+				return false;
+			s += literal.size();
+			break;
+		}
+
+		case kOp_Any:
+			if (*s == '\0' || *s == '/')
+				return false;
+			s++;
+			break;
+
+		case kOp_Set: {
+			unsigned char c = (unsigned char)*s;
+
+			if ((_sets[instruction.arg].bits[c >> 3] & (1 << (c & 7))) == 0)
+				return false;
+			s++;
+			break;
+		}
+
+		case kOp_Star:
+			// shortest run first, up to the end of this part of the address
+			for (;; s++) {
+				if (_match(pc, s))
+					return true;
+				if (*s == '\0' || *s == '/')
+					return false;
+			}
+
+		case kOp_Choice: {
+			const vector<string> &choices = _choices[instruction.arg];
+
+			for (unsigned int i = 0; i < choices.size(); i++) {
+				if (strncmp(s, choices[i].c_str(), choices[i].size()) == 0 && _match(pc, s + choices[i].size()))
+					return true;
+			}
+			return false;
+		}
+
+		default:
+			return *s == '\0';
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+#ifndef __OscAddressPattern_h__
+#define __OscAddressPattern_h__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// an OSC 1.0 address pattern, compiled once into a short program so that matching it
+// against many addresses parses nothing.  '?' matches any one character and '*' any run
+// of them, neither crossing a '/'.  [abc], [a-z] and [!a-z] match one character in or out
+// of a set, and {foo,bar} any one of the strings listed.
+class OscAddressPattern
+{
+public:
+	OscAddressPattern(void);
+	explicit OscAddressPattern(const string &pattern);
+
+	// false if the pattern has an unclosed [ or {, in which case it matches nothing
+	bool valid(void) const { return _valid; }
+	bool match(const string &address) const;
+
+	// whether s has any of the characters that make a pattern of an address
+	static bool isPattern(const string &s);
+
+private:
+	typedef enum {
+		kOp_Literal,    // arg indexes _literals
+		kOp_Any,        // ?
+		kOp_Star,       // *
+		kOp_Set,        // arg indexes _sets
+		kOp_Choice,     // arg indexes _choices
+		kOp_End
+	} Opcode;
+
+	typedef struct {
+		Opcode op;
+		unsigned int arg;
+	} Instruction;
+
+	typedef struct {
+		unsigned char bits[32];     // bit c & 7 of bits[c >> 3] for each character c in the set
+	} CharSet;
+
+	bool _compile(const string &pattern);
+	bool _match(unsigned int pc, const char *s) const;
+
+	vector<Instruction> _program;
+	vector<string> _literals;
+	vector<CharSet> _sets;
+	vector<vector<string> > _choices;
+	bool _valid;
+};
+
+#endif // __OscAddressPattern_h__
@@ -29,6 +29,7 @@ map<lo_address, UdpTransmitSocket*> oscHosts;
 //----------------------------------------------------------------------------------------------------------
 
 OscListener::OscListener() 
+	: _realtime(RealtimeThread::kThreadClass_Osc)
 {
 	_handler = 0;
 	_userdata = 0;
@@ -63,6 +64,8 @@ OscListener::ProcessMessage(const osc::ReceivedMessage& msg, const IpEndpointNam
 {
 	OscListenerLock(this);
 
+	_realtime.update();
+
 	if (_handler) {
 		_handler(msg, _userdata);
 	}
@@ -9,6 +9,7 @@
 #include "oscpack/ip/IpEndpointName.h"
 
 #include "OscException.h"
+#include "../RealtimeThread.h"
 
 #include <vector>
 #include <string>
@@ -73,6 +74,7 @@ namespace liblointerface {
 		lo_method_handler _handler;
 		void *_userdata;
 		CRITICAL_SECTION cs;
+		RealtimeThread _realtime;
 
 		class OscListenerLock
 		{
@@ -5,16 +5,18 @@
 OscMessageStream::OscMessageStream(const ReceivedMessage &message) : 
 	suffixPos(1), msg(message), it(msg.ArgumentsBegin()), address(msg.AddressPattern())
 {
-	for (;suffixPos < address.length(); suffixPos++) {
-		if (address[suffixPos] == '/') {
-			break;
-		}
-	}
+	findSuffix();
 }
 
 OscMessageStream::OscMessageStream(const OscMessageStream &stream) :
-	suffixPos(stream.suffixPos), msg(stream.msg), it(msg.ArgumentsBegin()), address(msg.AddressPattern())
+	suffixPos(stream.suffixPos), msg(stream.msg), it(msg.ArgumentsBegin()), address(stream.address)
+{
+}
+
+OscMessageStream::OscMessageStream(const OscMessageStream &stream, const string &addressPattern) :
+	suffixPos(1), msg(stream.msg), it(msg.ArgumentsBegin()), address(addressPattern)
 {
+	findSuffix();
 }
 
 OscMessageStream::~OscMessageStream(void)
@@ -64,6 +66,12 @@ OscMessageStream::typetagMatch(const char *typetags)
 	return true;
 }
 
+const char *
+OscMessageStream::typetags(void) const
+{
+	return msg.TypeTags();
+}
+
 bool
 OscMessageStream::addressMatch(const char *addressPattern)
 {
@@ -146,3 +154,28 @@ OscMessageStream::getString(void)
 		throw OscException(OscException::kOscExceptionTypeLibloError, "invalid argument type.", false);
 	}
 }
+
+void
+OscMessageStream::getBlob(const void *&data, unsigned long &size)
+{
+	if (it == msg.ArgumentsEnd()) {
+		throw OscException(OscException::kOscExceptionTypeLibloError, "stream past endpoint - must reset first.", false);
+	}
+
+	if (it->IsBlob()) {
+		(it++)->AsBlob(data, size);
+	}
+	else {
+		throw OscException(OscException::kOscExceptionTypeLibloError, "invalid argument type.", false);
+	}
+}
+
+void
+OscMessageStream::findSuffix(void)
+{
+	for (;suffixPos < address.length(); suffixPos++) {
+		if (address[suffixPos] == '/') {
+			break;
+		}
+	}
+}
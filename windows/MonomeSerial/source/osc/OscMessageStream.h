@@ -12,6 +12,8 @@ class OscMessageStream
 public:
 	OscMessageStream(const ReceivedMessage &message);
 	OscMessageStream(const OscMessageStream &stream);
+	// the arguments of stream under another address
+	OscMessageStream(const OscMessageStream &stream, const string &addressPattern);
 
 	~OscMessageStream(void);
 
@@ -20,6 +22,7 @@ public:
 	string getAddressPatternSuffix(void) const;
 
 	bool typetagMatch(const char *typetags);
+	const char *typetags(void) const;
 	bool addressMatch(const char *addressPattern);
 	bool endOfStream(void);
 
@@ -31,8 +34,12 @@ public:
 	int getInt32(void);
 	float getFloat(void);
 	string getString(void);
+	// points into the received packet, so only good while the message is being handled
+	void getBlob(const void *&data, unsigned long &size);
 
 private:
+	void findSuffix(void);
+
 	ReceivedMessage msg;
 	string address;
 	int suffixPos;
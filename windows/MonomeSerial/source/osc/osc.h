@@ -55,6 +55,8 @@
 #define kOscTypeTagInt                        "i"
 #define kOscTypeTagFloat                      "f"
 #define kOscTypeTagString                     "s"
+#define kOscTypeTagBlob                       "b"
+#define kOscTypeTagTimeTag                    "t"
 
 #define kOscDefaultAddrPatternButtonPressSuffix  "/press"
 #define kOscDefaultAddrPatternLedStateSuffix     "/led"
@@ -69,7 +71,21 @@
 #define kOscDefaultAddrPatternLedColumnSuffix    "/led_col"
 #define kOscDefaultAddrPatternEncEnableSuffix    "/enc_enable"
 #define kOscDefaultAddrPatternEncValueSuffix     "/enc"
+#define kOscDefaultAddrPatternEncTotalSuffix     "/enc_total"
 #define kOscDefaultAddrPatternLedFrameSuffix     "/frame"
+#define kOscDefaultAddrPatternLedAnimationSuffix "/anim"
+#define kOscDefaultAddrPatternLedShiftSuffix     "/shift"
+#define kOscDefaultAddrPatternLedBlitSuffix      "/blit"
+#define kOscDefaultAddrPatternLedCopySuffix      "/copy"
+#define kOscDefaultAddrPatternLedFillSuffix      "/fill"
+#define kOscDefaultAddrPatternLedMapSuffix       "/led_map"
+#define kOscDefaultAddrPatternLayerSuffix        "/layer"
+#define kOscDefaultAddrPatternLayerInfix         "/layer/"	// prefix/layer/<id>/led etc. draw on layer id
+#define kOscDefaultAddrPatternSubscribeSuffix    "/subscribe"
+#define kOscDefaultAddrPatternUnsubscribeSuffix  "/unsubscribe"
+#define kOscDefaultAddrPatternEchoSuffix         "/echo"
+#define kOscDefaultAddrPatternDoubleBufferSuffix "/double_buffer"
+#define kOscDefaultAddrPatternSwapSuffix         "/swap"
 #define kOscDefaultAddrPatternLed_ModeSuffix	"/led_mode"
 #define kOscDefaultAddrPatternTilt_ModeSuffix	"/tiltmode"
 
@@ -84,6 +100,14 @@
 #define kOscDefaultAddrPatternSystemDevSerial	 "/sys/serial"
 
 #define kOscDefaultAddrPatternSystemGrids		 "/sys/grids"
+#define kOscDefaultAddrPatternSystemEncInterval  "/sys/enc_interval"
+#define kOscDefaultAddrPatternSystemEncAccel     "/sys/enc_accel"
+#define kOscDefaultAddrPatternSystemFilter       "/sys/filter"
+#define kOscDefaultAddrPatternSystemTimestamp    "/sys/timestamp"
+#define kOscDefaultAddrPatternSystemClock        "/sys/clock"
+#define kOscDefaultAddrPatternSystemRealtime     "/sys/realtime"
+#define kOscDefaultAddrPatternSystemFlow         "/sys/flow"
+#define kOscDefaultAddrPatternSystemStats        "/sys/stats"
 
 
 #define kOscDefaultAddrPatternSystemAuxVersion   "/sys/aux/version"
@@ -132,8 +156,31 @@
 #define kOscDefaultTypeTagsLedColumn          kOscTypeTagInt kOscTypeTagInt
 #define kOscDefaultTypeTagsEncEnable          kOscTypeTagInt kOscTypeTagInt
 #define kOscDefaultTypeTagsEncValue           kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsEncTotal           kOscTypeTagInt
 #define kOscDefaultTypeTagsLedFrame           kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
 #define kOscDefaultTypeTagsLedOffsetFrame     kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedAnimationStop   kOscTypeTagString
+#define kOscDefaultTypeTagsLedShift           kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedShiftWrap       kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedCopy            kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedFill            kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedMap             kOscTypeTagBlob
+#define kOscDefaultTypeTagsLedMapRect         kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagBlob
+// /layer <id> <z> <or, mask, xor or replace> [<column> <row> <width> <height>], or /layer <id> to remove it
+#define kOscDefaultTypeTagsLayer              kOscTypeTagInt kOscTypeTagInt kOscTypeTagString
+#define kOscDefaultTypeTagsLayerClip          kOscDefaultTypeTagsLayer kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLayerRemove        kOscTypeTagInt
+// /subscribe <host> <port> <events> [<column> <row> <width> <height>], /unsubscribe <host> <port>
+#define kOscDefaultTypeTagsSubscribe          kOscTypeTagString kOscTypeTagInt kOscTypeTagString
+#define kOscDefaultTypeTagsSubscribeRect      kOscDefaultTypeTagsSubscribe kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsUnsubscribe        kOscTypeTagString kOscTypeTagInt
+// /echo <momentary, toggle or radio> [<column> <row> <width> <height>], or /echo off
+#define kOscDefaultTypeTagsEcho               kOscTypeTagString
+#define kOscDefaultTypeTagsEchoRect           kOscDefaultTypeTagsEcho kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt
+// /double_buffer <0 or 1> [<auto swap interval in ms>], /swap takes no arguments
+#define kOscDefaultTypeTagsDoubleBuffer       kOscTypeTagInt
+#define kOscDefaultTypeTagsDoubleBufferAuto   kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsLedAnimationPulse  kOscTypeTagString kOscTypeTagInt kOscTypeTagInt kOscTypeTagFloat kOscTypeTagFloat
 #define kOscDefaultTypeTagsTiltMode			  kOscTypeTagInt // added by dan
 
 #define kOscDefaultTypeTagsSysPrefixAll          kOscTypeTagString
@@ -161,6 +208,77 @@
 
 #define kOscDefaultTypeTagsSysGrids				 kOscTypeTagInt
 
+#define kOscDefaultTypeTagsSysEncIntervalAll          kOscTypeTagInt
+#define kOscDefaultTypeTagsSysEncIntervalSingle       kOscTypeTagInt kOscTypeTagInt
+#define kOscDefaultTypeTagsSysEncIntervalSingleSerial kOscTypeTagString kOscTypeTagInt
+
+#define kOscDefaultTypeTagsSysEncAccelAll             kOscTypeTagFloat
+#define kOscDefaultTypeTagsSysEncAccelSingle          kOscTypeTagInt kOscTypeTagFloat
+#define kOscDefaultTypeTagsSysEncAccelSingleSerial    kOscTypeTagString kOscTypeTagFloat
+
+// input, deadband, interval, "none"/"lowpass"/"median", amount
+#define kOscDefaultTypeTagsSysFilter                  kOscTypeTagInt kOscTypeTagFloat kOscTypeTagInt kOscTypeTagString kOscTypeTagFloat
+#define kOscDefaultTypeTagsSysFilterAll               kOscDefaultTypeTagsSysFilter
+#define kOscDefaultTypeTagsSysFilterSingle            kOscTypeTagInt kOscDefaultTypeTagsSysFilter
+#define kOscDefaultTypeTagsSysFilterSingleSerial      kOscTypeTagString kOscDefaultTypeTagsSysFilter
+
+// /sys/timestamp <off, bundle or arg>; /sys/clock with no arguments answers with the pair
+#define kOscDefaultTypeTagsSysTimestampAll            kOscTypeTagString
+#define kOscDefaultTypeTagsSysTimestampSingle         kOscTypeTagInt kOscTypeTagString
+#define kOscDefaultTypeTagsSysTimestampSingleSerial   kOscTypeTagString kOscTypeTagString
+#define kOscDefaultTypeTagsSysClockResponse           kOscTypeTagTimeTag kOscTypeTagTimeTag
+
+// /sys/realtime <0 or 1>, or <thread class> <processor mask>; with no arguments answers
+// with whether it's on and, in debug builds, the allocations made on real time threads
+#define kOscDefaultTypeTagsSysRealtime                kOscTypeTagInt
+#define kOscDefaultTypeTagsSysRealtimeAffinity        kOscTypeTagString kOscTypeTagInt
+#define kOscDefaultTypeTagsSysRealtimeResponse        kOscTypeTagInt kOscTypeTagInt
+
+// /sys/flow <off, report or credit>; with no arguments, and whenever a report is due,
+// answers /sys/flow <device> <0 clear, 1 busy, 2 congested> <credits> <utilisation>
+#define kOscDefaultTypeTagsSysFlowAll                 kOscTypeTagString
+#define kOscDefaultTypeTagsSysFlowSingle              kOscTypeTagInt kOscTypeTagString
+#define kOscDefaultTypeTagsSysFlowSingleSerial        kOscTypeTagString kOscTypeTagString
+#define kOscDefaultTypeTagsSysFlowResponse            kOscTypeTagInt kOscTypeTagInt kOscTypeTagInt kOscTypeTagFloat
+
+// /sys/stats with no arguments answers for each device with
+// /sys/stats <device> <capacity> <throughput> <write time> <flush interval> <single leds>
+#define kOscDefaultTypeTagsSysStatsResponse           kOscTypeTagInt kOscTypeTagFloat kOscTypeTagFloat kOscTypeTagFloat kOscTypeTagFloat kOscTypeTagInt
+
+#define kOscRealtimeThreadReader                      "reader"
+#define kOscRealtimeThreadOsc                         "osc"
+#define kOscRealtimeThreadMidi                        "midi"
+#define kOscRealtimeThreadTransmit                    "transmit"
+#define kOscRealtimeThreadScheduler                   "scheduler"
+
+#define kOscLayerBlendOr                              "or"
+#define kOscLayerBlendMask                            "mask"
+#define kOscLayerBlendXor                             "xor"
+#define kOscLayerBlendReplace                         "replace"
+
+#define kOscInputEventPress                           "press"
+#define kOscInputEventEnc                             "enc"
+#define kOscInputEventAdc                             "adc"
+#define kOscInputEventTilt                            "tilt"
+#define kOscInputEventAll                             "all"
+
+#define kOscEchoMomentary                             "momentary"
+#define kOscEchoToggle                                "toggle"
+#define kOscEchoRadio                                 "radio"
+#define kOscEchoOff                                   "off"
+
+#define kOscInputTimestampsOff                        "off"
+#define kOscInputTimestampsBundle                     "bundle"
+#define kOscInputTimestampsArgument                   "arg"
+
+#define kOscFlowOff                                   "off"
+#define kOscFlowReport                                "report"
+#define kOscFlowCredit                                "credit"
+
+#define kOscSensorFilterSmoothingNone				"none"
+#define kOscSensorFilterSmoothingOnePole			"lowpass"
+#define kOscSensorFilterSmoothingMedian				"median"
+
 #define kOscDefaultTypeTagsSysAuxEnable          kOscTypeTagInt kOscTypeTagInt
 #define kOscDefaultTypeTagsSysAuxDirection       kOscTypeTagInt kOscTypeTagInt
 #define kOscDefaultTypeTagsSysAuxState           kOscTypeTagInt kOscTypeTagInt
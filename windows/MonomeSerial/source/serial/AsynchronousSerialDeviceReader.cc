@@ -27,6 +27,7 @@
 #include "../stdafx.h"
 #include "FTD2xx.h"
 #include "AsynchronousSerialDeviceReader.h"
+#include "../RealtimeThread.h"
 #include "Message.h"
 #include "Message256.h"
 #include "messageMK.h"
@@ -94,6 +95,9 @@ AsynchronousSerialDeviceReader::addSerialDevice(SerialDevice *device,
 		}
     }
 
+	if (_deviceContexts.size() >= MAXIMUM_WAIT_OBJECTS)
+		return;
+
 	SerialDeviceContext context = {device, packetSize, callback, userData};
 	_deviceContexts.push_back(context);
 }
@@ -154,9 +158,11 @@ AsynchronousSerialDeviceReader::_read()
 	int counter = 0;
 	size_t numDevices = 0;
 	int deviceNum = 0;
+	RealtimeThread realtime(RealtimeThread::kThreadClass_Reader);
 
 	while (!_terminateThread) {
 		do {
+			realtime.update();
 			numDevices = _deviceContexts.size();
 			Sleep(100);
 		}
@@ -164,8 +170,6 @@ AsynchronousSerialDeviceReader::_read()
 
 		EnterCriticalSection(&_deviceContextsLock); 
 //		{
-			HANDLE *waitObjects = new HANDLE[numDevices];
-
 			counter = 0;
 			for (i = _deviceContexts.begin(); i != _deviceContexts.end(); i++) {
 				SerialDeviceContext &context = *i;
@@ -191,7 +195,7 @@ AsynchronousSerialDeviceReader::_read()
 						continue;				
 					}
 					else {
-						waitObjects[counter++] = eventObj;
+						_waitObjects[counter++] = eventObj;
 					}
 				}
 			}
@@ -203,7 +207,9 @@ AsynchronousSerialDeviceReader::_read()
 				break;
 			}
 
-			eventResult = WaitForMultipleObjects(numDevices, waitObjects, false, DEVICE_WAIT_TIMEOUT);
+			realtime.update();
+
+			eventResult = WaitForMultipleObjects(numDevices, _waitObjects, false, DEVICE_WAIT_TIMEOUT);
 			if (eventResult == WAIT_FAILED) {
 #ifdef DEBUG_PRINT
 				cout << "WaitForMultipleObjects() call returned WAIT_FAILED.  Last error = " << GetLastError() << endl;
@@ -243,11 +249,21 @@ AsynchronousSerialDeviceReader::_read()
 								_serial_rx_in -= _serial_rx_buf_size;
 
 							while (_serial_rx_out != _serial_rx_in) {
-								if (_serial_rx_in >= _serial_rx_out && _serial_rx_in - _serial_rx_out < context.packetSize)
+								size_t burstSize;
+
+								// hand the callback every complete packet in the contiguous part of the
+								// ring at once, so whatever it sends in response can go out as one burst.
+								if (_serial_rx_in >= _serial_rx_out)
+									burstSize = _serial_rx_in - _serial_rx_out;
+								else
+									burstSize = _serial_rx_buf + _serial_rx_buf_size - _serial_rx_out;
+
+								burstSize -= burstSize % context.packetSize;
+								if (burstSize == 0)
 									break;
 
 								if (context.callback != 0 && 
-									context.callback(device, _serial_rx_out, context.packetSize, context.userData) != 0) {
+									context.callback(device, _serial_rx_out, burstSize, context.userData) != 0) {
 									_serial_rx_out = _serial_rx_in = _serial_rx_buf;
 
 									//device->flush();
@@ -255,7 +271,7 @@ AsynchronousSerialDeviceReader::_read()
 									break;
 								}
 
-								_serial_rx_out += context.packetSize;
+								_serial_rx_out += burstSize;
 								if (_serial_rx_out >= _serial_rx_buf + _serial_rx_buf_size)
 									_serial_rx_out -= _serial_rx_buf_size;
 							}
@@ -270,17 +286,12 @@ AsynchronousSerialDeviceReader::_read()
 			}
 		}
 
-		for (int j = 0; j < _deviceContexts.size(); j++) {
-			HANDLE _handle = waitObjects[j];
+		for (int j = 0; j < counter; j++) {
+			HANDLE _handle = _waitObjects[j];
 			if (_handle != INVALID_HANDLE_VALUE) {
-				CloseHandle(waitObjects[j]);
+				CloseHandle(_waitObjects[j]);
 			}
 		}
-
-		if (waitObjects) {
-			delete[] waitObjects;
-			waitObjects = 0;
-		}
 	}
 
 	/*if (_serial_rx_buf) {
@@ -59,6 +59,7 @@ private:
 
 private:
     vector<SerialDeviceContext> _deviceContexts;
+	HANDLE _waitObjects[MAXIMUM_WAIT_OBJECTS];	// one event per device, so the reader never allocates
 	char *_serial_rx_in, *_serial_rx_out, *_serial_rx_buf;
     size_t _serial_rx_buf_size;
 
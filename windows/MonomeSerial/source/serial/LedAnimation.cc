@@ -0,0 +1,227 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#include "../stdafx.h"
+#include "LedAnimation.h"
+
+
+LedAnimation::LedAnimation(void)
+{
+	_type = kAnimation_None;
+	_column = _row = _width = _height = 0;
+	_interval = 0;
+	_steps = 0;
+	_step = 0;
+	_numFrames = 0;
+	_dx = _dy = 0;
+	_low = _high = 0.f;
+}
+
+void 
+LedAnimation::setFrames(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, unsigned int numFrames)
+{
+	_setRegion(kAnimation_Frames, column, row, width, height);
+
+	if (numFrames > kMaxFrames)
+		numFrames = kMaxFrames;
+	else if (numFrames == 0)
+		stop();
+
+	if (_type == kAnimation_None)
+		return;
+
+	for (unsigned int f = 0; f < numFrames; f++) {
+		for (unsigned int r = 0; r < _height; r++)
+			_frames[f][r] = bitMaps[f * height + r];
+	}
+
+	_numFrames = numFrames;
+}
+
+void 
+LedAnimation::setBlink(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps)
+{
+	setFrames(column, row, width, height, bitMaps, 1);
+
+	if (_type != kAnimation_None)
+		_type = kAnimation_Blink;
+}
+
+void 
+LedAnimation::setScroll(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, int dx, int dy)
+{
+	setFrames(column, row, width, height, bitMaps, 1);
+
+	if (_type == kAnimation_None)
+		return;
+
+	_type = kAnimation_Scroll;
+
+	// reduced to one step of 0 to width - 1 to the right and 0 to height - 1 down
+	_dx = ((dx % (int)_width) + (int)_width) % (int)_width;
+	_dy = ((dy % (int)_height) + (int)_height) % (int)_height;
+}
+
+void 
+LedAnimation::setPulse(float low, float high)
+{
+	_setRegion(kAnimation_Pulse, 0, 0, 0, 0);
+	_low = low;
+	_high = high;
+}
+
+void 
+LedAnimation::stop(void)
+{
+	_type = kAnimation_None;
+	_step = 0;
+}
+
+void 
+LedAnimation::setTiming(unsigned int interval, unsigned int steps)
+{
+	_interval = interval > 0 ? interval : 1;
+	_steps = steps;
+	_step = 0;
+}
+
+unsigned int 
+LedAnimation::interval(void) const
+{
+	return _interval;
+}
+
+LedAnimation::Type 
+LedAnimation::type(void) const
+{
+	return _type;
+}
+
+bool 
+LedAnimation::drawsLeds(void) const
+{
+	return _type != kAnimation_None && _type != kAnimation_Pulse;
+}
+
+unsigned int 
+LedAnimation::column(void) const
+{
+	return _column;
+}
+
+unsigned int 
+LedAnimation::row(void) const
+{
+	return _row;
+}
+
+unsigned int 
+LedAnimation::width(void) const
+{
+	return _width;
+}
+
+unsigned int 
+LedAnimation::height(void) const
+{
+	return _height;
+}
+
+void 
+LedAnimation::frame(uint16 bitMaps[kMaxRows]) const
+{
+	unsigned int r;
+	uint16 mask = (uint16)((1 << _width) - 1);
+
+	memset(bitMaps, 0, kMaxRows * sizeof(uint16));
+
+	switch (_type) {
+		case kAnimation_Frames:
+			for (r = 0; r < _height; r++)
+				bitMaps[r] = _frames[_step % _numFrames][r] & mask;
+			break;
+
+		case kAnimation_Blink:
+			if ((_step & 1) == 0) {
+				for (r = 0; r < _height; r++)
+					bitMaps[r] = _frames[0][r] & mask;
+			}
+			break;
+
+		case kAnimation_Scroll:
+			{
+				unsigned int dx = (_dx * (_step % _width)) % _width;
+				unsigned int dy = (_dy * (_step % _height)) % _height;
+
+				for (r = 0; r < _height; r++) {
+					uint16 source = _frames[0][(r + _height - dy) % _height] & mask;
+
+					if (dx == 0)
+						bitMaps[r] = source;
+					else
+						bitMaps[r] = (uint16)(((source << dx) | (source >> (_width - dx))) & mask);
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+float 
+LedAnimation::intensity(void) const
+{
+	unsigned int phase = _step % (2 * kPulseSteps);
+
+	if (phase > kPulseSteps)
+		phase = 2 * kPulseSteps - phase;
+
+	return _low + (_high - _low) * (float)phase / (float)kPulseSteps;
+}
+
+bool 
+LedAnimation::advance(void)
+{
+	_step++;
+
+	return _steps == 0 || _step < _steps;
+}
+
+void 
+LedAnimation::_setRegion(Type type, unsigned int column, unsigned int row, unsigned int width, unsigned int height)
+{
+	_type = type;
+	_column = column;
+	_row = row;
+	_width = width < (unsigned int)kMaxColumns ? width : (unsigned int)kMaxColumns;
+	_height = height < (unsigned int)kMaxRows ? height : (unsigned int)kMaxRows;
+	_step = 0;
+
+	if (_type != kAnimation_Pulse && (_width == 0 || _height == 0))
+		_type = kAnimation_None;
+}
@@ -0,0 +1,99 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#ifndef __LedAnimation_h__
+#define __LedAnimation_h__
+
+#include "types.h"
+
+// an animation a client uploads for a region of one device, which the server then plays
+// from its own timer instead of the client sending every frame.  the region and frames are
+// in osc coordinates: bit n of row r of a frame is the led at (column + n, row + r).
+class LedAnimation
+{
+public:
+	typedef enum {
+		kAnimation_None,
+		kAnimation_Frames,		// each frame in turn
+		kAnimation_Blink,		// the frame, then the region dark
+		kAnimation_Scroll,		// the frame, moved by dx, dy more each step and wrapped around the region
+		kAnimation_Pulse		// led intensity from low to high and back; draws no leds
+	} Type;
+
+	enum {
+		kMaxFrames = 32,
+		kMaxRows = 16,
+		kMaxColumns = 16,
+		kPulseSteps = 16		// steps from low to high intensity
+	};
+
+public:
+	LedAnimation(void);
+
+	void setFrames(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, unsigned int numFrames);
+	void setBlink(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps);
+	void setScroll(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, int dx, int dy);
+	void setPulse(float low, float high);
+	void stop(void);
+
+	// milliseconds between steps, and how many steps to play before stopping (0 for no end)
+	void setTiming(unsigned int interval, unsigned int steps);
+	unsigned int interval(void) const;
+
+	Type type(void) const;
+	bool drawsLeds(void) const;
+
+	unsigned int column(void) const;
+	unsigned int row(void) const;
+	unsigned int width(void) const;
+	unsigned int height(void) const;
+
+	// the region, or the intensity for a pulse, at the current step
+	void frame(uint16 bitMaps[kMaxRows]) const;
+	float intensity(void) const;
+
+	// moves to the next step.  returns false once the last step has been played.
+	bool advance(void);
+
+private:
+	void _setRegion(Type type, unsigned int column, unsigned int row, unsigned int width, unsigned int height);
+
+private:
+	Type _type;
+	unsigned int _column, _row, _width, _height;
+	unsigned int _interval;
+	unsigned int _steps;
+	unsigned int _step;
+
+	uint16 _frames[kMaxFrames][kMaxRows];
+	unsigned int _numFrames;
+
+	int _dx, _dy;
+	float _low, _high;
+};
+
+#endif // __LedAnimation_h__
@@ -0,0 +1,138 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#include "../stdafx.h"
+#include "LedBitmap.h"
+
+
+LedBitmap::LedBitmap(unsigned int column, unsigned int row, unsigned int width, unsigned int height)
+	: _leds(width * height, 0)
+{
+	_column = column;
+	_row = row;
+	_width = width;
+	_height = height;
+}
+
+unsigned int 
+LedBitmap::column(void) const
+{
+	return _column;
+}
+
+unsigned int 
+LedBitmap::row(void) const
+{
+	return _row;
+}
+
+unsigned int 
+LedBitmap::width(void) const
+{
+	return _width;
+}
+
+unsigned int 
+LedBitmap::height(void) const
+{
+	return _height;
+}
+
+bool 
+LedBitmap::contains(unsigned int column, unsigned int row) const
+{
+	return column - _column < _width && row - _row < _height;
+}
+
+bool 
+LedBitmap::led(unsigned int column, unsigned int row) const
+{
+	if (!contains(column, row))
+		return false;
+
+	return _leds[(row - _row) * _width + (column - _column)] != 0;
+}
+
+void 
+LedBitmap::setLed(unsigned int column, unsigned int row, bool state)
+{
+	if (contains(column, row))
+		_leds[(row - _row) * _width + (column - _column)] = state ? 1 : 0;
+}
+
+void 
+LedBitmap::shift(int dx, int dy, bool wrap)
+{
+	vector<unsigned char> from(_leds);
+	int width = (int)_width, height = (int)_height;
+
+	for (int r = 0; r < height; r++) {
+		for (int c = 0; c < width; c++) {
+			int fromColumn = c - dx, fromRow = r - dy;
+
+			if (wrap) {
+				fromColumn = ((fromColumn % width) + width) % width;
+				fromRow = ((fromRow % height) + height) % height;
+			}
+
+			if (fromColumn >= 0 && fromColumn < width && fromRow >= 0 && fromRow < height)
+				_leds[r * width + c] = from[fromRow * width + fromColumn];
+			else
+				_leds[r * width + c] = 0;
+		}
+	}
+}
+
+void 
+LedBitmap::blit(unsigned int column, unsigned int row, unsigned int width, unsigned int height, const unsigned int *bitMaps)
+{
+	for (unsigned int r = 0; r < height && r < kMaxSize; r++) {
+		for (unsigned int c = 0; c < width && c < 32; c++)
+			setLed(column + c, row + r, (bitMaps[r] & (1U << c)) != 0);
+	}
+}
+
+void 
+LedBitmap::copy(unsigned int fromColumn, unsigned int fromRow, unsigned int width, unsigned int height, unsigned int toColumn, unsigned int toRow)
+{
+	// read before writing, so overlapping rectangles copy as they were
+	LedBitmap from(*this);
+
+	for (unsigned int r = 0; r < height && r < kMaxSize; r++) {
+		for (unsigned int c = 0; c < width && c < kMaxSize; c++)
+			setLed(toColumn + c, toRow + r, from.led(fromColumn + c, fromRow + r));
+	}
+}
+
+void 
+LedBitmap::fill(unsigned int column, unsigned int row, unsigned int width, unsigned int height, bool state)
+{
+	for (unsigned int r = 0; r < height && r < kMaxSize; r++) {
+		for (unsigned int c = 0; c < width && c < kMaxSize; c++)
+			setLed(column + c, row + r, state);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#ifndef __LedCanvas_h__
+#define __LedCanvas_h__
+
+#include "MonomeXXhDevice.h"
+#include <vector>
+using namespace std;
+
+// the devices sharing one osc prefix, laid out as one surface by their osc start columns
+// and rows.  led messages go only to the devices they overlap, looked up in an index of
+// 8x8 cells built with the layout, and row and column bitmaps are cut into each device's
+// slice once instead of every device picking through the whole message.
+class LedCanvas
+{
+public:
+	enum { kCellSize = 8, kMaxCells = 32 };	// the index covers osc columns and rows 0-255
+	enum { kBaseLayer = -1 };				// draws with the plain led messages rather than on a layer
+
+public:
+	LedCanvas(void);
+
+	void addDevice(MonomeXXhDevice *device);
+	const vector<MonomeXXhDevice *>& devices(void) const;
+
+	void ledStateChange(unsigned int column, unsigned int row, bool state, int layer = kBaseLayer);
+	// bitMaps[k] holds columns 8k to 8k + 7 of the row, or rows 8k to 8k + 7 of the column.
+	// a value of 256 or more leaves its 8 leds as they are.
+	void ledRow(unsigned int row, unsigned int numBitMaps, const unsigned int *bitMaps, int layer = kBaseLayer);
+	void ledColumn(unsigned int column, unsigned int numBitMaps, const unsigned int *bitMaps, int layer = kBaseLayer);
+	// on the base layer each device keeps its own /frame handling; on a layer it is an 8x8 region
+	void ledFrame(unsigned int column, unsigned int row, unsigned char bitMaps[8], int layer = kBaseLayer);
+
+private:
+	typedef struct {
+		unsigned int column, row, width, height;	// the device's osc led bounds
+	} Tile;
+
+	enum { kMaxIndexedTiles = 32 };	// tiles past these are checked on every lookup
+
+	void _drawRegion(unsigned int tile, int layer, unsigned int column, unsigned int row, unsigned int width, unsigned int height, const uint16 *bitMaps, const uint16 *keep);
+	uint32 _tilesInRect(unsigned int column, unsigned int row, unsigned int width, unsigned int height) const;
+	bool _overlaps(unsigned int tile, uint32 candidates, unsigned int column, unsigned int row, unsigned int width, unsigned int height) const;
+	unsigned int _sliceLength(unsigned int numBitMaps, unsigned int first, unsigned int count) const;
+	uint16 _slice(unsigned int numBitMaps, const unsigned int *bitMaps, unsigned int first, unsigned int count, uint16 &keep) const;
+
+private:
+	vector<MonomeXXhDevice *> _devices;
+	vector<Tile> _tiles;
+
+	uint32 _cells[kMaxCells][kMaxCells];	// bit t is set in each cell tile t overlaps
+	uint32 _rowBands[kMaxCells];			// every tile overlapping a band of kCellSize rows
+	uint32 _columnBands[kMaxCells];
+};
+
+#endif // __LedCanvas_h__
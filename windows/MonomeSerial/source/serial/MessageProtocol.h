@@ -0,0 +1,253 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#ifndef __MessageProtocol_h__
+#define __MessageProtocol_h__
+
+#include "message.h"
+#include "message256.h"
+#include "messageMK.h"
+
+// the serial protocols of each device family as one table per direction.  every message
+// starts with its opcode in the top nibble of the first byte.  the tables give each
+// message's opcode and length; the families below turn them into message types, framing
+// lengths and compile time checks, and the field templates into inline shifts and masks.
+//
+// a new family is a pair of tables, a struct like the ones below, and its fields.
+
+// static_assert where the compiler has it (vs2010 does).  otherwise a negative array size
+// stops the build, marked unused so the checks inside the encoders don't warn
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define MESSAGE_STATIC_ASSERT(condition, name) static_assert(condition, #name)
+#elif defined(__GNUC__)
+#define MESSAGE_STATIC_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1] __attribute__((unused))
+#else
+#define MESSAGE_STATIC_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]
+#endif
+
+enum { kMessageMaxLength = 9 };		// a 256 led frame
+
+// name, opcode, length in bytes
+#define MESSAGE_40H_INPUTS(X) \
+	X(ButtonPress,		kMessageTypeButtonPress,	2) \
+	X(AdcVal,			kMessageTypeAdcVal,			2) \
+	X(EncVal,			kMessageTypeEncVal,			2)
+
+#define MESSAGE_40H_OUTPUTS(X) \
+	X(LedStateChange,	kMessageTypeLedStateChange,	2) \
+	X(LedIntensity,		kMessageTypeLedIntensity,	2) \
+	X(LedTest,			kMessageTypeLedTest,		2) \
+	X(AdcEnable,		kMessageTypeAdcEnable,		2) \
+	X(Shutdown,			kMessageTypeShutdown,		2) \
+	X(LedSetRow,		kMessageTypeLedSetRow,		2) \
+	X(LedSetColumn,		kMessageTypeLedSetColumn,	2) \
+	X(EncEnable,		kMessageTypeEncEnable,		2)
+
+// 256, 128 and 64
+#define MESSAGE_SERIES_INPUTS(X) \
+	X(KeyDown,			kMessageType_256_keydown,			2) \
+	X(KeyUp,			kMessageType_256_keyup,				2) \
+	X(Tilt,				kMessageTypeTiltEvent,				2) \
+	X(AuxiliaryInput,	kMessageType_256_auxiliaryInput,	2)
+
+#define MESSAGE_SERIES_OUTPUTS(X) \
+	X(LedOn,			kMessageType_256_led_on,			2) \
+	X(LedOff,			kMessageType_256_led_off,			2) \
+	X(LedRow1,			kMessageType_256_led_row1,			2) \
+	X(LedColumn1,		kMessageType_256_led_col1,			2) \
+	X(LedRow2,			kMessageType_256_led_row2,			3) \
+	X(LedColumn2,		kMessageType_256_led_col2,			3) \
+	X(LedFrame,			kMessageType_256_led_frame,			9) \
+	X(Clear,			kMessageType_256_clear,				1) \
+	X(Intensity,		kMessageType_256_intensity,			1) \
+	X(Mode,				kMessageType_256_mode,				1) \
+	X(ActivatePort,		kMessageType_256_activatePort,		1) \
+	X(DeactivatePort,	kMessageType_256_deactivatePort,	1)
+
+#define MESSAGE_MK_INPUTS(X) \
+	X(KeyDown,			kMessageType_mk_keydown,	2) \
+	X(KeyUp,			kMessageType_mk_keyup,		2) \
+	X(Tilt,				kMessageTypeTiltEvent,		2) \
+	X(AuxOut,			kMessageType_mk_auxout,		3)
+
+#define MESSAGE_MK_OUTPUTS(X) \
+	X(LedOn,			kMessageType_mk_led_on,		2) \
+	X(LedOff,			kMessageType_mk_led_off,	2) \
+	X(LedRow1,			kMessageType_mk_led_row1,	2) \
+	X(LedColumn1,		kMessageType_mk_led_col1,	2) \
+	X(LedRow2,			kMessageType_mk_led_row2,	3) \
+	X(LedColumn2,		kMessageType_mk_led_col2,	3) \
+	X(LedFrame,			kMessageType_mk_led_frame,	9) \
+	X(Clear,			kMessageType_mk_clear,		1) \
+	X(Intensity,		kMessageType_mk_intensity,	1) \
+	X(Mode,				kMessageType_mk_mode,		1) \
+	X(Grids,			kMessageType_mk_grids,		1) \
+	X(AuxIn,			kMessageType_mk_auxin,		3)
+
+// bits Shift to Shift + Bits - 1 of byte Byte
+template <unsigned int Byte, unsigned int Shift, unsigned int Bits>
+struct MessageField
+{
+	MESSAGE_STATIC_ASSERT(Bits > 0 && Shift + Bits <= 8, field_fits_in_its_byte);
+	MESSAGE_STATIC_ASSERT(Byte < kMessageMaxLength, field_inside_longest_message);
+
+	enum { kByte = Byte, kMask = ((1 << Bits) - 1) << Shift };
+
+	static inline uint8 get(const uint8 *data) { return (uint8)((data[Byte] >> Shift) & ((1 << Bits) - 1)); }
+	static inline void set(uint8 *data, unsigned int value) { data[Byte] = (uint8)((data[Byte] & ~kMask) | ((value << Shift) & kMask)); }
+};
+
+typedef MessageField<0, 4, 4> MessageOpcodeField;
+typedef MessageField<0, 0, 4> MessageArgumentField;		// the low nibble of the first byte
+typedef MessageField<1, 4, 4> MessageXField;
+typedef MessageField<1, 0, 4> MessageYField;
+typedef MessageField<1, 0, 8> MessageDataField;			// the whole second byte
+
+template <unsigned int Opcode, unsigned int Length>
+struct MessageType
+{
+	MESSAGE_STATIC_ASSERT(Opcode < 16, opcode_fits_in_a_nibble);
+	MESSAGE_STATIC_ASSERT(Length >= 1 && Length <= kMessageMaxLength, length_in_range);
+
+	enum { kOpcode = Opcode, kLength = Length };
+
+	static inline bool match(const uint8 *data) { return MessageOpcodeField::get(data) == Opcode; }
+
+	// writes the opcode and the first byte's argument, and clears the rest
+	static inline void begin(uint8 *data, unsigned int argument = 0)
+	{
+		data[0] = (uint8)((Opcode << 4) | (argument & 0xF));
+		for (unsigned int i = 1; i < Length; i++)
+			data[i] = 0;
+	}
+};
+
+// the switches double as checks: two messages with one opcode are a duplicate case label
+#define MESSAGE_DECLARE_TYPE(name, opcode, length) typedef MessageType<opcode, length> name;
+#define MESSAGE_LENGTH_CASE(name, opcode, length) case opcode: return length;
+
+#define MESSAGE_DECLARE_FAMILY(inputs, outputs) \
+	inputs(MESSAGE_DECLARE_TYPE) \
+	struct Output { outputs(MESSAGE_DECLARE_TYPE) }; \
+	/* bytes in the message starting with firstByte, or 0 if there is no such message */ \
+	static inline unsigned int inputLength(uint8 firstByte) \
+	{ \
+		switch (firstByte >> 4) { \
+		inputs(MESSAGE_LENGTH_CASE) \
+		default: return 0; \
+		} \
+	} \
+	static inline unsigned int outputLength(uint8 firstByte) \
+	{ \
+		switch (firstByte >> 4) { \
+		outputs(MESSAGE_LENGTH_CASE) \
+		default: return 0; \
+		} \
+	}
+
+struct Message40h
+{
+	MESSAGE_DECLARE_FAMILY(MESSAGE_40H_INPUTS, MESSAGE_40H_OUTPUTS)
+
+	typedef MessageArgumentField ButtonState;
+	typedef MessageXField ButtonX;
+	typedef MessageYField ButtonY;
+	typedef MessageField<0, 2, 2> AdcPort;
+	typedef MessageField<0, 0, 2> AdcValueHigh;
+	typedef MessageDataField AdcValueLow;
+	typedef MessageArgumentField EncPort;
+	typedef MessageDataField EncValue;
+
+	static inline uint16 adcValue(const uint8 *data) { return (uint16)((AdcValueHigh::get(data) << 8) | AdcValueLow::get(data)); }
+};
+
+struct MessageSeries
+{
+	MESSAGE_DECLARE_FAMILY(MESSAGE_SERIES_INPUTS, MESSAGE_SERIES_OUTPUTS)
+
+	typedef MessageXField KeyX;
+	typedef MessageYField KeyY;
+	typedef MessageArgumentField TiltAxis;
+	typedef MessageDataField TiltValue;
+	typedef MessageArgumentField AuxPort;
+	typedef MessageDataField AuxValue;
+};
+
+struct MessageMK
+{
+	MESSAGE_DECLARE_FAMILY(MESSAGE_MK_INPUTS, MESSAGE_MK_OUTPUTS)
+
+	typedef MessageXField KeyX;
+	typedef MessageYField KeyY;
+	typedef MessageArgumentField TiltAxis;
+	typedef MessageDataField TiltValue;
+	typedef MessageArgumentField AuxOutType;
+	typedef MessageDataField AuxOutPort;
+	typedef MessageField<2, 0, 8> AuxOutValue;
+};
+
+// encoders for the three shapes the led messages come in
+template <class Type>
+inline void messagePackXY(uint8 *data, unsigned int x, unsigned int y)
+{
+	MESSAGE_STATIC_ASSERT(Type::kLength == 2, xy_messages_are_two_bytes);
+
+	Type::begin(data);
+	MessageXField::set(data, x);
+	MessageYField::set(data, y);
+}
+
+template <class Type>
+inline void messagePackArgument(uint8 *data, unsigned int argument)
+{
+	MESSAGE_STATIC_ASSERT(Type::kLength == 1, argument_messages_are_one_byte);
+
+	Type::begin(data, argument);
+}
+
+// an index in the first byte, then Type::kLength - 1 bytes of data
+template <class Type>
+inline void messagePackIndexed(uint8 *data, unsigned int index, const uint8 *bytes)
+{
+	MESSAGE_STATIC_ASSERT(Type::kLength >= 2, indexed_messages_carry_data);
+
+	Type::begin(data, index);
+	for (unsigned int i = 1; i < Type::kLength; i++)
+		data[i] = bytes[i - 1];
+}
+
+// the C structs the pack functions fill have to agree with the tables
+MESSAGE_STATIC_ASSERT(sizeof(t_message) == MessageSeries::KeyDown::kLength, t_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_256_1byte_message) == MessageSeries::Output::Clear::kLength, t_256_1byte_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_256_3byte_message) == MessageSeries::Output::LedRow2::kLength, t_256_3byte_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_256_frame_message) == MessageSeries::Output::LedFrame::kLength, t_256_frame_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_mk_1byte_message) == MessageMK::Output::Clear::kLength, t_mk_1byte_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_mk_3byte_message) == MessageMK::AuxOut::kLength, t_mk_3byte_message_matches_table);
+MESSAGE_STATIC_ASSERT(sizeof(t_mk_frame_message) == MessageMK::Output::LedFrame::kLength, t_mk_frame_message_matches_table);
+MESSAGE_STATIC_ASSERT(kMessage_256_NumTypes <= 16 && kMessage_mk_NumTypes <= 16, opcodes_fit_in_a_nibble);
+
+#endif // __MessageProtocol_h__
@@ -0,0 +1,215 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+
+#include "../stdafx.h"
+#include "SensorFilter.h"
+
+#include <math.h>
+
+
+SensorFilter::SensorFilter(void)
+{
+	_fullScale = 1.f;
+	_steps = 0;
+
+	_deadband = 0.f;
+	_interval = 0;
+	_smoothing = kSmoothing_None;
+	_amount = 1.f;
+
+	_historyLength = 0;
+	_historyIndex = 0;
+	_smoothed = 0.f;
+	_primed = false;
+
+	_sent = false;
+	_lastSent = 0.f;
+	_lastStep = 0;
+	_lastSentTime = 0;
+
+	_holding = false;
+	_held = 0.f;
+	_heldStep = 0;
+	_retryScheduled = false;
+}
+
+void 
+SensorFilter::setRange(float fullScale, unsigned int steps)
+{
+	_fullScale = fullScale > 0.f ? fullScale : 1.f;
+	_steps = steps;
+}
+
+void 
+SensorFilter::setDeadband(float deadband)
+{
+	_deadband = deadband > 0.f ? deadband : 0.f;
+}
+
+float 
+SensorFilter::deadband(void) const
+{
+	return _deadband;
+}
+
+void 
+SensorFilter::setInterval(unsigned int milliseconds)
+{
+	_interval = milliseconds;
+}
+
+unsigned int 
+SensorFilter::interval(void) const
+{
+	return _interval;
+}
+
+void 
+SensorFilter::setSmoothing(Smoothing smoothing, float amount)
+{
+	_smoothing = smoothing;
+	_amount = amount;
+
+	if (_smoothing == kSmoothing_OnePole && (_amount <= 0.f || _amount > 1.f))
+		_amount = 1.f;
+	else if (_smoothing == kSmoothing_Median && (_amount < 1.f || _amount > kMaxMedianWindow))
+		_amount = 3.f;
+
+	// start again from the next sample rather than mixing in the old filter's state
+	_historyLength = 0;
+	_historyIndex = 0;
+	_primed = false;
+}
+
+SensorFilter::Smoothing 
+SensorFilter::smoothing(void) const
+{
+	return _smoothing;
+}
+
+float 
+SensorFilter::smoothingAmount(void) const
+{
+	return _amount;
+}
+
+bool 
+SensorFilter::process(float sample, unsigned int outputSteps, HostTime time, float &value, HostTime &retryTime)
+{
+	float smoothed = _smooth(sample);
+	unsigned int steps = outputSteps != 0 ? outputSteps : _steps;
+	long step = steps != 0 ? (long)(smoothed / _fullScale * steps) : 0;
+
+	retryTime = 0;
+
+	// nothing the output could show, or inside the deadband: drop it, and anything held with it
+	if (_sent && ((steps != 0 && step == _lastStep) || fabs(smoothed - _lastSent) < _deadband * _fullScale)) {
+		_holding = false;
+		return false;
+	}
+
+	if (_sent && _interval != 0) {
+		HostTime sendTime = _lastSentTime + EventScheduler::hostTimeFromMilliseconds(_interval);
+
+		if (time < sendTime) {
+			_holding = true;
+			_held = smoothed;
+			_heldStep = step;
+
+			if (!_retryScheduled) {
+				_retryScheduled = true;
+				retryTime = sendTime;
+			}
+
+			return false;
+		}
+	}
+
+	_sent = true;
+	_holding = false;
+	_lastSent = smoothed;
+	_lastStep = step;
+	_lastSentTime = time;
+
+	value = smoothed;
+	return true;
+}
+
+bool 
+SensorFilter::retry(HostTime time, float &value, HostTime &retryTime)
+{
+	retryTime = 0;
+	_retryScheduled = false;
+
+	if (!_holding)
+		return false;
+
+	_holding = false;
+	_lastSent = _held;
+	_lastStep = _heldStep;
+	_lastSentTime = time;
+
+	value = _held;
+	return true;
+}
+
+float 
+SensorFilter::_smooth(float sample)
+{
+	if (_smoothing == kSmoothing_OnePole) {
+		if (!_primed)
+			_smoothed = sample;
+		else
+			_smoothed += _amount * (sample - _smoothed);
+
+		_primed = true;
+		return _smoothed;
+	}
+	else if (_smoothing == kSmoothing_Median) {
+		unsigned int window = (unsigned int)_amount;
+		float sorted[kMaxMedianWindow];
+		unsigned int i, j;
+
+		_history[_historyIndex] = sample;
+		_historyIndex = (_historyIndex + 1) % window;
+		if (_historyLength < window)
+			_historyLength++;
+
+		// insertion sort, the window is tiny
+		for (i = 0; i < _historyLength; i++) {
+			float v = _history[i];
+
+			for (j = i; j > 0 && sorted[j - 1] > v; j--)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = v;
+		}
+
+		return sorted[_historyLength / 2];
+	}
+
+	return sample;
+}
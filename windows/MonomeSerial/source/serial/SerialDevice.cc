@@ -98,6 +98,7 @@ SerialDevice::SerialDevice(const string& serialNumber)
 	bool opened = false;
 
 	_serial = serialNumber;
+	_readTime = 0;
     _unexpectedDeviceRemovalFlag = false;
 	FT_STATUS ftStatus;
 
@@ -164,6 +165,12 @@ SerialDevice::read(char *buffer, size_t len)
 		return 0;
 	}
 
+	if (BytesReceived > 0) {
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		_readTime = counter.QuadPart;
+	}
+
 	return BytesReceived;
 }
 
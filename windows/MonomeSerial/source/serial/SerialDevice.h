@@ -58,6 +58,9 @@ public:
 	unsigned long read(char *buffer, size_t len);
     void flush(void);
 
+	// host time (the performance counter) at which the last successful read returned
+	unsigned __int64 readTime(void) const;
+
 	// added by daniel b for Windows FTDI version.  returns the # of bytes in the receive queue.
 	unsigned long hasBytes(void);
 
@@ -71,6 +74,7 @@ public:
 private:
 	string _serial;
     FT_HANDLE _fileHandle;
+	unsigned __int64 _readTime;
     bool _unexpectedDeviceRemovalFlag;
 };
 
@@ -86,6 +90,12 @@ SerialDevice::fileHandle(void) const
     return _fileHandle;
 }
 
+inline unsigned __int64 
+SerialDevice::readTime(void) const
+{
+	return _readTime;
+}
+
 inline bool
 SerialDevice::unexpectedDeviceRemovalFlag(void)
 {
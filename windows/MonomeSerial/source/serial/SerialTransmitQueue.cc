@@ -0,0 +1,120 @@
+/*
+ * MonomeSerial, a simple MIDI and OpenSoundControl routing utility for the monome 40h
+ * Copyright (C) 2007 Joe Lake
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+//--------------------------------------------
+/*
+ * Current code by Daniel Battaglia and Steve Duda.
+ * Released under the original GPL
+ */
+//--------------------------------------------
+
+
+#include "../stdafx.h"
+#include "SerialTransmitQueue.h"
+
+#include <string.h>
+
+
+// how long each class may wait, in milliseconds
+static const double _budgets[SerialTransmitQueue::kNumClasses] = {
+	0.5,	// interactive
+	5.0,	// control
+	20.0	// bulk
+};
+
+SerialTransmitQueue::SerialTransmitQueue(void)
+{
+	for (unsigned int c = 0; c < kClass_Bulk; c++) {
+		_queues[c].length = 0;
+		_queues[c].deadline = 0;
+	}
+
+	_bulkPending = false;
+	_bulkDeadline = 0;
+}
+
+bool 
+SerialTransmitQueue::push(Class c, const void *data, unsigned int len, HostTime time)
+{
+	if (c >= kClass_Bulk || len > space(c))
+		return false;
+
+	Queue &queue = _queues[c];
+
+	if (queue.length == 0)
+		queue.deadline = time + EventScheduler::hostTimeFromMilliseconds(_budgets[c]);
+
+	memcpy(queue.data + queue.length, data, len);
+	queue.length += len;
+
+	return true;
+}
+
+void 
+SerialTransmitQueue::markBulk(HostTime time, bool urgent)
+{
+	HostTime deadline = urgent ? time : time + EventScheduler::hostTimeFromMilliseconds(_budgets[kClass_Bulk]);
+
+	if (!_bulkPending || deadline < _bulkDeadline)
+		_bulkDeadline = deadline;
+
+	_bulkPending = true;
+}
+
+// earliest deadline first; on a tie the more interactive class wins
+SerialTransmitQueue::Class 
+SerialTransmitQueue::next(bool bulk) const
+{
+	Class best = kNumClasses;
+	HostTime bestDeadline = 0;
+
+	for (unsigned int c = 0; c < kClass_Bulk; c++) {
+		if (_queues[c].length > 0 && (best == kNumClasses || _queues[c].deadline < bestDeadline)) {
+			best = (Class)c;
+			bestDeadline = _queues[c].deadline;
+		}
+	}
+
+	if (bulk && _bulkPending && (best == kNumClasses || _bulkDeadline < bestDeadline))
+		best = kClass_Bulk;
+
+	return best;
+}
+
+bool 
+SerialTransmitQueue::overdue(HostTime now) const
+{
+	for (unsigned int c = 0; c < kClass_Bulk; c++) {
+		if (_queues[c].length > 0 && _queues[c].deadline < now)
+			return true;
+	}
+
+	return _bulkPending && _bulkDeadline < now;
+}
+
+unsigned int 
+SerialTransmitQueue::take(Class c, uint8 *buffer)
+{
+	Queue &queue = _queues[c];
+	unsigned int len = queue.length;
+
+	memcpy(buffer, queue.data, len);
+	queue.length = 0;
+
+	return len;
+}
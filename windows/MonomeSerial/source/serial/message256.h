@@ -59,8 +59,7 @@ typedef enum {
     kMessage_256_NumTypes //15
 } e256MessageTypes;
 
-const int kMessageSize_256[15] = {2,2,2,2, 3,2,3,3,
-								  9,1,1,1, 1,1,2};
+// message lengths, for both directions, are in MessageProtocol.h
 
 
 typedef struct {